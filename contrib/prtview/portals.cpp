@@ -34,6 +34,7 @@
 #include "cullable.h"
 
 #include "prtview.h"
+#include "prtfile.h"
 
 const int LINE_BUF = 1000;
 
@@ -69,7 +70,7 @@ bool CBspPortal::Build(char *def)
     char *c = def;
     unsigned int n;
     int dummy1, dummy2;
-    int res_cnt, i;
+    int res_cnt;
 
     if (portals.hint_flags) {
         res_cnt = sscanf(def, "%u %d %d %d", &point_count, &dummy1, &dummy2, (int *) &hint);
@@ -95,7 +96,44 @@ bool CBspPortal::Build(char *def)
         c++;
 
         sscanf(c, "%f %f %f", point[n].p, point[n].p + 1, point[n].p + 2);
+    }
+
+    Finish();
+
+    return true;
+}
+
+bool CBspPortal::Build(const float *points, unsigned count, bool is_hint)
+{
+    unsigned int n;
+
+    point_count = count;
+    hint = is_hint;
+
+    if (point_count < 3) {
+        return false;
+    }
+
+    point = new CBspPoint[point_count];
+    inner_point = new CBspPoint[point_count];
+
+    for (n = 0; n < point_count; n++) {
+        point[n].p[0] = points[n * 3 + 0];
+        point[n].p[1] = points[n * 3 + 1];
+        point[n].p[2] = points[n * 3 + 2];
+    }
+
+    Finish();
+
+    return true;
+}
+
+void CBspPortal::Finish()
+{
+    unsigned int n;
+    int i;
 
+    for (n = 0; n < point_count; n++) {
         center.p[0] += point[n].p[0];
         center.p[1] += point[n].p[1];
         center.p[2] += point[n].p[2];
@@ -131,8 +169,6 @@ bool CBspPortal::Build(char *def)
     fp_color_random[1] = (float) (rand() & 0xff) / 255.0f;
     fp_color_random[2] = (float) (rand() & 0xff) / 255.0f;
     fp_color_random[3] = 1.0f;
-
-    return true;
 }
 
 CPortals::CPortals()
@@ -172,6 +208,23 @@ void CPortals::Load()
 
     FILE *in;
 
+    in = fopen(fn, "rb");
+
+    if (in == NULL) {
+        globalOutputStream() << "  ERROR - could not open file.\n";
+
+        return;
+    }
+
+    if (fread(buf, 1, 4, in) == 4 && strncmp(PRTFILE_BINARY_IDENT, buf, 4) == 0) {
+        LoadBinary(in);
+        fclose(in);
+
+        return;
+    }
+
+    fclose(in);
+
     in = fopen(fn, "rt");
 
     if (in == NULL) {
@@ -180,6 +233,8 @@ void CPortals::Load()
         return;
     }
 
+    memset(buf, 0, LINE_BUF + 1);
+
     if (!fgets(buf, LINE_BUF, in)) {
         fclose(in);
 
@@ -302,6 +357,112 @@ void CPortals::Load()
     globalOutputStream() << "  " << node_count << " portals read in.\n";
 }
 
+// in is positioned just after the ident
+void CPortals::LoadBinary(FILE *in)
+{
+    prtFileHeader_t header;
+    int num_faces, num_points;
+    unsigned int num_records, n;
+    size_t body_size;
+    unsigned char *body;
+    prtFileRecord_t *records;
+    float *points;
+
+    if (fread(reinterpret_cast<char *>( &header ) + 4, 1, sizeof(header) - 4, in) != sizeof(header) - 4) {
+        globalOutputStream() << "  ERROR - File ended prematurely.\n";
+
+        return;
+    }
+
+    if (GINT32_FROM_LE(header.version) != PRTFILE_BINARY_VERSION) {
+        globalOutputStream() << "  ERROR - Unsupported binary portal file version " << GINT32_FROM_LE(header.version)
+                             << ".\n";
+
+        return;
+    }
+
+    node_count = GINT32_FROM_LE(header.numClusters);
+    portal_count = GINT32_FROM_LE(header.numPortals);
+    num_faces = GINT32_FROM_LE(header.numFaces);
+    num_points = GINT32_FROM_LE(header.numPoints);
+
+    // bound every count before the body size is computed from them
+    if (portal_count > 0xFFFF || num_faces < 0 || num_faces > 0xFFFFF || num_points < 0 || num_points > 0xFFFFFF) {
+        portal_count = 0;
+        node_count = 0;
+
+        globalOutputStream() << "  ERROR - Extreme number of portals, aborting.\n";
+
+        return;
+    }
+
+    if (portal_count == 0) {
+        node_count = 0;
+
+        globalOutputStream() << "  ERROR - number of portals equals 0, aborting.\n";
+
+        return;
+    }
+
+    num_records = portal_count + num_faces;
+    body_size = num_records * sizeof(prtFileRecord_t) + num_points * 3 * sizeof(float);
+    body = new unsigned char[body_size];
+
+    if (fread(body, 1, body_size, in) != body_size) {
+        delete[] body;
+        portal_count = 0;
+        node_count = 0;
+
+        globalOutputStream() << "  ERROR - File ended prematurely.\n";
+
+        return;
+    }
+
+    if (PrtFileChecksum(body, body_size) != GUINT32_FROM_LE(header.checksum)) {
+        delete[] body;
+        portal_count = 0;
+        node_count = 0;
+
+        globalOutputStream() << "  ERROR - Checksum mismatch, the portal file is damaged.\n";
+
+        return;
+    }
+
+#if G_BYTE_ORDER != G_LITTLE_ENDIAN
+    for (n = 0; n < body_size / 4; n++) {
+        reinterpret_cast<guint32 *>( body )[n] = GUINT32_FROM_LE(reinterpret_cast<guint32 *>( body )[n]);
+    }
+#endif
+
+    records = reinterpret_cast<prtFileRecord_t *>( body );
+    points = reinterpret_cast<float *>( records + num_records );
+
+    portal = new CBspPortal[portal_count];
+    portal_sort = new int[portal_count];
+
+    // the binary format always carries the hint flags
+    hint_flags = true;
+
+    for (n = 0; n < portal_count; n++) {
+        const prtFileRecord_t &r = records[n];
+
+        if (r.firstPoint < 0 || r.numPoints < 0 || r.firstPoint > num_points - r.numPoints
+            || !portal[n].Build(points + r.firstPoint * 3, r.numPoints, (r.flags & PRTFILE_FLAG_HINT) != 0)) {
+            delete[] body;
+            Purge();
+
+            globalOutputStream() << "  ERROR - Information for portal number " << n + 1 << " of " << portal_count
+                                 << " is not formatted correctly.\n";
+
+            return;
+        }
+    }
+
+    delete[] body;
+
+    globalOutputStream() << "  " << node_count << " portals read in.\n";
+}
+
 #include "math/matrix.h"
 
 const char *g_state_solid = "$plugins/prtview/solid";
@@ -21,6 +21,7 @@
 #define _PORTALS_H_
 
 #include <glib.h>
+#include <stdio.h>
 #include "irender.h"
 #include "renderable.h"
 #include "math/vector.h"
@@ -51,6 +52,11 @@ public:
     bool hint;
 
     bool Build(char *def);
+
+    bool Build(const float *points, unsigned count, bool is_hint);
+
+private:
+    void Finish();
 };
 
 #ifdef PATH_MAX
@@ -78,6 +84,7 @@ protected:
 public:
 
     void Load();     // use filename in fn
+    void LoadBinary(FILE *in);
     void Purge();
 
     void FixColors();
@@ -0,0 +1,82 @@
+/*
+   Copyright (C) 1999-2006 Id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#if !defined( INCLUDED_PRTFILE_H )
+#define INCLUDED_PRTFILE_H
+
+/*
+   binary portal file (.prt), shared by q3map2 and the prtview plugin
+
+   the text "PRT1" format is still the default; this one is written by
+   q3map2 -bsp -binaryprt and recognized by its ident.  all values are
+   little-endian and 4 byte aligned, so the readers only swap the body
+   and copy the points out of it:
+
+   prtFileHeader_t
+   prtFileRecord_t records[ numPortals + numFaces ]   portals first, then faces
+   float points[ numPoints ][ 3 ]
+
+   the checksum covers everything after the header
+ */
+
+#define PRTFILE_BINARY_IDENT    "PRTB"
+#define PRTFILE_BINARY_VERSION  1
+
+#define PRTFILE_FLAG_HINT       1
+#define PRTFILE_FLAG_SKY        2
+
+typedef struct prtFileHeader_s
+{
+	char ident[ 4 ];
+	int version;
+	int numClusters;
+	int numPortals;
+	int numFaces;
+	int numPoints;
+	unsigned int checksum;
+	int reserved;
+}
+prtFileHeader_t;
+
+typedef struct prtFileRecord_s
+{
+	int numPoints;
+	int firstPoint;
+	int clusters[ 2 ];          /* faces only use clusters[ 0 ], clusters[ 1 ] is -1 */
+	int flags;
+}
+prtFileRecord_t;
+
+/* 32 bit fnv-1a over the file body */
+static inline unsigned int PrtFileChecksum( const void *data, unsigned int length ){
+	const unsigned char *p = (const unsigned char *) data;
+	unsigned int hash = 2166136261u;
+	unsigned int i;
+
+	for ( i = 0; i < length; i++ )
+	{
+		hash ^= p[ i ];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+#endif
@@ -0,0 +1,445 @@
+# Times q3map2 compiles over the regression test maps and a few generated
+# large maps, and checks that different q3map2 binaries write the same bsp
+# files.
+#
+# Usage:
+#   python3 bench.py [--runs N] [--threads N] [--stages bsp,vis,light,pipeline]
+#                    [--bsp-args "-meta"] [--vis-args ""] [--light-args "-fast"]
+#                    [--maps a,b] [--no-synthetic] [--scale N]
+#                    [--save baseline.json] [--baseline baseline.json]
+#                    [--tolerance 0.1] q3map2 [q3map2 ...]
+#
+# Every stage of every map is run --runs times by every binary with a fixed
+# thread count, the best time is reported together with the peak memory and
+# the light rays traced (both from q3map2 -profile, "-" for binaries without
+# it or without ray counts).  The first binary is the
+# reference: the others get their speedup against it, and a bsp that differs
+# from its is marked with a '*' (the script then exits with 2).  Bytes
+# q3map2 leaves uninitialised or stamps with its version are cleared before
+# the bsp files are compared.  Lit bsp files only compare reliably with
+# --threads 1.
+#
+# The synthetic_* maps are generated here (rooms for vis, brush terrain for
+# meta surfaces, curved patches), --scale makes them larger.  They use no
+# game assets, missing textures only cause warnings.
+#
+# --save writes the reference binary's results to a file, --baseline reads
+# such a file and flags every time, peak memory or ray count that is more
+# than --tolerance above it with a '!' (the script then exits with 3).
+# Times under --min-time seconds are too noisy to be compared.
+#
+# The pipeline stage runs the other stages again in one q3map2 process
+# (-bsp ... -vis ... -light ...) and fails when that leaves no bsp behind,
+# leaked maps included.  Binaries without the pipeline get "-".
+
+import argparse
+import hashlib
+import json
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+
+STAGES = ("bsp", "vis", "light", "pipeline")
+
+
+def bspChecksum(filename, lit):
+    data = bytearray(open(filename, "rb").read())
+    if data[:4] == b"IBSP":
+        # shader names are copied into uninitialised 64 byte fields
+        offset, length = struct.unpack_from("<ii", data, 8 + 8 * 1)
+        for shader in range(offset, offset + length, 72):
+            end = data.index(b"\0", shader)
+            if end < shader + 64:
+                data[end:shader + 64] = bytes(shader + 64 - end)
+        # patch lightmap st are only set by -light
+        if not lit:
+            offset, length = struct.unpack_from("<ii", data, 8 + 8 * 10)
+            for vert in range(offset, offset + length, 44):
+                data[vert + 20:vert + 28] = bytes(8)
+        # lumps are padded to 4 bytes with whatever was in memory
+        for lump in range(17):
+            offset, length = struct.unpack_from("<ii", data, 8 + 8 * lump)
+            end = offset + length
+            data[end:(end + 3) & ~3] = bytes(((end + 3) & ~3) - end)
+    # the version stamp
+    stamp = data.find(b"I LOVE MY Q3MAP2")
+    if stamp >= 0:
+        end = (data.index(b"\0", stamp) + 4) & ~3
+        data[stamp:end] = bytes(end - stamp)
+    return hashlib.md5(data).hexdigest()[:8]
+
+
+# synthetic maps
+
+CONTENTS_DETAIL = 0x8000000
+
+def brush(planes, texture, contents=0):
+    lines = ["{"]
+    for plane in planes:
+        lines.append("( %g %g %g ) ( %g %g %g ) ( %g %g %g ) %s 0 0 0 0.5 0.5 %d 0 0" % (plane + (texture, contents)))
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+
+def box(mins, maxs, texture="base_wall/basewall01"):
+    (x0, y0, z0), (x1, y1, z1) = mins, maxs
+    return brush([(x0, 0, 0, x0, 1, 0, x0, 0, 1), (x1, 0, 0, x1, 0, 1, x1, 1, 0),
+                  (0, y0, 0, 0, y0, 1, 1, y0, 0), (0, y1, 0, 1, y1, 0, 0, y1, 1),
+                  (0, 0, z0, 1, 0, z0, 0, 1, z0), (0, 0, z1, 0, 1, z1, 1, 0, z1)], texture)
+
+
+def hull(mins, maxs, texture="common/caulk"):
+    # six walls sealing the inside of mins, maxs
+    (x0, y0, z0), (x1, y1, z1) = mins, maxs
+    return (box((x0 - 16, y0 - 16, z0 - 16), (x1 + 16, y1 + 16, z0), texture) +
+            box((x0 - 16, y0 - 16, z1), (x1 + 16, y1 + 16, z1 + 16), texture) +
+            box((x0 - 16, y0 - 16, z0), (x0, y1 + 16, z1), texture) +
+            box((x1, y0 - 16, z0), (x1 + 16, y1 + 16, z1), texture) +
+            box((x0, y0 - 16, z0), (x1, y0, z1), texture) +
+            box((x0, y1, z0), (x1, y1 + 16, z1), texture))
+
+
+def entity(classname, origin, **keys):
+    text = '{\n"classname" "%s"\n"origin" "%g %g %g"\n' % ((classname,) + origin)
+    for key, value in sorted(keys.items()):
+        text += '"%s" "%s"\n' % (key, value)
+    return text + "}\n"
+
+
+def synthRooms(scale):
+    # a grid of rooms joined by doorways, lots of portals for vis
+    n = 10 * scale
+    size, height, wall, door = 256, 192, 16, 64
+    extent = n * size
+    world = hull((0, 0, 0), (extent, extent, height))
+    rng = random.Random(1)
+    for i in range(n):
+        for j in range(n):
+            x, y = i * size, j * size
+            # a wall with a doorway on the +x and +y side of every inner room
+            if i < n - 1:
+                mid = y + rng.randrange(wall + door // 2, size - wall - door // 2, 8)
+                world += box((x + size - wall // 2, y, 0), (x + size + wall // 2, mid - door // 2, height))
+                world += box((x + size - wall // 2, mid + door // 2, 0), (x + size + wall // 2, y + size, height))
+                world += box((x + size - wall // 2, mid - door // 2, 128), (x + size + wall // 2, mid + door // 2, height))
+            if j < n - 1:
+                mid = x + rng.randrange(wall + door // 2, size - wall - door // 2, 8)
+                world += box((x, y + size - wall // 2, 0), (mid - door // 2, y + size + wall // 2, height))
+                world += box((mid + door // 2, y + size - wall // 2, 0), (x + size, y + size + wall // 2, height))
+                world += box((mid - door // 2, y + size - wall // 2, 128), (mid + door // 2, y + size + wall // 2, height))
+            # a pillar
+            px, py = x + rng.randrange(48, size - 80, 8), y + rng.randrange(48, size - 80, 8)
+            world += box((px, py, 0), (px + 32, py + 32, rng.randrange(32, height, 8)))
+    text = '{\n"classname" "worldspawn"\n' + world + "}\n"
+    text += entity("info_player_start", (size // 2, size // 2, 32))
+    for i in range(n):
+        for j in range(n):
+            text += entity("light", (i * size + size // 2, j * size + size // 2, height - 32), light=300)
+    return text
+
+
+def synthTerrain(scale):
+    # a detail brush heightfield, every top face is a meta triangle pair
+    n = 32 * scale
+    size = 64
+    extent = n * size
+    world = hull((0, 0, -64), (extent, extent, 1024))
+
+    def height(i, j):
+        return int(64 + 48 * ((i * 7 + j * 13) % 17) / 17.0 + 32 * ((i * j) % 5) / 5.0)
+
+    for i in range(n):
+        for j in range(n):
+            x0, y0 = i * size, j * size
+            x1, y1 = x0 + size, y0 + size
+            a, b, c = height(i, j), height(i + 1, j), height(i, j + 1)
+            world += brush([(x0, 0, 0, x0, 1, 0, x0, 0, 1), (x1, 0, 0, x1, 0, 1, x1, 1, 0),
+                            (0, y0, 0, 0, y0, 1, 1, y0, 0), (0, y1, 0, 1, y1, 0, 0, y1, 1),
+                            (0, 0, -64, 1, 0, -64, 0, 1, -64), (x0, y0, a, x0, y1, c, x1, y0, b)],
+                           "base_wall/basewall01", CONTENTS_DETAIL)
+    text = '{\n"classname" "worldspawn"\n' + world + "}\n"
+    text += entity("info_player_start", (extent // 2, extent // 2, 512))
+    for i in range(0, n, 8):
+        for j in range(0, n, 8):
+            text += entity("light", (i * size + 256, j * size + 256, 640), light=2000)
+    return text
+
+
+def synthPatches(scale):
+    # a field of curved patches, for tesselation and patch lighting
+    n = 24 * scale
+    size = 128
+    extent = n * size
+    world = hull((0, 0, 0), (extent, extent, 768))
+    for i in range(n):
+        for j in range(n):
+            x, y = i * size, j * size
+            rows = []
+            for u in range(3):
+                row = []
+                for v in range(3):
+                    z = 64 + (48 if u == 1 and v == 1 else 0) + 16 * ((i + j) % 3)
+                    row.append("( %g %g %g %g %g )" % (x + u * size / 2, y + v * size / 2, z, u * 0.5, v * 0.5))
+                rows.append("( " + " ".join(row) + " )")
+            world += "{\npatchDef2\n{\nbase_wall/basewall01\n( 3 3 0 0 0 )\n(\n" + "\n".join(rows) + "\n)\n}\n}\n"
+    text = '{\n"classname" "worldspawn"\n' + world + "}\n"
+    text += entity("info_player_start", (extent // 2, extent // 2, 384))
+    for i in range(0, n, 4):
+        for j in range(0, n, 4):
+            text += entity("light", (i * size + 256, j * size + 256, 512), light=1500)
+    return text
+
+
+SYNTHETIC = {
+    "synthetic_patches": synthPatches,
+    "synthetic_rooms": synthRooms,
+    "synthetic_terrain": synthTerrain,
+}
+
+
+def readProfile(filename):
+    # rays and peak memory of the whole run, None when the trace lacks them
+    try:
+        events = json.load(open(filename))["traceEvents"]
+    except (OSError, ValueError, KeyError):
+        return None, None
+    for event in events:
+        if event.get("name") == "q3map2" and event.get("ph") == "X":
+            args = event.get("args", {})
+            rays = int(args["rays"]) if "rays" in args else None
+            peak = args["peak_rss_kb"] / 1024.0 if "peak_rss_kb" in args else None
+            return rays, peak
+    return None, None
+
+
+HELP = {}
+
+
+def supports(q3map2, option, stage=None):
+    # older binaries lack -profile and the pipeline, their help doesn't list them
+    command = [q3map2, "-help"] + ([stage] if stage else [])
+    key = " ".join(command)
+    if key not in HELP:
+        HELP[key] = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT).stdout
+    return option.encode() in HELP[key]
+
+
+def runStage(q3map2, work, name, stage, args, options):
+    game = os.path.join(work, name)
+    mapfile = os.path.join(game, "maps", name + ".map")
+    profile = os.path.join(work, "profile.json")
+    command = [q3map2, "-fs_basepath", work, "-fs_game", name, "-threads", str(options.threads)]
+    if supports(q3map2, "-profile"):
+        command += ["-profile", profile]
+    if stage == "pipeline":
+        command.append("-bsp")
+        for other in options.stages:
+            if other != "pipeline":
+                command += (["-" + other] if other != "bsp" else []) + options.stageArgs[other]
+    else:
+        if stage != "bsp":
+            command.append("-" + stage)
+        command += args
+    command.append(mapfile)
+
+    if os.path.exists(profile):
+        os.remove(profile)
+    start = time.time()
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    elapsed = time.time() - start
+    if result.returncode != 0:
+        sys.stdout.write(result.stdout.decode(errors="replace"))
+        sys.exit("%s %s failed on %s" % (q3map2, stage, name))
+    rays, peak = readProfile(profile)
+    return {"time": elapsed, "rays": rays, "peak_mb": peak}
+
+
+def compileMap(q3map2, work, name, source, options):
+    # runs the stages, returns { stage: result } and the bsp checksum
+    game = os.path.join(work, name)
+    shutil.rmtree(game, ignore_errors=True)
+    if callable(source):
+        os.makedirs(os.path.join(game, "maps"))
+        open(os.path.join(game, "maps", name + ".map"), "w").write(source(options.scale))
+    else:
+        shutil.copytree(source, game)
+    bspfile = os.path.join(game, "maps", name + ".bsp")
+    prtfile = os.path.join(game, "maps", name + ".prt")
+
+    results = {}
+    for stage in options.stages:
+        # a leaking map has no portal file
+        if stage == "vis" and not os.path.exists(prtfile):
+            continue
+        if stage == "pipeline":
+            continue
+        best = None
+        for run in range(options.runs):
+            if stage == "bsp" and os.path.exists(bspfile):
+                os.remove(bspfile)
+            result = runStage(q3map2, work, name, stage, options.stageArgs[stage], options)
+            if best is None or result["time"] < best["time"]:
+                best = result
+        results[stage] = best
+    checksum = bspChecksum(bspfile, "light" in options.stages)
+
+    # the stages in one process, the last one has to write the bsp
+    if "pipeline" in options.stages and supports(q3map2, "-saveintermediate", "bsp"):
+        best = None
+        for run in range(options.runs):
+            os.remove(bspfile)
+            result = runStage(q3map2, work, name, "pipeline", [], options)
+            if not os.path.exists(bspfile):
+                sys.exit("%s pipeline wrote no bsp for %s" % (q3map2, name))
+            if best is None or result["time"] < best["time"]:
+                best = result
+        results["pipeline"] = best
+    return results, checksum
+
+
+def regressed(value, base, tolerance, minimum=0.0):
+    # values that stay under minimum are noise, missing ones can't be compared
+    if value is None or base is None:
+        return False
+    return max(value, base) >= minimum and value > base * (1.0 + tolerance)
+
+
+def formatValue(value, width, fmt):
+    return "%*s" % (width, "-") if value is None else ("%" + str(width) + fmt) % value
+
+
+def main():
+    parser = argparse.ArgumentParser(description="time q3map2 over the regression test maps")
+    parser.add_argument("--runs", type=int, default=3, help="runs per stage, map and binary, the best counts")
+    parser.add_argument("--threads", type=int, default=1, help="q3map2 -threads for every run")
+    parser.add_argument("--stages", default="bsp,vis,light", help="comma separated stages to run, in order (bsp, vis, light, pipeline)")
+    parser.add_argument("--bsp-args", "--args", dest="bspArgs", default="-meta", help="q3map2 bsp arguments")
+    parser.add_argument("--vis-args", dest="visArgs", default="", help="q3map2 -vis arguments")
+    parser.add_argument("--light-args", dest="lightArgs", default="-fast", help="q3map2 -light arguments")
+    parser.add_argument("--maps", default="", help="comma separated test names, default all")
+    parser.add_argument("--no-synthetic", dest="synthetic", action="store_false", help="skip the generated maps")
+    parser.add_argument("--scale", type=int, default=1, help="size multiplier of the generated maps")
+    parser.add_argument("--save", help="write the reference results to this baseline file")
+    parser.add_argument("--baseline", help="compare against this baseline file")
+    parser.add_argument("--tolerance", type=float, default=0.1, help="allowed increase over the baseline, 0.1 is 10%%")
+    parser.add_argument("--min-time", dest="minTime", type=float, default=0.1,
+                        help="times below this many seconds are not compared to the baseline")
+    parser.add_argument("q3map2", nargs="+", help="binaries, the first is the reference")
+    options = parser.parse_args()
+
+    options.stages = [stage for stage in options.stages.split(",") if stage]
+    for stage in options.stages:
+        if stage not in STAGES:
+            sys.exit("unknown stage %s, use %s" % (stage, ",".join(STAGES)))
+    if "bsp" not in options.stages:
+        sys.exit("the bsp stage is needed for the others")
+    options.stageArgs = {"bsp": options.bspArgs.split(), "vis": options.visArgs.split(),
+                         "light": options.lightArgs.split()}
+    settings = {"threads": options.threads, "stages": options.stages, "args": options.stageArgs,
+                "scale": options.scale}
+
+    tests = os.path.dirname(os.path.abspath(__file__))
+    sources = {}
+    for name in os.listdir(tests):
+        if os.path.isfile(os.path.join(tests, name, "maps", name + ".map")):
+            sources[name] = os.path.join(tests, name)
+    if options.synthetic:
+        sources.update(SYNTHETIC)
+    if options.maps:
+        names = options.maps.split(",")
+        for name in names:
+            if name not in sources:
+                sys.exit("unknown map %s" % name)
+    else:
+        names = sorted(sources)
+
+    baseline = None
+    if options.baseline:
+        baseline = json.load(open(options.baseline))
+        if baseline.get("settings") != json.loads(json.dumps(settings)):
+            print("warning: %s was made with %s" % (options.baseline, json.dumps(baseline.get("settings"))))
+        baseline = baseline.get("maps", {})
+
+    print("%-28s %-8s" % ("map", "stage") + "".join(" %9s %6s %10s " % ("time%d" % (i + 1), "MB", "rays")
+                                                    for i in range(len(options.q3map2))))
+
+    work = tempfile.mkdtemp(prefix="q3map2-bench.")
+    totals = [dict((stage, 0.0) for stage in options.stages) for q3map2 in options.q3map2]
+    saved = {}
+    differs = False
+    regressions = 0
+    try:
+        for name in names:
+            results = []
+            for i, q3map2 in enumerate(options.q3map2):
+                results.append(compileMap(q3map2, work, name, sources[name], options))
+            base = baseline.get(name) if baseline is not None else None
+
+            for stage in options.stages:
+                if stage not in results[0][0]:
+                    continue
+                line = "%-28s %-8s" % (name, stage)
+                for i, (stages, checksum) in enumerate(results):
+                    result = stages.get(stage)
+                    if result is None:
+                        line += " %9s %6s %10s " % ("-", "-", "-")
+                        continue
+                    totals[i][stage] += result["time"]
+                    marks = [" ", " ", " "]
+                    old = base["stages"].get(stage) if base is not None else None
+                    if old is not None:
+                        for j, (key, minimum) in enumerate((("time", options.minTime), ("peak_mb", 0.0), ("rays", 0.0))):
+                            if regressed(result[key], old.get(key), options.tolerance, minimum):
+                                marks[j] = "!"
+                                regressions += 1
+                    line += " %9.3f%s%s%s%s%s" % (result["time"], marks[0], formatValue(result["peak_mb"], 6, ".0f"),
+                                                  marks[1], formatValue(result["rays"], 10, "d"), marks[2])
+                print(line)
+
+            line = "%-28s %-8s" % (name, "file")
+            for i, (stages, checksum) in enumerate(results):
+                mark = " "
+                if checksum != results[0][1] or (base is not None and checksum != base["bsp"]):
+                    mark = "*"
+                    differs = True
+                line += " %27s%s" % (checksum, mark)
+            print(line)
+            saved[name] = {"stages": results[0][0], "bsp": results[0][1]}
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+    for stage in options.stages:
+        print("%-28s %-8s" % ("total", stage) + "".join(" %9.3f %17s " % (total[stage], "") for total in totals))
+    for i in range(1, len(options.q3map2)):
+        # stages one of the binaries can't run don't count
+        common = [stage for stage in options.stages if totals[0][stage] > 0.0 and totals[i][stage] > 0.0]
+        reference, total = sum(totals[0][stage] for stage in common), sum(totals[i][stage] for stage in common)
+        if total > 0.0:
+            print("%s: %.2fx against %s" % (options.q3map2[i], reference / total, options.q3map2[0]))
+    if baseline is not None:
+        reference = sum(result["stages"][stage]["time"] for name, result in baseline.items() if name in saved
+                        for stage in result["stages"] if stage in saved[name]["stages"])
+        total = sum(result["stages"][stage]["time"] for name, result in saved.items() if name in baseline
+                    for stage in result["stages"] if stage in baseline[name]["stages"])
+        if total > 0.0:
+            print("%s: %.2fx against %s" % (options.q3map2[0], reference / total, options.baseline))
+
+    if options.save:
+        json.dump({"settings": settings, "maps": saved}, open(options.save, "w"), indent=1, sort_keys=True)
+        print("wrote %s" % options.save)
+    if differs:
+        print("* bsp differs from the reference or the baseline")
+        sys.exit(2)
+    if regressions:
+        print("! %d results more than %d%% above the baseline" % (regressions, round(options.tolerance * 100.0)))
+        sys.exit(3)
+
+
+if __name__ == "__main__":
+    main()
@@ -52,9 +52,23 @@
 #define PATHSEPERATOR   '/'
 
 #ifdef SAFE_MALLOC
+qboolean countMallocs;
+int numMallocs;
+
+static void CountMalloc( void ){
+#if defined( __GNUC__ )
+	__sync_fetch_and_add( &numMallocs, 1 );
+#else
+	numMallocs++;
+#endif
+}
+
 void *safe_malloc( size_t size ){
 	void *p;
 
+	if ( countMallocs ) {
+		CountMalloc();
+	}
 	p = malloc( size );
 	if ( !p ) {
 		Error( "safe_malloc failed on allocation of %i bytes", size );
@@ -66,6 +80,9 @@ void *safe_malloc( size_t size ){
 void *safe_malloc_info( size_t size, char* info ){
 	void *p;
 
+	if ( countMallocs ) {
+		CountMalloc();
+	}
 	p = malloc( size );
 	if ( !p ) {
 		Error( "%s: safe_malloc failed on allocation of %i bytes", info, size );
@@ -290,6 +307,27 @@ double I_FloatTime( void ){
 #endif
 }
 
+/*
+   ================
+   I_PreciseTime
+   monotonic seconds with sub-millisecond resolution, for timing stages
+   ================
+ */
+double I_PreciseTime( void ){
+#if GDEF_OS_WINDOWS
+	LARGE_INTEGER count, frequency;
+
+	QueryPerformanceCounter( &count );
+	QueryPerformanceFrequency( &frequency );
+	return (double) count.QuadPart / frequency.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif
+}
+
 void Q_getwd( char *out ){
 	int i = 0;
 
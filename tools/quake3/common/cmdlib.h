@@ -68,6 +68,10 @@
 #ifdef SAFE_MALLOC
 void *safe_malloc( size_t size );
 void *safe_malloc_info( size_t size, char* info );
+
+// counted only while countMallocs is set (q3map2 -profile)
+extern qboolean countMallocs;
+extern int numMallocs;
 #else
 #define safe_malloc( a ) malloc( a )
 #endif /* SAFE_MALLOC */
@@ -97,6 +101,7 @@ void ExpandWildcards( int *argc, char ***argv );
 
 
 double I_FloatTime( void );
+double I_PreciseTime( void );
 
 void    Error( const char *error, ... ) GDEF_ATTRIBUTE_NORETURN;
 int     CheckParm( const char *check );
@@ -31,6 +31,7 @@
 #include "mathlib.h"
 #include "polylib.h"
 #include "inout.h"
+#include "qthreads.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -298,6 +299,163 @@ void FPrintf( int flag, char *buf ){
 	xml_SendNode( node );
 }
 
+// output of worker threads
+// while RunThreadsOn runs them, each worker queues its text in a ring of its own without
+// locking, and the thread that started them writes it out. the workers never wait on
+// printf, libxml or the network, and the writer sends what came in since its last pass
+// as a few big messages, so the pacifier doesn't turn every dot into an xml node
+// a ring has one producer and one consumer: the worker moves head, the writer moves tail
+#define OUTPUT_RING_SIZE 65536 // power of two
+
+typedef struct outputRing_s
+{
+	unsigned int head, tail;
+	char text[OUTPUT_RING_SIZE];
+} outputRing_t;
+
+typedef struct outputHeader_s
+{
+	unsigned int sequence;
+	int flag, length;
+} outputHeader_t;
+
+#if defined( __GNUC__ )
+#define OUTPUT_QUEUE                1
+#define OutputLoad( var )           __atomic_load_n( &( var ), __ATOMIC_ACQUIRE )
+#define OutputStore( var, value )   __atomic_store_n( &( var ), ( value ), __ATOMIC_RELEASE )
+#define OutputSequence()            __sync_fetch_and_add( &outputSequence, 1 )
+#elif defined( _MSC_VER )
+#define OUTPUT_QUEUE                1
+#define OutputLoad( var )           ( (unsigned int) InterlockedCompareExchange( (volatile LONG *) &( var ), 0, 0 ) )
+#define OutputStore( var, value )   InterlockedExchange( (volatile LONG *) &( var ), (LONG) ( value ) )
+#define OutputSequence()            ( (unsigned int) InterlockedExchangeAdd( (volatile LONG *) &outputSequence, 1 ) )
+#else
+// no atomics to share a ring with, so the workers print directly and the rings stay empty
+#define OUTPUT_QUEUE                0
+#define OutputLoad( var )           ( var )
+#define OutputStore( var, value )   ( ( var ) = ( value ) )
+#define OutputSequence()            ( outputSequence++ )
+#endif
+
+static outputRing_t outputRings[MAX_THREADS];
+static int numOutputRings;
+static qboolean outputQueued;
+static unsigned int outputSequence;
+#if defined( _MSC_VER )
+static __declspec( thread ) outputRing_t *outputThreadRing;
+#else
+static __thread outputRing_t *outputThreadRing;
+#endif
+
+static void RingWrite( outputRing_t *ring, unsigned int pos, const void *data, int size ){
+	int i;
+
+	for ( i = 0; i < size; i++ )
+		ring->text[( pos + i ) & ( OUTPUT_RING_SIZE - 1 )] = ( (const char*) data )[i];
+}
+
+static void RingRead( outputRing_t *ring, unsigned int pos, void *data, int size ){
+	int i;
+
+	for ( i = 0; i < size; i++ )
+		( (char*) data )[i] = ring->text[( pos + i ) & ( OUTPUT_RING_SIZE - 1 )];
+}
+
+// queue text in the ring of the calling worker, returns false if it is to be printed directly
+static qboolean QueueOutput( int flag, const char *buf ){
+	outputRing_t *ring = outputThreadRing;
+	outputHeader_t header;
+	unsigned int size;
+
+	if ( !OUTPUT_QUEUE || ring == NULL || !outputQueued ) {
+		return qfalse;
+	}
+
+	header.flag = flag;
+	header.length = strlen( buf );
+	size = sizeof( header ) + header.length;
+
+	// wait for the writer to make room
+	while ( OUTPUT_RING_SIZE - ( ring->head - OutputLoad( ring->tail ) ) < size )
+		Sys_Sleep( 1 );
+
+	header.sequence = OutputSequence();
+	RingWrite( ring, ring->head, &header, sizeof( header ) );
+	RingWrite( ring, ring->head + sizeof( header ), buf, header.length );
+	OutputStore( ring->head, ring->head + size );
+	return qtrue;
+}
+
+// called by each worker thread before it starts working
+void Sys_ThreadOutputStart( int thread ){
+	outputThreadRing = &outputRings[thread];
+}
+
+// called before the workers are started, from then on the caller writes their output
+void Sys_BeginThreadOutput( int numThreads ){
+	numOutputRings = numThreads;
+	outputQueued = qtrue;
+}
+
+// writes the output queued so far, oldest first
+void Sys_FlushThreadOutput( void ){
+	outputRing_t *ring, *oldest;
+	outputHeader_t header, oldestHeader;
+	char out_buffer[4096];
+	int i, flag, length, copy;
+
+	flag = -1;
+	length = 0;
+	for ( ;; )
+	{
+		// find the oldest message at the tail of a ring
+		oldest = NULL;
+		for ( i = 0; i < numOutputRings; i++ )
+		{
+			ring = &outputRings[i];
+			if ( OutputLoad( ring->head ) == ring->tail ) {
+				continue;
+			}
+			RingRead( ring, ring->tail, &header, sizeof( header ) );
+			if ( oldest == NULL || (int) ( header.sequence - oldestHeader.sequence ) < 0 ) {
+				oldest = ring;
+				oldestHeader = header;
+			}
+		}
+		if ( oldest == NULL ) {
+			break;
+		}
+
+		// messages of the same level are written together
+		if ( length > 0 && ( oldestHeader.flag != flag || length + oldestHeader.length >= (int) sizeof( out_buffer ) ) ) {
+			out_buffer[length] = '\0';
+			FPrintf( flag, out_buffer );
+			length = 0;
+		}
+		flag = oldestHeader.flag;
+
+		// an overlong message is cut short, but all of it leaves the ring
+		copy = oldestHeader.length;
+		if ( copy >= (int) sizeof( out_buffer ) - length ) {
+			copy = sizeof( out_buffer ) - 1 - length;
+		}
+		RingRead( oldest, oldest->tail + sizeof( oldestHeader ), out_buffer + length, copy );
+		length += copy;
+		OutputStore( oldest->tail, oldest->tail + sizeof( oldestHeader ) + oldestHeader.length );
+	}
+
+	if ( length > 0 ) {
+		out_buffer[length] = '\0';
+		FPrintf( flag, out_buffer );
+	}
+}
+
+// called after the workers are done, writes the rest of their output
+void Sys_EndThreadOutput( void ){
+	Sys_FlushThreadOutput();
+	outputQueued = qfalse;
+}
+
 #ifdef DBG_XML
 void DumpXML(){
 	xmlSaveFile( "XMLDump.xml", doc );
@@ -316,7 +474,9 @@ void Sys_FPrintf( int flag, const char *format, ... ){
 	vsprintf( out_buffer, format, argptr );
 	va_end( argptr );
 
-	FPrintf( flag, out_buffer );
+	if ( !QueueOutput( flag, out_buffer ) ) {
+		FPrintf( flag, out_buffer );
+	}
 }
 
 void Sys_Printf( const char *format, ... ){
@@ -327,7 +487,9 @@ void Sys_Printf( const char *format, ... ){
 	vsprintf( out_buffer, format, argptr );
 	va_end( argptr );
 
-	FPrintf( SYS_STD, out_buffer );
+	if ( !QueueOutput( SYS_STD, out_buffer ) ) {
+		FPrintf( SYS_STD, out_buffer );
+	}
 }
 
 /*
@@ -348,7 +510,14 @@ void Error( const char *error, ... ){
 
 	sprintf( out_buffer, "************ ERROR ************\n%s\n", tmp );
 
-	FPrintf( SYS_ERR, out_buffer );
+	// a worker waits for the writer to get its output out, the message included
+	if ( QueueOutput( SYS_ERR, out_buffer ) ) {
+		while ( OutputLoad( outputThreadRing->tail ) != outputThreadRing->head )
+			Sys_Sleep( 1 );
+	}
+	else{
+		FPrintf( SYS_ERR, out_buffer );
+	}
 
 #ifdef DBG_XML
 	DumpXML();
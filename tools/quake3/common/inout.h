@@ -52,6 +52,12 @@ extern qboolean verbose;
 void Sys_Printf( const char *text, ... );
 void Sys_FPrintf( int flag, const char *text, ... );
 
+// output of RunThreadsOn workers is queued per thread and written by the thread that started them
+void Sys_ThreadOutputStart( int thread );
+void Sys_BeginThreadOutput( int numThreads );
+void Sys_FlushThreadOutput( void );
+void Sys_EndThreadOutput( void );
+
 #if GDEF_DEBUG
 #define DBG_XML 1
 #endif
@@ -0,0 +1,278 @@
+/*
+   Copyright (C) 1999-2007 id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "cmdlib.h"
+#include "inout.h"
+#include "qthreads.h"
+#include "mempool.h"
+
+
+/* pools that ever got a slab */
+static memPool_t *pools;
+
+#define FREE_LINK( pool, item ) ( *(void**) ( (char*) ( item ) + ( pool )->size - sizeof( void* ) ) )
+
+/* slabs start with their link, padded so items stay 8 byte aligned */
+#define SLAB_HEADER sizeof( memPoolHeader_t )
+
+
+
+/*
+   PoolNewSlab()
+   gives the calling thread's cache a fresh slab
+ */
+
+static void PoolNewSlab( memPool_t *pool, memPoolCache_t *cache ){
+	char    *slab;
+	size_t size;
+
+
+	/* big items get a slab of their own */
+	size = MEMPOOL_SLAB_SIZE;
+	if ( pool->size > size - SLAB_HEADER ) {
+		size = SLAB_HEADER + pool->size;
+	}
+
+	/* link it */
+	slab = safe_malloc( size );
+	*(void**) slab = cache->slabs;
+	cache->slabs = slab;
+	cache->numSlabs++;
+	cache->next = slab + SLAB_HEADER;
+	cache->left = ( size - SLAB_HEADER ) / pool->size;
+
+	/* register the pool, this is rare enough to take the lock */
+	if ( !pool->registered ) {
+		ThreadLock();
+		if ( !pool->registered ) {
+			pool->nextPool = pools;
+			pools = pool;
+			pool->registered = 1;
+		}
+		ThreadUnlock();
+	}
+}
+
+
+
+/*
+   PoolAlloc()
+   returns an uninitialized item
+ */
+
+void *PoolAlloc( memPool_t *pool ){
+	memPoolCache_t  *cache;
+	void            *item;
+
+
+	cache = &pool->caches[ ThreadNumber() ];
+	cache->active++;
+
+	/* reuse a freed item */
+	if ( cache->freeList != NULL ) {
+		item = cache->freeList;
+		cache->freeList = FREE_LINK( pool, item );
+		return item;
+	}
+
+	/* carve a new one */
+	if ( cache->left == 0 ) {
+		PoolNewSlab( pool, cache );
+	}
+	item = cache->next;
+	cache->next += pool->size;
+	cache->left--;
+	return item;
+}
+
+
+
+/*
+   PoolFree()
+   puts an item on the calling thread's free list
+ */
+
+void PoolFree( memPool_t *pool, void *item ){
+	memPoolCache_t  *cache;
+
+
+	cache = &pool->caches[ ThreadNumber() ];
+	cache->active--;
+	FREE_LINK( pool, item ) = cache->freeList;
+	cache->freeList = item;
+}
+
+
+
+/*
+   PoolAllocSized()
+   allocates from the first of an ascending list of pools that fits, and
+   falls back to the heap for anything bigger
+ */
+
+void *PoolAllocSized( memPool_t *classes, int numClasses, size_t size ){
+	int i;
+	memPoolHeader_t *header;
+
+
+	size += sizeof( *header );
+	for ( i = 0; i < numClasses; i++ )
+	{
+		if ( classes[ i ].size >= size ) {
+			header = PoolAlloc( &classes[ i ] );
+			header->pool = &classes[ i ];
+			return header + 1;
+		}
+	}
+
+	header = safe_malloc( size );
+	header->pool = NULL;
+	return header + 1;
+}
+
+
+
+/*
+   PoolFreeSized()
+   frees an item from PoolAllocSized
+ */
+
+void PoolFreeSized( void *item ){
+	memPoolHeader_t *header;
+
+
+	header = (memPoolHeader_t*) item - 1;
+	if ( header->pool != NULL ) {
+		PoolFree( header->pool, header );
+	}
+	else{
+		free( header );
+	}
+}
+
+
+
+/*
+   PoolActive()
+   number of items in use, only exact while no worker threads are running
+ */
+
+int PoolActive( memPool_t *pool ){
+	int i, active;
+
+
+	active = 0;
+	for ( i = 0; i < MAX_THREADS; i++ )
+		active += pool->caches[ i ].active;
+	return active;
+}
+
+
+
+/*
+   PoolRelease()
+   frees all slabs of a pool at once if none of its items are in use
+ */
+
+qboolean PoolRelease( memPool_t *pool ){
+	int i, numSlabs;
+	memPoolCache_t  *cache;
+	void            *slab, *next;
+
+
+	if ( threaded ) {
+		Error( "PoolRelease: %s released while threads are running", pool->name );
+	}
+	if ( PoolActive( pool ) != 0 ) {
+		return qfalse;
+	}
+
+	/* count before the peak is lost */
+	numSlabs = 0;
+	for ( i = 0; i < MAX_THREADS; i++ )
+		numSlabs += pool->caches[ i ].numSlabs;
+	if ( numSlabs > pool->peakSlabs ) {
+		pool->peakSlabs = numSlabs;
+	}
+
+	/* free everything */
+	for ( i = 0; i < MAX_THREADS; i++ )
+	{
+		cache = &pool->caches[ i ];
+		for ( slab = cache->slabs; slab != NULL; slab = next )
+		{
+			next = *(void**) slab;
+			free( slab );
+		}
+		memset( cache, 0, sizeof( *cache ) );
+	}
+	return qtrue;
+}
+
+
+
+/*
+   PoolReleaseAll()
+   releases every pool that is no longer in use, at the end of a stage
+ */
+
+void PoolReleaseAll( void ){
+	memPool_t   *pool;
+
+
+	for ( pool = pools; pool != NULL; pool = pool->nextPool )
+		PoolRelease( pool );
+}
+
+
+
+/*
+   PrintPoolStats()
+   verbose report of the slab memory each pool has held at its peak
+ */
+
+void PrintPoolStats( void ){
+	int i, numSlabs;
+	size_t slabSize, total;
+	memPool_t   *pool;
+
+
+	Sys_FPrintf( SYS_VRB, "--- PrintPoolStats ---\n" );
+	total = 0;
+	for ( pool = pools; pool != NULL; pool = pool->nextPool )
+	{
+		numSlabs = 0;
+		for ( i = 0; i < MAX_THREADS; i++ )
+			numSlabs += pool->caches[ i ].numSlabs;
+		if ( numSlabs > pool->peakSlabs ) {
+			pool->peakSlabs = numSlabs;
+		}
+
+		slabSize = MEMPOOL_SLAB_SIZE;
+		if ( pool->size > slabSize - SLAB_HEADER ) {
+			slabSize = SLAB_HEADER + pool->size;
+		}
+		total += pool->peakSlabs * slabSize;
+		Sys_FPrintf( SYS_VRB, "%9d KB peak %9d active %s (%d bytes)\n",
+					 (int) ( pool->peakSlabs * slabSize / 1024 ), PoolActive( pool ), pool->name, (int) pool->size );
+	}
+	Sys_FPrintf( SYS_VRB, "%9d KB peak pool memory\n", (int) ( total / 1024 ) );
+}
@@ -0,0 +1,80 @@
+/*
+   Copyright (C) 1999-2007 id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+   fixed size allocations carved out of 64 KB slabs
+
+   every thread allocates from its own slabs and free list, so no locking
+   is needed.  an item may be freed on any thread, it simply moves to that
+   thread's free list.  a freed item keeps its first word, so the "already
+   freed" markers of windings and brushes still work.  the slabs of a pool
+   are only given back as a whole by PoolRelease, when none of its items are
+   in use any more.
+
+   declare pools statically:
+   static memPool_t nodePool = MEMPOOL( "nodes", sizeof( node_t ) );
+ */
+
+#define MEMPOOL_SLAB_SIZE       65536
+
+/* items are rounded up to 8 bytes and hold at least the free list link */
+#define MEMPOOL_ITEM_SIZE( size ) ( ( ( size ) < 2 * sizeof( void* ) ? 2 * sizeof( void* ) : ( size ) + 7 ) & ~(size_t) 7 )
+
+#define MEMPOOL( name, size )   { name, MEMPOOL_ITEM_SIZE( size ), NULL, 0, 0, { { 0 } } }
+
+typedef struct memPoolCache_s
+{
+	void                *freeList;      /* freed items, linked through their last pointer */
+	void                *slabs;         /* slabs allocated by this thread */
+	char                *next;          /* unused rest of the current slab */
+	size_t left;
+	int numSlabs;
+	int active;                         /* allocations minus frees on this thread, may be negative */
+}
+memPoolCache_t;
+
+typedef struct memPool_s
+{
+	const char          *name;
+	size_t size;
+	struct memPool_s    *nextPool;      /* list of pools that have slabs, for PoolReleaseAll */
+	int registered;
+	int peakSlabs;
+	memPoolCache_t caches[ MAX_THREADS ];
+}
+memPool_t;
+
+/* header in front of PoolAllocSized items */
+typedef union memPoolHeader_u
+{
+	memPool_t           *pool;
+	double align;
+}
+memPoolHeader_t;
+
+void *PoolAlloc( memPool_t *pool );
+void PoolFree( memPool_t *pool, void *item );
+void *PoolAllocSized( memPool_t *pools, int numPools, size_t size );
+void PoolFreeSized( void *item );
+int PoolActive( memPool_t *pool );
+qboolean PoolRelease( memPool_t *pool );
+void PoolReleaseAll( void );
+void PrintPoolStats( void );
@@ -24,9 +24,18 @@
 #include "inout.h"
 #include "polylib.h"
 #include "qfiles.h"
+#include "qthreads.h"
+#include "mempool.h"
 
+/* x86-64 always does float math in sse, so the vector paths below round
+   exactly like the scalar code they replace */
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	#include <emmintrin.h>
+	#define POLYLIB_SSE2    1
+#else
+	#define POLYLIB_SSE2    0
+#endif
 
-extern int numthreads;
 
 // counters are only bumped when running single threaded,
 // because they are an awefull coherence problem
@@ -37,6 +46,45 @@ int c_winding_points;
 
 #define BOGUS_RANGE WORLD_SIZE
 
+/* windings are pooled by point count, bigger ones come from the heap */
+#define WINDING_POOL( points )  MEMPOOL( "windings", sizeof( memPoolHeader_t ) + (size_t)&( ( (winding_t*) 0 )->p[ points ] ) )
+
+static memPool_t windingPools[] =
+{
+	WINDING_POOL( 4 ),
+	WINDING_POOL( 8 ),
+	WINDING_POOL( 12 ),
+	WINDING_POOL( 16 ),
+	WINDING_POOL( 24 ),
+	WINDING_POOL( 32 ),
+	WINDING_POOL( 64 )
+};
+
+#define WINDING_ACCU_POOL( points ) MEMPOOL( "accu windings", sizeof( memPoolHeader_t ) + (size_t)&( ( (winding_accu_t*) 0 )->p[ points ] ) )
+
+static memPool_t windingAccuPools[] =
+{
+	WINDING_ACCU_POOL( 4 ),
+	WINDING_ACCU_POOL( 8 ),
+	WINDING_ACCU_POOL( 12 ),
+	WINDING_ACCU_POOL( 16 ),
+	WINDING_ACCU_POOL( 32 )
+};
+
+/* the chops build their result on the stack and only then allocate, or
+   reuse the input.  every input point adds at most itself and a split point */
+typedef struct
+{
+	int numpoints;
+	vec3_t p[MAX_POINTS_ON_WINDING * 2];
+} stackWinding_t;
+
+typedef struct
+{
+	int numpoints;
+	vec3_accu_t p[MAX_POINTS_ON_WINDING * 2];
+} stackWindingAccu_t;
+
 void pw( winding_t *w ){
 	int i;
 	for ( i = 0 ; i < w->numpoints ; i++ )
@@ -66,7 +114,7 @@ winding_t   *AllocWinding( int points ){
 		}
 	}
 	s = sizeof( *w ) + ( points ? sizeof( w->p[0] ) * ( points - 1 ) : 0 );
-	w = safe_malloc( s );
+	w = PoolAllocSized( windingPools, sizeof( windingPools ) / sizeof( windingPools[ 0 ] ), s );
 	memset( w, 0, s );
 	return w;
 }
@@ -94,7 +142,7 @@ winding_accu_t *AllocWindingAccu( int points ){
 		}
 	}
 	s = sizeof( *w ) + ( points ? sizeof( w->p[0] ) * ( points - 1 ) : 0 );
-	w = safe_malloc( s );
+	w = PoolAllocSized( windingAccuPools, sizeof( windingAccuPools ) / sizeof( windingAccuPools[ 0 ] ), s );
 	memset( w, 0, s );
 	return w;
 }
@@ -117,7 +165,7 @@ void FreeWinding( winding_t *w ){
 	if ( numthreads == 1 ) {
 		c_active_windings--;
 	}
-	free( w );
+	PoolFreeSized( w );
 }
 
 /*
@@ -138,7 +186,176 @@ void FreeWindingAccu( winding_accu_t *w ){
 	if ( numthreads == 1 ) {
 		c_active_windings--;
 	}
-	free( w );
+	PoolFreeSized( w );
+}
+
+/*
+   =============
+   WindingCapacity
+   =============
+ */
+
+/* how many points a pooled winding has room for, the chops reuse it when
+   the result fits.  heap windings are only known to hold what they hold now */
+static int WindingCapacity( winding_t *w ){
+	memPoolHeader_t *header;
+
+	header = (memPoolHeader_t*) w - 1;
+	if ( header->pool == NULL ) {
+		return w->numpoints;
+	}
+	return ( header->pool->size - sizeof( *header ) - (size_t)( (winding_t*) 0 )->p ) / sizeof( w->p[0] );
+}
+
+static int WindingAccuCapacity( winding_accu_t *w ){
+	memPoolHeader_t *header;
+
+	header = (memPoolHeader_t*) w - 1;
+	if ( header->pool == NULL ) {
+		return w->numpoints;
+	}
+	return ( header->pool->size - sizeof( *header ) - (size_t)( (winding_accu_t*) 0 )->p ) / sizeof( w->p[0] );
+}
+
+/*
+   =============
+   WindingPlaneSides
+
+   Distances of the points to a plane and their sides.  The sse2 path does
+   the same float operations in the same order, four points at a time, so
+   the distances come out bit identical.
+   =============
+ */
+static void WindingPlaneSides( vec3_t *p, int numpoints, vec3_t normal, vec_t dist, vec_t epsilon,
+							   vec_t *dists, int *sides, int *counts ){
+	int i;
+	vec_t dot;
+
+	counts[0] = counts[1] = counts[2] = 0;
+	i = 0;
+
+#if POLYLIB_SSE2
+	{
+		__m128 a, b, c, x, y, z, d, nx, ny, nz, vdist, front, back;
+		int frontMask, backMask, k;
+
+		nx = _mm_set1_ps( normal[0] );
+		ny = _mm_set1_ps( normal[1] );
+		nz = _mm_set1_ps( normal[2] );
+		vdist = _mm_set1_ps( dist );
+		front = _mm_set1_ps( epsilon );
+		back = _mm_set1_ps( -epsilon );
+		for ( ; i + 4 <= numpoints; i += 4 )
+		{
+			/* x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 */
+			a = _mm_loadu_ps( p[i] );
+			b = _mm_loadu_ps( p[i] + 4 );
+			c = _mm_loadu_ps( p[i] + 8 );
+			x = _mm_shuffle_ps( a, _mm_shuffle_ps( b, c, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 3, 0 ) );
+			y = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 1, 1 ) ),
+								_mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 2, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+			z = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 1, 2, 2 ) ), c, _MM_SHUFFLE( 3, 0, 2, 0 ) );
+
+			d = _mm_add_ps( _mm_mul_ps( x, nx ), _mm_mul_ps( y, ny ) );
+			d = _mm_sub_ps( _mm_add_ps( d, _mm_mul_ps( z, nz ) ), vdist );
+			_mm_storeu_ps( &dists[i], d );
+
+			frontMask = _mm_movemask_ps( _mm_cmpgt_ps( d, front ) );
+			backMask = _mm_movemask_ps( _mm_cmplt_ps( d, back ) );
+			for ( k = 0; k < 4; k++ )
+			{
+				sides[i + k] = ( frontMask >> k ) & 1 ? SIDE_FRONT : ( backMask >> k ) & 1 ? SIDE_BACK : SIDE_ON;
+				counts[sides[i + k]]++;
+			}
+		}
+	}
+#endif
+
+	for ( ; i < numpoints; i++ )
+	{
+		dot = DotProduct( p[i], normal );
+		dot -= dist;
+		dists[i] = dot;
+		if ( dot > epsilon ) {
+			sides[i] = SIDE_FRONT;
+		}
+		else if ( dot < -epsilon ) {
+			sides[i] = SIDE_BACK;
+		}
+		else
+		{
+			sides[i] = SIDE_ON;
+		}
+		counts[sides[i]]++;
+	}
+	sides[i] = sides[0];
+	dists[i] = dists[0];
+}
+
+/*
+   =============
+   WindingAccuPlaneSides
+
+   Double precision version, two points at a time.
+   =============
+ */
+static void WindingAccuPlaneSides( vec3_accu_t *p, int numpoints, vec3_accu_t normal, vec_accu_t dist, vec_accu_t epsilon,
+								   vec_accu_t *dists, int *sides, int *counts ){
+	int i;
+
+	counts[0] = counts[1] = counts[2] = 0;
+	i = 0;
+
+#if POLYLIB_SSE2
+	{
+		__m128d a, b, c, x, y, z, d, nx, ny, nz, vdist, front, back;
+		int frontMask, backMask, k;
+
+		nx = _mm_set1_pd( normal[0] );
+		ny = _mm_set1_pd( normal[1] );
+		nz = _mm_set1_pd( normal[2] );
+		vdist = _mm_set1_pd( dist );
+		front = _mm_set1_pd( epsilon );
+		back = _mm_set1_pd( -epsilon );
+		for ( ; i + 2 <= numpoints; i += 2 )
+		{
+			/* x0 y0 | z0 x1 | y1 z1 */
+			a = _mm_loadu_pd( p[i] );
+			b = _mm_loadu_pd( p[i] + 2 );
+			c = _mm_loadu_pd( p[i] + 4 );
+			x = _mm_shuffle_pd( a, b, 2 );
+			y = _mm_shuffle_pd( a, c, 1 );
+			z = _mm_shuffle_pd( b, c, 2 );
+
+			d = _mm_add_pd( _mm_mul_pd( x, nx ), _mm_mul_pd( y, ny ) );
+			d = _mm_sub_pd( _mm_add_pd( d, _mm_mul_pd( z, nz ) ), vdist );
+			_mm_storeu_pd( &dists[i], d );
+
+			frontMask = _mm_movemask_pd( _mm_cmpgt_pd( d, front ) );
+			backMask = _mm_movemask_pd( _mm_cmplt_pd( d, back ) );
+			for ( k = 0; k < 2; k++ )
+			{
+				sides[i + k] = ( frontMask >> k ) & 1 ? SIDE_FRONT : ( backMask >> k ) & 1 ? SIDE_BACK : SIDE_ON;
+				counts[sides[i + k]]++;
+			}
+		}
+	}
+#endif
+
+	for ( ; i < numpoints; i++ )
+	{
+		dists[i] = DotProductAccu( p[i], normal ) - dist;
+		if ( dists[i] > epsilon ) {
+			sides[i] = SIDE_FRONT;
+		}
+		else if ( dists[i] < -epsilon ) {
+			sides[i] = SIDE_BACK;
+		}
+		else{sides[i] = SIDE_ON; }
+		counts[sides[i]]++;
+	}
+	sides[i] = sides[0];
+	dists[i] = dists[0];
 }
 
 /*
@@ -473,46 +690,37 @@ winding_t   *CopyWinding( winding_t *w ){
 
 /*
    ==================
-   CopyWindingAccuIncreaseSizeAndFreeOld
+   CopyWindingAccuToRegular
    ==================
  */
-winding_accu_t *CopyWindingAccuIncreaseSizeAndFreeOld( winding_accu_t *w ){
+winding_t   *CopyWindingAccuToRegular( winding_accu_t *w ){
 	int i;
-	winding_accu_t  *c;
+	winding_t   *c;
 
 	if ( !w ) {
-		Error( "CopyWindingAccuIncreaseSizeAndFreeOld: winding is NULL" );
+		Error( "CopyWindingAccuToRegular: winding is NULL" );
 	}
 
-	c = AllocWindingAccu( w->numpoints + 1 );
+	c = AllocWinding( w->numpoints );
 	c->numpoints = w->numpoints;
 	for ( i = 0; i < c->numpoints; i++ )
 	{
-		VectorCopyAccu( w->p[i], c->p[i] );
+		VectorCopyAccuToRegular( w->p[i], c->p[i] );
 	}
-	FreeWindingAccu( w );
 	return c;
 }
 
 /*
    ==================
-   CopyWindingAccuToRegular
+   CopyStackWinding
    ==================
  */
-winding_t   *CopyWindingAccuToRegular( winding_accu_t *w ){
-	int i;
+static winding_t *CopyStackWinding( stackWinding_t *w ){
 	winding_t   *c;
 
-	if ( !w ) {
-		Error( "CopyWindingAccuToRegular: winding is NULL" );
-	}
-
 	c = AllocWinding( w->numpoints );
 	c->numpoints = w->numpoints;
-	for ( i = 0; i < c->numpoints; i++ )
-	{
-		VectorCopyAccuToRegular( w->p[i], c->p[i] );
-	}
+	memcpy( c->p, w->p, w->numpoints * sizeof( w->p[0] ) );
 	return c;
 }
 
@@ -545,36 +753,15 @@ void    ClipWindingEpsilonStrict( winding_t *in, vec3_t normal, vec_t dist,
 	vec_t dists[MAX_POINTS_ON_WINDING + 4];
 	int sides[MAX_POINTS_ON_WINDING + 4];
 	int counts[3];
-	static vec_t dot;           // VC 4.2 optimizer bug if not static
+	vec_t dot;
 	int i, j;
 	vec_t   *p1, *p2;
 	vec3_t mid;
-	winding_t   *f, *b;
+	stackWinding_t f, b;
 	int maxpts;
 
-	counts[0] = counts[1] = counts[2] = 0;
-
 // determine sides for each point
-	for ( i = 0 ; i < in->numpoints ; i++ )
-	{
-
-		dot = DotProduct( in->p[i], normal );
-		dot -= dist;
-		dists[i] = dot;
-		if ( dot > epsilon ) {
-			sides[i] = SIDE_FRONT;
-		}
-		else if ( dot < -epsilon ) {
-			sides[i] = SIDE_BACK;
-		}
-		else
-		{
-			sides[i] = SIDE_ON;
-		}
-		counts[sides[i]]++;
-	}
-	sides[i] = sides[0];
-	dists[i] = dists[0];
+	WindingPlaneSides( in->p, in->numpoints, normal, dist, epsilon, dists, sides, counts );
 
 	*front = *back = NULL;
 
@@ -593,28 +780,27 @@ void    ClipWindingEpsilonStrict( winding_t *in, vec3_t normal, vec_t dist,
 	maxpts = in->numpoints + 4;   // cant use counts[0]+2 because
 	                              // of fp grouping errors
 
-	*front = f = AllocWinding( maxpts );
-	*back = b = AllocWinding( maxpts );
+	f.numpoints = b.numpoints = 0;
 
 	for ( i = 0 ; i < in->numpoints ; i++ )
 	{
 		p1 = in->p[i];
 
 		if ( sides[i] == SIDE_ON ) {
-			VectorCopy( p1, f->p[f->numpoints] );
-			f->numpoints++;
-			VectorCopy( p1, b->p[b->numpoints] );
-			b->numpoints++;
+			VectorCopy( p1, f.p[f.numpoints] );
+			f.numpoints++;
+			VectorCopy( p1, b.p[b.numpoints] );
+			b.numpoints++;
 			continue;
 		}
 
 		if ( sides[i] == SIDE_FRONT ) {
-			VectorCopy( p1, f->p[f->numpoints] );
-			f->numpoints++;
+			VectorCopy( p1, f.p[f.numpoints] );
+			f.numpoints++;
 		}
 		if ( sides[i] == SIDE_BACK ) {
-			VectorCopy( p1, b->p[b->numpoints] );
-			b->numpoints++;
+			VectorCopy( p1, b.p[b.numpoints] );
+			b.numpoints++;
 		}
 
 		if ( sides[i + 1] == SIDE_ON || sides[i + 1] == sides[i] ) {
@@ -638,18 +824,21 @@ void    ClipWindingEpsilonStrict( winding_t *in, vec3_t normal, vec_t dist,
 			}
 		}
 
-		VectorCopy( mid, f->p[f->numpoints] );
-		f->numpoints++;
-		VectorCopy( mid, b->p[b->numpoints] );
-		b->numpoints++;
+		VectorCopy( mid, f.p[f.numpoints] );
+		f.numpoints++;
+		VectorCopy( mid, b.p[b.numpoints] );
+		b.numpoints++;
 	}
 
-	if ( f->numpoints > maxpts || b->numpoints > maxpts ) {
+	if ( f.numpoints > maxpts || b.numpoints > maxpts ) {
 		Error( "ClipWinding: points exceeded estimate" );
 	}
-	if ( f->numpoints > MAX_POINTS_ON_WINDING || b->numpoints > MAX_POINTS_ON_WINDING ) {
+	if ( f.numpoints > MAX_POINTS_ON_WINDING || b.numpoints > MAX_POINTS_ON_WINDING ) {
 		Error( "ClipWinding: MAX_POINTS_ON_WINDING" );
 	}
+
+	*front = CopyStackWinding( &f );
+	*back = CopyStackWinding( &b );
 }
 
 void    ClipWindingEpsilon( winding_t *in, vec3_t normal, vec_t dist,
@@ -674,8 +863,7 @@ void ChopWindingInPlaceAccu( winding_accu_t **inout, vec3_t normal, vec_t dist,
 	int i, j;
 	vec_accu_t dists[MAX_POINTS_ON_WINDING + 1];
 	int sides[MAX_POINTS_ON_WINDING + 1];
-	int maxpts;
-	winding_accu_t  *f;
+	stackWindingAccu_t f;
 	vec_accu_t  *p1, *p2;
 	vec_accu_t w;
 	vec3_accu_t mid, normalAccu;
@@ -719,23 +907,8 @@ void ChopWindingInPlaceAccu( winding_accu_t **inout, vec3_t normal, vec_t dist,
 	else{fineEpsilon = (vec_accu_t) crudeEpsilon; }
 
 	in = *inout;
-	counts[0] = counts[1] = counts[2] = 0;
 	VectorCopyRegularToAccu( normal, normalAccu );
-
-	for ( i = 0; i < in->numpoints; i++ )
-	{
-		dists[i] = DotProductAccu( in->p[i], normalAccu ) - dist;
-		if ( dists[i] > fineEpsilon ) {
-			sides[i] = SIDE_FRONT;
-		}
-		else if ( dists[i] < -fineEpsilon ) {
-			sides[i] = SIDE_BACK;
-		}
-		else{sides[i] = SIDE_ON; }
-		counts[sides[i]]++;
-	}
-	sides[i] = sides[0];
-	dists[i] = dists[0];
+	WindingAccuPlaneSides( in->p, in->numpoints, normalAccu, dist, fineEpsilon, dists, sides, counts );
 
 	// I'm wondering if whatever code that handles duplicate planes is robust enough
 	// that we never get a case where two nearly equal planes result in 2 NULL windings
@@ -752,24 +925,15 @@ void ChopWindingInPlaceAccu( winding_accu_t **inout, vec3_t normal, vec_t dist,
 	// NOTE: The least number of points that a winding can have at this point is 2.
 	// In that case, one point is SIDE_FRONT and the other is SIDE_BACK.
 
-	maxpts = counts[SIDE_FRONT] + 2; // We dynamically expand if this is too small.
-	f = AllocWindingAccu( maxpts );
+	f.numpoints = 0;
 
 	for ( i = 0; i < in->numpoints; i++ )
 	{
 		p1 = in->p[i];
 
 		if ( sides[i] == SIDE_ON || sides[i] == SIDE_FRONT ) {
-			if ( f->numpoints >= MAX_POINTS_ON_WINDING ) {
-				Error( "ChopWindingInPlaceAccu: MAX_POINTS_ON_WINDING" );
-			}
-			if ( f->numpoints >= maxpts ) { // This will probably never happen.
-				Sys_FPrintf( SYS_VRB, "WARNING: estimate on chopped winding size incorrect (no problem)\n" );
-				f = CopyWindingAccuIncreaseSizeAndFreeOld( f );
-				maxpts++;
-			}
-			VectorCopyAccu( p1, f->p[f->numpoints] );
-			f->numpoints++;
+			VectorCopyAccu( p1, f.p[f.numpoints] );
+			f.numpoints++;
 			if ( sides[i] == SIDE_ON ) {
 				continue;
 			}
@@ -796,20 +960,22 @@ void ChopWindingInPlaceAccu( winding_accu_t **inout, vec3_t normal, vec_t dist,
 			}
 			else{mid[j] = p1[j] + ( w * ( p2[j] - p1[j] ) ); }
 		}
-		if ( f->numpoints >= MAX_POINTS_ON_WINDING ) {
-			Error( "ChopWindingInPlaceAccu: MAX_POINTS_ON_WINDING" );
-		}
-		if ( f->numpoints >= maxpts ) { // This will probably never happen.
-			Sys_FPrintf( SYS_VRB, "WARNING: estimate on chopped winding size incorrect (no problem)\n" );
-			f = CopyWindingAccuIncreaseSizeAndFreeOld( f );
-			maxpts++;
-		}
-		VectorCopyAccu( mid, f->p[f->numpoints] );
-		f->numpoints++;
+		VectorCopyAccu( mid, f.p[f.numpoints] );
+		f.numpoints++;
+	}
+
+	if ( f.numpoints > MAX_POINTS_ON_WINDING ) {
+		Error( "ChopWindingInPlaceAccu: MAX_POINTS_ON_WINDING" );
 	}
 
-	FreeWindingAccu( in );
-	*inout = f;
+	// Reuse the input if the result fits, which is nearly always.
+	if ( f.numpoints > WindingAccuCapacity( in ) ) {
+		FreeWindingAccu( in );
+		in = AllocWindingAccu( f.numpoints );
+		*inout = in;
+	}
+	in->numpoints = f.numpoints;
+	memcpy( in->p, f.p, f.numpoints * sizeof( f.p[0] ) );
 }
 
 /*
@@ -822,36 +988,17 @@ void ChopWindingInPlace( winding_t **inout, vec3_t normal, vec_t dist, vec_t eps
 	vec_t dists[MAX_POINTS_ON_WINDING + 4];
 	int sides[MAX_POINTS_ON_WINDING + 4];
 	int counts[3];
-	static vec_t dot;           // VC 4.2 optimizer bug if not static
+	vec_t dot;
 	int i, j;
 	vec_t   *p1, *p2;
 	vec3_t mid;
-	winding_t   *f;
+	stackWinding_t f;
 	int maxpts;
 
 	in = *inout;
-	counts[0] = counts[1] = counts[2] = 0;
 
 // determine sides for each point
-	for ( i = 0 ; i < in->numpoints ; i++ )
-	{
-		dot = DotProduct( in->p[i], normal );
-		dot -= dist;
-		dists[i] = dot;
-		if ( dot > epsilon ) {
-			sides[i] = SIDE_FRONT;
-		}
-		else if ( dot < -epsilon ) {
-			sides[i] = SIDE_BACK;
-		}
-		else
-		{
-			sides[i] = SIDE_ON;
-		}
-		counts[sides[i]]++;
-	}
-	sides[i] = sides[0];
-	dists[i] = dists[0];
+	WindingPlaneSides( in->p, in->numpoints, normal, dist, epsilon, dists, sides, counts );
 
 	if ( !counts[0] ) {
 		FreeWinding( in );
@@ -865,21 +1012,21 @@ void ChopWindingInPlace( winding_t **inout, vec3_t normal, vec_t dist, vec_t eps
 	maxpts = in->numpoints + 4;   // cant use counts[0]+2 because
 	                              // of fp grouping errors
 
-	f = AllocWinding( maxpts );
+	f.numpoints = 0;
 
 	for ( i = 0 ; i < in->numpoints ; i++ )
 	{
 		p1 = in->p[i];
 
 		if ( sides[i] == SIDE_ON ) {
-			VectorCopy( p1, f->p[f->numpoints] );
-			f->numpoints++;
+			VectorCopy( p1, f.p[f.numpoints] );
+			f.numpoints++;
 			continue;
 		}
 
 		if ( sides[i] == SIDE_FRONT ) {
-			VectorCopy( p1, f->p[f->numpoints] );
-			f->numpoints++;
+			VectorCopy( p1, f.p[f.numpoints] );
+			f.numpoints++;
 		}
 
 		if ( sides[i + 1] == SIDE_ON || sides[i + 1] == sides[i] ) {
@@ -903,19 +1050,25 @@ void ChopWindingInPlace( winding_t **inout, vec3_t normal, vec_t dist, vec_t eps
 			}
 		}
 
-		VectorCopy( mid, f->p[f->numpoints] );
-		f->numpoints++;
+		VectorCopy( mid, f.p[f.numpoints] );
+		f.numpoints++;
 	}
 
-	if ( f->numpoints > maxpts ) {
+	if ( f.numpoints > maxpts ) {
 		Error( "ClipWinding: points exceeded estimate" );
 	}
-	if ( f->numpoints > MAX_POINTS_ON_WINDING ) {
+	if ( f.numpoints > MAX_POINTS_ON_WINDING ) {
 		Error( "ClipWinding: MAX_POINTS_ON_WINDING" );
 	}
 
-	FreeWinding( in );
-	*inout = f;
+	// reuse the input if the result fits, which is nearly always
+	if ( f.numpoints > WindingCapacity( in ) ) {
+		FreeWinding( in );
+		in = AllocWinding( f.numpoints );
+		*inout = in;
+	}
+	in->numpoints = f.numpoints;
+	memcpy( in->p, f.p, f.numpoints * sizeof( f.p[0] ) );
 }
 
 
@@ -20,11 +20,19 @@
  */
 
 
+#define MAX_THREADS 64
+
 extern int numthreads;
+extern qboolean threaded;     /* qtrue while RunThreadsOn is running worker threads */
+
+/* running totals for profiling: wall seconds of runs on worker threads, and the cpu seconds each worker used */
+extern double threadRunTime;
+extern double threadCPUTime[ MAX_THREADS ];
 
 void ThreadSetDefault( void );
 int GetThreadWork( void );
 void RunThreadsOnIndividual( int workcnt, qboolean showpacifier, void ( *func )( int ) );
 void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) );
+int ThreadNumber( void );     /* 0 .. numthreads - 1 inside RunThreadsOn workers, 0 elsewhere */
 void ThreadLock( void );
 void ThreadUnlock( void );
@@ -33,8 +33,6 @@
 #include "inout.h"
 #include "qthreads.h"
 
-#define MAX_THREADS 64
-
 int dispatch;
 int workcount;
 int oldf;
@@ -42,6 +40,29 @@ qboolean pacifier;
 
 qboolean threaded;
 
+double threadRunTime;
+double threadCPUTime[ MAX_THREADS ];
+
+/* worker threads record their number here, the main thread keeps 0 */
+#if defined( _MSC_VER )
+static __declspec( thread ) int threadNumber;
+#else
+static __thread int threadNumber;
+#endif
+static void ( *threadFunc )( int );
+
+/* ms between writes of the workers' output */
+#define OUTPUT_INTERVAL 10
+
+/*
+   =============
+   ThreadNumber
+   =============
+ */
+int ThreadNumber( void ){
+	return threadNumber;
+}
+
 /*
    =============
    GetThreadWork
@@ -138,6 +159,9 @@ void ThreadSetDefault( void ){
 			numthreads = 1;
 		}
 	}
+	if ( numthreads > MAX_THREADS ) {
+		numthreads = MAX_THREADS;
+	}
 
 	Sys_Printf( "%i threads\n", numthreads );
 }
@@ -165,6 +189,21 @@ void ThreadUnlock( void ){
 	LeaveCriticalSection( &crit );
 }
 
+static DWORD WINAPI ThreadStart( LPVOID num ){
+	FILETIME creation, exit, kernel, user;
+
+	threadNumber = (int)(uintptr_t) num;
+	Sys_ThreadOutputStart( threadNumber );
+	threadFunc( threadNumber );
+
+	/* 100 ns units */
+	if ( GetThreadTimes( GetCurrentThread(), &creation, &exit, &kernel, &user ) ) {
+		threadCPUTime[ threadNumber ] += ( ( (ULONGLONG) kernel.dwHighDateTime << 32 | kernel.dwLowDateTime )
+										 + ( (ULONGLONG) user.dwHighDateTime << 32 | user.dwLowDateTime ) ) / 10000000.0;
+	}
+	return 0;
+}
+
 /*
    =============
    RunThreadsOn
@@ -175,6 +214,7 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) ){
 	HANDLE threadhandle[MAX_THREADS];
 	int i;
 	int start, end;
+	double runStart;
 
 	start = I_FloatTime();
 	dispatch = 0;
@@ -193,6 +233,9 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) ){
 	}
 	else
 	{
+		runStart = I_PreciseTime();
+		threadFunc = func;
+		Sys_BeginThreadOutput( numthreads );
 		for ( i = 0 ; i < numthreads ; i++ )
 		{
 			threadhandle[i] = CreateThread(
@@ -202,14 +245,19 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) ){
 			    /* ydnar: cranking stack size to eliminate radiosity crash with 1MB stack on win32 */
 				( 4096 * 1024 ),
 
-				(LPTHREAD_START_ROUTINE)func,   // LPTHREAD_START_ROUTINE lpStartAddr,
-				(LPVOID)i,  // LPVOID lpvThreadParm,
+				ThreadStart,    // LPTHREAD_START_ROUTINE lpStartAddr,
+				(LPVOID)(uintptr_t)i,   // LPVOID lpvThreadParm,
 				0,          //   DWORD fdwCreate,
 				&threadid[i] );
 		}
 
+		/* write the output of the threads while waiting for them */
+		while ( WaitForMultipleObjects( numthreads, threadhandle, TRUE, OUTPUT_INTERVAL ) == WAIT_TIMEOUT )
+			Sys_FlushThreadOutput();
 		for ( i = 0 ; i < numthreads ; i++ )
-			WaitForSingleObject( threadhandle[i], INFINITE );
+			CloseHandle( threadhandle[i] );
+		Sys_EndThreadOutput();
+		threadRunTime += I_PreciseTime() - runStart;
 	}
 	DeleteCriticalSection( &crit );
 
@@ -445,6 +493,9 @@ void ThreadSetDefault( void ){
 		/* can't detect, so default to four threads */
 		numthreads = 4;
 	}
+	if ( numthreads > MAX_THREADS ) {
+		numthreads = MAX_THREADS;
+	}
 
 	if ( numthreads > 1 ) {
 		Sys_Printf( "threads: %d\n", numthreads );
@@ -528,6 +579,58 @@ void recursive_mutex_init( pthread_mutexattr_t attribs ){
 	pt_mutex->lock = 0;
 }
 
+/* the thread running RunThreadsOn waits on this for the workers, writing their output */
+static pthread_mutex_t doneMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;
+static int numThreadsDone;
+
+static void *ThreadStart( void *num ){
+	struct timespec ts;
+
+	threadNumber = (int)(uintptr_t) num;
+	Sys_ThreadOutputStart( threadNumber );
+	threadFunc( threadNumber );
+
+	/* every run gets fresh threads, so this is the cpu time of this run */
+	if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 ) {
+		threadCPUTime[ threadNumber ] += ts.tv_sec + ts.tv_nsec / 1000000000.0;
+	}
+
+	pthread_mutex_lock( &doneMutex );
+	numThreadsDone++;
+	pthread_cond_signal( &doneCond );
+	pthread_mutex_unlock( &doneMutex );
+	return NULL;
+}
+
+/*
+   =============
+   WaitForThreads
+
+   writes the output of the workers every OUTPUT_INTERVAL ms until they are all done
+   =============
+ */
+static void WaitForThreads( void ){
+	struct timespec ts;
+
+	pthread_mutex_lock( &doneMutex );
+	while ( numThreadsDone < numthreads )
+	{
+		clock_gettime( CLOCK_REALTIME, &ts );
+		ts.tv_nsec += OUTPUT_INTERVAL * 1000000;
+		if ( ts.tv_nsec >= 1000000000 ) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait( &doneCond, &doneMutex, &ts );
+
+		pthread_mutex_unlock( &doneMutex );
+		Sys_FlushThreadOutput();
+		pthread_mutex_lock( &doneMutex );
+	}
+	pthread_mutex_unlock( &doneMutex );
+}
+
 /*
    =============
    RunThreadsOn
@@ -541,6 +644,7 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) ){
 
 	int start, end;
 	int i = 0;
+	double runStart;
 
 	start     = I_FloatTime();
 	pacifier  = showpacifier;
@@ -575,19 +679,26 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, void ( *func )( int ) ){
 		}
 		recursive_mutex_init( mattrib );
 
+		runStart = I_PreciseTime();
+		threadFunc = func;
+		numThreadsDone = 0;
+		Sys_BeginThreadOutput( numthreads );
 		for ( i = 0 ; i < numthreads ; i++ )
 		{
 			/* Default pthread attributes: joinable & non-realtime scheduling */
-			if ( pthread_create(&work_threads[i], &attr, (void *(*)(void *)) func, (void*)(uintptr_t)i ) != 0 ) {
+			if ( pthread_create(&work_threads[i], &attr, ThreadStart, (void*)(uintptr_t)i ) != 0 ) {
 				Error( "pthread_create failed" );
 			}
 		}
+		WaitForThreads();
 		for ( i = 0 ; i < numthreads ; i++ )
 		{
 			if ( pthread_join( work_threads[i], NULL ) != 0 ) {
 				Error( "pthread_join failed" );
 			}
 		}
+		Sys_EndThreadOutput();
+		threadRunTime += I_PreciseTime() - runStart;
 		pthread_mutexattr_destroy( &mattrib );
 		threaded = qfalse;
 	}
@@ -53,19 +53,35 @@
 #include <minizip/unzip.h>
 #include <glib.h>
 
-typedef struct
+typedef struct VFS_PAKFILE_s
 {
 	char*   name;
 	unzFile zipfile;
 	unz_file_pos zippos;
 	guint32 size;
+	struct VFS_PAKFILE_s* hashNext;
 } VFS_PAKFILE;
 
+// directory contents, read the first time a file is looked up in it
+typedef struct VFS_DIRLIST_s
+{
+	char*   path;
+	char**  names;
+	int numNames;
+	struct VFS_DIRLIST_s* hashNext;
+} VFS_DIRLIST;
+
+#define VFS_PAKHASH_SIZE 65536
+#define VFS_DIRHASH_SIZE 4096
+
 // =============================================================================
 // Global variables
 
 static GSList*  g_unzFiles;
-static GSList*  g_pakFiles;
+// pak files by lower-cased name, each chain in load order
+static VFS_PAKFILE* g_pakHash[VFS_PAKHASH_SIZE];
+static VFS_PAKFILE** g_pakHashTail[VFS_PAKHASH_SIZE];
+static VFS_DIRLIST* g_dirHash[VFS_DIRHASH_SIZE];
 static char g_strDirs[VFS_MAXDIRS][PATH_MAX + 1];
 static int g_numDirs;
 char g_strForbiddenDirs[VFS_MAXDIRS][PATH_MAX + 1];
@@ -101,6 +117,106 @@ static void vfsFixDOSName( char *src ){
 //!\todo Define globally or use heap-allocated string.
 #define NAME_MAX 255
 
+static unsigned int vfsHashName( const char *name ){
+	unsigned int hash = 0;
+
+	while ( *name )
+	{
+		hash = hash * 31 + (unsigned char) *name++;
+	}
+	return hash;
+}
+
+static void vfsAddPakFile( VFS_PAKFILE *file ){
+	unsigned int hash = vfsHashName( file->name ) & ( VFS_PAKHASH_SIZE - 1 );
+
+	file->hashNext = NULL;
+	if ( g_pakHash[hash] == NULL ) {
+		g_pakHash[hash] = file;
+	}
+	else{
+		*g_pakHashTail[hash] = file;
+	}
+	g_pakHashTail[hash] = &file->hashNext;
+}
+
+static VFS_PAKFILE *vfsFindPakFile( const char *lower ){
+	return g_pakHash[vfsHashName( lower ) & ( VFS_PAKHASH_SIZE - 1 )];
+}
+
+// access() follows the file system, so match case the way it would
+#if GDEF_OS_WINDOWS || GDEF_OS_MACOS
+#define vfsNameCompare Q_stricmp
+#else
+#define vfsNameCompare strcmp
+#endif
+
+static int vfsCompareNames( const void *a, const void *b ){
+	return vfsNameCompare( *(char* const*) a, *(char* const*) b );
+}
+
+static VFS_DIRLIST *vfsGetDirList( const char *path ){
+	unsigned int hash = vfsHashName( path ) & ( VFS_DIRHASH_SIZE - 1 );
+	VFS_DIRLIST *list;
+	GDir *dir;
+	const char *name;
+	int allocated;
+
+	for ( list = g_dirHash[hash]; list != NULL; list = list->hashNext )
+	{
+		if ( strcmp( list->path, path ) == 0 ) {
+			return list;
+		}
+	}
+
+	list = (VFS_DIRLIST*)safe_malloc( sizeof( VFS_DIRLIST ) );
+	list->path = strdup( path );
+	list->names = NULL;
+	list->numNames = 0;
+	allocated = 0;
+
+	// a missing directory simply lists nothing
+	dir = g_dir_open( path, 0, NULL );
+	if ( dir != NULL ) {
+		while ( ( name = g_dir_read_name( dir ) ) != NULL )
+		{
+			if ( list->numNames == allocated ) {
+				allocated = allocated ? allocated * 2 : 64;
+				list->names = (char**)realloc( list->names, allocated * sizeof( char* ) );
+				if ( list->names == NULL ) {
+					Error( "vfsGetDirList: out of memory" );
+				}
+			}
+			list->names[list->numNames++] = strdup( name );
+		}
+		g_dir_close( dir );
+		qsort( list->names, list->numNames, sizeof( char* ), vfsCompareNames );
+	}
+
+	list->hashNext = g_dirHash[hash];
+	g_dirHash[hash] = list;
+	return list;
+}
+
+// stands in for access( path, R_OK ) == 0 without a system call per lookup;
+// files created after their directory was first listed are not seen
+static gboolean vfsFileExists( const char *path ){
+	char dirpath[PATH_MAX + NAME_MAX];
+	const char *base;
+	VFS_DIRLIST *list;
+
+	base = strrchr( path, '/' );
+	if ( base == NULL || base[1] == '\0' || (size_t)( base - path + 1 ) >= sizeof( dirpath ) ) {
+		return access( path, R_OK ) == 0;
+	}
+	memcpy( dirpath, path, base - path + 1 );
+	dirpath[base - path + 1] = '\0';
+	base++;
+
+	list = vfsGetDirList( dirpath );
+	return bsearch( &base, list->names, list->numNames, sizeof( char* ), vfsCompareNames ) != NULL;
+}
+
 static void vfsInitPakFile( const char *filename ){
 	unz_global_info gi;
 	unzFile uf;
@@ -138,7 +254,6 @@ static void vfsInitPakFile( const char *filename ){
 		}
 
 		file = (VFS_PAKFILE*)safe_malloc( sizeof( VFS_PAKFILE ) );
-		g_pakFiles = g_slist_append( g_pakFiles, file );
 
 		vfsFixDOSName( filename_inzip );
 		 //-1 null terminated string
@@ -148,6 +263,7 @@ static void vfsInitPakFile( const char *filename ){
 		file->size = file_info.uncompressed_size;
 		file->zipfile = uf;
 		file->zippos = pos;
+		vfsAddPakFile( file );
 
 		if ( ( i + 1 ) < gi.number_entry ) {
 			err = unzGoToNextFile( uf );
@@ -255,18 +371,39 @@ void vfsInitDirectory( const char *path ){
 
 // frees all memory that we allocated
 void vfsShutdown(){
+	int i, j;
+
 	while ( g_unzFiles )
 	{
 		unzClose( (unzFile)g_unzFiles->data );
 		g_unzFiles = g_slist_remove( g_unzFiles, g_unzFiles->data );
 	}
 
-	while ( g_pakFiles )
+	for ( i = 0; i < VFS_PAKHASH_SIZE; i++ )
 	{
-		VFS_PAKFILE* file = (VFS_PAKFILE*)g_pakFiles->data;
-		free( file->name );
-		free( file );
-		g_pakFiles = g_slist_remove( g_pakFiles, file );
+		while ( g_pakHash[i] )
+		{
+			VFS_PAKFILE* file = g_pakHash[i];
+			g_pakHash[i] = file->hashNext;
+			free( file->name );
+			free( file );
+		}
+	}
+
+	for ( i = 0; i < VFS_DIRHASH_SIZE; i++ )
+	{
+		while ( g_dirHash[i] )
+		{
+			VFS_DIRLIST* list = g_dirHash[i];
+			g_dirHash[i] = list->hashNext;
+			for ( j = 0; j < list->numNames; j++ )
+			{
+				free( list->names[j] );
+			}
+			free( list->names );
+			free( list->path );
+			free( list );
+		}
 	}
 }
 
@@ -275,16 +412,14 @@ int vfsGetFileCount( const char *filename ){
 	int i, count = 0;
 	char fixed[NAME_MAX], tmp[NAME_MAX];
 	char *lower;
-	GSList *lst;
+	VFS_PAKFILE *file;
 
 	strcpy( fixed, filename );
 	vfsFixDOSName( fixed );
 	lower = g_ascii_strdown( fixed, -1 );
 
-	for ( lst = g_pakFiles; lst != NULL; lst = g_slist_next( lst ) )
+	for ( file = vfsFindPakFile( lower ); file != NULL; file = file->hashNext )
 	{
-		VFS_PAKFILE* file = (VFS_PAKFILE*)lst->data;
-
 		if ( strcmp( file->name, lower ) == 0 ) {
 			count++;
 		}
@@ -294,7 +429,7 @@ int vfsGetFileCount( const char *filename ){
 	{
 		strcpy( tmp, g_strDirs[i] );
 		strcat( tmp, lower );
-		if ( access( tmp, R_OK ) == 0 ) {
+		if ( vfsFileExists( tmp ) ) {
 			count++;
 		}
 	}
@@ -307,7 +442,7 @@ int vfsLoadFile( const char *filename, void **bufferptr, int index ){
 	int i, count = 0;
 	char tmp[NAME_MAX], fixed[NAME_MAX];
 	char *lower;
-	GSList *lst;
+	VFS_PAKFILE *file;
 
 	// filename is a full path
 	if ( index == -1 ) {
@@ -350,7 +485,7 @@ int vfsLoadFile( const char *filename, void **bufferptr, int index ){
 	{
 		strcpy( tmp, g_strDirs[i] );
 		strcat( tmp, filename );
-		if ( access( tmp, R_OK ) == 0 ) {
+		if ( vfsFileExists( tmp ) ) {
 			if ( count == index ) {
 				long len;
 				FILE *f;
@@ -386,10 +521,8 @@ int vfsLoadFile( const char *filename, void **bufferptr, int index ){
 		}
 	}
 
-	for ( lst = g_pakFiles; lst != NULL; lst = g_slist_next( lst ) )
+	for ( file = vfsFindPakFile( lower ); file != NULL; file = file->hashNext )
 	{
-		VFS_PAKFILE* file = (VFS_PAKFILE*)lst->data;
-
 		if ( strcmp( file->name, lower ) != 0 ) {
 			continue;
 		}
@@ -38,6 +38,23 @@
 
 
 
+/* brushes are pooled by side count, bigger ones come from the heap */
+#define BRUSH_POOL( numSides )  MEMPOOL( "brushes", sizeof( memPoolHeader_t ) + (size_t)&( ( (brush_t*) 0 )->sides[ numSides ] ) )
+
+static memPool_t brushPools[] =
+{
+	BRUSH_POOL( 6 ),
+	BRUSH_POOL( 8 ),
+	BRUSH_POOL( 12 ),
+	BRUSH_POOL( 16 ),
+	BRUSH_POOL( 24 ),
+	BRUSH_POOL( 32 )
+};
+
+static memPool_t nodePool = MEMPOOL( "nodes", sizeof( node_t ) );
+
+
+
 /* -------------------------------------------------------------------------------
 
    functions
@@ -98,7 +115,7 @@ brush_t *AllocBrush( int numSides ){
 		Error( "AllocBrush called with numsides = %d", numSides );
 	}
 	c = (size_t)&( ( (brush_t*) 0 )->sides[ numSides ] );
-	bb = safe_malloc( c );
+	bb = PoolAllocSized( brushPools, sizeof( brushPools ) / sizeof( brushPools[ 0 ] ), c );
 	memset( bb, 0, c );
 	if ( numthreads == 1 ) {
 		numActiveBrushes++;
@@ -136,7 +153,7 @@ void FreeBrush( brush_t *b ){
 	*( (unsigned int*) b ) = 0xFEFEFEFE;
 
 	/* free it */
-	free( b );
+	PoolFreeSized( b );
 	if ( numthreads == 1 ) {
 		numActiveBrushes--;
 	}
@@ -844,12 +861,21 @@ tree_t *AllocTree( void ){
 node_t *AllocNode( void ){
 	node_t  *node;
 
-	node = safe_malloc( sizeof( *node ) );
+	node = PoolAlloc( &nodePool );
 	memset( node, 0, sizeof( *node ) );
 
 	return node;
 }
 
+/*
+   ================
+   FreeNode
+   ================
+ */
+void FreeNode( node_t *node ){
+	PoolFree( &nodePool, node );
+}
+
 
 /*
    ================
@@ -327,7 +327,9 @@ void ProcessWorldModel( const char *portalFilePath, const char *lineFilePath ){
 	FilterStructuralBrushesIntoTree( e, tree );
 
 	/* see if the bsp is completely enclosed */
+	ProfileBegin( "FloodEntities" );
 	leakStatus = FloodEntities( tree );
+	ProfileEnd();
 	if ( ignoreLeaks ) {
 		if ( leakStatus == FLOODENTITIES_LEAKED ) {
 			leakStatus = FLOODENTITIES_GOOD;
@@ -388,7 +390,9 @@ void ProcessWorldModel( const char *portalFilePath, const char *lineFilePath ){
 	FloodAreas( tree );
 
 	/* create drawsurfs for triangle models */
+	ProfileBegin( "AddTriangleModels" );
 	AddTriangleModels( e );
+	ProfileEnd();
 
 	/* create drawsurfs for surface models */
 	AddEntitySurfaceModels( e );
@@ -401,7 +405,10 @@ void ProcessWorldModel( const char *portalFilePath, const char *lineFilePath ){
 
 	/* drawsurfs that cross fog boundaries will need to be split along the fog boundary */
 	if ( !nofog ) {
+		ProfileBegin( "FogDrawSurfaces" );
+		SetupDrawSurfaceTree( e );
 		FogDrawSurfaces( e );
+		ProfileEnd();
 	}
 
 	/* subdivide each drawsurf as required by shader tesselation */
@@ -417,8 +424,12 @@ void ProcessWorldModel( const char *portalFilePath, const char *lineFilePath ){
 	/* ydnar: classify the surfaces */
 	ClassifyEntitySurfaces( e );
 
-	/* ydnar: project decals */
+	/* ydnar: project decals (surfaces changed since fogging, so the tree is rebuilt) */
+	ProfileBegin( "MakeEntityDecals" );
+	SetupDrawSurfaceTree( e );
 	MakeEntityDecals( e );
+	FreeDrawSurfaceTree();
+	ProfileEnd();
 
 	/* ydnar: meta surfaces */
 	MakeEntityMetaTriangles( e );
@@ -567,7 +578,11 @@ void ProcessSubModel( void ){
 	ClassifyEntitySurfaces( e );
 
 	/* ydnar: project decals */
+	ProfileBegin( "MakeEntityDecals" );
+	SetupDrawSurfaceTree( e );
 	MakeEntityDecals( e );
+	FreeDrawSurfaceTree();
+	ProfileEnd();
 
 	/* ydnar: meta surfaces */
 	MakeEntityMetaTriangles( e );
@@ -607,6 +622,9 @@ void ProcessModels( const char *portalFilePath, const char *lineFilePath ){
 	/* create map fogs */
 	CreateMapFogs();
 
+	/* find bordering patches of all entities at once, this is the entity-local part that can run on all threads */
+	PatchMapBorders();
+
 	/* walk entity list */
 	for ( mapEntityNum = 0; mapEntityNum < numEntities; mapEntityNum++ )
 	{
@@ -619,10 +637,14 @@ void ProcessModels( const char *portalFilePath, const char *lineFilePath ){
 		/* process the model */
 		Sys_FPrintf( SYS_VRB, "############### model %i ###############\n", numBSPModels );
 		if ( mapEntityNum == 0 ) {
+			ProfileBegin( "ProcessWorldModel" );
 			ProcessWorldModel(portalFilePath, lineFilePath);
+			ProfileEnd();
 		}
 		else{
+			ProfileBegin( "ProcessSubModel" );
 			ProcessSubModel();
+			ProfileEnd();
 		}
 
 		/* potentially turn off the deluge of text */
@@ -632,6 +654,13 @@ void ProcessModels( const char *portalFilePath, const char *lineFilePath ){
 	/* restore -v setting */
 	verbose = oldVerbose;
 
+	FreePatchBorders();
+	FreeMeshCache();
+
+	/* report peak memory of the compile objects and give back the pools no longer in use */
+	PrintPoolStats();
+	PoolReleaseAll();
+
 	/* write fogs */
 	EmitFogs();
 
@@ -1004,6 +1033,10 @@ int BSPMain( int argc, char **argv ){
 			i++;
 			Sys_Printf( "Use %s as portal file\n", portalFilePath );
 		}
+		else if ( !strcmp( argv[ i ], "-binaryprt" ) ) {
+			Sys_Printf( "Writing binary portal file\n" );
+			binaryPortalFile = qtrue;
+		}
 		else if ( !strcmp( argv[ i ], "-srffile" ) )
 		{
 			strcpy( surfaceFilePath, argv[i + 1] );
@@ -1059,6 +1092,9 @@ int BSPMain( int argc, char **argv ){
 
 	/* if onlyents, just grab the entites and resave */
 	if ( onlyents ) {
+		if ( bspInMemory ) {
+			Error( "-onlyents can't be used with -vis or -light" );
+		}
 		OnlyEnts( BSPFilePath );
 		return 0;
 	}
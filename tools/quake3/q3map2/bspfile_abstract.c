@@ -36,6 +36,12 @@
 /* dependencies */
 #include "q3map2.h"
 
+#ifdef Q_UNIX
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
 
 
 
@@ -293,6 +299,94 @@ void *GetLump( bspHeader_t *header, int lump ){
 
 
 
+/*
+   LoadBSPFileData()
+   maps a bsp file copy-on-write where the os allows it, so the loaders copy lumps
+   straight out of the page cache instead of out of a heap copy of the whole file.
+   the lumps can't be used in place, the bsp arrays get realloc'd and freed later on
+ */
+
+static qboolean bspFileMapped;
+
+void *LoadBSPFileData( const char *filename, int *length ){
+	void    *data;
+
+
+	#ifdef Q_UNIX
+	{
+		int fd;
+		struct stat st;
+
+
+		fd = open( filename, O_RDONLY );
+		if ( fd >= 0 ) {
+			data = MAP_FAILED;
+			if ( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+				data = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+			}
+			close( fd );
+			if ( data != MAP_FAILED ) {
+				bspFileMapped = qtrue;
+				*length = st.st_size;
+				return data;
+			}
+		}
+	}
+	#endif
+
+	/* read it */
+	bspFileMapped = qfalse;
+	*length = LoadFile( filename, &data );
+	return data;
+}
+
+
+
+/*
+   FreeBSPFileData()
+   releases what LoadBSPFileData returned
+ */
+
+void FreeBSPFileData( void *data, int length ){
+	#ifdef Q_UNIX
+	if ( bspFileMapped ) {
+		munmap( data, length );
+		bspFileMapped = qfalse;
+		return;
+	}
+	#endif
+	free( data );
+}
+
+
+
+/*
+   CheckLumps()
+   makes sure no lump reaches past the end of the file, a mapped file would fault there
+ */
+
+void CheckLumps( bspHeader_t *header, int numLumps, int length ){
+	int i;
+
+
+	for ( i = 0; i < numLumps; i++ )
+	{
+		if ( header->lumps[ i ].offset < 0 || header->lumps[ i ].length < 0 ||
+			 header->lumps[ i ].offset > length || header->lumps[ i ].length > length - header->lumps[ i ].offset ) {
+			if ( force ) {
+				Sys_FPrintf( SYS_WRN, "WARNING: CheckLumps: lump %d (%d bytes at %d) is past the end of the file\n", i, header->lumps[ i ].length, header->lumps[ i ].offset );
+				header->lumps[ i ].offset = 0;
+				header->lumps[ i ].length = 0;
+			}
+			else{
+				Error( "CheckLumps: lump %d (%d bytes at %d) is past the end of the file", i, header->lumps[ i ].length, header->lumps[ i ].offset );
+			}
+		}
+	}
+}
+
+
+
 /*
    CopyLump()
    copies a bsp file lump into a destination buffer
@@ -365,8 +459,10 @@ void LoadBSPFile( const char *filename ){
 	}
 
 	/* load it, then byte swap the in-memory version */
+	ProfileBegin( "LoadBSPFile" );
 	game->load( filename );
 	SwapBSPFile();
+	ProfileEnd();
 }
 
 
@@ -391,13 +487,30 @@ void WriteBSPFile( const char *filename ){
 	sprintf( tempname, "%s.%08X", filename, (int) tm );
 
 	/* byteswap, write the bsp, then swap back so it can be manipulated further */
+	ProfileBegin( "WriteBSPFile" );
 	SwapBSPFile();
 	game->write( tempname );
 	SwapBSPFile();
+	ProfileEnd();
 
 	/* replace existing bsp file */
 	remove( filename );
 	rename( tempname, filename );
+	bspFileWritten = qtrue;
+}
+
+
+
+/*
+   ConformBSPData()
+   drops what writing and reloading the bsp in the game's format would,
+   so a stage taking the bsp over in memory sees the same data
+ */
+
+void ConformBSPData( void ){
+	if ( game != NULL && game->load == LoadIBSPFile ) {
+		ConformIBSPData();
+	}
 }
 
 
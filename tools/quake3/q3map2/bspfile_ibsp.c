@@ -454,10 +454,14 @@ static void AddLightGridLumps( FILE *file, ibspHeader_t *header ){
 
 void LoadIBSPFile( const char *filename ){
 	ibspHeader_t    *header;
+	int length;
 
 
 	/* load the file header */
-	LoadFile( filename, (void**) &header );
+	header = LoadBSPFileData( filename, &length );
+	if ( length < (int) sizeof( *header ) ) {
+		Error( "%s is too short to be a bsp file", filename );
+	}
 
 	/* swap the header (except the first 4 bytes) */
 	SwapBlock( (int*) ( (byte*) header + sizeof( int ) ), sizeof( *header ) - sizeof( int ) );
@@ -471,6 +475,8 @@ void LoadIBSPFile( const char *filename ){
 	}
 
 	/* load/convert lumps */
+	CheckLumps( (bspHeader_t*) header, HEADER_LUMPS, length );
+
 	numBSPShaders = CopyLump_Allocate( (bspHeader_t*) header, LUMP_SHADERS, (void **) &bspShaders, sizeof( bspShader_t ), &allocatedBSPShaders );
 
 	numBSPModels = CopyLump_Allocate( (bspHeader_t*) header, LUMP_MODELS, (void **) &bspModels, sizeof( bspModel_t ), &allocatedBSPModels );
@@ -516,7 +522,50 @@ void LoadIBSPFile( const char *filename ){
 	}
 
 	/* free the file buffer */
-	free( header );
+	FreeBSPFileData( header, length );
+}
+
+
+
+/*
+   ConformIBSPData()
+   clears the extra lightmap styles and brush side surfaces the format doesn't store
+ */
+
+void ConformIBSPData( void ){
+	int i, j;
+	bspDrawSurface_t    *ds;
+	bspDrawVert_t       *dv;
+
+
+	for ( i = 0; i < numBSPBrushSides; i++ )
+		bspBrushSides[ i ].surfaceNum = -1;
+
+	for ( i = 0; i < numBSPDrawSurfaces; i++ )
+	{
+		ds = &bspDrawSurfaces[ i ];
+		ds->lightmapStyles[ 0 ] = LS_NORMAL;
+		ds->vertexStyles[ 0 ] = LS_NORMAL;
+		for ( j = 1; j < MAX_LIGHTMAPS; j++ )
+		{
+			ds->lightmapStyles[ j ] = LS_NONE;
+			ds->vertexStyles[ j ] = LS_NONE;
+			ds->lightmapNum[ j ] = -3;
+			ds->lightmapX[ j ] = 0;
+			ds->lightmapY[ j ] = 0;
+		}
+	}
+
+	for ( i = 0; i < numBSPDrawVerts; i++ )
+	{
+		dv = &bspDrawVerts[ i ];
+		for ( j = 1; j < MAX_LIGHTMAPS; j++ )
+		{
+			dv->lightmap[ j ][ 0 ] = 0.0f;
+			dv->lightmap[ j ][ 1 ] = 0.0f;
+			memset( dv->color[ j ], 0, sizeof( dv->color[ j ] ) );
+		}
+	}
 }
 
 
@@ -213,10 +213,14 @@ static void AddLightGridLumps( FILE *file, rbspHeader_t *header ){
 
 void LoadRBSPFile( const char *filename ){
 	rbspHeader_t    *header;
+	int length;
 
 
 	/* load the file header */
-	LoadFile( filename, (void**) &header );
+	header = LoadBSPFileData( filename, &length );
+	if ( length < (int) sizeof( *header ) ) {
+		Error( "%s is too short to be a bsp file", filename );
+	}
 
 	/* swap the header (except the first 4 bytes) */
 	SwapBlock( (int*) ( (byte*) header + sizeof( int ) ), sizeof( *header ) - sizeof( int ) );
@@ -230,6 +234,8 @@ void LoadRBSPFile( const char *filename ){
 	}
 
 	/* load/convert lumps */
+	CheckLumps( (bspHeader_t*) header, HEADER_LUMPS, length );
+
 	numBSPShaders = CopyLump_Allocate( (bspHeader_t*) header, LUMP_SHADERS, (void **) &bspShaders, sizeof( bspShader_t ), &allocatedBSPShaders );
 
 	numBSPModels = CopyLump_Allocate( (bspHeader_t*) header, LUMP_MODELS, (void **) &bspModels, sizeof( bspModel_t ), &allocatedBSPModels );
@@ -271,7 +277,7 @@ void LoadRBSPFile( const char *filename ){
 	CopyLightGridLumps( header );
 
 	/* free the file buffer */
-	free( header );
+	FreeBSPFileData( header, length );
 }
 
 
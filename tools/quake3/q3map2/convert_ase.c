@@ -44,61 +44,75 @@
  */
 
 int numLightmapsASE = 0;
-static void ConvertSurface( FILE *f, bspModel_t *model, int modelNum, bspDrawSurface_t *ds, int surfaceNum, vec3_t origin ){
+
+/* surfaces to export, in file order */
+typedef struct aseSurface_s
+{
+	int surfaceNum, modelNum;
+	vec3_t origin;
+}
+aseSurface_t;
+
+static aseSurface_t     *aseSurfaces;
+static int numASESurfaces, maxASESurfaces;
+
+static void ConvertSurface( textBuffer_t *f, int num ){
 	int i, v, face, a, b, c;
+	aseSurface_t        *as;
+	bspDrawSurface_t    *ds;
 	bspDrawVert_t   *dv;
 	vec3_t normal;
+	float           *origin;
 	char name[ 1024 ];
 
 
-	/* ignore patches for now */
-	if ( ds->surfaceType != MST_PLANAR && ds->surfaceType != MST_TRIANGLE_SOUP ) {
-		return;
-	}
+	as = &aseSurfaces[ num ];
+	ds = &bspDrawSurfaces[ as->surfaceNum ];
+	origin = as->origin;
 
 	/* print object header for each dsurf */
-	sprintf( name, "mat%dmodel%dsurf%d", ds->shaderNum, modelNum, surfaceNum );
-	fprintf( f, "*GEOMOBJECT\t{\r\n" );
-	fprintf( f, "\t*NODE_NAME\t\"%s\"\r\n", name );
-	fprintf( f, "\t*NODE_TM\t{\r\n" );
-	fprintf( f, "\t\t*NODE_NAME\t\"%s\"\r\n", name );
-	fprintf( f, "\t\t*INHERIT_POS\t0\t0\t0\r\n" );
-	fprintf( f, "\t\t*INHERIT_ROT\t0\t0\t0\r\n" );
-	fprintf( f, "\t\t*INHERIT_SCL\t0\t0\t0\r\n" );
-	fprintf( f, "\t\t*TM_ROW0\t1.0\t0\t0\r\n" );
-	fprintf( f, "\t\t*TM_ROW1\t0\t1.0\t0\r\n" );
-	fprintf( f, "\t\t*TM_ROW2\t0\t0\t1.0\r\n" );
-	fprintf( f, "\t\t*TM_ROW3\t0\t0\t0\r\n" );
-	fprintf( f, "\t\t*TM_POS\t%f\t%f\t%f\r\n", origin[ 0 ], origin[ 1 ], origin[ 2 ] );
-	fprintf( f, "\t}\r\n" );
+	sprintf( name, "mat%dmodel%dsurf%d", ds->shaderNum, as->modelNum, as->surfaceNum );
+	TextPrintf( f, "*GEOMOBJECT\t{\r\n" );
+	TextPrintf( f, "\t*NODE_NAME\t\"%s\"\r\n", name );
+	TextPrintf( f, "\t*NODE_TM\t{\r\n" );
+	TextPrintf( f, "\t\t*NODE_NAME\t\"%s\"\r\n", name );
+	TextPrintf( f, "\t\t*INHERIT_POS\t0\t0\t0\r\n" );
+	TextPrintf( f, "\t\t*INHERIT_ROT\t0\t0\t0\r\n" );
+	TextPrintf( f, "\t\t*INHERIT_SCL\t0\t0\t0\r\n" );
+	TextPrintf( f, "\t\t*TM_ROW0\t1.0\t0\t0\r\n" );
+	TextPrintf( f, "\t\t*TM_ROW1\t0\t1.0\t0\r\n" );
+	TextPrintf( f, "\t\t*TM_ROW2\t0\t0\t1.0\r\n" );
+	TextPrintf( f, "\t\t*TM_ROW3\t0\t0\t0\r\n" );
+	TextPrintf( f, "\t\t*TM_POS\t%f\t%f\t%f\r\n", origin[ 0 ], origin[ 1 ], origin[ 2 ] );
+	TextPrintf( f, "\t}\r\n" );
 
 	/* print mesh header */
-	fprintf( f, "\t*MESH\t{\r\n" );
-	fprintf( f, "\t\t*TIMEVALUE\t0\r\n" );
-	fprintf( f, "\t\t*MESH_NUMVERTEX\t%d\r\n", ds->numVerts );
-	fprintf( f, "\t\t*MESH_NUMFACES\t%d\r\n", ds->numIndexes / 3 );
+	TextPrintf( f, "\t*MESH\t{\r\n" );
+	TextPrintf( f, "\t\t*TIMEVALUE\t0\r\n" );
+	TextPrintf( f, "\t\t*MESH_NUMVERTEX\t%d\r\n", ds->numVerts );
+	TextPrintf( f, "\t\t*MESH_NUMFACES\t%d\r\n", ds->numIndexes / 3 );
 	switch ( ds->surfaceType )
 	{
 	case MST_PLANAR:
-		fprintf( f, "\t\t*COMMENT\t\"SURFACETYPE\tMST_PLANAR\"\r\n" );
+		TextPrintf( f, "\t\t*COMMENT\t\"SURFACETYPE\tMST_PLANAR\"\r\n" );
 		break;
 	case MST_TRIANGLE_SOUP:
-		fprintf( f, "\t\t*COMMENT\t\"SURFACETYPE\tMST_TRIANGLE_SOUP\"\r\n" );
+		TextPrintf( f, "\t\t*COMMENT\t\"SURFACETYPE\tMST_TRIANGLE_SOUP\"\r\n" );
 		break;
 	}
 
 	/* export vertex xyz */
-	fprintf( f, "\t\t*MESH_VERTEX_LIST\t{\r\n" );
+	TextPrintf( f, "\t\t*MESH_VERTEX_LIST\t{\r\n" );
 	for ( i = 0; i < ds->numVerts; i++ )
 	{
 		v = i + ds->firstVert;
 		dv = &bspDrawVerts[ v ];
-		fprintf( f, "\t\t\t*MESH_VERTEX\t%d\t%f\t%f\t%f\r\n", i, dv->xyz[ 0 ], dv->xyz[ 1 ], dv->xyz[ 2 ] );
+		TextPrintf( f, "\t\t\t*MESH_VERTEX\t%d\t%f\t%f\t%f\r\n", i, dv->xyz[ 0 ], dv->xyz[ 1 ], dv->xyz[ 2 ] );
 	}
-	fprintf( f, "\t\t}\r\n" );
+	TextPrintf( f, "\t\t}\r\n" );
 
 	/* export vertex normals */
-	fprintf( f, "\t\t*MESH_NORMALS\t{\r\n" );
+	TextPrintf( f, "\t\t*MESH_NORMALS\t{\r\n" );
 	for ( i = 0; i < ds->numIndexes; i += 3 )
 	{
 		face = ( i / 3 );
@@ -109,73 +123,98 @@ static void ConvertSurface( FILE *f, bspModel_t *model, int modelNum, bspDrawSur
 		VectorAdd( normal, bspDrawVerts[ b ].normal, normal );
 		VectorAdd( normal, bspDrawVerts[ c ].normal, normal );
 		if ( VectorNormalize( normal, normal ) ) {
-			fprintf( f, "\t\t\t*MESH_FACENORMAL\t%d\t%f\t%f\t%f\r\n", face, normal[ 0 ], normal[ 1 ], normal[ 2 ] );
+			TextPrintf( f, "\t\t\t*MESH_FACENORMAL\t%d\t%f\t%f\t%f\r\n", face, normal[ 0 ], normal[ 1 ], normal[ 2 ] );
 		}
 	}
 	for ( i = 0; i < ds->numVerts; i++ )
 	{
 		v = i + ds->firstVert;
 		dv = &bspDrawVerts[ v ];
-		fprintf( f, "\t\t\t*MESH_VERTEXNORMAL\t%d\t%f\t%f\t%f\r\n", i, dv->normal[ 0 ], dv->normal[ 1 ], dv->normal[ 2 ] );
+		TextPrintf( f, "\t\t\t*MESH_VERTEXNORMAL\t%d\t%f\t%f\t%f\r\n", i, dv->normal[ 0 ], dv->normal[ 1 ], dv->normal[ 2 ] );
 	}
-	fprintf( f, "\t\t}\r\n" );
+	TextPrintf( f, "\t\t}\r\n" );
 
 	/* export faces */
-	fprintf( f, "\t\t*MESH_FACE_LIST\t{\r\n" );
+	TextPrintf( f, "\t\t*MESH_FACE_LIST\t{\r\n" );
 	for ( i = 0; i < ds->numIndexes; i += 3 )
 	{
 		face = ( i / 3 );
 		a = bspDrawIndexes[ i + ds->firstIndex ];
 		c = bspDrawIndexes[ i + ds->firstIndex + 1 ];
 		b = bspDrawIndexes[ i + ds->firstIndex + 2 ];
-		fprintf( f, "\t\t\t*MESH_FACE\t%d\tA:\t%d\tB:\t%d\tC:\t%d\tAB:\t1\tBC:\t1\tCA:\t1\t*MESH_SMOOTHING\t0\t*MESH_MTLID\t0\r\n",
+		TextPrintf( f, "\t\t\t*MESH_FACE\t%d\tA:\t%d\tB:\t%d\tC:\t%d\tAB:\t1\tBC:\t1\tCA:\t1\t*MESH_SMOOTHING\t0\t*MESH_MTLID\t0\r\n",
 				 face, a, b, c );
 	}
-	fprintf( f, "\t\t}\r\n" );
+	TextPrintf( f, "\t\t}\r\n" );
 
 	/* export vertex st */
-	fprintf( f, "\t\t*MESH_NUMTVERTEX\t%d\r\n", ds->numVerts );
-	fprintf( f, "\t\t*MESH_TVERTLIST\t{\r\n" );
+	TextPrintf( f, "\t\t*MESH_NUMTVERTEX\t%d\r\n", ds->numVerts );
+	TextPrintf( f, "\t\t*MESH_TVERTLIST\t{\r\n" );
 	for ( i = 0; i < ds->numVerts; i++ )
 	{
 		v = i + ds->firstVert;
 		dv = &bspDrawVerts[ v ];
-		fprintf( f, "\t\t\t*MESH_TVERT\t%d\t%f\t%f\t%f\r\n", i, dv->st[ 0 ], ( 1.0 - dv->st[ 1 ] ), 1.0f );
+		TextPrintf( f, "\t\t\t*MESH_TVERT\t%d\t%f\t%f\t%f\r\n", i, dv->st[ 0 ], ( 1.0 - dv->st[ 1 ] ), 1.0f );
 	}
-	fprintf( f, "\t\t}\r\n" );
+	TextPrintf( f, "\t\t}\r\n" );
 
 	/* export texture faces */
-	fprintf( f, "\t\t*MESH_NUMTVFACES\t%d\r\n", ds->numIndexes / 3 );
-	fprintf( f, "\t\t*MESH_TFACELIST\t{\r\n" );
+	TextPrintf( f, "\t\t*MESH_NUMTVFACES\t%d\r\n", ds->numIndexes / 3 );
+	TextPrintf( f, "\t\t*MESH_TFACELIST\t{\r\n" );
 	for ( i = 0; i < ds->numIndexes; i += 3 )
 	{
 		face = ( i / 3 );
 		a = bspDrawIndexes[ i + ds->firstIndex ];
 		c = bspDrawIndexes[ i + ds->firstIndex + 1 ];
 		b = bspDrawIndexes[ i + ds->firstIndex + 2 ];
-		fprintf( f, "\t\t\t*MESH_TFACE\t%d\t%d\t%d\t%d\r\n", face, a, b, c );
+		TextPrintf( f, "\t\t\t*MESH_TFACE\t%d\t%d\t%d\t%d\r\n", face, a, b, c );
 	}
-	fprintf( f, "\t\t}\r\n" );
+	TextPrintf( f, "\t\t}\r\n" );
 
 	/* print mesh footer */
-	fprintf( f, "\t}\r\n" );
+	TextPrintf( f, "\t}\r\n" );
 
 	/* print object footer */
-	fprintf( f, "\t*PROP_MOTIONBLUR\t0\r\n" );
-	fprintf( f, "\t*PROP_CASTSHADOW\t1\r\n" );
-	fprintf( f, "\t*PROP_RECVSHADOW\t1\r\n" );
+	TextPrintf( f, "\t*PROP_MOTIONBLUR\t0\r\n" );
+	TextPrintf( f, "\t*PROP_CASTSHADOW\t1\r\n" );
+	TextPrintf( f, "\t*PROP_RECVSHADOW\t1\r\n" );
 	if ( lightmapsAsTexcoord ) {
 		if ( ds->lightmapNum[0] >= 0 && ds->lightmapNum[0] + (int)deluxemap < numLightmapsASE ) {
-			fprintf( f, "\t*MATERIAL_REF\t%d\r\n", ds->lightmapNum[0] + deluxemap );
-		}
-		else{
-			Sys_FPrintf( SYS_WRN, "WARNING: lightmap %d out of range, not exporting\n", ds->lightmapNum[0] + deluxemap );
+			TextPrintf( f, "\t*MATERIAL_REF\t%d\r\n", ds->lightmapNum[0] + deluxemap );
 		}
 	}
 	else{
-		fprintf( f, "\t*MATERIAL_REF\t%d\r\n", ds->shaderNum );
+		TextPrintf( f, "\t*MATERIAL_REF\t%d\r\n", ds->shaderNum );
 	}
-	fprintf( f, "}\r\n" );
+	TextPrintf( f, "}\r\n" );
+}
+
+
+
+/*
+   AddSurface()
+   queues a bsp drawsurface for export
+ */
+
+static void AddSurface( bspModel_t *model, int modelNum, bspDrawSurface_t *ds, int surfaceNum, vec3_t origin ){
+	aseSurface_t    *as;
+
+
+	/* ignore patches for now */
+	if ( ds->surfaceType != MST_PLANAR && ds->surfaceType != MST_TRIANGLE_SOUP ) {
+		return;
+	}
+
+	/* warn here, the surfaces are printed on all threads */
+	if ( lightmapsAsTexcoord && !( ds->lightmapNum[0] >= 0 && ds->lightmapNum[0] + (int)deluxemap < numLightmapsASE ) ) {
+		Sys_FPrintf( SYS_WRN, "WARNING: lightmap %d out of range, not exporting\n", ds->lightmapNum[0] + deluxemap );
+	}
+
+	AUTOEXPAND_BY_REALLOC( aseSurfaces, numASESurfaces, maxASESurfaces, 1024 );
+	as = &aseSurfaces[ numASESurfaces++ ];
+	as->surfaceNum = surfaceNum;
+	as->modelNum = modelNum;
+	VectorCopy( origin, as->origin );
 }
 
 
@@ -185,7 +224,7 @@ static void ConvertSurface( FILE *f, bspModel_t *model, int modelNum, bspDrawSur
    exports a bsp model to an ase chunk
  */
 
-static void ConvertModel( FILE *f, bspModel_t *model, int modelNum, vec3_t origin ){
+static void ConvertModel( bspModel_t *model, int modelNum, vec3_t origin ){
 	int i, s;
 	bspDrawSurface_t    *ds;
 
@@ -195,7 +234,7 @@ static void ConvertModel( FILE *f, bspModel_t *model, int modelNum, vec3_t origi
 	{
 		s = i + model->firstBSPSurface;
 		ds = &bspDrawSurfaces[ s ];
-		ConvertSurface( f, model, modelNum, ds, s, origin );
+		AddSurface( model, modelNum, ds, s, origin );
 	}
 }
 
@@ -430,9 +469,15 @@ int ConvertBSPToASE( char *bspName ){
 		}
 
 		/* convert model */
-		ConvertModel( f, model, modelNum, origin );
+		ConvertModel( model, modelNum, origin );
 	}
 
+	/* print the surfaces on all threads */
+	WriteTextJobs( f, numASESurfaces, ConvertSurface, qfalse );
+	free( aseSurfaces );
+	aseSurfaces = NULL;
+	numASESurfaces = maxASESurfaces = 0;
+
 	/* close the file and return */
 	fclose( f );
 
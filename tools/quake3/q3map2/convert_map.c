@@ -57,14 +57,274 @@ static vec_t Det3x3( vec_t a00, vec_t a01, vec_t a02,
 		+   a02 * ( a10 * a21 - a11 * a20 );
 }
 
-void GetBestSurfaceTriangleMatchForBrushside( side_t *buildSide, bspDrawVert_t *bestVert[3] ){
+/*
+   surface triangle index
+
+   ConvertBrush() recovers the texture projection of a brush side from the
+   draw surface triangle that covers most of it.  the triangles of planar and
+   triangle soup surfaces are hashed by shader, normal and distance, so a side
+   only tests the ones that can lie on its plane instead of all of them
+ */
+
+typedef struct convertTriangle_s
+{
+	int surfaceNum, firstIndex;
+	unsigned int key;
+	int next;                               /* hash chain */
+}
+convertTriangle_t;
+
+typedef struct convertWork_s
+{
+	brush_t             *buildBrush;
+	int                 *triangles;
+	int allocatedTriangles;
+}
+convertWork_t;
+
+#define MAX_CONVERT_SIDES       512
+
+static int                  *shaderGroups;      /* per bsp shader, the first bsp shader with its name */
+static int                  *sideGroups;        /* per bsp shader, the group its sides match or -1 */
+static shaderInfo_t         **shaderInfos;      /* per bsp shader */
+static convertTriangle_t    *triangles;
+static int numTriangles;
+static int                  *triangleHash, triangleHashSize;
+static double normalCell, distCell;
+
+static convertWork_t convertWork[ MAX_THREADS ];
+static bspModel_t           *convertModel;
+static vec3_t convertOrigin;
+static qboolean convertBrushPrimitives;
+
+
+
+/*
+   TriangleKey()
+   hash key of a shader group and a normal and distance cell
+ */
+
+static unsigned int TriangleKey( int group, int nx, int ny, int nz, int d ){
+	unsigned int key;
+
+	key = (unsigned int) group;
+	key = key * 0x9E3779B1u + (unsigned int) nx;
+	key = key * 0x9E3779B1u + (unsigned int) ny;
+	key = key * 0x9E3779B1u + (unsigned int) nz;
+	key = key * 0x9E3779B1u + (unsigned int) d;
+	return key ^ ( key >> 15 );
+}
+
+
+
+/*
+   TriangleNormal()
+   the normal GetBestSurfaceTriangleMatchForBrushside() tests a triangle with
+ */
+
+static void TriangleNormal( bspDrawSurface_t *s, bspDrawVert_t *vert[3], vec3_t norm ){
+	vec3_t v1v0, v2v0;
+
+	if ( s->surfaceType == MST_PLANAR && VectorCompare( vert[0]->normal, vert[1]->normal ) && VectorCompare( vert[1]->normal, vert[2]->normal ) ) {
+		VectorCopy( vert[0]->normal, norm );
+	}
+	else
+	{
+		VectorSubtract( vert[1]->xyz, vert[0]->xyz, v1v0 );
+		VectorSubtract( vert[2]->xyz, vert[0]->xyz, v2v0 );
+		CrossProduct( v2v0, v1v0, norm );
+		VectorNormalize( norm, norm );
+	}
+}
+
+
+
+/*
+   SetupTriangleIndex()
+   hashes the triangles of the bsp draw surfaces
+ */
+
+static void SetupTriangleIndex( void ){
+	int i, j, t;
+	bspDrawSurface_t    *s;
+	bspDrawVert_t       *vert[3];
+	convertTriangle_t   *tri;
+	vec3_t norm;
+	vec_t length, maxLength;
+
+
+	/* sides match surfaces by shader name, which needn't be unique in the bsp */
+	shaderGroups = safe_malloc( numBSPShaders * sizeof( *shaderGroups ) );
+	sideGroups = safe_malloc( numBSPShaders * sizeof( *sideGroups ) );
+	shaderInfos = safe_malloc( numBSPShaders * sizeof( *shaderInfos ) );
+	for ( i = 0; i < numBSPShaders; i++ )
+	{
+		for ( j = 0; j < i && strcmp( bspShaders[ i ].shader, bspShaders[ j ].shader ); j++ ) ;
+		shaderGroups[ i ] = j;
+
+		/* the side's shader info may be named differently */
+		shaderInfos[ i ] = ShaderInfoForShader( bspShaders[ i ].shader );
+		for ( j = 0; j < numBSPShaders && strcmp( shaderInfos[ i ]->shader, bspShaders[ j ].shader ); j++ ) ;
+		sideGroups[ i ] = j < numBSPShaders ? j : -1;
+	}
+
+	/* collect the triangles in surface order */
+	numTriangles = 0;
+	for ( s = bspDrawSurfaces; s != bspDrawSurfaces + numBSPDrawSurfaces; ++s )
+	{
+		if ( ( s->surfaceType == MST_PLANAR || s->surfaceType == MST_TRIANGLE_SOUP ) && s->shaderNum >= 0 && s->shaderNum < numBSPShaders ) {
+			numTriangles += s->numIndexes / 3;
+		}
+	}
+	triangles = safe_malloc( ( numTriangles > 0 ? numTriangles : 1 ) * sizeof( *triangles ) );
+	numTriangles = 0;
+	maxLength = 0;
+	for ( s = bspDrawSurfaces; s != bspDrawSurfaces + numBSPDrawSurfaces; ++s )
+	{
+		if ( ( s->surfaceType != MST_PLANAR && s->surfaceType != MST_TRIANGLE_SOUP ) || s->shaderNum < 0 || s->shaderNum >= numBSPShaders ) {
+			continue;
+		}
+		for ( t = 0; t + 3 <= s->numIndexes; t += 3 )
+		{
+			tri = &triangles[ numTriangles++ ];
+			tri->surfaceNum = s - bspDrawSurfaces;
+			tri->firstIndex = s->firstIndex + t;
+			for ( j = 0; j < 3; j++ )
+			{
+				length = VectorLength( bspDrawVerts[ s->firstVert + bspDrawIndexes[ tri->firstIndex + j ] ].xyz );
+				if ( length > maxLength ) {
+					maxLength = length;
+				}
+			}
+		}
+	}
+
+	/* a triangle matches a plane if its normal is within normalEpsilon and its
+	   points are closer than distanceEpsilon, truncated to whole units.  cells
+	   are at least that big, so a side only has to look at the neighbours of
+	   its own cell */
+	normalCell = normalEpsilon > 1.0 / 64.0 ? normalEpsilon : 1.0 / 64.0;
+	distCell = 2.0 * ( distanceEpsilon + 1.0 + maxLength * normalEpsilon );
+
+	triangleHashSize = 1024;
+	while ( triangleHashSize < numTriangles * 2 )
+		triangleHashSize <<= 1;
+	triangleHash = safe_malloc( triangleHashSize * sizeof( *triangleHash ) );
+	for ( i = 0; i < triangleHashSize; i++ )
+		triangleHash[ i ] = -1;
+
+	/* hash them back to front, so the chains come out in surface order */
+	for ( i = numTriangles - 1; i >= 0; i-- )
+	{
+		tri = &triangles[ i ];
+		s = &bspDrawSurfaces[ tri->surfaceNum ];
+		for ( j = 0; j < 3; j++ )
+			vert[ j ] = &bspDrawVerts[ s->firstVert + bspDrawIndexes[ tri->firstIndex + j ] ];
+		TriangleNormal( s, vert, norm );
+		tri->key = TriangleKey( shaderGroups[ s->shaderNum ],
+								(int) floor( norm[ 0 ] / normalCell ), (int) floor( norm[ 1 ] / normalCell ), (int) floor( norm[ 2 ] / normalCell ),
+								(int) floor( DotProduct( vert[ 0 ]->xyz, norm ) / distCell ) );
+		tri->next = triangleHash[ tri->key & ( triangleHashSize - 1 ) ];
+		triangleHash[ tri->key & ( triangleHashSize - 1 ) ] = i;
+	}
+
+	Sys_FPrintf( SYS_VRB, "%9d surface triangles\n", numTriangles );
+}
+
+
+
+/*
+   FreeTriangleIndex()
+   frees the surface triangle index
+ */
+
+static void FreeTriangleIndex( void ){
+	free( shaderGroups );
+	free( sideGroups );
+	free( shaderInfos );
+	free( triangles );
+	free( triangleHash );
+	shaderGroups = NULL;
+	sideGroups = NULL;
+	shaderInfos = NULL;
+	triangles = NULL;
+	triangleHash = NULL;
+	numTriangles = 0;
+}
+
+
+
+/*
+   CompareInts()
+   qsort callback
+ */
+
+static int CompareInts( const void *a, const void *b ){
+	return *(const int*) a - *(const int*) b;
+}
+
+
+
+/*
+   TrianglesForPlane()
+   lists the triangles of a shader group that may lie on a plane, in
+   surface order
+ */
+
+static int TrianglesForPlane( int group, plane_t *plane, convertWork_t *work ){
+	int x, y, z, d, i, num, numUnique, cell[ 4 ];
+	unsigned int key;
+
+
+	for ( i = 0; i < 3; i++ )
+		cell[ i ] = (int) floor( plane->normal[ i ] / normalCell );
+	cell[ 3 ] = (int) floor( plane->dist / distCell );
+
+	num = 0;
+	for ( x = -1; x <= 1; x++ )
+		for ( y = -1; y <= 1; y++ )
+			for ( z = -1; z <= 1; z++ )
+				for ( d = -1; d <= 1; d++ )
+				{
+					key = TriangleKey( group, cell[ 0 ] + x, cell[ 1 ] + y, cell[ 2 ] + z, cell[ 3 ] + d );
+					for ( i = triangleHash[ key & ( triangleHashSize - 1 ) ]; i >= 0; i = triangles[ i ].next )
+					{
+						/* the key mixes the group with the cells, so groups can collide */
+						if ( triangles[ i ].key != key || shaderGroups[ bspDrawSurfaces[ triangles[ i ].surfaceNum ].shaderNum ] != group ) {
+							continue;
+						}
+						AUTOEXPAND_BY_REALLOC( work->triangles, num, work->allocatedTriangles, 256 );
+						work->triangles[ num++ ] = i;
+					}
+				}
+
+	/* different cells can share a key */
+	qsort( work->triangles, num, sizeof( *work->triangles ), CompareInts );
+	numUnique = 0;
+	for ( i = 0; i < num; i++ )
+	{
+		if ( numUnique == 0 || work->triangles[ i ] != work->triangles[ numUnique - 1 ] ) {
+			work->triangles[ numUnique++ ] = work->triangles[ i ];
+		}
+	}
+	return numUnique;
+}
+
+
+
+/*
+   GetBestSurfaceTriangleMatchForBrushside()
+   finds the triangle that covers most of a brush side
+ */
+
+static void GetBestSurfaceTriangleMatchForBrushside( side_t *buildSide, int group, bspDrawVert_t *bestVert[3], convertWork_t *work ){
 	bspDrawSurface_t *s;
 	int i;
-	int t;
+	int t, numCandidates;
 	vec_t best = 0;
 	vec_t thisarea;
 	vec3_t normdiff;
-	vec3_t v1v0, v2v0, norm;
+	vec3_t norm;
 	bspDrawVert_t *vert[3];
 	winding_t *polygon;
 	plane_t *buildPlane = &mapplanes[buildSide->planenum];
@@ -73,92 +333,88 @@ void GetBestSurfaceTriangleMatchForBrushside( side_t *buildSide, bspDrawVert_t *
 	// first, start out with NULLs
 	bestVert[0] = bestVert[1] = bestVert[2] = NULL;
 
-	// brute force through all surfaces
-	for ( s = bspDrawSurfaces; s != bspDrawSurfaces + numBSPDrawSurfaces; ++s )
+	// no surface uses the shader
+	if ( group < 0 ) {
+		return;
+	}
+
+	// look at the triangles of the shader near the plane, in surface order
+	numCandidates = TrianglesForPlane( group, buildPlane, work );
+	for ( t = 0; t < numCandidates; t++ )
 	{
-		if ( s->surfaceType != MST_PLANAR && s->surfaceType != MST_TRIANGLE_SOUP ) {
-			continue;
-		}
-		if ( strcmp( buildSide->shaderInfo->shader, bspShaders[s->shaderNum].shader ) ) {
-			continue;
-		}
-		for ( t = 0; t + 3 <= s->numIndexes; t += 3 )
-		{
-			vert[0] = &bspDrawVerts[s->firstVert + bspDrawIndexes[s->firstIndex + t + 0]];
-			vert[1] = &bspDrawVerts[s->firstVert + bspDrawIndexes[s->firstIndex + t + 1]];
-			vert[2] = &bspDrawVerts[s->firstVert + bspDrawIndexes[s->firstIndex + t + 2]];
-			if ( s->surfaceType == MST_PLANAR && VectorCompare( vert[0]->normal, vert[1]->normal ) && VectorCompare( vert[1]->normal, vert[2]->normal ) ) {
-				VectorSubtract( vert[0]->normal, buildPlane->normal, normdiff ); if ( VectorLength( normdiff ) >= normalEpsilon ) {
-					continue;
-				}
-				VectorSubtract( vert[1]->normal, buildPlane->normal, normdiff ); if ( VectorLength( normdiff ) >= normalEpsilon ) {
-					continue;
-				}
-				VectorSubtract( vert[2]->normal, buildPlane->normal, normdiff ); if ( VectorLength( normdiff ) >= normalEpsilon ) {
-					continue;
-				}
-			}
-			else
-			{
-				// this is more prone to roundoff errors, but with embedded
-				// models, there is no better way
-				VectorSubtract( vert[1]->xyz, vert[0]->xyz, v1v0 );
-				VectorSubtract( vert[2]->xyz, vert[0]->xyz, v2v0 );
-				CrossProduct( v2v0, v1v0, norm );
-				VectorNormalize( norm, norm );
-				VectorSubtract( norm, buildPlane->normal, normdiff ); if ( VectorLength( normdiff ) >= normalEpsilon ) {
-					continue;
-				}
-			}
-			if ( abs( DotProduct( vert[0]->xyz, buildPlane->normal ) - buildPlane->dist ) >= distanceEpsilon ) {
+		s = &bspDrawSurfaces[ triangles[ work->triangles[ t ] ].surfaceNum ];
+		for ( i = 0; i < 3; i++ )
+			vert[i] = &bspDrawVerts[s->firstVert + bspDrawIndexes[triangles[ work->triangles[ t ] ].firstIndex + i]];
+		if ( s->surfaceType == MST_PLANAR && VectorCompare( vert[0]->normal, vert[1]->normal ) && VectorCompare( vert[1]->normal, vert[2]->normal ) ) {
+			VectorSubtract( vert[0]->normal, buildPlane->normal, normdiff ); if ( VectorLength( normdiff ) >= normalEpsilon ) {
 				continue;
 			}
-			if ( abs( DotProduct( vert[1]->xyz, buildPlane->normal ) - buildPlane->dist ) >= distanceEpsilon ) {
+			VectorSubtract( vert[1]->normal, buildPlane->normal, normdiff ); if ( VectorLength( normdiff ) >= normalEpsilon ) {
 				continue;
 			}
-			if ( abs( DotProduct( vert[2]->xyz, buildPlane->normal ) - buildPlane->dist ) >= distanceEpsilon ) {
+			VectorSubtract( vert[2]->normal, buildPlane->normal, normdiff ); if ( VectorLength( normdiff ) >= normalEpsilon ) {
 				continue;
 			}
-			// Okay. Correct surface type, correct shader, correct plane. Let's start with the business...
-			polygon = CopyWinding( buildSide->winding );
-			for ( i = 0; i < 3; ++i )
-			{
-				// 0: 1, 2
-				// 1: 2, 0
-				// 2; 0, 1
-				vec3_t *v1 = &vert[( i + 1 ) % 3]->xyz;
-				vec3_t *v2 = &vert[( i + 2 ) % 3]->xyz;
-				vec3_t triNormal;
-				vec_t triDist;
-				vec3_t sideDirection;
-				// we now need to generate triNormal and triDist so that they represent the plane spanned by normal and (v2 - v1).
-				VectorSubtract( *v2, *v1, sideDirection );
-				CrossProduct( sideDirection, buildPlane->normal, triNormal );
-				triDist = DotProduct( *v1, triNormal );
-				ChopWindingInPlace( &polygon, triNormal, triDist, distanceEpsilon );
-				if ( !polygon ) {
-					goto exwinding;
-				}
-			}
-			thisarea = WindingArea( polygon );
-			if ( thisarea > 0 ) {
-				++matches;
+		}
+		else
+		{
+			// this is more prone to roundoff errors, but with embedded
+			// models, there is no better way
+			TriangleNormal( s, vert, norm );
+			VectorSubtract( norm, buildPlane->normal, normdiff ); if ( VectorLength( normdiff ) >= normalEpsilon ) {
+				continue;
 			}
-			if ( thisarea > best ) {
-				best = thisarea;
-				bestVert[0] = vert[0];
-				bestVert[1] = vert[1];
-				bestVert[2] = vert[2];
+		}
+		if ( abs( DotProduct( vert[0]->xyz, buildPlane->normal ) - buildPlane->dist ) >= distanceEpsilon ) {
+			continue;
+		}
+		if ( abs( DotProduct( vert[1]->xyz, buildPlane->normal ) - buildPlane->dist ) >= distanceEpsilon ) {
+			continue;
+		}
+		if ( abs( DotProduct( vert[2]->xyz, buildPlane->normal ) - buildPlane->dist ) >= distanceEpsilon ) {
+			continue;
+		}
+		// Okay. Correct surface type, correct shader, correct plane. Let's start with the business...
+		polygon = CopyWinding( buildSide->winding );
+		for ( i = 0; i < 3; ++i )
+		{
+			// 0: 1, 2
+			// 1: 2, 0
+			// 2; 0, 1
+			vec3_t *v1 = &vert[( i + 1 ) % 3]->xyz;
+			vec3_t *v2 = &vert[( i + 2 ) % 3]->xyz;
+			vec3_t triNormal;
+			vec_t triDist;
+			vec3_t sideDirection;
+			// we now need to generate triNormal and triDist so that they represent the plane spanned by normal and (v2 - v1).
+			VectorSubtract( *v2, *v1, sideDirection );
+			CrossProduct( sideDirection, buildPlane->normal, triNormal );
+			triDist = DotProduct( *v1, triNormal );
+			ChopWindingInPlace( &polygon, triNormal, triDist, distanceEpsilon );
+			if ( !polygon ) {
+				goto exwinding;
 			}
-			FreeWinding( polygon );
-exwinding:
-			;
 		}
+		thisarea = WindingArea( polygon );
+		if ( thisarea > 0 ) {
+			++matches;
+		}
+		if ( thisarea > best ) {
+			best = thisarea;
+			bestVert[0] = vert[0];
+			bestVert[1] = vert[1];
+			bestVert[2] = vert[2];
+		}
+		FreeWinding( polygon );
+exwinding:
+		;
 	}
 	//if(strncmp(buildSide->shaderInfo->shader, "textures/common/", 16))
 	//	fprintf(stderr, "brushside with %s: %d matches (%f area)\n", buildSide->shaderInfo->shader, matches, best);
 }
 
+
+
 #define FRAC( x ) ( ( x ) - floor( x ) )
 static void ConvertOriginBrush( FILE *f, int num, vec3_t origin, qboolean brushPrimitives ){
 	int originSize = 256;
@@ -220,35 +476,35 @@ static void ConvertOriginBrush( FILE *f, int num, vec3_t origin, qboolean brushP
 	fprintf( f, "\t}\n\n" );
 }
 
-static void ConvertBrush( FILE *f, int num, bspBrush_t *brush, vec3_t origin, qboolean brushPrimitives ){
+static void ConvertBrush( textBuffer_t *f, int num, bspBrush_t *brush, vec3_t origin, qboolean brushPrimitives, convertWork_t *work ){
 	int i, j;
 	bspBrushSide_t  *side;
 	side_t          *buildSide;
-	bspShader_t     *shader;
 	char            *texture;
 	plane_t         *buildPlane;
 	vec3_t pts[ 3 ];
 	bspDrawVert_t   *vert[3];
+	int groups[ MAX_CONVERT_SIDES ];
 
 
 	/* start brush */
-	fprintf( f, "\t// brush %d\n", num );
-	fprintf( f, "\t{\n" );
+	TextPrintf( f, "\t// brush %d\n", num );
+	TextPrintf( f, "\t{\n" );
 	if ( brushPrimitives ) {
-		fprintf( f, "\tbrushDef\n" );
-		fprintf( f, "\t{\n" );
+		TextPrintf( f, "\tbrushDef\n" );
+		TextPrintf( f, "\t{\n" );
 	}
 
 	/* clear out build brush */
-	for ( i = 0; i < buildBrush->numsides; i++ )
+	for ( i = 0; i < work->buildBrush->numsides; i++ )
 	{
-		buildSide = &buildBrush->sides[ i ];
+		buildSide = &work->buildBrush->sides[ i ];
 		if ( buildSide->winding != NULL ) {
 			FreeWinding( buildSide->winding );
 			buildSide->winding = NULL;
 		}
 	}
-	buildBrush->numsides = 0;
+	work->buildBrush->numsides = 0;
 
 	/* iterate through bsp brush sides */
 	for ( i = 0; i < brush->numSides; i++ )
@@ -260,31 +516,34 @@ static void ConvertBrush( FILE *f, int num, bspBrush_t *brush, vec3_t origin, qb
 		if ( side->shaderNum < 0 || side->shaderNum >= numBSPShaders ) {
 			continue;
 		}
-		shader = &bspShaders[ side->shaderNum ];
-		//if( !Q_stricmp( shader->shader, "default" ) || !Q_stricmp( shader->shader, "noshader" ) )
+		//if( !Q_stricmp( bspShaders[ side->shaderNum ].shader, "default" ) || !Q_stricmp( bspShaders[ side->shaderNum ].shader, "noshader" ) )
 		//	continue;
 
 		/* add build side */
-		buildSide = &buildBrush->sides[ buildBrush->numsides ];
-		buildBrush->numsides++;
+		if ( work->buildBrush->numsides >= MAX_CONVERT_SIDES ) {
+			break;
+		}
+		groups[ work->buildBrush->numsides ] = sideGroups[ side->shaderNum ];
+		buildSide = &work->buildBrush->sides[ work->buildBrush->numsides ];
+		work->buildBrush->numsides++;
 
 		/* tag it */
-		buildSide->shaderInfo = ShaderInfoForShader( shader->shader );
+		buildSide->shaderInfo = shaderInfos[ side->shaderNum ];
 		buildSide->planenum = side->planeNum;
 		buildSide->winding = NULL;
 	}
 
 	/* make brush windings */
-	if ( !CreateBrushWindings( buildBrush ) ) {
+	if ( !CreateBrushWindings( work->buildBrush ) ) {
 		Sys_Printf( "CreateBrushWindings failed\n" );
 		return;
 	}
 
 	/* iterate through build brush sides */
-	for ( i = 0; i < buildBrush->numsides; i++ )
+	for ( i = 0; i < work->buildBrush->numsides; i++ )
 	{
 		/* get build side */
-		buildSide = &buildBrush->sides[ i ];
+		buildSide = &work->buildBrush->sides[ i ];
 
 		/* get plane */
 		buildPlane = &mapplanes[ buildSide->planenum ];
@@ -304,7 +563,7 @@ static void ConvertBrush( FILE *f, int num, bspBrush_t *brush, vec3_t origin, qb
 		//   - meshverts point in pairs of three into verts
 		//   - (triangles)
 		//   - find the triangle that has most in common with our side
-		GetBestSurfaceTriangleMatchForBrushside( buildSide, vert );
+		GetBestSurfaceTriangleMatchForBrushside( buildSide, groups[ i ], vert, work );
 
 		/* get texture name */
 		if ( !Q_strncasecmp( buildSide->shaderInfo->shader, "textures/", 9 ) ) {
@@ -386,7 +645,7 @@ static void ConvertBrush( FILE *f, int num, bspBrush_t *brush, vec3_t origin, qb
 
 				/* print brush side */
 				/* ( 640 24 -224 ) ( 448 24 -224 ) ( 448 -232 -224 ) common/caulk 0 48 0 0.500000 0.500000 0 0 0 */
-				fprintf( f, "\t\t( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( ( %.8f %.8f %.8f ) ( %.8f %.8f %.8f ) ) %s %d 0 0\n",
+				TextPrintf( f, "\t\t( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( ( %.8f %.8f %.8f ) ( %.8f %.8f %.8f ) ) %s %d 0 0\n",
 						 pts[ 0 ][ 0 ], pts[ 0 ][ 1 ], pts[ 0 ][ 2 ],
 						 pts[ 1 ][ 0 ], pts[ 1 ][ 1 ], pts[ 1 ][ 2 ],
 						 pts[ 2 ][ 0 ], pts[ 2 ][ 1 ], pts[ 2 ][ 2 ],
@@ -483,7 +742,7 @@ static void ConvertBrush( FILE *f, int num, bspBrush_t *brush, vec3_t origin, qb
 
 				/* print brush side */
 				/* ( 640 24 -224 ) ( 448 24 -224 ) ( 448 -232 -224 ) common/caulk 0 48 0 0.500000 0.500000 0 0 0 */
-				fprintf( f, "\t\t( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) %s %.8f %.8f %.8f %.8f %.8f %d 0 0\n",
+				TextPrintf( f, "\t\t( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) %s %.8f %.8f %.8f %.8f %.8f %d 0 0\n",
 						 pts[ 0 ][ 0 ], pts[ 0 ][ 1 ], pts[ 0 ][ 2 ],
 						 pts[ 1 ][ 0 ], pts[ 1 ][ 1 ], pts[ 1 ][ 2 ],
 						 pts[ 2 ][ 0 ], pts[ 2 ][ 1 ], pts[ 2 ][ 2 ],
@@ -510,7 +769,7 @@ static void ConvertBrush( FILE *f, int num, bspBrush_t *brush, vec3_t origin, qb
 			VectorMA( pts[ 0 ], 256.0f, vecs[ 0 ], pts[ 1 ] );
 			VectorMA( pts[ 0 ], 256.0f, vecs[ 1 ], pts[ 2 ] );
 			if ( brushPrimitives ) {
-				fprintf( f, "\t\t( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( ( %.8f %.8f %.8f ) ( %.8f %.8f %.8f ) ) %s %d 0 0\n",
+				TextPrintf( f, "\t\t( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( ( %.8f %.8f %.8f ) ( %.8f %.8f %.8f ) ) %s %d 0 0\n",
 						 pts[ 0 ][ 0 ], pts[ 0 ][ 1 ], pts[ 0 ][ 2 ],
 						 pts[ 1 ][ 0 ], pts[ 1 ][ 1 ], pts[ 1 ][ 2 ],
 						 pts[ 2 ][ 0 ], pts[ 2 ][ 1 ], pts[ 2 ][ 2 ],
@@ -522,7 +781,7 @@ static void ConvertBrush( FILE *f, int num, bspBrush_t *brush, vec3_t origin, qb
 			}
 			else
 			{
-				fprintf( f, "\t\t( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) %s %.8f %.8f %.8f %.8f %.8f %d 0 0\n",
+				TextPrintf( f, "\t\t( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) ( %.3f %.3f %.3f ) %s %.8f %.8f %.8f %.8f %.8f %d 0 0\n",
 						 pts[ 0 ][ 0 ], pts[ 0 ][ 1 ], pts[ 0 ][ 2 ],
 						 pts[ 1 ][ 0 ], pts[ 1 ][ 1 ], pts[ 1 ][ 2 ],
 						 pts[ 2 ][ 0 ], pts[ 2 ][ 1 ], pts[ 2 ][ 2 ],
@@ -536,9 +795,9 @@ static void ConvertBrush( FILE *f, int num, bspBrush_t *brush, vec3_t origin, qb
 
 	/* end brush */
 	if ( brushPrimitives ) {
-		fprintf( f, "\t}\n" );
+		TextPrintf( f, "\t}\n" );
 	}
-	fprintf( f, "\t}\n\n" );
+	TextPrintf( f, "\t}\n\n" );
 }
 #undef FRAC
 
@@ -681,6 +940,20 @@ static void ConvertPatch( FILE *f, int num, bspDrawSurface_t *ds, vec3_t origin
 
 
 
+/*
+   ConvertBrushThread()
+   converts a brush of the current model into its text buffer
+ */
+
+static void ConvertBrushThread( textBuffer_t *buffer, int i ){
+	int num;
+
+	num = convertModel->firstBSPBrush + i;
+	ConvertBrush( buffer, num, &bspBrushes[ num ], convertOrigin, convertBrushPrimitives, &convertWork[ ThreadNumber() ] );
+}
+
+
+
 /*
    ConvertModel()
    exports a bsp model to a map file
@@ -688,7 +961,6 @@ static void ConvertPatch( FILE *f, int num, bspDrawSurface_t *ds, vec3_t origin
 
 static void ConvertModel( FILE *f, bspModel_t *model, int modelNum, vec3_t origin, qboolean brushPrimitives ){
 	int i, num;
-	bspBrush_t          *brush;
 	bspDrawSurface_t    *ds;
 
 
@@ -703,26 +975,34 @@ static void ConvertModel( FILE *f, bspModel_t *model, int modelNum, vec3_t origi
 		mapplanes[ i ].hash_chain = 0;
 	}
 
-	/* allocate a build brush */
-	buildBrush = AllocBrush( 512 );
-	buildBrush->entityNum = 0;
-	buildBrush->original = buildBrush;
+	/* allocate a build brush per thread */
+	for ( i = 0; i < numthreads; i++ )
+	{
+		convertWork[ i ].buildBrush = AllocBrush( MAX_CONVERT_SIDES );
+		convertWork[ i ].buildBrush->entityNum = 0;
+		convertWork[ i ].buildBrush->original = convertWork[ i ].buildBrush;
+	}
 
 	if ( origin[0] != 0 || origin[1] != 0 || origin[2] != 0 ) {
 		ConvertOriginBrush( f, -1, origin, brushPrimitives );
 	}
 
-	/* go through each brush in the model */
-	for ( i = 0; i < model->numBSPBrushes; i++ )
+	/* convert the brushes on all threads, then write them in order */
+	convertModel = model;
+	VectorCopy( origin, convertOrigin );
+	convertBrushPrimitives = brushPrimitives;
+	WriteTextJobs( f, model->numBSPBrushes, ConvertBrushThread, verbose );
+
+	/* free the build brushes */
+	for ( i = 0; i < numthreads; i++ )
 	{
-		num = i + model->firstBSPBrush;
-		brush = &bspBrushes[ num ];
-		ConvertBrush( f, num, brush, origin, brushPrimitives );
+		FreeBrush( convertWork[ i ].buildBrush );
+		convertWork[ i ].buildBrush = NULL;
+		free( convertWork[ i ].triangles );
+		convertWork[ i ].triangles = NULL;
+		convertWork[ i ].allocatedTriangles = 0;
 	}
 
-	/* free the build brush */
-	free( buildBrush );
-
 	/* go through each drawsurf in the model */
 	for ( i = 0; i < model->numBSPSurfaces; i++ )
 	{
@@ -808,6 +1088,9 @@ int ConvertBSPToMap_Ext( char *bspName, qboolean brushPrimitives ){
 	/* print header */
 	fprintf( f, "// Generated by Q3Map2 (ydnar) -convert -format map\n" );
 
+	/* index the surface triangles the brush sides get their textures from */
+	SetupTriangleIndex();
+
 	/* walk entity list */
 	for ( i = 0; i < numEntities; i++ )
 	{
@@ -861,6 +1144,7 @@ int ConvertBSPToMap_Ext( char *bspName, qboolean brushPrimitives ){
 
 	/* close the file and return */
 	fclose( f );
+	FreeTriangleIndex();
 
 	/* return to sender */
 	return 0;
@@ -45,50 +45,52 @@
 
 int firstLightmap = 0;
 int lastLightmap = -1;
-static void ConvertLightmapToMTL( FILE *f, const char *base, int lightmapNum );
+static void ConvertLightmapToMTL( textBuffer_t *f, const char *base, int lightmapNum );
+
+/* surfaces to export, in file order */
+typedef struct objSurface_s
+{
+	int surfaceNum, modelNum;
+	int firstVertex;                    /* obj numbers vertexes across the whole file */
+	qboolean newMaterial;               /* prints a usemtl line */
+}
+objSurface_t;
+
+static objSurface_t     *objSurfaces;
+static int numObjSurfaces, maxObjSurfaces;
 
 int objVertexCount = 0;
 int objLastShaderNum = -1;
-static void ConvertSurfaceToOBJ( FILE *f, bspModel_t *model, int modelNum, bspDrawSurface_t *ds, int surfaceNum, vec3_t origin ){
-	int i, v, a, b, c;
-	bspDrawVert_t   *dv;
 
-	/* ignore patches for now */
-	if ( ds->surfaceType != MST_PLANAR && ds->surfaceType != MST_TRIANGLE_SOUP ) {
-		return;
-	}
+static void ConvertSurfaceToOBJ( textBuffer_t *f, int num ){
+	int i, v, a, b, c, vertexCount;
+	objSurface_t        *os;
+	bspDrawSurface_t    *ds;
+	bspDrawVert_t       *dv;
+
 
-	fprintf( f, "g mat%dmodel%dsurf%d\r\n", ds->shaderNum, modelNum, surfaceNum );
+	os = &objSurfaces[ num ];
+	ds = &bspDrawSurfaces[ os->surfaceNum ];
+	vertexCount = os->firstVertex;
+
+	TextPrintf( f, "g mat%dmodel%dsurf%d\r\n", ds->shaderNum, os->modelNum, os->surfaceNum );
 	switch ( ds->surfaceType )
 	{
 	case MST_PLANAR:
-		fprintf( f, "# SURFACETYPE MST_PLANAR\r\n" );
+		TextPrintf( f, "# SURFACETYPE MST_PLANAR\r\n" );
 		break;
 	case MST_TRIANGLE_SOUP:
-		fprintf( f, "# SURFACETYPE MST_TRIANGLE_SOUP\r\n" );
+		TextPrintf( f, "# SURFACETYPE MST_TRIANGLE_SOUP\r\n" );
 		break;
 	}
 
 	/* export shader */
-	if ( lightmapsAsTexcoord ) {
-		if ( objLastShaderNum != ds->lightmapNum[0] ) {
-			fprintf( f, "usemtl lm_%04d\r\n", ds->lightmapNum[0] + deluxemap );
-			objLastShaderNum = ds->lightmapNum[0] + deluxemap;
-		}
-		if ( ds->lightmapNum[0] + (int)deluxemap < firstLightmap ) {
-			Sys_FPrintf( SYS_WRN, "WARNING: lightmap %d out of range (exporting anyway)\n", ds->lightmapNum[0] + deluxemap );
-			firstLightmap = ds->lightmapNum[0] + deluxemap;
-		}
-		if ( ds->lightmapNum[0] > lastLightmap ) {
-			Sys_FPrintf( SYS_WRN, "WARNING: lightmap %d out of range (exporting anyway)\n", ds->lightmapNum[0] + deluxemap );
-			lastLightmap = ds->lightmapNum[0] + deluxemap;
+	if ( os->newMaterial ) {
+		if ( lightmapsAsTexcoord ) {
+			TextPrintf( f, "usemtl lm_%04d\r\n", ds->lightmapNum[0] + deluxemap );
 		}
-	}
-	else
-	{
-		if ( objLastShaderNum != ds->shaderNum ) {
-			fprintf( f, "usemtl %s\r\n", bspShaders[ds->shaderNum].shader );
-			objLastShaderNum = ds->shaderNum;
+		else{
+			TextPrintf( f, "usemtl %s\r\n", bspShaders[ds->shaderNum].shader );
 		}
 	}
 
@@ -97,14 +99,14 @@ static void ConvertSurfaceToOBJ( FILE *f, bspModel_t *model, int modelNum, bspDr
 	{
 		v = i + ds->firstVert;
 		dv = &bspDrawVerts[ v ];
-		fprintf( f, "# vertex %d\r\n", i + objVertexCount + 1 );
-		fprintf( f, "v %f %f %f\r\n", dv->xyz[ 0 ], dv->xyz[ 1 ], dv->xyz[ 2 ] );
-		fprintf( f, "vn %f %f %f\r\n", dv->normal[ 0 ], dv->normal[ 1 ], dv->normal[ 2 ] );
+		TextPrintf( f, "# vertex %d\r\n", i + vertexCount + 1 );
+		TextPrintf( f, "v %f %f %f\r\n", dv->xyz[ 0 ], dv->xyz[ 1 ], dv->xyz[ 2 ] );
+		TextPrintf( f, "vn %f %f %f\r\n", dv->normal[ 0 ], dv->normal[ 1 ], dv->normal[ 2 ] );
 		if ( lightmapsAsTexcoord ) {
-			fprintf( f, "vt %f %f\r\n", dv->lightmap[0][0], 1.0 - dv->lightmap[0][1] );
+			TextPrintf( f, "vt %f %f\r\n", dv->lightmap[0][0], 1.0 - dv->lightmap[0][1] );
 		}
 		else{
-			fprintf( f, "vt %f %f\r\n", dv->st[ 0 ], 1.0 - dv->st[ 1 ] );
+			TextPrintf( f, "vt %f %f\r\n", dv->st[ 0 ], 1.0 - dv->st[ 1 ] );
 		}
 	}
 
@@ -114,11 +116,59 @@ static void ConvertSurfaceToOBJ( FILE *f, bspModel_t *model, int modelNum, bspDr
 		a = bspDrawIndexes[ i + ds->firstIndex ];
 		c = bspDrawIndexes[ i + ds->firstIndex + 1 ];
 		b = bspDrawIndexes[ i + ds->firstIndex + 2 ];
-		fprintf( f, "f %d/%d/%d %d/%d/%d %d/%d/%d\r\n",
-				 a + objVertexCount + 1, a + objVertexCount + 1, a + objVertexCount + 1,
-				 b + objVertexCount + 1, b + objVertexCount + 1, b + objVertexCount + 1,
-				 c + objVertexCount + 1, c + objVertexCount + 1, c + objVertexCount + 1
-				 );
+		TextPrintf( f, "f %d/%d/%d %d/%d/%d %d/%d/%d\r\n",
+					a + vertexCount + 1, a + vertexCount + 1, a + vertexCount + 1,
+					b + vertexCount + 1, b + vertexCount + 1, b + vertexCount + 1,
+					c + vertexCount + 1, c + vertexCount + 1, c + vertexCount + 1
+					);
+	}
+}
+
+
+
+/*
+   AddSurfaceToOBJ()
+   queues a bsp drawsurface for export, numbering its vertexes and
+   picking its material in file order
+ */
+
+static void AddSurfaceToOBJ( bspModel_t *model, int modelNum, bspDrawSurface_t *ds, int surfaceNum, vec3_t origin ){
+	objSurface_t    *os;
+
+
+	/* ignore patches for now */
+	if ( ds->surfaceType != MST_PLANAR && ds->surfaceType != MST_TRIANGLE_SOUP ) {
+		return;
+	}
+
+	AUTOEXPAND_BY_REALLOC( objSurfaces, numObjSurfaces, maxObjSurfaces, 1024 );
+	os = &objSurfaces[ numObjSurfaces++ ];
+	os->surfaceNum = surfaceNum;
+	os->modelNum = modelNum;
+	os->firstVertex = objVertexCount;
+	os->newMaterial = qfalse;
+
+	/* pick shader */
+	if ( lightmapsAsTexcoord ) {
+		if ( objLastShaderNum != ds->lightmapNum[0] ) {
+			os->newMaterial = qtrue;
+			objLastShaderNum = ds->lightmapNum[0] + deluxemap;
+		}
+		if ( ds->lightmapNum[0] + (int)deluxemap < firstLightmap ) {
+			Sys_FPrintf( SYS_WRN, "WARNING: lightmap %d out of range (exporting anyway)\n", ds->lightmapNum[0] + deluxemap );
+			firstLightmap = ds->lightmapNum[0] + deluxemap;
+		}
+		if ( ds->lightmapNum[0] > lastLightmap ) {
+			Sys_FPrintf( SYS_WRN, "WARNING: lightmap %d out of range (exporting anyway)\n", ds->lightmapNum[0] + deluxemap );
+			lastLightmap = ds->lightmapNum[0] + deluxemap;
+		}
+	}
+	else
+	{
+		if ( objLastShaderNum != ds->shaderNum ) {
+			os->newMaterial = qtrue;
+			objLastShaderNum = ds->shaderNum;
+		}
 	}
 
 	objVertexCount += ds->numVerts;
@@ -131,7 +181,7 @@ static void ConvertSurfaceToOBJ( FILE *f, bspModel_t *model, int modelNum, bspDr
    exports a bsp model to an ase chunk
  */
 
-static void ConvertModelToOBJ( FILE *f, bspModel_t *model, int modelNum, vec3_t origin ){
+static void ConvertModelToOBJ( bspModel_t *model, int modelNum, vec3_t origin ){
 	int i, s;
 	bspDrawSurface_t    *ds;
 
@@ -141,7 +191,7 @@ static void ConvertModelToOBJ( FILE *f, bspModel_t *model, int modelNum, vec3_t
 	{
 		s = i + model->firstBSPSurface;
 		ds = &bspDrawSurfaces[ s ];
-		ConvertSurfaceToOBJ( f, model, modelNum, ds, s, origin );
+		AddSurfaceToOBJ( model, modelNum, ds, s, origin );
 	}
 }
 
@@ -152,7 +202,7 @@ static void ConvertModelToOBJ( FILE *f, bspModel_t *model, int modelNum, vec3_t
    exports a bsp shader to an ase chunk
  */
 
-static void ConvertShaderToMTL( FILE *f, bspShader_t *shader, int shaderNum ){
+static void ConvertShaderToMTL( textBuffer_t *f, bspShader_t *shader, int shaderNum ){
 	shaderInfo_t    *si;
 	char filename[ 1024 ];
 
@@ -179,27 +229,27 @@ static void ConvertShaderToMTL( FILE *f, bspShader_t *shader, int shaderNum ){
 	 */
 
 	/* print shader info */
-	fprintf( f, "newmtl %s\r\n", shader->shader );
-	fprintf( f, "Kd %f %f %f\r\n", si->color[ 0 ], si->color[ 1 ], si->color[ 2 ] );
+	TextPrintf( f, "newmtl %s\r\n", shader->shader );
+	TextPrintf( f, "Kd %f %f %f\r\n", si->color[ 0 ], si->color[ 1 ], si->color[ 2 ] );
 	if ( shadersAsBitmap ) {
-		fprintf( f, "map_Kd %s\r\n", shader->shader );
+		TextPrintf( f, "map_Kd %s\r\n", shader->shader );
 	}
 	else{
 		/* blender hates this, so let's not do it
 		    fprintf( f, "map_Kd ..\\%s\r\n", filename );
 		 */
-		fprintf( f, "map_Kd ../%s\r\n", filename );
+		TextPrintf( f, "map_Kd ../%s\r\n", filename );
 	}
 }
 
-static void ConvertLightmapToMTL( FILE *f, const char *base, int lightmapNum ){
+static void ConvertLightmapToMTL( textBuffer_t *f, const char *base, int lightmapNum ){
 	/* print shader info */
-	fprintf( f, "newmtl lm_%04d\r\n", lightmapNum );
+	TextPrintf( f, "newmtl lm_%04d\r\n", lightmapNum );
 	if ( lightmapNum >= 0 ) {
 		/* blender hates this, so let's not do it
 		    fprintf( f, "map_Kd %s\\lm_%04d.tga\r\n", base, lightmapNum );
 		 */
-		fprintf( f, "map_Kd %s/lm_%04d.tga\r\n", base, lightmapNum );
+		TextPrintf( f, "map_Kd %s/lm_%04d.tga\r\n", base, lightmapNum );
 	}
 }
 
@@ -213,6 +263,7 @@ static void ConvertLightmapToMTL( FILE *f, const char *base, int lightmapNum ){
 int ConvertBSPToOBJ( char *bspName ){
 	int i, modelNum;
 	FILE            *f, *fmtl;
+	textBuffer_t mtl;
 	bspShader_t     *shader;
 	bspModel_t      *model;
 	entity_t        *e;
@@ -254,6 +305,7 @@ int ConvertBSPToOBJ( char *bspName ){
 	fprintf( f, "mtllib %s.mtl\r\n", base );
 
 	fprintf( fmtl, "# Generated by Q3Map2 (ydnar) -convert -format obj\r\n" );
+	memset( &mtl, 0, sizeof( mtl ) );
 	if ( lightmapsAsTexcoord ) {
 		int lightmapCount;
 		for ( lightmapCount = 0; lightmapCount < numBSPLightmaps; lightmapCount++ )
@@ -277,7 +329,7 @@ int ConvertBSPToOBJ( char *bspName ){
 		for ( i = 0; i < numBSPShaders; i++ )
 		{
 			shader = &bspShaders[ i ];
-			ConvertShaderToMTL( fmtl, shader, i );
+			ConvertShaderToMTL( &mtl, shader, i );
 		}
 	}
 
@@ -309,13 +361,21 @@ int ConvertBSPToOBJ( char *bspName ){
 		}
 
 		/* convert model */
-		ConvertModelToOBJ( f, model, modelNum, origin );
+		ConvertModelToOBJ( model, modelNum, origin );
 	}
 
+	/* print the surfaces on all threads */
+	WriteTextJobs( f, numObjSurfaces, ConvertSurfaceToOBJ, qfalse );
+	free( objSurfaces );
+	objSurfaces = NULL;
+	numObjSurfaces = maxObjSurfaces = 0;
+
 	if ( lightmapsAsTexcoord ) {
 		for ( i = firstLightmap; i <= lastLightmap; i++ )
-			ConvertLightmapToMTL( fmtl, base, i );
+			ConvertLightmapToMTL( &mtl, base, i );
 	}
+	WriteTextBuffer( &mtl, fmtl );
+	FreeTextBuffer( &mtl );
 
 	/* close the file and return */
 	fclose( f );
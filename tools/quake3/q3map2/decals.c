@@ -59,6 +59,26 @@ static int numDecalSurfaces = 0;
 
 static vec3_t entityOrigin;
 
+/* projection is threaded per projector, the clipped windings are turned into surfaces afterwards in order */
+typedef struct decalFragment_s
+{
+	mapDrawSurface_t        *ds;
+	vec3_t normal;
+	winding_t               *w;
+}
+decalFragment_t;
+
+typedef struct decalWork_s
+{
+	decalProjector_t dp;
+	int numFragments, allocatedFragments;
+	decalFragment_t         *fragments;
+}
+decalWork_t;
+
+static entity_t *decalEntity;
+static decalWork_t *decalWork;
+
 
 
 /*
@@ -411,7 +431,7 @@ void ProcessDecals( void ){
 	vec3_t origin, target, delta;
 	entity_t            *e, *e2;
 	parseMesh_t         *p;
-	mesh_t              *mesh, *subdivided;
+	mesh_t              *mesh;
 	bspDrawVert_t       *dv[ 4 ];
 	const char          *value;
 
@@ -469,12 +489,7 @@ void ProcessDecals( void ){
 			if ( distance > 0.125f ) {
 				/* tesselate the patch */
 				iterations = IterationsForCurve( p->longestCurve, patchSubdivisions );
-				subdivided = SubdivideMesh2( p->mesh, iterations );
-
-				/* fit it to the curve and remove colinear verts on rows/columns */
-				PutMeshOnCurve( *subdivided );
-				mesh = RemoveLinearMeshColumnsRows( subdivided );
-				FreeMesh( subdivided );
+				mesh = TesselateMesh( p->mesh, iterations );
 
 				/* offset by projector origin */
 				for ( j = 0; j < ( mesh->width * mesh->height ); j++ )
@@ -544,15 +559,15 @@ void ProcessDecals( void ){
 
 /*
    ProjectDecalOntoWinding()
-   projects a decal onto a winding
+   clips a winding to a decal projector, what is left is kept for EmitDecalSurface
  */
 
-static void ProjectDecalOntoWinding( decalProjector_t *dp, mapDrawSurface_t *ds, winding_t *w ){
-	int i, j;
-	float d, d2, alpha;
+static void ProjectDecalOntoWinding( decalWork_t *work, mapDrawSurface_t *ds, winding_t *w ){
+	int i;
+	float d;
 	winding_t           *front, *back;
-	mapDrawSurface_t    *ds2;
-	bspDrawVert_t       *dv;
+	decalProjector_t    *dp;
+	decalFragment_t     *fragment;
 	vec4_t plane;
 
 
@@ -573,6 +588,7 @@ static void ProjectDecalOntoWinding( decalProjector_t *dp, mapDrawSurface_t *ds,
 	}
 
 	/* backface check */
+	dp = &work->dp;
 	d = DotProduct( dp->planes[ 0 ], plane );
 	if ( d < -0.0001f ) {
 		FreeWinding( w );
@@ -605,6 +621,32 @@ static void ProjectDecalOntoWinding( decalProjector_t *dp, mapDrawSurface_t *ds,
 		return;
 	}
 
+	/* keep it */
+	AUTOEXPAND_BY_REALLOC( work->fragments, work->numFragments, work->allocatedFragments, 16 );
+	fragment = &work->fragments[ work->numFragments++ ];
+	fragment->ds = ds;
+	VectorCopy( plane, fragment->normal );
+	fragment->w = w;
+}
+
+
+
+/*
+   EmitDecalSurface()
+   makes a decal surface from a clipped winding
+ */
+
+static void EmitDecalSurface( decalProjector_t *dp, decalFragment_t *fragment ){
+	int i, j;
+	float d, d2, alpha;
+	mapDrawSurface_t    *ds, *ds2;
+	bspDrawVert_t       *dv;
+	winding_t           *w;
+
+
+	ds = fragment->ds;
+	w = fragment->w;
+
 	/* add to counts */
 	numDecalSurfaces++;
 
@@ -642,7 +684,7 @@ static void ProjectDecalOntoWinding( decalProjector_t *dp, mapDrawSurface_t *ds,
 
 		/* set misc */
 		VectorSubtract( w->p[ i ], entityOrigin, dv->xyz );
-		VectorCopy( plane, dv->normal );
+		VectorCopy( fragment->normal, dv->normal );
 		dv->st[ 0 ] = DotProduct( dv->xyz, dp->texMat[ 0 ] ) + dp->texMat[ 0 ][ 3 ];
 		dv->st[ 1 ] = DotProduct( dv->xyz, dp->texMat[ 1 ] ) + dp->texMat[ 1 ][ 3 ];
 
@@ -655,6 +697,8 @@ static void ProjectDecalOntoWinding( decalProjector_t *dp, mapDrawSurface_t *ds,
 			dv->color[ j ][ 3 ] = alpha;
 		}
 	}
+
+	FreeWinding( w );
 }
 
 
@@ -664,7 +708,7 @@ static void ProjectDecalOntoWinding( decalProjector_t *dp, mapDrawSurface_t *ds,
    projects a decal onto a brushface surface
  */
 
-static void ProjectDecalOntoFace( decalProjector_t *dp, mapDrawSurface_t *ds ){
+static void ProjectDecalOntoFace( decalWork_t *work, mapDrawSurface_t *ds ){
 	vec4_t plane;
 	float d;
 	winding_t   *w;
@@ -679,7 +723,7 @@ static void ProjectDecalOntoFace( decalProjector_t *dp, mapDrawSurface_t *ds ){
 	if ( ds->planar ) {
 		VectorCopy( mapplanes[ ds->planeNum ].normal, plane );
 		plane[ 3 ] = mapplanes[ ds->planeNum ].dist + DotProduct( plane, entityOrigin );
-		d = DotProduct( dp->planes[ 0 ], plane );
+		d = DotProduct( work->dp.planes[ 0 ], plane );
 		if ( d < -0.0001f ) {
 			return;
 		}
@@ -687,7 +731,7 @@ static void ProjectDecalOntoFace( decalProjector_t *dp, mapDrawSurface_t *ds ){
 
 	/* generate decal */
 	w = WindingFromDrawSurf( ds );
-	ProjectDecalOntoWinding( dp, ds, w );
+	ProjectDecalOntoWinding( work, ds, w );
 }
 
 
@@ -697,11 +741,11 @@ static void ProjectDecalOntoFace( decalProjector_t *dp, mapDrawSurface_t *ds ){
    projects a decal onto a patch surface
  */
 
-static void ProjectDecalOntoPatch( decalProjector_t *dp, mapDrawSurface_t *ds ){
+static void ProjectDecalOntoPatch( decalWork_t *work, mapDrawSurface_t *ds ){
 	int x, y, pw[ 5 ], r, iterations;
 	vec4_t plane;
 	float d;
-	mesh_t src, *mesh, *subdivided;
+	mesh_t src, *mesh;
 	winding_t   *w;
 
 
@@ -709,7 +753,7 @@ static void ProjectDecalOntoPatch( decalProjector_t *dp, mapDrawSurface_t *ds ){
 	if ( ds->planar ) {
 		VectorCopy( mapplanes[ ds->planeNum ].normal, plane );
 		plane[ 3 ] = mapplanes[ ds->planeNum ].dist + DotProduct( plane, entityOrigin );
-		d = DotProduct( dp->planes[ 0 ], plane );
+		d = DotProduct( work->dp.planes[ 0 ], plane );
 		if ( d < -0.0001f ) {
 			return;
 		}
@@ -720,12 +764,7 @@ static void ProjectDecalOntoPatch( decalProjector_t *dp, mapDrawSurface_t *ds ){
 	src.height = ds->patchHeight;
 	src.verts = ds->verts;
 	iterations = IterationsForCurve( ds->longestCurve, patchSubdivisions );
-	subdivided = SubdivideMesh2( src, iterations );
-
-	/* fit it to the curve and remove colinear verts on rows/columns */
-	PutMeshOnCurve( *subdivided );
-	mesh = RemoveLinearMeshColumnsRows( subdivided );
-	FreeMesh( subdivided );
+	mesh = TesselateMesh( src, iterations );
 
 	/* iterate through the mesh quads */
 	for ( y = 0; y < ( mesh->height - 1 ); y++ )
@@ -748,7 +787,7 @@ static void ProjectDecalOntoPatch( decalProjector_t *dp, mapDrawSurface_t *ds ){
 			VectorCopy( mesh->verts[ pw[ r + 0 ] ].xyz, w->p[ 0 ] );
 			VectorCopy( mesh->verts[ pw[ r + 1 ] ].xyz, w->p[ 1 ] );
 			VectorCopy( mesh->verts[ pw[ r + 2 ] ].xyz, w->p[ 2 ] );
-			ProjectDecalOntoWinding( dp, ds, w );
+			ProjectDecalOntoWinding( work, ds, w );
 
 			/* generate decal for second triangle */
 			w = AllocWinding( 3 );
@@ -756,7 +795,7 @@ static void ProjectDecalOntoPatch( decalProjector_t *dp, mapDrawSurface_t *ds ){
 			VectorCopy( mesh->verts[ pw[ r + 0 ] ].xyz, w->p[ 0 ] );
 			VectorCopy( mesh->verts[ pw[ r + 2 ] ].xyz, w->p[ 1 ] );
 			VectorCopy( mesh->verts[ pw[ r + 3 ] ].xyz, w->p[ 2 ] );
-			ProjectDecalOntoWinding( dp, ds, w );
+			ProjectDecalOntoWinding( work, ds, w );
 		}
 	}
 
@@ -771,7 +810,7 @@ static void ProjectDecalOntoPatch( decalProjector_t *dp, mapDrawSurface_t *ds ){
    projects a decal onto a triangle surface
  */
 
-static void ProjectDecalOntoTriangles( decalProjector_t *dp, mapDrawSurface_t *ds ){
+static void ProjectDecalOntoTriangles( decalWork_t *work, mapDrawSurface_t *ds ){
 	int i;
 	vec4_t plane;
 	float d;
@@ -787,7 +826,7 @@ static void ProjectDecalOntoTriangles( decalProjector_t *dp, mapDrawSurface_t *d
 	if ( ds->planar ) {
 		VectorCopy( mapplanes[ ds->planeNum ].normal, plane );
 		plane[ 3 ] = mapplanes[ ds->planeNum ].dist + DotProduct( plane, entityOrigin );
-		d = DotProduct( dp->planes[ 0 ], plane );
+		d = DotProduct( work->dp.planes[ 0 ], plane );
 		if ( d < -0.0001f ) {
 			return;
 		}
@@ -802,100 +841,130 @@ static void ProjectDecalOntoTriangles( decalProjector_t *dp, mapDrawSurface_t *d
 		VectorCopy( ds->verts[ ds->indexes[ i ] ].xyz, w->p[ 0 ] );
 		VectorCopy( ds->verts[ ds->indexes[ i + 1 ] ].xyz, w->p[ 1 ] );
 		VectorCopy( ds->verts[ ds->indexes[ i + 2 ] ].xyz, w->p[ 2 ] );
-		ProjectDecalOntoWinding( dp, ds, w );
+		ProjectDecalOntoWinding( work, ds, w );
 	}
 }
 
 
 
 /*
-   MakeEntityDecals()
-   projects decals onto world surfaces
+   MakeDecalFragments()
+   projects one decal projector onto the surfaces of decalEntity
  */
 
-void MakeEntityDecals( entity_t *e ){
-	int i, j, k, f, fOld, start;
-	decalProjector_t dp;
+static void MakeDecalFragments( int num ){
+	int i, j, k;
+	decalWork_t         *work;
 	mapDrawSurface_t    *ds;
+	vec3_t mins, maxs;
+	int *surfs, numSurfs, allocatedSurfs;
 	vec3_t identityAxis[ 3 ] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
 
 
-	/* note it */
-	Sys_FPrintf( SYS_VRB, "--- MakeEntityDecals ---\n" );
-
-	/* set entity origin */
-	VectorCopy( e->origin, entityOrigin );
-
-	/* transform projector instead of geometry */
-	VectorClear( entityOrigin );
+	/* get projector */
+	work = &decalWork[ num ];
+	TransformDecalProjector( &projectors[ num ], identityAxis, decalEntity->origin, &work->dp );
 
-	/* init pacifier */
-	fOld = -1;
-	start = I_FloatTime();
+	/* find the surfaces in reach */
+	for ( k = 0; k < 3; k++ )
+	{
+		mins[ k ] = work->dp.center[ k ] - work->dp.radius;
+		maxs[ k ] = work->dp.center[ k ] + work->dp.radius;
+	}
+	surfs = NULL;
+	allocatedSurfs = 0;
+	numSurfs = DrawSurfacesInBounds( mins, maxs, decalEntity->firstDrawSurf, numMapDrawSurfs, &surfs, &allocatedSurfs );
 
-	/* walk the list of decal projectors */
-	for ( i = 0; i < numProjectors; i++ )
+	/* walk the list of surfaces in the entity */
+	for ( i = 0; i < numSurfs; i++ )
 	{
-		/* print pacifier */
-		f = 10 * i / numProjectors;
-		if ( f != fOld ) {
-			fOld = f;
-			Sys_FPrintf( SYS_VRB, "%d...", f );
+		/* get surface */
+		j = surfs[ i ];
+		ds = &mapDrawSurfs[ j ];
+		if ( ds->numVerts <= 0 ) {
+			continue;
 		}
 
-		/* get projector */
-		TransformDecalProjector( &projectors[ i ], identityAxis, e->origin, &dp );
+		/* ignore autosprite or nomarks */
+		if ( ds->shaderInfo->autosprite || ( ds->shaderInfo->compileFlags & C_NOMARKS ) ) {
+			continue;
+		}
 
-		/* walk the list of surfaces in the entity */
-		for ( j = e->firstDrawSurf; j < numMapDrawSurfs; j++ )
-		{
-			/* get surface */
-			ds = &mapDrawSurfs[ j ];
-			if ( ds->numVerts <= 0 ) {
-				continue;
+		/* bounds check */
+		for ( k = 0; k < 3; k++ )
+			if ( ds->mins[ k ] >= ( work->dp.center[ k ] + work->dp.radius ) ||
+				 ds->maxs[ k ] <= ( work->dp.center[ k ] - work->dp.radius ) ) {
+				break;
 			}
+		if ( k < 3 ) {
+			continue;
+		}
 
-			/* ignore autosprite or nomarks */
-			if ( ds->shaderInfo->autosprite || ( ds->shaderInfo->compileFlags & C_NOMARKS ) ) {
-				continue;
-			}
+		/* switch on type */
+		switch ( ds->type )
+		{
+		case SURFACE_FACE:
+			ProjectDecalOntoFace( work, ds );
+			break;
+
+		case SURFACE_PATCH:
+			ProjectDecalOntoPatch( work, ds );
+			break;
+
+		case SURFACE_TRIANGLES:
+		case SURFACE_FORCED_META:
+		case SURFACE_META:
+			ProjectDecalOntoTriangles( work, ds );
+			break;
+
+		default:
+			break;
+		}
+	}
 
-			/* bounds check */
-			for ( k = 0; k < 3; k++ )
-				if ( ds->mins[ k ] >= ( dp.center[ k ] + dp.radius ) ||
-					 ds->maxs[ k ] <= ( dp.center[ k ] - dp.radius ) ) {
-					break;
-				}
-			if ( k < 3 ) {
-				continue;
-			}
+	free( surfs );
+}
 
-			/* switch on type */
-			switch ( ds->type )
-			{
-			case SURFACE_FACE:
-				ProjectDecalOntoFace( &dp, ds );
-				break;
 
-			case SURFACE_PATCH:
-				ProjectDecalOntoPatch( &dp, ds );
-				break;
 
-			case SURFACE_TRIANGLES:
-			case SURFACE_FORCED_META:
-			case SURFACE_META:
-				ProjectDecalOntoTriangles( &dp, ds );
-				break;
+/*
+   MakeEntityDecals()
+   projects decals onto world surfaces
+ */
 
-			default:
-				break;
-			}
+void MakeEntityDecals( entity_t *e ){
+	int i, j;
+	decalWork_t         *work;
+
+
+	/* note it */
+	Sys_FPrintf( SYS_VRB, "--- MakeEntityDecals ---\n" );
+
+	/* set entity origin */
+	VectorCopy( e->origin, entityOrigin );
+
+	/* transform projector instead of geometry */
+	VectorClear( entityOrigin );
+
+	/* clip the projectors against the surfaces */
+	if ( numProjectors > 0 ) {
+		decalEntity = e;
+		decalWork = safe_malloc( numProjectors * sizeof( *decalWork ) );
+		memset( decalWork, 0, numProjectors * sizeof( *decalWork ) );
+		RunThreadsOnIndividual( numProjectors, verbose, MakeDecalFragments );
+
+		/* make the surfaces in projector order */
+		for ( i = 0; i < numProjectors; i++ )
+		{
+			work = &decalWork[ i ];
+			for ( j = 0; j < work->numFragments; j++ )
+				EmitDecalSurface( &work->dp, &work->fragments[ j ] );
+			free( work->fragments );
 		}
+		free( decalWork );
+		decalWork = NULL;
 	}
 
-	/* print time */
-	Sys_FPrintf( SYS_VRB, " (%d)\n", (int) ( I_FloatTime() - start ) );
-
 	/* emit some stats */
 	Sys_FPrintf( SYS_VRB, "%9d decal surfaces\n", numDecalSurfaces );
 }
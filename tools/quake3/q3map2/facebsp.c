@@ -40,6 +40,28 @@
 
 int c_faceLeafs;
 
+static memPool_t facePool = MEMPOOL( "faces", sizeof( face_t ) );
+
+/* face lists at least this long score their split candidates on all threads */
+#define FACEBSP_THREAD_FACES    256
+
+/* trees with fewer faces than this are built on a single thread */
+#define FACEBSP_THREAD_TREE     1024
+
+/* subtrees handed to the threads once the top of the tree is built */
+typedef struct faceTreeWork_s
+{
+	node_t      *node;
+	face_t      *list;
+}
+faceTreeWork_t;
+
+static qboolean faceTreeDefer;
+static int faceTreeDeferFaces;
+static int numFaceTreeWork;
+static int allocatedFaceTreeWork;
+static faceTreeWork_t *faceTreeWork;
+
 
 /*
    ================
@@ -49,7 +71,7 @@ int c_faceLeafs;
 face_t  *AllocBspFace( void ) {
 	face_t  *f;
 
-	f = safe_malloc( sizeof( *f ) );
+	f = PoolAlloc( &facePool );
 	memset( f, 0, sizeof( *f ) );
 
 	return f;
@@ -66,51 +88,145 @@ void    FreeBspFace( face_t *f ) {
 	if ( f->w ) {
 		FreeWinding( f->w );
 	}
-	free( f );
+	PoolFree( &facePool, f );
 }
 
 
 
 /*
-   SelectSplitPlaneNum()
-   finds the best split plane for this node
+   BlockSplitAxis()
+   returns the axis of the first block boundary the node crosses, or -1
  */
 
-static void SelectSplitPlaneNum( node_t *node, face_t *list, int *splitPlaneNum, int *compileFlags ){
-	face_t *split;
+static int BlockSplitAxis( node_t *node, float *dist ){
+	int i;
+
+	/* ydnar 2002-06-24: changed this to split on z-axis as well */
+	/* ydnar 2002-09-21: changed blocksize to be a vector, so mappers can specify a 3 element value */
+
+	for ( i = 0; i < 3; i++ )
+	{
+		if ( blockSize[ i ] <= 0 ) {
+			continue;
+		}
+		*dist = blockSize[ i ] * ( floor( node->mins[ i ] / blockSize[ i ] ) + 1 );
+		if ( node->maxs[ i ] > *dist ) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+
+/*
+   EvaluateSplitFace()
+   scores the plane of one face as a split for the whole list
+ */
+
+static int EvaluateSplitFace( face_t *split, face_t *list ){
 	face_t *check;
-	face_t *bestSplit;
 	int splits, facing, front, back;
 	int side;
 	plane_t *plane;
+	int value;
+	float sizeBias;
+
+
+	plane = &mapplanes[ split->planenum ];
+	splits = 0;
+	facing = 0;
+	front = 0;
+	back = 0;
+	for ( check = list ; check ; check = check->next ) {
+		if ( check->planenum == split->planenum ) {
+			facing++;
+			//check->checked = qtrue;	// won't need to test this plane again
+			continue;
+		}
+		side = WindingOnPlaneSide( check->w, plane->normal, plane->dist );
+		if ( side == SIDE_CROSS ) {
+			splits++;
+		}
+		else if ( side == SIDE_FRONT ) {
+			front++;
+		}
+		else if ( side == SIDE_BACK ) {
+			back++;
+		}
+	}
+
+	if ( bspAlternateSplitWeights ) {
+		// from 27
+
+		//Bigger is better
+		sizeBias = WindingArea( split->w );
+
+		//Base score = 20000 perfectly balanced
+		value = 20000 - ( abs( front - back ) );
+		value -= plane->counter; // If we've already used this plane sometime in the past try not to use it again
+		value -= facing ;       // if we're going to have alot of other surfs use this plane, we want to get it in quickly.
+		value -= splits * 5;        //more splits = bad
+		value +=  sizeBias * 10; //We want a huge score bias based on plane size
+	}
+	else
+	{
+		value =  5 * facing - 5 * splits; // - abs(front-back);
+		if ( plane->type < 3 ) {
+			value += 5;       // axial is better
+		}
+	}
+
+	value += split->priority;       // prioritize hints higher
+
+	return value;
+}
+
+
+
+/*
+   SelectSplitPlaneNumThread()
+   scores one candidate of a long face list, the candidates are split across threads
+ */
+
+static face_t *splitList;
+static face_t **splitFaces;
+static int *splitValues;
+static int allocatedSplitFaces;
+
+static void SelectSplitPlaneNumThread( int num ){
+	splitValues[ num ] = EvaluateSplitFace( splitFaces[ num ], splitList );
+}
+
+
+
+/*
+   SelectSplitPlaneNum()
+   finds the best split plane for this node
+ */
+
+static void SelectSplitPlaneNum( node_t *node, face_t *list, int numFaces, int *splitPlaneNum, int *compileFlags ){
+	face_t *split;
+	face_t *bestSplit;
 	int value, bestValue;
 	int i;
 	vec3_t normal;
 	float dist;
 	int planenum;
-	float sizeBias;
 
 	/* ydnar: set some defaults */
 	*splitPlaneNum = -1; /* leaf */
 	*compileFlags = 0;
 
-	/* ydnar 2002-06-24: changed this to split on z-axis as well */
-	/* ydnar 2002-09-21: changed blocksize to be a vector, so mappers can specify a 3 element value */
-
 	/* if it is crossing a block boundary, force a split */
-	for ( i = 0; i < 3; i++ )
-	{
-		if ( blockSize[ i ] <= 0 ) {
-			continue;
-		}
-		dist = blockSize[ i ] * ( floor( node->mins[ i ] / blockSize[ i ] ) + 1 );
-		if ( node->maxs[ i ] > dist ) {
-			VectorClear( normal );
-			normal[ i ] = 1;
-			planenum = FindFloatPlane( normal, dist, 0, NULL );
-			*splitPlaneNum = planenum;
-			return;
-		}
+	i = BlockSplitAxis( node, &dist );
+	if ( i >= 0 ) {
+		VectorClear( normal );
+		normal[ i ] = 1;
+		planenum = FindFloatPlane( normal, dist, 0, NULL );
+		*splitPlaneNum = planenum;
+		return;
 	}
 
 	/* pick one of the face planes */
@@ -122,60 +238,41 @@ static void SelectSplitPlaneNum( node_t *node, face_t *list, int *splitPlaneNum,
 	//for( split = list; split; split = split->next )
 	//	split->checked = qfalse;
 
-	for ( split = list; split; split = split->next )
-	{
-		//if ( split->checked )
-		//	continue;
-
-		plane = &mapplanes[ split->planenum ];
-		splits = 0;
-		facing = 0;
-		front = 0;
-		back = 0;
-		for ( check = list ; check ; check = check->next ) {
-			if ( check->planenum == split->planenum ) {
-				facing++;
-				//check->checked = qtrue;	// won't need to test this plane again
-				continue;
-			}
-			side = WindingOnPlaneSide( check->w, plane->normal, plane->dist );
-			if ( side == SIDE_CROSS ) {
-				splits++;
-			}
-			else if ( side == SIDE_FRONT ) {
-				front++;
-			}
-			else if ( side == SIDE_BACK ) {
-				back++;
-			}
+	/* score long lists on all threads (unless we are one of them), picking the best in list order keeps the result identical */
+	if ( numFaces >= FACEBSP_THREAD_FACES && numthreads > 1 && !threaded ) {
+		if ( numFaces > allocatedSplitFaces ) {
+			free( splitFaces );
+			free( splitValues );
+			allocatedSplitFaces = numFaces;
+			splitFaces = safe_malloc( allocatedSplitFaces * sizeof( *splitFaces ) );
+			splitValues = safe_malloc( allocatedSplitFaces * sizeof( *splitValues ) );
 		}
+		for ( i = 0, split = list; split; split = split->next, i++ )
+			splitFaces[ i ] = split;
+		splitList = list;
 
-		if ( bspAlternateSplitWeights ) {
-			// from 27
-
-			//Bigger is better
-			sizeBias = WindingArea( split->w );
+		RunThreadsOnIndividual( numFaces, qfalse, SelectSplitPlaneNumThread );
 
-			//Base score = 20000 perfectly balanced
-			value = 20000 - ( abs( front - back ) );
-			value -= plane->counter; // If we've already used this plane sometime in the past try not to use it again
-			value -= facing ;       // if we're going to have alot of other surfs use this plane, we want to get it in quickly.
-			value -= splits * 5;        //more splits = bad
-			value +=  sizeBias * 10; //We want a huge score bias based on plane size
-		}
-		else
+		for ( i = 0; i < numFaces; i++ )
 		{
-			value =  5 * facing - 5 * splits; // - abs(front-back);
-			if ( plane->type < 3 ) {
-				value += 5;       // axial is better
+			if ( splitValues[ i ] > bestValue ) {
+				bestValue = splitValues[ i ];
+				bestSplit = splitFaces[ i ];
 			}
 		}
+	}
+	else
+	{
+		for ( split = list; split; split = split->next )
+		{
+			//if ( split->checked )
+			//	continue;
 
-		value += split->priority;       // prioritize hints higher
-
-		if ( value > bestValue ) {
-			bestValue = value;
-			bestSplit = split;
+			value = EvaluateSplitFace( split, list );
+			if ( value > bestValue ) {
+				bestValue = value;
+				bestSplit = split;
+			}
 		}
 	}
 
@@ -188,7 +285,8 @@ static void SelectSplitPlaneNum( node_t *node, face_t *list, int *splitPlaneNum,
 	*splitPlaneNum = bestSplit->planenum;
 	*compileFlags = bestSplit->compileFlags;
 
-	if ( *splitPlaneNum > -1 ) {
+	/* the counter is only read by the alternate weights, which never build subtrees in parallel */
+	if ( *splitPlaneNum > -1 && bspAlternateSplitWeights ) {
 		mapplanes[ *splitPlaneNum ].counter++;
 	}
 }
@@ -227,19 +325,31 @@ void BuildFaceTree_r( node_t *node, face_t *list ){
 	winding_t   *frontWinding, *backWinding;
 	int i;
 	int splitPlaneNum, compileFlags;
+	float dist;
 
 
 	/* count faces left */
 	i = CountFaceList( list );
 
+	/* hand small enough subtrees to the threads, unless they still need block splits (new planes would be numbered in thread order) */
+	if ( faceTreeDefer && i <= faceTreeDeferFaces && BlockSplitAxis( node, &dist ) < 0 ) {
+		AUTOEXPAND_BY_REALLOC( faceTreeWork, numFaceTreeWork, allocatedFaceTreeWork, 64 );
+		faceTreeWork[ numFaceTreeWork ].node = node;
+		faceTreeWork[ numFaceTreeWork ].list = list;
+		numFaceTreeWork++;
+		return;
+	}
+
 	/* select the best split plane */
-	SelectSplitPlaneNum( node, list, &splitPlaneNum, &compileFlags );
+	SelectSplitPlaneNum( node, list, i, &splitPlaneNum, &compileFlags );
 
 	/* if we don't have any more faces, this is a node */
 	if ( splitPlaneNum == -1 ) {
 		node->planenum = PLANENUM_LEAF;
 		node->has_structural_children = qfalse;
+		ThreadLock();
 		c_faceLeafs++;
+		ThreadUnlock();
 		return;
 	}
 
@@ -329,6 +439,17 @@ void BuildFaceTree_r( node_t *node, face_t *list ){
 }
 
 
+/*
+   BuildFaceTreeThread()
+   builds one of the deferred subtrees
+ */
+
+static void BuildFaceTreeThread( int num ){
+	BuildFaceTree_r( faceTreeWork[ num ].node, faceTreeWork[ num ].list );
+}
+
+
+
 /*
    ================
    FaceBSP
@@ -339,10 +460,12 @@ void BuildFaceTree_r( node_t *node, face_t *list ){
 tree_t *FaceBSP( face_t *list ) {
 	tree_t      *tree;
 	face_t  *face;
+	node_t  *node;
 	int i;
 	int count;
 
 	Sys_FPrintf( SYS_VRB, "--- FaceBSP ---\n" );
+	ProfileBegin( "FaceBSP" );
 
 	tree = AllocTree();
 
@@ -367,10 +490,32 @@ tree_t *FaceBSP( face_t *list ) {
 	VectorCopy( tree->maxs, tree->headnode->maxs );
 	c_faceLeafs = 0;
 
-	BuildFaceTree_r( tree->headnode, list );
+	/* build the top of the tree here, then the subtrees below it in parallel */
+	if ( numthreads > 1 && !threaded && !bspAlternateSplitWeights && count >= FACEBSP_THREAD_TREE ) {
+		faceTreeDefer = qtrue;
+		faceTreeDeferFaces = count / ( numthreads * 4 );
+		numFaceTreeWork = 0;
+
+		BuildFaceTree_r( tree->headnode, list );
+
+		faceTreeDefer = qfalse;
+		RunThreadsOnIndividual( numFaceTreeWork, qfalse, BuildFaceTreeThread );
+
+		/* the top of the tree was finished before its deferred children, pass their structural flags up */
+		for ( i = 0; i < numFaceTreeWork; i++ )
+		{
+			for ( node = faceTreeWork[ i ].node; node->parent != NULL; node = node->parent )
+				node->parent->has_structural_children |= node->has_structural_children;
+		}
+		Sys_FPrintf( SYS_VRB, "%9d subtrees built in parallel\n", numFaceTreeWork );
+	}
+	else{
+		BuildFaceTree_r( tree->headnode, list );
+	}
 
 	Sys_FPrintf( SYS_VRB, "%9d leafs\n", c_faceLeafs );
 
+	ProfileEnd();
 	return tree;
 }
 
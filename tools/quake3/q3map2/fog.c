@@ -473,12 +473,13 @@ qboolean ChopFaceSurfaceByBrush( entity_t *e, mapDrawSurface_t *ds, brush_t *b )
  */
 
 void FogDrawSurfaces( entity_t *e ){
-	int i, j, k, fogNum;
+	int i, j, k, c, fogNum;
 	fog_t               *fog;
 	mapDrawSurface_t    *ds;
 	vec3_t mins, maxs;
 	int fogged, numFogged;
 	int numBaseDrawSurfs;
+	int *surfs, numSurfs, allocatedSurfs;
 
 
 	/* note it */
@@ -487,6 +488,8 @@ void FogDrawSurfaces( entity_t *e ){
 	/* reset counters */
 	numFogged = 0;
 	numFogFragments = 0;
+	surfs = NULL;
+	allocatedSurfs = 0;
 
 	/* walk fog list */
 	for ( fogNum = 0; fogNum < numMapFogs; fogNum++ )
@@ -496,9 +499,24 @@ void FogDrawSurfaces( entity_t *e ){
 
 		/* clip each surface into this, but don't clip any of the resulting fragments to the same brush */
 		numBaseDrawSurfs = numMapDrawSurfs;
-		for ( i = 0; i < numBaseDrawSurfs; i++ )
+
+		/* only surfaces near the fog brush can be chopped by it (chopped surfaces can snap a little outside their old bounds) */
+		if ( fog->brush != NULL ) {
+			for ( k = 0; k < 3; k++ )
+			{
+				mins[ k ] = fog->brush->mins[ k ] - 1.0f;
+				maxs[ k ] = fog->brush->maxs[ k ] + 1.0f;
+			}
+			numSurfs = DrawSurfacesInBounds( mins, maxs, 0, numBaseDrawSurfs, &surfs, &allocatedSurfs );
+		}
+		else{
+			numSurfs = numBaseDrawSurfs;
+		}
+
+		for ( c = 0; c < numSurfs; c++ )
 		{
 			/* get the drawsurface */
+			i = fog->brush != NULL ? surfs[ c ] : c;
 			ds = &mapDrawSurfs[ i ];
 
 			/* no fog? */
@@ -572,6 +590,8 @@ void FogDrawSurfaces( entity_t *e ){
 		}
 	}
 
+	free( surfs );
+
 	/* emit some statistics */
 	Sys_FPrintf( SYS_VRB, "%9d fog polygon fragments\n", numFogFragments );
 	Sys_FPrintf( SYS_VRB, "%9d fog patch fragments\n", numFogPatchFragments );
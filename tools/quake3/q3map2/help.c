@@ -88,6 +88,7 @@ void HelpBsp()
 	struct HelpOption bsp[] = {
 		{"-bsp <filename.map>", "Switch that enters this stage"},
 		{"-altsplit", "Alternate BSP tree splitting weights (should give more fps)"},
+		{"-binaryprt", "Write the portal file in the binary PRTB format, which vis and prtview load much faster"},
 		{"-bspfile <filename.bsp>", "BSP file to write"},
 		{"-celshader <shadername>", "Sets a global cel shader name"},
 		{"-custinfoparms", "Read scripts/custinfoparms.txt"},
@@ -121,6 +122,7 @@ void HelpBsp()
 		{"-prtfile <filename.prt>", "Portal file to write"},
 		{"-rename", "Append suffix to miscmodel shaders (needed for SoF2)"},
 		{"-samplesize <N>", "Sets default lightmap resolution in luxels/qu"},
+		{"-saveintermediate", "With `-vis` or `-light`, still write the BSP, portal and surface files between the stages"},
 		{"-skyfix", "Turn sky box into six surfaces to work around ATI problems"},
 		{"-snap <N>", "Snap brush bevel planes to the given number of units"},
 		{"-srffile <filename.srf>", "Surface file to write"},
@@ -128,6 +130,7 @@ void HelpBsp()
 		{"-texrange <N>", "Limit per-surface texture range to the given number of units, and subdivide surfaces like with `q3map_tessSize` if this is not met"},
 		{"-tmpout", "Write the BSP file to /tmp"},
 		{"-verboseentities", "Enable `-v` only for map entities, not for the world"},
+		{"-vis [options] -light [options]", "Run vis and/or light in the same process, handing over the BSP in memory"},
 	};
 	HelpOptions("BSP Stage", 0, 80, bsp, sizeof(bsp)/sizeof(struct HelpOption));
 }
@@ -143,7 +146,7 @@ void HelpVis()
 		{"-nopassage", "Just use PortalFlow vis (usually less fps)"},
 		{"-nosort", "Do not sort the portals before calculating vis (usually slower)"},
 		{"-passageOnly", "Just use PassageFlow vis (usually less fps)"},
-		{"-prtfile <filename.prt>", "Portal file to read"},
+		{"-prtfile <filename.prt>", "Portal file to read (text or binary)"},
 		{"-saveprt", "Keep the Portal file after running vis (so you can run vis again)"},
 		{"-tmpin", "Use /tmp folder for input"},
 		{"-tmpout", "Use /tmp folder for output"},
@@ -361,6 +364,7 @@ void HelpCommon()
 		{"-fs_nohomepath", "Do not load home path in VFS"},
 		{"-fs_pakpath <path>", "Specify a package directory (can be used more than once to look in multiple paths)"},
 		{"-game <gamename>", "Load settings for the given game (default: quake3)"},
+		{"-profile <filename.json>", "Print the time, memory and light rays of each step and write them as a Chrome trace"},
 		{"-subdivisions <F>", "multiplier for patch subdivisions quality"},
 		{"-threads <N>", "number of threads to use"},
 		{"-v", "Verbose mode"}
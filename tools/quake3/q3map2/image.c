@@ -226,6 +226,62 @@ static void LoadPNGBuffer( byte *buffer, int size, byte **pixels, int *width, in
 
 
 
+/* name index over images */
+#define IMAGE_HASH_SIZE     1024
+
+static int imageHashHead[ IMAGE_HASH_SIZE ];
+static int imageHashNext[ MAX_IMAGES ];
+
+
+
+/*
+   ImageNameHash()
+   hashes an extensionless image name
+ */
+
+static int ImageNameHash( const char *name ){
+	unsigned int hash;
+
+
+	hash = 0;
+	for ( ; *name; name++ )
+		hash = hash * 31 + (unsigned char) *name;
+	return hash & ( IMAGE_HASH_SIZE - 1 );
+}
+
+
+
+/*
+   ImageLink() / ImageUnlink()
+   adds or removes a named image from the name index
+ */
+
+static void ImageLink( image_t *image ){
+	int num, hash;
+
+
+	num = image - images;
+	hash = ImageNameHash( image->name );
+	imageHashNext[ num ] = imageHashHead[ hash ];
+	imageHashHead[ hash ] = num;
+}
+
+static void ImageUnlink( image_t *image ){
+	int num, *link;
+
+
+	num = image - images;
+	for ( link = &imageHashHead[ ImageNameHash( image->name ) ]; *link >= 0; link = &imageHashNext[ *link ] )
+	{
+		if ( *link == num ) {
+			*link = imageHashNext[ num ];
+			break;
+		}
+	}
+}
+
+
+
 /*
    ImageInit()
    implicitly called by every function to set up image list
@@ -238,6 +294,7 @@ static void ImageInit( void ){
 	if ( numImages <= 0 ) {
 		/* clear images (fixme: this could theoretically leak) */
 		memset( images, 0, sizeof( images ) );
+		memset( imageHashHead, 0xFF, sizeof( imageHashHead ) );
 
 		/* generate *bogus image */
 		images[ 0 ].name = safe_malloc( strlen( DEFAULT_IMAGE ) + 1 );
@@ -250,6 +307,10 @@ static void ImageInit( void ){
 		images[ 0 ].pixels = safe_malloc( 64 * 64 * 4 );
 		for ( i = 0; i < ( 64 * 64 * 4 ); i++ )
 			images[ 0 ].pixels[ i ] = 255;
+		ImageLink( &images[ 0 ] );
+
+		/* the bogus image counts, so the list isn't cleared again before the first real load */
+		numImages = 1;
 	}
 }
 
@@ -272,6 +333,7 @@ void ImageFree( image_t *image ){
 	/* free? */
 	if ( image->refCount <= 0 ) {
 		if ( image->name != NULL ) {
+			ImageUnlink( image );
 			free( image->name );
 		}
 		image->name = NULL;
@@ -310,10 +372,10 @@ image_t *ImageFind( const char *filename ){
 	strcpy( name, filename );
 	StripExtension( name );
 
-	/* search list */
-	for ( i = 0; i < MAX_IMAGES; i++ )
+	/* search index */
+	for ( i = imageHashHead[ ImageNameHash( name ) ]; i >= 0; i = imageHashNext[ i ] )
 	{
-		if ( images[ i ].name != NULL && !strcmp( name, images[ i ].name ) ) {
+		if ( !strcmp( name, images[ i ].name ) ) {
 			return &images[ i ];
 		}
 	}
@@ -325,61 +387,42 @@ image_t *ImageFind( const char *filename ){
 
 
 /*
-   ImageLoad()
-   loads an rgba image and returns a pointer to the image_t struct or NULL if not found
+   ImageLoadFile()
+   vfsLoadFile wrapper, the vfs isn't reentrant so image prefetch threads take turns
  */
 
-image_t *ImageLoad( const char *filename ){
-	int i;
-	image_t     *image;
-	char name[ 1024 ];
+static int ImageLoadFile( const char *name, byte **buffer, qboolean lockFiles ){
 	int size;
-	byte        *buffer = NULL;
-	qboolean alphaHack = qfalse;
 
 
-	/* init */
-	ImageInit();
-
-	/* dummy check */
-	if ( filename == NULL || filename[ 0 ] == '\0' ) {
-		return NULL;
+	if ( lockFiles ) {
+		ThreadLock();
+	}
+	size = vfsLoadFile( name, (void**) buffer, 0 );
+	if ( lockFiles ) {
+		ThreadUnlock();
 	}
+	return size;
+}
 
-	/* strip file extension off name */
-	strcpy( name, filename );
-	StripExtension( name );
 
-	/* try to find existing image */
-	image = ImageFind( name );
-	if ( image != NULL ) {
-		image->refCount++;
-		return image;
-	}
 
-	/* none found, so find first non-null image */
-	image = NULL;
-	for ( i = 0; i < MAX_IMAGES; i++ )
-	{
-		if ( images[ i ].name == NULL ) {
-			image = &images[ i ];
-			break;
-		}
-	}
+/*
+   ImageLoadPixels()
+   tries the supported extensions on an extensionless name and decodes the first one found,
+   only touches the image's pixels, size and filename so it can run outside the image list
+ */
 
-	/* too many images? */
-	if ( image == NULL ) {
-		Error( "MAX_IMAGES (%d) exceeded, there are too many image files referenced by the map.", MAX_IMAGES );
-	}
+static qboolean ImageLoadPixels( char *name, image_t *image, qboolean lockFiles ){
+	int size;
+	byte        *buffer = NULL;
+	qboolean alphaHack = qfalse;
 
-	/* set it up */
-	image->name = safe_malloc( strlen( name ) + 1 );
-	strcpy( image->name, name );
 
 	/* attempt to load tga */
 	StripExtension( name );
 	strcat( name, ".tga" );
-	size = vfsLoadFile( (const char*) name, (void**) &buffer, 0 );
+	size = ImageLoadFile( name, &buffer, lockFiles );
 	if ( size > 0 ) {
 		LoadTGABuffer( buffer, buffer + size, &image->pixels, &image->width, &image->height );
 	}
@@ -388,7 +431,7 @@ image_t *ImageLoad( const char *filename ){
 		/* attempt to load png */
 		StripExtension( name );
 		strcat( name, ".png" );
-		size = vfsLoadFile( (const char*) name, (void**) &buffer, 0 );
+		size = ImageLoadFile( name, &buffer, lockFiles );
 		if ( size > 0 ) {
 			LoadPNGBuffer( buffer, size, &image->pixels, &image->width, &image->height );
 		}
@@ -397,7 +440,7 @@ image_t *ImageLoad( const char *filename ){
 			/* attempt to load jpg */
 			StripExtension( name );
 			strcat( name, ".jpg" );
-			size = vfsLoadFile( (const char*) name, (void**) &buffer, 0 );
+			size = ImageLoadFile( name, &buffer, lockFiles );
 			if ( size > 0 ) {
 				if ( LoadJPGBuff( buffer, size, &image->pixels, &image->width, &image->height ) == -1 && image->pixels != NULL ) {
 					// On error, LoadJPGBuff might store a pointer to the error message in image->pixels
@@ -410,7 +453,7 @@ image_t *ImageLoad( const char *filename ){
 				/* attempt to load dds */
 				StripExtension( name );
 				strcat( name, ".dds" );
-				size = vfsLoadFile( (const char*) name, (void**) &buffer, 0 );
+				size = ImageLoadFile( name, &buffer, lockFiles );
 				if ( size > 0 ) {
 					LoadDDSBuffer( buffer, size, &image->pixels, &image->width, &image->height );
 
@@ -433,7 +476,7 @@ image_t *ImageLoad( const char *filename ){
 					/* attempt to load ktx */
 					StripExtension( name );
 					strcat( name, ".ktx" );
-					size = vfsLoadFile( (const char*) name, (void**) &buffer, 0 );
+					size = ImageLoadFile( name, &buffer, lockFiles );
 					if ( size > 0 ) {
 						LoadKTXBufferFirstImage( buffer, size, &image->pixels, &image->width, &image->height );
 					}
@@ -449,23 +492,17 @@ image_t *ImageLoad( const char *filename ){
 	if ( size <= 0 || image->width <= 0 || image->height <= 0 || image->pixels == NULL ) {
 		//%	Sys_Printf( "size = %d  width = %d  height = %d  pixels = 0x%08x (%s)\n",
 		//%		size, image->width, image->height, image->pixels, name );
-		free( image->name );
-		image->name = NULL;
-		return NULL;
+		return qfalse;
 	}
 
 	/* set filename */
 	image->filename = safe_malloc( strlen( name ) + 1 );
 	strcpy( image->filename, name );
 
-	/* set count */
-	image->refCount = 1;
-	numImages++;
-
 	if ( alphaHack ) {
 		StripExtension( name );
 		strcat( name, "_alpha.jpg" );
-		size = vfsLoadFile( (const char*) name, (void**) &buffer, 0 );
+		size = ImageLoadFile( name, &buffer, lockFiles );
 		if ( size > 0 ) {
 			unsigned char *pixels;
 			int width, height;
@@ -486,6 +523,144 @@ image_t *ImageLoad( const char *filename ){
 		}
 	}
 
+	return qtrue;
+}
+
+
+
+/*
+   ImageFreeSlot()
+   returns the first unused image
+ */
+
+static image_t *ImageFreeSlot( void ){
+	int i;
+
+
+	for ( i = 0; i < MAX_IMAGES; i++ )
+	{
+		if ( images[ i ].name == NULL ) {
+			return &images[ i ];
+		}
+	}
+
+	Error( "MAX_IMAGES (%d) exceeded, there are too many image files referenced by the map.", MAX_IMAGES );
+	return NULL;
+}
+
+
+
+/*
+   ImageLoad()
+   loads an rgba image and returns a pointer to the image_t struct or NULL if not found
+ */
+
+image_t *ImageLoad( const char *filename ){
+	image_t     *image;
+	char name[ 1024 ];
+
+
+	/* init */
+	ImageInit();
+
+	/* dummy check */
+	if ( filename == NULL || filename[ 0 ] == '\0' ) {
+		return NULL;
+	}
+
+	/* strip file extension off name */
+	strcpy( name, filename );
+	StripExtension( name );
+
+	/* try to find existing image */
+	image = ImageFind( name );
+	if ( image != NULL ) {
+		image->refCount++;
+		return image;
+	}
+
+	/* none found, so find first non-null image */
+	image = ImageFreeSlot();
+
+	/* set it up */
+	image->name = safe_malloc( strlen( name ) + 1 );
+	strcpy( image->name, name );
+
+	/* load it */
+	if ( !ImageLoadPixels( name, image, qfalse ) ) {
+		free( image->name );
+		image->name = NULL;
+		return NULL;
+	}
+	ImageLink( image );
+
+	/* set count */
+	image->refCount = 1;
+	numImages++;
+
 	/* return the image */
 	return image;
 }
+
+
+
+/*
+   ImagePrefetch()
+   loads an image into the list ahead of ImageLoad, safe to call from worker threads.
+   files are read one at a time but decoded in parallel.  the image is left with no
+   references, so the first ImageLoad of it owns it.  returns qfalse if it wasn't found
+ */
+
+qboolean ImagePrefetch( const char *filename ){
+	image_t     *image, loaded;
+	char name[ 1024 ];
+	qboolean found;
+
+
+	/* dummy check */
+	if ( filename == NULL || filename[ 0 ] == '\0' ) {
+		return qfalse;
+	}
+
+	/* strip file extension off name */
+	strcpy( name, filename );
+	StripExtension( name );
+
+	/* claim the name, so no other thread loads it too */
+	ThreadLock();
+	ImageInit();
+	image = ImageFind( name );
+	if ( image != NULL ) {
+		ThreadUnlock();
+		return qtrue;
+	}
+	image = ImageFreeSlot();
+	image->name = safe_malloc( strlen( name ) + 1 );
+	strcpy( image->name, name );
+	ImageLink( image );
+	ThreadUnlock();
+
+	/* load it on this thread */
+	memset( &loaded, 0, sizeof( loaded ) );
+	found = ImageLoadPixels( name, &loaded, qtrue );
+
+	/* publish or drop it */
+	ThreadLock();
+	if ( found ) {
+		image->filename = loaded.filename;
+		image->pixels = loaded.pixels;
+		image->width = loaded.width;
+		image->height = loaded.height;
+		image->refCount = 0;
+		numImages++;
+	}
+	else
+	{
+		ImageUnlink( image );
+		free( image->name );
+		image->name = NULL;
+	}
+	ThreadUnlock();
+
+	return found;
+}
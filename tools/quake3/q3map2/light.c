@@ -1906,7 +1906,9 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 
 	/* determine the number of grid points */
 	Sys_Printf( "--- SetupGrid ---\n" );
+	ProfileBegin( "SetupGrid" );
 	SetupGrid();
+	ProfileEnd();
 
 	/* find the optional minimum lighting values */
 	GetVectorForKey( &entities[ 0 ], "_color", color );
@@ -1960,8 +1962,10 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 
 	/* create world lights */
 	Sys_FPrintf( SYS_VRB, "--- CreateLights ---\n" );
+	ProfileBegin( "CreateLights" );
 	CreateEntityLights();
 	CreateSurfaceLights();
+	ProfileEnd();
 	Sys_Printf( "%9d point lights\n", numPointLights );
 	Sys_Printf( "%9d spotlights\n", numSpotLights );
 	Sys_Printf( "%9d diffuse (area) lights\n", numDiffuseLights );
@@ -1973,9 +1977,11 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 		SetupEnvelopes( qtrue, fastgrid );
 
 		Sys_Printf( "--- TraceGrid ---\n" );
+		ProfileBegin( "TraceGrid" );
 		inGrid = qtrue;
 		RunThreadsOnIndividual( numRawGridPoints, qtrue, TraceGrid );
 		inGrid = qfalse;
+		ProfileEnd();
 		Sys_Printf( "%d x %d x %d = %d grid\n",
 					gridBounds[ 0 ], gridBounds[ 1 ], gridBounds[ 2 ], numBSPGridPoints );
 
@@ -1989,7 +1995,9 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 
 	/* map the world luxels */
 	Sys_Printf( "--- MapRawLightmap ---\n" );
+	ProfileBegin( "MapRawLightmap" );
 	RunThreadsOnIndividual( numRawLightmaps, qtrue, MapRawLightmap );
+	ProfileEnd();
 	Sys_Printf( "%9d luxels\n", numLuxels );
 	Sys_Printf( "%9d luxels mapped\n", numLuxelsMapped );
 	Sys_Printf( "%9d luxels occluded\n", numLuxelsOccluded );
@@ -1997,7 +2005,9 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 	/* dirty them up */
 	if ( dirty ) {
 		Sys_Printf( "--- DirtyRawLightmap ---\n" );
+		ProfileBegin( "DirtyRawLightmap" );
 		RunThreadsOnIndividual( numRawLightmaps, qtrue, DirtyRawLightmap );
+		ProfileEnd();
 	}
 
 	/* floodlight pass */
@@ -2013,13 +2023,17 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 	lightsClusterCulled = 0;
 
 	Sys_Printf( "--- IlluminateRawLightmap ---\n" );
+	ProfileBegin( "IlluminateRawLightmap" );
 	RunThreadsOnIndividual( numRawLightmaps, qtrue, IlluminateRawLightmap );
+	ProfileEnd();
 	Sys_Printf( "%9d luxels illuminated\n", numLuxelsIlluminated );
 
 	StitchSurfaceLightmaps();
 
 	Sys_Printf( "--- IlluminateVertexes ---\n" );
+	ProfileBegin( "IlluminateVertexes" );
 	RunThreadsOnIndividual( numBSPDrawSurfaces, qtrue, IlluminateVertexes );
+	ProfileEnd();
 	Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
 
 	/* ydnar: emit statistics on light culling */
@@ -2041,6 +2055,7 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 
 		/* note it */
 		Sys_Printf( "\n--- Radiosity (bounce %d of %d) ---\n", b, bt );
+		ProfileBegin( "Radiosity" );
 
 		/* flag bouncing */
 		bouncing = qtrue;
@@ -2055,6 +2070,7 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 		SetupEnvelopes( qfalse, fastbounce );
 		if ( numLights == 0 ) {
 			Sys_Printf( "No diffuse light to calculate, ending radiosity.\n" );
+			ProfileEnd();
 			return;
 		}
 
@@ -2064,9 +2080,11 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 			gridBoundsCulled = 0;
 
 			Sys_Printf( "--- BounceGrid ---\n" );
+			ProfileBegin( "TraceGrid" );
 			inGrid = qtrue;
 			RunThreadsOnIndividual( numRawGridPoints, qtrue, TraceGrid );
 			inGrid = qfalse;
+			ProfileEnd();
 			Sys_FPrintf( SYS_VRB, "%9d grid points envelope culled\n", gridEnvelopeCulled );
 			Sys_FPrintf( SYS_VRB, "%9d grid points bounds culled\n", gridBoundsCulled );
 		}
@@ -2078,14 +2096,18 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 		lightsClusterCulled = 0;
 
 		Sys_Printf( "--- IlluminateRawLightmap ---\n" );
+		ProfileBegin( "IlluminateRawLightmap" );
 		RunThreadsOnIndividual( numRawLightmaps, qtrue, IlluminateRawLightmap );
+		ProfileEnd();
 		Sys_Printf( "%9d luxels illuminated\n", numLuxelsIlluminated );
 		Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
 
 		StitchSurfaceLightmaps();
 
 		Sys_Printf( "--- IlluminateVertexes ---\n" );
+		ProfileBegin( "IlluminateVertexes" );
 		RunThreadsOnIndividual( numBSPDrawSurfaces, qtrue, IlluminateVertexes );
+		ProfileEnd();
 		Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
 
 		/* ydnar: emit statistics on light culling */
@@ -2097,6 +2119,7 @@ void LightWorld( const char *BSPFilePath, qboolean fastAllocate ){
 		/* interate */
 		bounce--;
 		b++;
+		ProfileEnd();
 	}
 	/* ydnar: store off lightmaps */
 	StoreSurfaceLightmaps( fastAllocate );
@@ -2966,16 +2989,21 @@ int LightMain( int argc, char **argv ){
 
 	/* ydnar: handle shaders */
 	BeginMapShaderFile( BSPFilePath );
-	LoadShaderInfo();
+	if ( !bspInMemory ) {
+		LoadShaderInfo();
+	}
 
 	/* note loading */
 	Sys_Printf( "Loading %s\n", source );
 
-	/* ydnar: load surface file */
-	LoadSurfaceExtraFile( surfaceFilePath );
+	/* ydnar: load surface file and bsp file, the pipeline already has them (and the shaders) */
+	if ( !bspInMemory ) {
+		LoadSurfaceExtraFile( surfaceFilePath );
+		LoadBSPFile( BSPFilePath );
+	}
 
-	/* load bsp file */
-	LoadBSPFile( BSPFilePath );
+	/* decode its shaders' images up front */
+	PrefetchShaderImages();
 
 	/* parse bsp entities */
 	ParseEntities();
@@ -3003,6 +3031,7 @@ int LightMain( int argc, char **argv ){
 
 	/* light the world */
 	LightWorld( BSPFilePath, fastAllocate );
+	FreeMeshCache();
 
 	/* write out the bsp */
 	UnparseEntities();
@@ -121,6 +121,16 @@ int headNodeNum = 0, skyboxNodeNum = 0, maxTraceDepth = 0, numTraceLeafNodes = 0
 int numTraceNodes = 0, maxTraceNodes = 0;
 traceNode_t                     *traceNodes = NULL;
 
+/* rays traced by each thread, a cache line apart so counting costs nothing */
+typedef struct traceCount_s
+{
+	unsigned long long count;
+	char pad[ 64 - sizeof( unsigned long long ) ];
+}
+traceCount_t;
+
+static traceCount_t traceCounts[ MAX_THREADS ];
+
 
 
 /* -------------------------------------------------------------------------------
@@ -896,7 +906,7 @@ static void PopulateWithBSPModel( bspModel_t *model, m4x4_t transform ){
 	surfaceInfo_t       *info;
 	bspDrawVert_t       *verts;
 	int                 *indexes;
-	mesh_t srcMesh, *mesh, *subdivided;
+	mesh_t srcMesh, *mesh;
 	traceInfo_t ti;
 	traceWinding_t tw;
 
@@ -976,12 +986,8 @@ static void PopulateWithBSPModel( bspModel_t *model, m4x4_t transform ){
 			srcMesh.height = ds->patchHeight;
 			srcMesh.verts = &bspDrawVerts[ ds->firstVert ];
 			//%	subdivided = SubdivideMesh( srcMesh, 8, 512 );
-			subdivided = SubdivideMesh2( srcMesh, info->patchIterations );
-
-			/* fit it to the curve and remove colinear verts on rows/columns */
-			PutMeshOnCurve( *subdivided );
-			mesh = RemoveLinearMeshColumnsRows( subdivided );
-			FreeMesh( subdivided );
+			/* subdivide it, fit it to the curve and remove colinear verts on rows/columns */
+			mesh = TesselateMesh( srcMesh, info->patchIterations );
 
 			/* set verts */
 			verts = mesh->verts;
@@ -1302,6 +1308,7 @@ static void PopulateTraceNodes( void ){
 void SetupTraceNodes( void ){
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- SetupTraceNodes ---\n" );
+	ProfileBegin( "SetupTraceNodes" );
 
 	/* find nodraw bit */
 	noDrawContentFlags = noDrawSurfaceFlags = noDrawCompileFlags = 0;
@@ -1342,6 +1349,8 @@ void SetupTraceNodes( void ){
 	maxTraceWindings = 0;
 	deadWinding = -1;
 
+	ProfileEnd();
+
 	/* debug code: write out trace triangles to an alias obj file */
 	#if 0
 	{
@@ -1738,6 +1747,9 @@ void TraceLine( trace_t *trace ){
 		return;
 	}
 
+	/* count it */
+	traceCounts[ ThreadNumber() ].count++;
+
 	/* trace through nodes */
 	TraceLine_r( headNodeNum, trace->origin, trace->end, trace );
 	if ( trace->passSolid && !trace->testAll ) {
@@ -1791,3 +1803,21 @@ float SetupTrace( trace_t *trace ){
 	VectorCopy( trace->origin, trace->hit );
 	return trace->distance;
 }
+
+
+
+/*
+   TraceCount()
+   rays traced so far, by all threads
+ */
+
+double TraceCount( void ){
+	int i;
+	double count;
+
+
+	count = 0.0;
+	for ( i = 0; i < MAX_THREADS; i++ )
+		count += traceCounts[ i ].count;
+	return count;
+}
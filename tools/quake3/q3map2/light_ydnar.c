@@ -1013,7 +1013,7 @@ void MapRawLightmap( int rawLightmapNum ){
 	rawLightmap_t       *lm;
 	bspDrawSurface_t    *ds;
 	surfaceInfo_t       *info;
-	mesh_t src, *subdivided, *mesh;
+	mesh_t src, *mesh;
 	bspDrawVert_t       *verts, *dv[ 4 ], fake;
 
 
@@ -1084,12 +1084,8 @@ void MapRawLightmap( int rawLightmapNum ){
 			src.height = ds->patchHeight;
 			src.verts = &yDrawVerts[ ds->firstVert ];
 			//%	subdivided = SubdivideMesh( src, 8, 512 );
-			subdivided = SubdivideMesh2( src, info->patchIterations );
-
-			/* fit it to the curve and remove colinear verts on rows/columns */
-			PutMeshOnCurve( *subdivided );
-			mesh = RemoveLinearMeshColumnsRows( subdivided );
-			FreeMesh( subdivided );
+			/* subdivide it, fit it to the curve and remove colinear verts on rows/columns */
+			mesh = TesselateMesh( src, info->patchIterations );
 
 			/* get verts */
 			verts = mesh->verts;
@@ -3798,7 +3794,7 @@ void SetupEnvelopes( qboolean forGrid, qboolean fastFlag ){
 				numCulledLights++;
 				*owner = light->next;
 				if ( light->w != NULL ) {
-					free( light->w );
+					FreeWinding( light->w );
 				}
 				free( light );
 				continue;
@@ -107,14 +107,31 @@ void WriteTGA24( char *filename, byte *data, int width, int height, qboolean fli
 
 
 
+/*
+   ExportLightmapThread()
+   writes one lightmap as a tga image
+ */
+
+static char exportDirname[ 1024 ];
+
+static void ExportLightmapThread( int i ){
+	char filename[ sizeof( exportDirname ) + 32 ];
+
+
+	snprintf( filename, sizeof( filename ), "%s/lightmap_%04d.tga", exportDirname, i );
+	WriteTGA24( filename, bspLightBytes + i * game->lightmapSize * game->lightmapSize * 3, game->lightmapSize, game->lightmapSize, qfalse );
+}
+
+
+
 /*
    ExportLightmaps()
    exports the lightmaps as a list of numbered tga images
  */
 
 void ExportLightmaps( void ){
-	int i;
-	char dirname[ 1024 ], filename[ 1024 ];
+	int i, numLightmaps;
+	char filename[ sizeof( exportDirname ) + 32 ];
 	byte        *lightmap;
 
 
@@ -122,8 +139,8 @@ void ExportLightmaps( void ){
 	Sys_FPrintf( SYS_VRB, "--- ExportLightmaps ---\n" );
 
 	/* do some path mangling */
-	strcpy( dirname, source );
-	StripExtension( dirname );
+	Q_strncpyz( exportDirname, source, sizeof( exportDirname ) );
+	StripExtension( exportDirname );
 
 	/* sanity check */
 	if ( bspLightBytes == NULL ) {
@@ -132,16 +149,18 @@ void ExportLightmaps( void ){
 	}
 
 	/* make a directory for the lightmaps */
-	Q_mkdir( dirname );
+	Q_mkdir( exportDirname );
 
 	/* iterate through the lightmaps */
 	for ( i = 0, lightmap = bspLightBytes; lightmap < ( bspLightBytes + numBSPLightBytes ); i++, lightmap += ( game->lightmapSize * game->lightmapSize * 3 ) )
 	{
-		/* write a tga image out */
-		sprintf( filename, "%s/lightmap_%04d.tga", dirname, i );
+		snprintf( filename, sizeof( filename ), "%s/lightmap_%04d.tga", exportDirname, i );
 		Sys_Printf( "Writing %s\n", filename );
-		WriteTGA24( filename, lightmap, game->lightmapSize, game->lightmapSize, qfalse );
 	}
+	numLightmaps = i;
+
+	/* write the tga images out on all threads */
+	RunThreadsOnIndividual( numLightmaps, qfalse, ExportLightmapThread );
 }
 
 
@@ -465,7 +484,7 @@ qboolean AddPatchToRawLightmap( int num, rawLightmap_t *lm ){
 	int x, y;
 	bspDrawVert_t       *verts, *a, *b;
 	vec3_t delta;
-	mesh_t src, *subdivided, *mesh;
+	mesh_t src, *mesh;
 	float sBasis, tBasis, s, t;
 	float length, widthTable[ MAX_EXPANDED_AXIS ], heightTable[ MAX_EXPANDED_AXIS ];
 
@@ -482,12 +501,8 @@ qboolean AddPatchToRawLightmap( int num, rawLightmap_t *lm ){
 	src.height = ds->patchHeight;
 	src.verts = &yDrawVerts[ ds->firstVert ];
 	//%	subdivided = SubdivideMesh( src, 8, 512 );
-	subdivided = SubdivideMesh2( src, info->patchIterations );
-
-	/* fit it to the curve and remove colinear verts on rows/columns */
-	PutMeshOnCurve( *subdivided );
-	mesh = RemoveLinearMeshColumnsRows( subdivided );
-	FreeMesh( subdivided );
+	/* subdivide it, fit it to the curve and remove colinear verts on rows/columns */
+	mesh = TesselateMesh( src, info->patchIterations );
 
 	/* find the longest distance on each row/column */
 	verts = mesh->verts;
@@ -945,6 +960,28 @@ static int CompareSurfaceInfo( const void *a, const void *b ){
 
 
 
+/*
+   TesselatePatchSurface()
+   fills the tesselation cache with a lightmapped patch as the lightmap stages see it
+ */
+
+static void TesselatePatchSurface( int num ){
+	bspDrawSurface_t    *ds;
+	mesh_t src;
+
+
+	ds = &bspDrawSurfaces[ num ];
+	if ( ds->surfaceType != MST_PATCH || ds->numVerts <= 0 || surfaceInfos[ num ].lm == NULL ) {
+		return;
+	}
+	src.width = ds->patchWidth;
+	src.height = ds->patchHeight;
+	src.verts = &yDrawVerts[ ds->firstVert ];
+	CacheTesselatedMesh( src, surfaceInfos[ num ].patchIterations );
+}
+
+
+
 /*
    SetupSurfaceLightmaps()
    allocates lightmaps for every surface in the bsp that needs one
@@ -964,6 +1001,7 @@ void SetupSurfaceLightmaps( void ){
 
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- SetupSurfaceLightmaps ---\n" );
+	ProfileBegin( "SetupSurfaceLightmaps" );
 
 	/* determine supersample amount */
 	if ( superSample < 1 ) {
@@ -1200,6 +1238,10 @@ void SetupSurfaceLightmaps( void ){
 		FinishRawLightmap( lm );
 	}
 
+	/* tesselate the lightmapped patches on all threads, now that their lightmap
+	   coordinates are set, MapRawLightmap() and ApproximateLightmap() reuse them */
+	RunThreadsOnIndividual( numBSPDrawSurfaces, qfalse, TesselatePatchSurface );
+
 	/* allocate vertex luxel storage */
 	for ( k = 0; k < MAX_LIGHTMAPS; k++ )
 	{
@@ -1218,6 +1260,8 @@ void SetupSurfaceLightmaps( void ){
 	Sys_FPrintf( SYS_VRB, "%9d non-planar surfaces lightmapped\n", numNonPlanarsLightmapped );
 	Sys_FPrintf( SYS_VRB, "%9d patches lightmapped\n", numPatchesLightmapped );
 	Sys_FPrintf( SYS_VRB, "%9d planar patches lightmapped\n", numPlanarPatchesLightmapped );
+
+	ProfileEnd();
 }
 
 
@@ -1722,7 +1766,7 @@ static qboolean ApproximateLightmap( rawLightmap_t *lm ){
 	int n, num, i, x, y, pw[ 5 ], r;
 	bspDrawSurface_t    *ds;
 	surfaceInfo_t       *info;
-	mesh_t src, *subdivided, *mesh;
+	mesh_t src, *mesh;
 	bspDrawVert_t       *verts, *dv[ 3 ];
 	qboolean approximated;
 
@@ -1805,12 +1849,8 @@ static qboolean ApproximateLightmap( rawLightmap_t *lm ){
 			src.height = ds->patchHeight;
 			src.verts = &yDrawVerts[ ds->firstVert ];
 			//%	subdivided = SubdivideMesh( src, 8, 512 );
-			subdivided = SubdivideMesh2( src, info->patchIterations );
-
-			/* fit it to the curve and remove colinear verts on rows/columns */
-			PutMeshOnCurve( *subdivided );
-			mesh = RemoveLinearMeshColumnsRows( subdivided );
-			FreeMesh( subdivided );
+			/* subdivide it, fit it to the curve and remove colinear verts on rows/columns */
+			mesh = TesselateMesh( src, info->patchIterations );
 
 			/* get verts */
 			verts = mesh->verts;
@@ -2486,6 +2526,7 @@ void StoreSurfaceLightmaps( qboolean fastAllocate ){
 
 	/* note it */
 	Sys_Printf( "--- StoreSurfaceLightmaps ---\n" );
+	ProfileBegin( "StoreSurfaceLightmaps" );
 
 	/* setup */
 	if ( lmCustomDir ) {
@@ -3502,4 +3543,6 @@ void StoreSurfaceLightmaps( qboolean fastAllocate ){
 
 	/* write map shader file */
 	WriteMapShaderFile();
+
+	ProfileEnd();
 }
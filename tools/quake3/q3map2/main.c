@@ -86,6 +86,7 @@ char *Q_strncat( char *dst, size_t dlen, const char *src, size_t slen ) {
  */
 
 static void ExitQ3Map( void ){
+	ProfileShutdown();
 	BSPFilesCleanup();
 	if ( mapDrawSurfs != NULL ) {
 		free( mapDrawSurfs );
@@ -93,6 +94,85 @@ static void ExitQ3Map( void ){
 }
 
 
+/*
+   PipelineMain()
+   runs -bsp [options] -vis [options] -light [options] mapfile in one process,
+   the stages hand over the bsp and the portals in memory
+ */
+
+static int PipelineMain( int argc, char **argv ){
+	int i, j, r, first, numArgs;
+	char        **args, *mapFile, *stage;
+
+
+	/* still write the .bsp, .prt and .srf files between the stages? */
+	for ( i = 1, j = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[ i ], "-saveintermediate" ) ) {
+			saveIntermediate = qtrue;
+		}
+		else{
+			argv[ j++ ] = argv[ i ];
+		}
+	}
+	argc = j;
+	mapFile = argv[ argc - 1 ];
+
+	/* each stage gets its own options and the map file */
+	args = safe_malloc( ( argc + 1 ) * sizeof( *args ) );
+	bspInMemory = qtrue;
+	r = 0;
+	first = 1;
+	stage = NULL;
+	for ( i = 2; i < argc && r == 0; i++ )
+	{
+		if ( i < argc - 1 && strcmp( argv[ i ], "-vis" ) && strcmp( argv[ i ], "-light" ) ) {
+			continue;
+		}
+
+		/* stage name, options, map file */
+		numArgs = i - first;
+		memcpy( args, &argv[ first ], numArgs * sizeof( *args ) );
+		if ( i == argc - 1 ) {
+			args[ numArgs++ ] = argv[ i ];
+		}
+		else{
+			args[ numArgs++ ] = mapFile;
+		}
+		args[ numArgs ] = NULL;
+
+		/* only the last stage has to write the bsp */
+		stage = args[ 0 ];
+		bspStageFollows = ( i < argc - 1 );
+		bspFileWritten = qfalse;
+
+		ProfileBegin( args[ 0 ] + 1 );
+		if ( !strcmp( args[ 0 ], "-bsp" ) ) {
+			r = BSPMain( numArgs, args );
+		}
+		else if ( !strcmp( args[ 0 ], "-vis" ) ) {
+			r = VisMain( numArgs, args );
+		}
+		else{
+			r = LightMain( numArgs, args );
+		}
+		ProfileEnd();
+		Sys_Printf( "\n" );
+
+		first = i;
+	}
+	free( args );
+
+	/* the last stage must leave the bsp on disk */
+	if ( r == 0 && !bspFileWritten ) {
+		Error( "%s stage didn't write the bsp file", stage );
+	}
+
+	return r;
+}
+
+
+
 /*
    main()
    q3map mojo...
@@ -165,6 +245,17 @@ int main( int argc, char **argv ){
 			numthreads = atoi( argv[ i ] );
 			argv[ i ] = NULL;
 		}
+
+		/* stage timing and memory report */
+		else if ( !strcmp( argv[ i ], "-profile" ) ) {
+			if ( i + 1 >= argc ) {
+				Error( "Out of arguments: No file specified after %s", argv[ i ] );
+			}
+			argv[ i ] = NULL;
+			i++;
+			ProfileInit( argv[ i ] );
+			argv[ i ] = NULL;
+		}
 	}
 
 	/* init model library */
@@ -268,6 +359,22 @@ int main( int argc, char **argv ){
 		r = MiniMapBSPMain( argc - 1, argv + 1 );
 	}
 
+	/* -bsp followed by -vis and/or -light in one go */
+	else if ( !strcmp( argv[ 1 ], "-bsp" ) ) {
+		for ( i = 2; i < argc - 1; i++ )
+		{
+			if ( !strcmp( argv[ i ], "-vis" ) || !strcmp( argv[ i ], "-light" ) ) {
+				break;
+			}
+		}
+		if ( i < argc - 1 ) {
+			r = PipelineMain( argc, argv );
+		}
+		else{
+			r = BSPMain( argc, argv );
+		}
+	}
+
 	/* ydnar: otherwise create a bsp */
 	else{
 		r = BSPMain( argc, argv );
@@ -42,10 +42,32 @@
 
 /* undefine to make plane finding use linear sort (note: really slow) */
 #define USE_HASHING
-#define PLANE_HASHES    8192
+
+/* planes are hashed on their distance and normal, quantised to these cell sizes */
+#define PLANE_HASHES        65536
+#define PLANE_HASH_DIST     1.0
+#define PLANE_HASH_NORMAL   ( 1.0 / 16.0 )
+
+/* the old distance-only buckets, still used to choose between several matching planes */
+#define PLANE_DIST_BUCKETS  8192
 
 int planehash[ PLANE_HASHES ];
 
+/* mapplanes arrays replaced while threads were running, they may still be read */
+static plane_t  **retiredPlanes;
+static int numRetiredPlanes;
+static int allocatedRetiredPlanes;
+
+/* FindFloatPlane reads the hash without locking: a plane and the array holding it
+   must be visible to other threads before the hash entry pointing at it */
+#if defined( __GNUC__ )
+#define PlaneHashLoad( var )            __atomic_load_n( &( var ), __ATOMIC_ACQUIRE )
+#define PlaneHashStore( var, value )    __atomic_store_n( &( var ), ( value ), __ATOMIC_RELEASE )
+#else
+#define PlaneHashLoad( var )            ( var )
+#define PlaneHashStore( var, value )    ( ( var ) = ( value ) )
+#endif
+
 int c_boxbevels;
 int c_edgebevels;
 int c_areaportals;
@@ -85,6 +107,36 @@ qboolean PlaneEqual( plane_t *p, vec3_t normal, vec_t dist ){
 
 
 
+/*
+   PlaneHashCell()
+   quantises one plane value to its hash cell
+ */
+
+static int PlaneHashCell( vec_t value, vec_t cellSize ){
+	return (int) floor( value / cellSize );
+}
+
+
+
+/*
+   PlaneHashForCells()
+   mixes the distance and normal cells of a plane into a hash bucket
+ */
+
+static int PlaneHashForCells( int dist, int n0, int n1, int n2 ){
+	unsigned int hash;
+
+
+	hash = (unsigned int) dist * 73856093u;
+	hash ^= (unsigned int) n0 * 19349663u;
+	hash ^= (unsigned int) n1 * 83492791u;
+	hash ^= (unsigned int) n2 * 2654435761u;
+	hash ^= hash >> 16;
+	return (int) ( hash & ( PLANE_HASHES - 1 ) );
+}
+
+
+
 /*
    AddPlaneToHash()
  */
@@ -93,10 +145,54 @@ void AddPlaneToHash( plane_t *p ){
 	int hash;
 
 
-	hash = ( PLANE_HASHES - 1 ) & (int) fabs( p->dist );
+	hash = PlaneHashForCells( PlaneHashCell( p->dist, PLANE_HASH_DIST ),
+							  PlaneHashCell( p->normal[ 0 ], PLANE_HASH_NORMAL ),
+							  PlaneHashCell( p->normal[ 1 ], PLANE_HASH_NORMAL ),
+							  PlaneHashCell( p->normal[ 2 ], PLANE_HASH_NORMAL ) );
 
 	p->hash_chain = planehash[hash];
-	planehash[hash] = p - mapplanes + 1;
+	PlaneHashStore( planehash[hash], (int) ( p - mapplanes + 1 ) );
+}
+
+
+
+/*
+   GrowMapPlanes()
+   like AUTOEXPAND_BY_REALLOC, but the old array is kept around while threads
+   are running, as they may be searching it without holding the lock
+ */
+
+static void GrowMapPlanes( int reqitem ){
+	plane_t     *planes;
+	int allocated, i;
+
+
+	allocated = allocatedmapplanes ? allocatedmapplanes : 1024;
+	while ( reqitem >= allocated )
+		allocated *= 2;
+	if ( allocated > 2147483647 / (int) sizeof( *mapplanes ) ) {
+		Error( "mapplanes over 2 GB" );
+	}
+
+	planes = safe_malloc( allocated * sizeof( *planes ) );
+	if ( nummapplanes > 0 ) {
+		memcpy( planes, mapplanes, nummapplanes * sizeof( *planes ) );
+	}
+
+	if ( threaded ) {
+		AUTOEXPAND_BY_REALLOC( retiredPlanes, numRetiredPlanes, allocatedRetiredPlanes, 16 );
+		retiredPlanes[ numRetiredPlanes++ ] = mapplanes;
+	}
+	else
+	{
+		free( mapplanes );
+		for ( i = 0; i < numRetiredPlanes; i++ )
+			free( retiredPlanes[ i ] );
+		numRetiredPlanes = 0;
+	}
+
+	PlaneHashStore( mapplanes, planes );
+	allocatedmapplanes = allocated;
 }
 
 /*
@@ -113,7 +209,9 @@ int CreateNewFloatPlane( vec3_t normal, vec_t dist ){
 	}
 
 	// create a new plane
-	AUTOEXPAND_BY_REALLOC( mapplanes, nummapplanes + 1, allocatedmapplanes, 1024 );
+	if ( nummapplanes + 1 >= allocatedmapplanes ) {
+		GrowMapPlanes( nummapplanes + 1 );
+	}
 
 	p = &mapplanes[nummapplanes];
 	VectorCopy( normal, p->normal );
@@ -308,46 +406,57 @@ void SnapPlaneImproved( vec3_t normal, vec_t *dist, int numPoints, const vec3_t
 
 
 /*
-   FindFloatPlane()
-   ydnar: changed to allow a number of test points to be supplied that
-   must be within an epsilon distance of the plane
- */
+   FindHashedPlane()
+   searches every hash cell within epsilon of the plane, returns -1 if there is no match;
+   safe to call from several threads while another one adds planes
 
-int FindFloatPlane( vec3_t innormal, vec_t dist, int numPoints, vec3_t *points ) // NOTE: this has a side effect on the normal. Good or bad?
+   when several planes match, the one the old distance-only hash would have found first
+   wins (lowest of the buckets dist - 1, dist, dist + 1, then the newest plane), so the
+   plane numbering doesn't change
+ */
 
-#ifdef USE_HASHING
+static int FindHashedPlane( vec3_t normal, vec_t dist, int numPoints, vec3_t *points ){
+	int j, k, d, n0, n1, n2, h;
+	int pidx, bucket, rank, best, bestRank;
+	int mins[ 4 ], maxs[ 4 ];
+	plane_t *planes, *p;
+	vec_t dd;
 
-{
-	int i, j, hash, h;
-	int pidx;
-	plane_t *p;
-	vec_t d;
-	vec3_t normal;
 
-	VectorCopy( innormal, normal );
-#if Q3MAP2_EXPERIMENTAL_SNAP_PLANE_FIX
-	SnapPlaneImproved( normal, &dist, numPoints, (const vec3_t *) points );
-#else
-	SnapPlane( normal, &dist );
-#endif
-	/* hash the plane */
-	hash = ( PLANE_HASHES - 1 ) & (int) fabs( dist );
+	/* get the cell ranges within epsilon */
+	mins[ 0 ] = PlaneHashCell( dist - distanceEpsilon, PLANE_HASH_DIST );
+	maxs[ 0 ] = PlaneHashCell( dist + distanceEpsilon, PLANE_HASH_DIST );
+	for ( k = 0; k < 3; k++ )
+	{
+		mins[ k + 1 ] = PlaneHashCell( normal[ k ] - normalEpsilon, PLANE_HASH_NORMAL );
+		maxs[ k + 1 ] = PlaneHashCell( normal[ k ] + normalEpsilon, PLANE_HASH_NORMAL );
+	}
+	bucket = ( PLANE_DIST_BUCKETS - 1 ) & (int) fabs( dist );
 
-	/* search the border bins as well */
-	for ( i = -1; i <= 1; i++ )
+	best = -1;
+	bestRank = 3;
+	for ( d = mins[ 0 ]; d <= maxs[ 0 ]; d++ )
+	for ( n0 = mins[ 1 ]; n0 <= maxs[ 1 ]; n0++ )
+	for ( n1 = mins[ 2 ]; n1 <= maxs[ 2 ]; n1++ )
+	for ( n2 = mins[ 3 ]; n2 <= maxs[ 3 ]; n2++ )
 	{
-		h = ( hash + i ) & ( PLANE_HASHES - 1 );
-		for ( pidx = planehash[ h ] - 1; pidx != -1; pidx = mapplanes[pidx].hash_chain - 1 )
+		h = PlaneHashForCells( d, n0, n1, n2 );
+		pidx = PlaneHashLoad( planehash[ h ] ) - 1;
+		planes = PlaneHashLoad( mapplanes );
+		for ( ; pidx != -1; pidx = planes[ pidx ].hash_chain - 1 )
 		{
-			p = &mapplanes[pidx];
+			p = &planes[ pidx ];
 
 			/* do standard plane compare */
 			if ( !PlaneEqual( p, normal, dist ) ) {
 				continue;
 			}
 
-			/* ydnar: uncomment the following line for old-style plane finding */
-			//%	return p - mapplanes;
+			/* only planes the old hash would have seen, in its order */
+			rank = ( ( ( PLANE_DIST_BUCKETS - 1 ) & (int) fabs( p->dist ) ) - bucket + 1 ) & ( PLANE_DIST_BUCKETS - 1 );
+			if ( rank > 2 || rank > bestRank || ( rank == bestRank && pidx < best ) ) {
+				continue;
+			}
 
 			/* ydnar: test supplied points against this plane */
 			for ( j = 0; j < numPoints; j++ )
@@ -357,22 +466,64 @@ int FindFloatPlane( vec3_t innormal, vec_t dist, int numPoints, vec3_t *points )
 				// very small when world coordinates extend to 2^16.  Making the
 				// dot product here in 64 bit land will not really help the situation
 				// because the error will already be carried in dist.
-				d = DotProduct( points[ j ], p->normal ) - p->dist;
-				d = fabs( d );
-				if ( d != 0.0 && d >= distanceEpsilon ) {
+				dd = DotProduct( points[ j ], p->normal ) - p->dist;
+				dd = fabs( dd );
+				if ( dd != 0.0 && dd >= distanceEpsilon ) {
 					break; // Point is too far from plane.
 				}
 			}
 
 			/* found a matching plane */
 			if ( j >= numPoints ) {
-				return p - mapplanes;
+				best = pidx;
+				bestRank = rank;
 			}
 		}
 	}
 
-	/* none found, so create a new one */
-	return CreateNewFloatPlane( normal, dist );
+	return best;
+}
+
+
+
+/*
+   FindFloatPlane()
+   ydnar: changed to allow a number of test points to be supplied that
+   must be within an epsilon distance of the plane
+ */
+
+int FindFloatPlane( vec3_t innormal, vec_t dist, int numPoints, vec3_t *points ) // NOTE: this has a side effect on the normal. Good or bad?
+
+#ifdef USE_HASHING
+
+{
+	int i;
+	vec3_t normal;
+
+	VectorCopy( innormal, normal );
+#if Q3MAP2_EXPERIMENTAL_SNAP_PLANE_FIX
+	SnapPlaneImproved( normal, &dist, numPoints, (const vec3_t *) points );
+#else
+	SnapPlane( normal, &dist );
+#endif
+
+	/* planes are never changed once hashed, so look without locking first */
+	i = FindHashedPlane( normal, dist, numPoints, points );
+	if ( i >= 0 ) {
+		return i;
+	}
+
+	/* another thread may have added it meanwhile, so look again while holding the lock */
+	ThreadLock();
+	if ( threaded ) {
+		i = FindHashedPlane( normal, dist, numPoints, points );
+	}
+	if ( i < 0 ) {
+		/* none found, so create a new one */
+		i = CreateNewFloatPlane( normal, dist );
+	}
+	ThreadUnlock();
+	return i;
 }
 
 #else
@@ -1864,6 +2015,7 @@ void LoadMapFile( char *filename, qboolean onlyLights, qboolean noCollapseGroups
 
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- LoadMapFile ---\n" );
+	ProfileBegin( "LoadMapFile" );
 	Sys_Printf( "Loading %s\n", filename );
 
 	/* hack */
@@ -1931,4 +2083,6 @@ void LoadMapFile( char *filename, qboolean onlyLights, qboolean noCollapseGroups
 			WriteBSPBrushMap( "fakemap.map", entities[ 0 ].brushes );
 		}
 	}
+
+	ProfileEnd();
 }
@@ -825,3 +825,186 @@ mesh_t *SubdivideMeshQuads( mesh_t *in, float minLength, int maxsize, int *width
 
 	return CopyMesh( &out );
 }
+
+
+
+/*
+   tesselation cache - the bsp, meta, decal and light stages tesselate the
+   same patches with the same iterations over and over, so the fitted mesh is
+   kept, keyed by the control points and the iteration count
+ */
+
+#define MESH_CACHE_HASH     4096
+
+typedef struct meshCache_s
+{
+	struct meshCache_s  *next;
+	unsigned int hash;
+	int width, height, iterations;
+	bspDrawVert_t       *control;
+	mesh_t              *mesh;
+}
+meshCache_t;
+
+static meshCache_t      *meshCache[ MESH_CACHE_HASH ];
+static int numMeshCacheHits, numMeshCacheMisses;
+
+
+
+/*
+   MeshCacheHash()
+   hashes the control points and iterations of a patch
+ */
+
+static unsigned int MeshCacheHash( mesh_t *in, int iterations ){
+	unsigned int hash;
+	const byte      *b;
+	int i, size;
+
+
+	hash = 2166136261u;
+	hash = ( hash ^ in->width ) * 16777619u;
+	hash = ( hash ^ in->height ) * 16777619u;
+	hash = ( hash ^ iterations ) * 16777619u;
+	b = (const byte*) in->verts;
+	size = in->width * in->height * sizeof( *in->verts );
+	for ( i = 0; i < size; i++ )
+		hash = ( hash ^ b[ i ] ) * 16777619u;
+	return hash;
+}
+
+
+
+/*
+   FindMeshCache()
+   returns the cached tesselation of a patch or NULL, call with the thread lock held
+ */
+
+static meshCache_t *FindMeshCache( mesh_t *in, int iterations, unsigned int hash ){
+	meshCache_t     *mc;
+
+
+	for ( mc = meshCache[ hash & ( MESH_CACHE_HASH - 1 ) ]; mc != NULL; mc = mc->next )
+	{
+		if ( mc->hash == hash && mc->width == in->width && mc->height == in->height && mc->iterations == iterations &&
+			 !memcmp( mc->control, in->verts, in->width * in->height * sizeof( *in->verts ) ) ) {
+			return mc;
+		}
+	}
+	return NULL;
+}
+
+
+
+/*
+   CacheTesselatedMeshEntry()
+   subdivides a patch, fits it to the curve and removes colinear rows/columns,
+   unless that was already done with the same control points and iterations.
+   returns the cache entry, safe to call from all threads
+ */
+
+static meshCache_t *CacheTesselatedMeshEntry( mesh_t in, int iterations ){
+	unsigned int hash;
+	meshCache_t     *mc, *old;
+	mesh_t          *subdivided;
+
+
+	/* look it up */
+	hash = MeshCacheHash( &in, iterations );
+	ThreadLock();
+	mc = FindMeshCache( &in, iterations, hash );
+	if ( mc != NULL ) {
+		numMeshCacheHits++;
+	}
+	ThreadUnlock();
+	if ( mc != NULL ) {
+		return mc;
+	}
+
+	/* tesselate it outside of the lock */
+	mc = safe_malloc( sizeof( *mc ) );
+	mc->hash = hash;
+	mc->width = in.width;
+	mc->height = in.height;
+	mc->iterations = iterations;
+	mc->control = safe_malloc( in.width * in.height * sizeof( *in.verts ) );
+	memcpy( mc->control, in.verts, in.width * in.height * sizeof( *in.verts ) );
+	subdivided = SubdivideMesh2( in, iterations );
+	PutMeshOnCurve( *subdivided );
+	mc->mesh = RemoveLinearMeshColumnsRows( subdivided );
+	FreeMesh( subdivided );
+
+	/* add it, unless another thread got there first */
+	ThreadLock();
+	old = FindMeshCache( &in, iterations, hash );
+	if ( old == NULL ) {
+		mc->next = meshCache[ hash & ( MESH_CACHE_HASH - 1 ) ];
+		meshCache[ hash & ( MESH_CACHE_HASH - 1 ) ] = mc;
+		numMeshCacheMisses++;
+	}
+	else{
+		numMeshCacheHits++;
+	}
+	ThreadUnlock();
+	if ( old != NULL ) {
+		FreeMesh( mc->mesh );
+		free( mc->control );
+		free( mc );
+		mc = old;
+	}
+	return mc;
+}
+
+
+
+/*
+   CacheTesselatedMesh()
+   tesselates a patch ahead of time so later TesselateMesh() calls only copy it,
+   safe to call from all threads
+ */
+
+void CacheTesselatedMesh( mesh_t in, int iterations ){
+	CacheTesselatedMeshEntry( in, iterations );
+}
+
+
+
+/*
+   TesselateMesh()
+   returns a copy of the subdivided patch fitted to the curve, with colinear
+   rows/columns removed, same as SubdivideMesh2() + PutMeshOnCurve() +
+   RemoveLinearMeshColumnsRows().  the caller frees it with FreeMesh()
+ */
+
+mesh_t *TesselateMesh( mesh_t in, int iterations ){
+	return CopyMesh( CacheTesselatedMeshEntry( in, iterations )->mesh );
+}
+
+
+
+/*
+   FreeMeshCache()
+   frees the tesselation cache
+ */
+
+void FreeMeshCache( void ){
+	int i;
+	meshCache_t     *mc, *next;
+
+
+	if ( numMeshCacheHits + numMeshCacheMisses > 0 ) {
+		Sys_FPrintf( SYS_VRB, "%9d patch tesselations, %d reused\n", numMeshCacheMisses, numMeshCacheHits );
+	}
+	for ( i = 0; i < MESH_CACHE_HASH; i++ )
+	{
+		for ( mc = meshCache[ i ]; mc != NULL; mc = next )
+		{
+			next = mc->next;
+			FreeMesh( mc->mesh );
+			free( mc->control );
+			free( mc );
+		}
+		meshCache[ i ] = NULL;
+	}
+	numMeshCacheHits = numMeshCacheMisses = 0;
+}
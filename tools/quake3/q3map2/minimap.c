@@ -46,6 +46,9 @@ typedef struct minimap_s
 	float *data1f;
 	float *sharpendata1f;
 	vec3_t mins, size;
+	int gridWidth, gridHeight;              /* brush footprints binned over mins/size */
+	float gridScale[2];
+	int *gridFirst, *gridBrushes;
 }
 minimap_t;
 
@@ -95,9 +98,31 @@ qboolean BrushIntersectionWithLine( bspBrush_t *brush, vec3_t start, vec3_t dir,
 	return in && out;
 }
 
+/*
+   MiniMapGridCell()
+   grid column (axis 0) or row (axis 1) of a coordinate, coordinates outside
+   the minimap go to the border cells so the lookup stays conservative
+ */
+
+static int MiniMapGridCell( float v, int axis ){
+	float f;
+	int size;
+
+
+	size = axis == 0 ? minimap.gridWidth : minimap.gridHeight;
+	f = ( v - minimap.mins[ axis ] ) * minimap.gridScale[ axis ];
+	if ( !( f >= 0 ) ) {
+		return 0;
+	}
+	if ( f >= size ) {
+		return size - 1;
+	}
+	return (int) f;
+}
+
 static float MiniMapSample( float x, float y ){
 	vec3_t org, dir;
-	int i, bi;
+	int i, bi, cell;
 	float t0, t1;
 	float samp;
 	bspBrush_t *b;
@@ -113,31 +138,30 @@ static float MiniMapSample( float x, float y ){
 
 	cnt = 0;
 	samp = 0;
-	for ( i = 0; i < minimap.model->numBSPBrushes; ++i )
+	cell = MiniMapGridCell( x, 0 ) + MiniMapGridCell( y, 1 ) * minimap.gridWidth;
+	for ( i = minimap.gridFirst[ cell ]; i < minimap.gridFirst[ cell + 1 ]; ++i )
 	{
-		bi = minimap.model->firstBSPBrush + i;
-		if ( opaqueBrushes[bi >> 3] & ( 1 << ( bi & 7 ) ) ) {
-			b = &bspBrushes[bi];
+		bi = minimap.gridBrushes[ i ];
+		b = &bspBrushes[bi];
 
-			// sort out mins/maxs of the brush
-			s = &bspBrushSides[b->firstSide];
-			if ( x < -bspPlanes[s[0].planeNum].dist ) {
-				continue;
-			}
-			if ( x > +bspPlanes[s[1].planeNum].dist ) {
-				continue;
-			}
-			if ( y < -bspPlanes[s[2].planeNum].dist ) {
-				continue;
-			}
-			if ( y > +bspPlanes[s[3].planeNum].dist ) {
-				continue;
-			}
+		// sort out mins/maxs of the brush
+		s = &bspBrushSides[b->firstSide];
+		if ( x < -bspPlanes[s[0].planeNum].dist ) {
+			continue;
+		}
+		if ( x > +bspPlanes[s[1].planeNum].dist ) {
+			continue;
+		}
+		if ( y < -bspPlanes[s[2].planeNum].dist ) {
+			continue;
+		}
+		if ( y > +bspPlanes[s[3].planeNum].dist ) {
+			continue;
+		}
 
-			if ( BrushIntersectionWithLine( b, org, dir, &t0, &t1 ) ) {
-				samp += t1 - t0;
-				++cnt;
-			}
+		if ( BrushIntersectionWithLine( b, org, dir, &t0, &t1 ) ) {
+			samp += t1 - t0;
+			++cnt;
 		}
 	}
 
@@ -331,6 +355,102 @@ void MiniMapSetupBrushes( void ){
 	// not all may be nodraw
 }
 
+
+
+/*
+   MiniMapSetupGrid()
+   bins the footprints of the opaque brushes into a 2d grid over the minimap,
+   so a sample only tests the brushes of its cell.  the brushes of a cell stay
+   in brush order, which keeps the sums (and the image) the same as testing
+   every brush
+ */
+
+#define MAX_MINIMAP_GRID            256
+#define MAX_MINIMAP_GRID_BRUSHES    ( 1 << 24 )
+
+static void MiniMapSetupGrid( void ){
+	int i, j, x, y, bi, size, numCells, total;
+	int mins[ 2 ], maxs[ 2 ];
+	bspBrush_t *b;
+	bspBrushSide_t *s;
+
+
+	/* about one brush per cell if they were spread out evenly */
+	size = (int) ceil( sqrt( (double) numOpaqueBrushes ) );
+	size = size < 1 ? 1 : size > MAX_MINIMAP_GRID ? MAX_MINIMAP_GRID : size;
+
+	for ( ;; )
+	{
+		minimap.gridWidth = size < minimap.width ? size : minimap.width;
+		minimap.gridHeight = size < minimap.height ? size : minimap.height;
+		minimap.gridWidth = minimap.gridWidth < 1 ? 1 : minimap.gridWidth;
+		minimap.gridHeight = minimap.gridHeight < 1 ? 1 : minimap.gridHeight;
+		minimap.gridScale[ 0 ] = minimap.size[ 0 ] > 0 ? minimap.gridWidth / minimap.size[ 0 ] : 0;
+		minimap.gridScale[ 1 ] = minimap.size[ 1 ] > 0 ? minimap.gridHeight / minimap.size[ 1 ] : 0;
+		numCells = minimap.gridWidth * minimap.gridHeight;
+
+		/* count */
+		minimap.gridFirst = safe_malloc( ( numCells + 1 ) * sizeof( *minimap.gridFirst ) );
+		memset( minimap.gridFirst, 0, ( numCells + 1 ) * sizeof( *minimap.gridFirst ) );
+		total = 0;
+		for ( i = 0; i < minimap.model->numBSPBrushes; ++i )
+		{
+			bi = minimap.model->firstBSPBrush + i;
+			if ( !( opaqueBrushes[bi >> 3] & ( 1 << ( bi & 7 ) ) ) ) {
+				continue;
+			}
+			b = &bspBrushes[bi];
+			s = &bspBrushSides[b->firstSide];
+			mins[ 0 ] = MiniMapGridCell( -bspPlanes[s[0].planeNum].dist, 0 );
+			maxs[ 0 ] = MiniMapGridCell( +bspPlanes[s[1].planeNum].dist, 0 );
+			mins[ 1 ] = MiniMapGridCell( -bspPlanes[s[2].planeNum].dist, 1 );
+			maxs[ 1 ] = MiniMapGridCell( +bspPlanes[s[3].planeNum].dist, 1 );
+			for ( y = mins[ 1 ]; y <= maxs[ 1 ]; y++ )
+				for ( x = mins[ 0 ]; x <= maxs[ 0 ]; x++ )
+					minimap.gridFirst[ x + y * minimap.gridWidth + 1 ]++;
+			total += ( maxs[ 0 ] - mins[ 0 ] + 1 ) * ( maxs[ 1 ] - mins[ 1 ] + 1 );
+		}
+
+		/* lots of big brushes, use coarser cells */
+		if ( total <= MAX_MINIMAP_GRID_BRUSHES || size == 1 ) {
+			break;
+		}
+		free( minimap.gridFirst );
+		size /= 2;
+	}
+
+	/* fill, brushes go in ascending order */
+	for ( i = 0; i < numCells; i++ )
+		minimap.gridFirst[ i + 1 ] += minimap.gridFirst[ i ];
+	minimap.gridBrushes = safe_malloc( ( total > 0 ? total : 1 ) * sizeof( *minimap.gridBrushes ) );
+	for ( i = 0; i < minimap.model->numBSPBrushes; ++i )
+	{
+		bi = minimap.model->firstBSPBrush + i;
+		if ( !( opaqueBrushes[bi >> 3] & ( 1 << ( bi & 7 ) ) ) ) {
+			continue;
+		}
+		b = &bspBrushes[bi];
+		s = &bspBrushSides[b->firstSide];
+		mins[ 0 ] = MiniMapGridCell( -bspPlanes[s[0].planeNum].dist, 0 );
+		maxs[ 0 ] = MiniMapGridCell( +bspPlanes[s[1].planeNum].dist, 0 );
+		mins[ 1 ] = MiniMapGridCell( -bspPlanes[s[2].planeNum].dist, 1 );
+		maxs[ 1 ] = MiniMapGridCell( +bspPlanes[s[3].planeNum].dist, 1 );
+		for ( y = mins[ 1 ]; y <= maxs[ 1 ]; y++ )
+			for ( x = mins[ 0 ]; x <= maxs[ 0 ]; x++ )
+			{
+				j = x + y * minimap.gridWidth;
+				minimap.gridBrushes[ minimap.gridFirst[ j ]++ ] = bi;
+			}
+	}
+
+	/* the fill moved every start to the next cell's */
+	for ( i = numCells; i > 0; i-- )
+		minimap.gridFirst[ i ] = minimap.gridFirst[ i - 1 ];
+	minimap.gridFirst[ 0 ] = 0;
+
+	Sys_FPrintf( SYS_VRB, "%9d x %d minimap grid, %d brush references\n", minimap.gridWidth, minimap.gridHeight, total );
+}
+
 qboolean MiniMapEvaluateSampleOffsets( int *bestj, int *bestk, float *bestval ){
 	float val, dx, dy;
 	int j, k;
@@ -625,6 +745,7 @@ int MiniMapBSPMain( int argc, char **argv ){
 	}
 
 	MiniMapSetupBrushes();
+	MiniMapSetupGrid();
 
 	if ( minimap.samples <= 1 ) {
 		Sys_Printf( "\n--- MiniMapNoSupersampling (%d) ---\n", minimap.height );
@@ -84,33 +84,87 @@ void PicoLoadFileFunc( const char *name, byte **buffer, int *bufSize ){
 
 
 
+/* name index over picoModels */
+#define MODEL_HASH_SIZE     256
+
+static int modelHashHead[ MODEL_HASH_SIZE ];
+static int modelHashNext[ MAX_MODELS ];
+
+
+
+/*
+   ModelHash()
+   hashes a model name and frame
+ */
+
+static int ModelHash( const char *name, int frame ){
+	unsigned int hash;
+
+
+	hash = frame;
+	for ( ; *name; name++ )
+		hash = hash * 31 + (unsigned char) *name;
+	return hash & ( MODEL_HASH_SIZE - 1 );
+}
+
+
+
+/*
+   ModelInit()
+   clears the model list until the first model is loaded
+ */
+
+static void ModelInit( void ){
+	if ( numPicoModels <= 0 ) {
+		memset( picoModels, 0, sizeof( picoModels ) );
+		memset( modelHashHead, 0xFF, sizeof( modelHashHead ) );
+	}
+}
+
+
+
+/*
+   FindModelNum()
+   returns the picoModels index of a loaded model or -1
+ */
+
+static int FindModelNum( const char *name, int frame ){
+	int i;
+
+
+	for ( i = modelHashHead[ ModelHash( name, frame ) ]; i >= 0; i = modelHashNext[ i ] )
+	{
+		if ( !strcmp( PicoGetModelName( picoModels[ i ] ), name ) &&
+			 PicoGetModelFrameNum( picoModels[ i ] ) == frame ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+
 /*
    FindModel() - ydnar
    finds an existing picoModel and returns a pointer to the picoModel_t struct or NULL if not found
  */
 
 picoModel_t *FindModel( const char *name, int frame ){
-	int i;
+	int num;
 
 
 	/* init */
-	if ( numPicoModels <= 0 ) {
-		memset( picoModels, 0, sizeof( picoModels ) );
-	}
+	ModelInit();
 
 	/* dummy check */
 	if ( name == NULL || name[ 0 ] == '\0' ) {
 		return NULL;
 	}
 
-	/* search list */
-	for ( i = 0; i < MAX_MODELS; i++ )
-	{
-		if ( picoModels[ i ] != NULL &&
-			 !strcmp( PicoGetModelName( picoModels[ i ] ), name ) &&
-			 PicoGetModelFrameNum( picoModels[ i ] ) == frame ) {
-			return picoModels[ i ];
-		}
+	/* search index */
+	num = FindModelNum( name, frame );
+	if ( num >= 0 ) {
+		return picoModels[ num ];
 	}
 
 	/* no matching picoModel found */
@@ -130,9 +184,7 @@ picoModel_t *LoadModel( const char *name, int frame ){
 
 
 	/* init */
-	if ( numPicoModels <= 0 ) {
-		memset( picoModels, 0, sizeof( picoModels ) );
-	}
+	ModelInit();
 
 	/* dummy check */
 	if ( name == NULL || name[ 0 ] == '\0' ) {
@@ -197,6 +249,9 @@ picoModel_t *LoadModel( const char *name, int frame ){
 	/* set count */
 	if ( *pm != NULL ) {
 		numPicoModels++;
+		i = ModelHash( PicoGetModelName( *pm ), PicoGetModelFrameNum( *pm ) );
+		modelHashNext[ pm - picoModels ] = modelHashHead[ i ];
+		modelHashHead[ i ] = pm - picoModels;
 	}
 
 	/* return the picoModel */
@@ -206,57 +261,64 @@ picoModel_t *LoadModel( const char *name, int frame ){
 
 
 /*
-   InsertModel() - ydnar
-   adds a picomodel into the bsp
+   LoadModelSkin()
+   parses a model's .skin file once, shared by every misc_model using that skin
  */
 
-void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap_t *remap, shaderInfo_t *celShader, int eNum, int castShadows, int recvShadows, int spawnFlags, float lightmapScale, int lightmapSampleSize, float shadeAngle ){
-	int i, j, s, numSurfaces;
-	m4x4_t identity, nTransform;
-	picoModel_t         *model;
-	picoShader_t        *shader;
-	picoSurface_t       *surface;
-	shaderInfo_t        *si;
-	mapDrawSurface_t    *ds;
-	bspDrawVert_t       *dv;
-	char                *picoShaderName;
-	char shaderName[ MAX_QPATH ];
-	picoVec_t           *xyz, *normal, *st;
-	byte                *color;
-	picoIndex_t         *indexes;
-	remap_t             *rm, *glob;
+typedef struct modelSkin_s
+{
+	struct modelSkin_s  *next;
+	char                *name;
+	int skin;
+	int skinFound;                      /* skin file that was loaded, -1 for none */
+	skinfile_t          *sf;
+}
+modelSkin_t;
+
+static modelSkin_t *modelSkins[ MODEL_HASH_SIZE ];
+
+static modelSkin_t *LoadModelSkin( const char *name, int skin ){
+	int hash, pos;
+	modelSkin_t         *ms;
 	skinfile_t          *sf, *sf2;
-	double normalEpsilon_save;
-	double distanceEpsilon_save;
 	char skinfilename[ MAX_QPATH ];
 	char                *skinfilecontent;
 	int skinfilesize;
 	char                *skinfileptr, *skinfilenextptr;
 
 
-	/* get model */
-	model = LoadModel( name, frame );
-	if ( model == NULL ) {
-		return;
+	/* already parsed? */
+	hash = ModelHash( name, skin );
+	for ( ms = modelSkins[ hash ]; ms != NULL; ms = ms->next )
+	{
+		if ( ms->skin == skin && !strcmp( ms->name, name ) ) {
+			return ms;
+		}
 	}
 
 	/* load skin file */
+	ms = safe_malloc( sizeof( *ms ) );
+	ms->name = safe_malloc( strlen( name ) + 1 );
+	strcpy( ms->name, name );
+	ms->skin = skin;
+	ms->skinFound = -1;
 	snprintf( skinfilename, sizeof( skinfilename ), "%s_%d.skin", name, skin );
 	skinfilename[sizeof( skinfilename ) - 1] = 0;
 	skinfilesize = vfsLoadFile( skinfilename, (void**) &skinfilecontent, 0 );
-	if ( skinfilesize < 0 && skin != 0 ) {
+	if ( skinfilesize >= 0 ) {
+		ms->skinFound = skin;
+	}
+	else if ( skin != 0 ) {
 		/* fallback to skin 0 if invalid */
 		snprintf( skinfilename, sizeof( skinfilename ), "%s_0.skin", name );
 		skinfilename[sizeof( skinfilename ) - 1] = 0;
 		skinfilesize = vfsLoadFile( skinfilename, (void**) &skinfilecontent, 0 );
 		if ( skinfilesize >= 0 ) {
-			Sys_Printf( "Skin %d of %s does not exist, using 0 instead\n", skin, name );
+			ms->skinFound = 0;
 		}
 	}
 	sf = NULL;
 	if ( skinfilesize >= 0 ) {
-		Sys_Printf( "Using skin %d of %s\n", skin, name );
-		int pos;
 		for ( skinfileptr = skinfilecontent; *skinfileptr; skinfileptr = skinfilenextptr )
 		{
 			// for fscanf
@@ -298,6 +360,122 @@ void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap
 		}
 		free( skinfilecontent );
 	}
+	ms->sf = sf;
+
+	/* link it */
+	ms->next = modelSkins[ hash ];
+	modelSkins[ hash ] = ms;
+	return ms;
+}
+
+
+
+/*
+   ModelSurfaceTemplate()
+   copies a model surface's vertexes and indexes once, so each misc_model
+   instance only has to transform them
+ */
+
+typedef struct modelSurfaceTemplate_s
+{
+	int numVerts, numIndexes;
+	bspDrawVert_t       *verts;         /* model space xyz and normal, st and color[ 0 ] as in the model */
+	int                 *indexes;
+	qboolean copied;
+	qboolean normalsFixed;
+}
+modelSurfaceTemplate_t;
+
+static modelSurfaceTemplate_t *modelSurfaceTemplates[ MAX_MODELS ];
+
+static modelSurfaceTemplate_t *ModelSurfaceTemplate( picoModel_t *model, int s ){
+	int i, num, numSurfaces;
+	modelSurfaceTemplate_t  *mst;
+	picoSurface_t           *surface;
+	bspDrawVert_t           *tv;
+	picoIndex_t             *indexes;
+
+
+	/* first instance of this model? */
+	num = FindModelNum( PicoGetModelName( model ), PicoGetModelFrameNum( model ) );
+	if ( modelSurfaceTemplates[ num ] == NULL ) {
+		numSurfaces = PicoGetModelNumSurfaces( model );
+		modelSurfaceTemplates[ num ] = safe_malloc( numSurfaces * sizeof( modelSurfaceTemplate_t ) );
+		memset( modelSurfaceTemplates[ num ], 0, numSurfaces * sizeof( modelSurfaceTemplate_t ) );
+	}
+	mst = &modelSurfaceTemplates[ num ][ s ];
+	if ( mst->copied ) {
+		return mst;
+	}
+	mst->copied = qtrue;
+
+	/* copy vertexes */
+	surface = PicoGetModelSurface( model, s );
+	mst->numVerts = PicoGetSurfaceNumVertexes( surface );
+	mst->verts = safe_malloc( mst->numVerts * sizeof( mst->verts[ 0 ] ) );
+	memset( mst->verts, 0, mst->numVerts * sizeof( mst->verts[ 0 ] ) );
+	for ( i = 0; i < mst->numVerts; i++ )
+	{
+		tv = &mst->verts[ i ];
+		VectorCopy( PicoGetSurfaceXYZ( surface, i ), tv->xyz );
+		VectorCopy( PicoGetSurfaceNormal( surface, i ), tv->normal );
+		tv->st[ 0 ] = PicoGetSurfaceST( surface, 0, i )[ 0 ];
+		tv->st[ 1 ] = PicoGetSurfaceST( surface, 0, i )[ 1 ];
+		memcpy( tv->color[ 0 ], PicoGetSurfaceColor( surface, 0, i ), 4 );
+	}
+
+	/* copy indexes */
+	mst->numIndexes = PicoGetSurfaceNumIndexes( surface );
+	mst->indexes = safe_malloc( mst->numIndexes * sizeof( mst->indexes[ 0 ] ) );
+	indexes = PicoGetSurfaceIndexes( surface, 0 );
+	for ( i = 0; i < mst->numIndexes; i++ )
+		mst->indexes[ i ] = indexes[ i ];
+
+	return mst;
+}
+
+
+
+/*
+   InsertModel() - ydnar
+   adds a picomodel into the bsp
+ */
+
+void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap_t *remap, shaderInfo_t *celShader, int eNum, int castShadows, int recvShadows, int spawnFlags, float lightmapScale, int lightmapSampleSize, float shadeAngle ){
+	int i, j, s, numSurfaces;
+	m4x4_t identity, nTransform;
+	picoModel_t         *model;
+	picoShader_t        *shader;
+	picoSurface_t       *surface;
+	shaderInfo_t        *si;
+	mapDrawSurface_t    *ds;
+	bspDrawVert_t       *dv;
+	char                *picoShaderName;
+	char shaderName[ MAX_QPATH ];
+	remap_t             *rm, *glob;
+	skinfile_t          *sf, *sf2;
+	modelSkin_t         *ms;
+	modelSurfaceTemplate_t  *mst;
+	bspDrawVert_t       *tv;
+	double normalEpsilon_save;
+	double distanceEpsilon_save;
+
+
+	/* get model */
+	model = LoadModel( name, frame );
+	if ( model == NULL ) {
+		return;
+	}
+
+	/* get skin */
+	ms = LoadModelSkin( name, skin );
+	if ( ms->skinFound >= 0 ) {
+		if ( ms->skinFound != skin ) {
+			Sys_Printf( "Skin %d of %s does not exist, using 0 instead\n", skin, name );
+		}
+		Sys_Printf( "Using skin %d of %s\n", skin, name );
+	}
+	sf = ms->sf;
 
 	/* handle null matrix */
 	if ( transform == NULL ) {
@@ -419,9 +597,13 @@ void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap
 			ds->type = SURFACE_FORCED_META;
 		}
 
-		/* fix the surface's normals (jal: conditioned by shader info) */
-		if ( !( spawnFlags & 64 ) && ( shadeAngle == 0.0f || ds->type != SURFACE_FORCED_META ) ) {
+		/* fix the surface's normals (jal: conditioned by shader info), fixing them again changes nothing */
+		mst = ModelSurfaceTemplate( model, s );
+		if ( !( spawnFlags & 64 ) && ( shadeAngle == 0.0f || ds->type != SURFACE_FORCED_META ) && !mst->normalsFixed ) {
 			PicoFixSurfaceNormals( surface );
+			for ( i = 0; i < mst->numVerts; i++ )
+				VectorCopy( PicoGetSurfaceNormal( surface, i ), mst->verts[ i ].normal );
+			mst->normalsFixed = qtrue;
 		}
 
 		/* set sample size */
@@ -440,27 +622,26 @@ void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap
 		}
 
 		/* set particulars */
-		ds->numVerts = PicoGetSurfaceNumVertexes( surface );
+		ds->numVerts = mst->numVerts;
 		ds->verts = safe_malloc( ds->numVerts * sizeof( ds->verts[ 0 ] ) );
 		memset( ds->verts, 0, ds->numVerts * sizeof( ds->verts[ 0 ] ) );
 
-		ds->numIndexes = PicoGetSurfaceNumIndexes( surface );
+		ds->numIndexes = mst->numIndexes;
 		ds->indexes = safe_malloc( ds->numIndexes * sizeof( ds->indexes[ 0 ] ) );
-		memset( ds->indexes, 0, ds->numIndexes * sizeof( ds->indexes[ 0 ] ) );
+		memcpy( ds->indexes, mst->indexes, ds->numIndexes * sizeof( ds->indexes[ 0 ] ) );
 
-		/* copy vertexes */
+		/* transform vertexes */
 		for ( i = 0; i < ds->numVerts; i++ )
 		{
 			/* get vertex */
 			dv = &ds->verts[ i ];
+			tv = &mst->verts[ i ];
 
 			/* xyz and normal */
-			xyz = PicoGetSurfaceXYZ( surface, i );
-			VectorCopy( xyz, dv->xyz );
+			VectorCopy( tv->xyz, dv->xyz );
 			m4x4_transform_point( transform, dv->xyz );
 
-			normal = PicoGetSurfaceNormal( surface, i );
-			VectorCopy( normal, dv->normal );
+			VectorCopy( tv->normal, dv->normal );
 			m4x4_transform_normal( nTransform, dv->normal );
 			VectorNormalize( dv->normal, dv->normal );
 
@@ -480,13 +661,11 @@ void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap
 			/* normal texture coordinates */
 			else
 			{
-				st = PicoGetSurfaceST( surface, 0, i );
-				dv->st[ 0 ] = st[ 0 ];
-				dv->st[ 1 ] = st[ 1 ];
+				dv->st[ 0 ] = tv->st[ 0 ];
+				dv->st[ 1 ] = tv->st[ 1 ];
 			}
 
 			/* set lightmap/color bits */
-			color = PicoGetSurfaceColor( surface, 0, i );
 			for ( j = 0; j < MAX_LIGHTMAPS; j++ )
 			{
 				dv->lightmap[ j ][ 0 ] = 0.0f;
@@ -495,23 +674,18 @@ void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap
 					dv->color[ j ][ 0 ] = 255.0f;
 					dv->color[ j ][ 1 ] = 255.0f;
 					dv->color[ j ][ 2 ] = 255.0f;
-					dv->color[ j ][ 3 ] = RGBTOGRAY( color );
+					dv->color[ j ][ 3 ] = RGBTOGRAY( tv->color[ 0 ] );
 				}
 				else
 				{
-					dv->color[ j ][ 0 ] = color[ 0 ];
-					dv->color[ j ][ 1 ] = color[ 1 ];
-					dv->color[ j ][ 2 ] = color[ 2 ];
-					dv->color[ j ][ 3 ] = color[ 3 ];
+					dv->color[ j ][ 0 ] = tv->color[ 0 ][ 0 ];
+					dv->color[ j ][ 1 ] = tv->color[ 0 ][ 1 ];
+					dv->color[ j ][ 2 ] = tv->color[ 0 ][ 2 ];
+					dv->color[ j ][ 3 ] = tv->color[ 0 ][ 3 ];
 				}
 			}
 		}
 
-		/* copy indexes */
-		indexes = PicoGetSurfaceIndexes( surface, 0 );
-		for ( i = 0; i < ds->numIndexes; i++ )
-			ds->indexes[ i ] = indexes[ i ];
-
 		/* set cel shader */
 		ds->celShader = celShader;
 
@@ -655,7 +829,7 @@ void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap
 					}
 					else
 					{
-						free( buildBrush );
+						FreeBrush( buildBrush );
 						continue;
 					}
 
@@ -671,7 +845,7 @@ void InsertModel( const char *name, int skin, int frame, m4x4_t transform, remap
 						entities[ mapEntityNum ].numBrushes++;
 					}
 					else{
-						free( buildBrush );
+						FreeBrush( buildBrush );
 					}
 				}
 			}
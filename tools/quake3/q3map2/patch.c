@@ -411,6 +411,192 @@ static void GrowGroup_r( parseMesh_t *pm, int patchNum, int patchCount, parseMes
 }
 
 
+/*
+   PatchBorders
+   the bordering matrix of an entity's patches, rows are filled on separate threads
+ */
+
+typedef struct patchBorders_s
+{
+	int patchCount;
+	parseMesh_t         **meshes;
+	byte                *bordering;
+}
+patchBorders_t;
+
+static patchBorders_t   *patchBorders;      /* indexed by entity number */
+static int numPatchBorderRows;
+static int              *patchBorderRows;   /* work number -> entity number, first row of each entity */
+
+
+
+/*
+   AllocPatchBorders()
+   collects the patches of an entity, returns the number found
+ */
+
+static int AllocPatchBorders( entity_t *e, patchBorders_t *pb ){
+	parseMesh_t *pm;
+	int i;
+
+
+	pb->patchCount = 0;
+	for ( pm = e->patches; pm; pm = pm->next )
+		pb->patchCount++;
+	if ( pb->patchCount == 0 ) {
+		return 0;
+	}
+
+	pb->meshes = safe_malloc( pb->patchCount * sizeof( *pb->meshes ) );
+	for ( i = 0, pm = e->patches; pm; pm = pm->next, i++ )
+		pb->meshes[ i ] = pm;
+
+	pb->bordering = safe_malloc( pb->patchCount * pb->patchCount );
+	memset( pb->bordering, 0, pb->patchCount * pb->patchCount );
+
+	return pb->patchCount;
+}
+
+
+
+/*
+   FindPatchBorderRow()
+   tests patch k against the patches after it, writing row k and column k of the bordering matrix
+ */
+
+static void FindPatchBorderRow( patchBorders_t *pb, int k ){
+	int i, j, l, c1, c2;
+	parseMesh_t             *check, *scan;
+	bspDrawVert_t           *v1, *v2;
+	int patchCount = pb->patchCount;
+	byte                    *bordering = pb->bordering;
+
+
+	bordering[k * patchCount + k] = 1;
+
+	for ( l = k + 1 ; l < patchCount ; l++ ) {
+		check = pb->meshes[k];
+		scan = pb->meshes[l];
+		c1 = scan->mesh.width * scan->mesh.height;
+		v1 = scan->mesh.verts;
+
+		for ( i = 0 ; i < c1 ; i++, v1++ ) {
+			c2 = check->mesh.width * check->mesh.height;
+			v2 = check->mesh.verts;
+			for ( j = 0 ; j < c2 ; j++, v2++ ) {
+				if ( fabs( v1->xyz[0] - v2->xyz[0] ) < 1.0
+					 && fabs( v1->xyz[1] - v2->xyz[1] ) < 1.0
+					 && fabs( v1->xyz[2] - v2->xyz[2] ) < 1.0 ) {
+					break;
+				}
+			}
+			if ( j != c2 ) {
+				break;
+			}
+		}
+		if ( i != c1 ) {
+			// we have a connection
+			bordering[k * patchCount + l] =
+				bordering[l * patchCount + k] = 1;
+		}
+		else {
+			// no connection
+			bordering[k * patchCount + l] =
+				bordering[l * patchCount + k] = 0;
+		}
+
+	}
+}
+
+
+
+/*
+   FindPatchBorderRowThread()
+   maps a work number to an entity and row
+ */
+
+static void FindPatchBorderRowThread( int num ){
+	int lo, hi, mid;
+
+
+	/* binary search for the last entity starting at or before this row */
+	lo = 0;
+	hi = numEntities - 1;
+	while ( lo < hi )
+	{
+		mid = ( lo + hi + 1 ) / 2;
+		if ( patchBorderRows[ mid ] <= num ) {
+			lo = mid;
+		}
+		else{
+			hi = mid - 1;
+		}
+	}
+
+	FindPatchBorderRow( &patchBorders[ lo ], num - patchBorderRows[ lo ] );
+}
+
+
+
+/*
+   PatchMapBorders()
+   finds the bordering patches of every entity up front, spread over all threads,
+   instead of one entity at a time in PatchMapDrawSurfs()
+ */
+
+void PatchMapBorders( void ){
+	int i;
+
+
+	/* note it */
+	Sys_FPrintf( SYS_VRB, "--- PatchMapBorders ---\n" );
+
+	/* collect the patches of all entities */
+	patchBorders = safe_malloc( numEntities * sizeof( *patchBorders ) );
+	memset( patchBorders, 0, numEntities * sizeof( *patchBorders ) );
+	patchBorderRows = safe_malloc( numEntities * sizeof( *patchBorderRows ) );
+	numPatchBorderRows = 0;
+	for ( i = 0; i < numEntities; i++ )
+	{
+		patchBorderRows[ i ] = numPatchBorderRows;
+		numPatchBorderRows += AllocPatchBorders( &entities[ i ], &patchBorders[ i ] );
+	}
+
+	/* one row of one entity per work unit */
+	RunThreadsOnIndividual( numPatchBorderRows, qfalse, FindPatchBorderRowThread );
+
+	free( patchBorderRows );
+	patchBorderRows = NULL;
+	Sys_FPrintf( SYS_VRB, "%9d patches\n", numPatchBorderRows );
+}
+
+
+
+/*
+   FreePatchBorders()
+   releases whatever PatchMapDrawSurfs() didn't use
+ */
+
+void FreePatchBorders( void ){
+	int i;
+
+
+	if ( patchBorders == NULL ) {
+		return;
+	}
+	for ( i = 0; i < numEntities; i++ )
+	{
+		if ( patchBorders[ i ].patchCount > 0 ) {
+			free( patchBorders[ i ].meshes );
+			free( patchBorders[ i ].bordering );
+		}
+	}
+	free( patchBorders );
+	patchBorders = NULL;
+}
+
+
+
 /*
    PatchMapDrawSurfs()
    any patches that share an edge need to choose their
@@ -419,17 +605,17 @@ static void GrowGroup_r( parseMesh_t *pm, int patchNum, int patchCount, parseMes
  */
 
 void PatchMapDrawSurfs( entity_t *e ){
-	int i, j, k, l, c1, c2;
-	parseMesh_t             *pm;
+	int i, j, k, c1;
+	parseMesh_t             **meshes;
 	parseMesh_t             *check, *scan;
 	mapDrawSurface_t        *ds;
 	int patchCount, groupCount;
-	bspDrawVert_t           *v1, *v2;
+	bspDrawVert_t           *v1;
 	vec3_t bounds[ 2 ];
 	byte                    *bordering;
+	patchBorders_t pb;
 
 	/* ydnar: mac os x fails with these if not static */
-	MAC_STATIC parseMesh_t  *meshes[ MAX_MAP_DRAW_SURFS ];
 	MAC_STATIC qb_t grouped[ MAX_MAP_DRAW_SURFS ];
 	MAC_STATIC byte group[ MAX_MAP_DRAW_SURFS ];
 
@@ -437,55 +623,22 @@ void PatchMapDrawSurfs( entity_t *e ){
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- PatchMapDrawSurfs ---\n" );
 
-	patchCount = 0;
-	for ( pm = e->patches ; pm ; pm = pm->next  ) {
-		meshes[patchCount] = pm;
-		patchCount++;
+	/* use the bordering matrix from PatchMapBorders() or build it now */
+	if ( patchBorders != NULL && patchBorders[ e - entities ].patchCount > 0 ) {
+		pb = patchBorders[ e - entities ];
+		patchBorders[ e - entities ].patchCount = 0;
 	}
-
-	if ( !patchCount ) {
-		return;
-	}
-	bordering = safe_malloc( patchCount * patchCount );
-	memset( bordering, 0, patchCount * patchCount );
-
-	// build the bordering matrix
-	for ( k = 0 ; k < patchCount ; k++ ) {
-		bordering[k * patchCount + k] = 1;
-
-		for ( l = k + 1 ; l < patchCount ; l++ ) {
-			check = meshes[k];
-			scan = meshes[l];
-			c1 = scan->mesh.width * scan->mesh.height;
-			v1 = scan->mesh.verts;
-
-			for ( i = 0 ; i < c1 ; i++, v1++ ) {
-				c2 = check->mesh.width * check->mesh.height;
-				v2 = check->mesh.verts;
-				for ( j = 0 ; j < c2 ; j++, v2++ ) {
-					if ( fabs( v1->xyz[0] - v2->xyz[0] ) < 1.0
-						 && fabs( v1->xyz[1] - v2->xyz[1] ) < 1.0
-						 && fabs( v1->xyz[2] - v2->xyz[2] ) < 1.0 ) {
-						break;
-					}
-				}
-				if ( j != c2 ) {
-					break;
-				}
-			}
-			if ( i != c1 ) {
-				// we have a connection
-				bordering[k * patchCount + l] =
-					bordering[l * patchCount + k] = 1;
-			}
-			else {
-				// no connection
-				bordering[k * patchCount + l] =
-					bordering[l * patchCount + k] = 0;
-			}
-
+	else
+	{
+		if ( !AllocPatchBorders( e, &pb ) ) {
+			return;
 		}
+		for ( k = 0 ; k < pb.patchCount ; k++ )
+			FindPatchBorderRow( &pb, k );
 	}
+	patchCount = pb.patchCount;
+	meshes = pb.meshes;
+	bordering = pb.bordering;
 
 	/* build groups */
 	memset( grouped, 0, patchCount );
@@ -531,4 +684,7 @@ void PatchMapDrawSurfs( entity_t *e ){
 	/* emit some statistics */
 	Sys_FPrintf( SYS_VRB, "%9d patches\n", patchCount );
 	Sys_FPrintf( SYS_VRB, "%9d patch LOD groups\n", groupCount );
+
+	free( meshes );
+	free( bordering );
 }
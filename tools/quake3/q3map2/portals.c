@@ -47,6 +47,8 @@ int c_peak_portals;
 int c_boundary;
 int c_boundary_sides;
 
+static memPool_t portalPool = MEMPOOL( "portals", sizeof( portal_t ) );
+
 /*
    ===========
    AllocPortal
@@ -62,7 +64,7 @@ portal_t *AllocPortal( void ){
 		c_peak_portals = c_active_portals;
 	}
 
-	p = safe_malloc( sizeof( portal_t ) );
+	p = PoolAlloc( &portalPool );
 	memset( p, 0, sizeof( portal_t ) );
 
 	return p;
@@ -75,7 +77,7 @@ void FreePortal( portal_t *p ){
 	if ( numthreads == 1 ) {
 		c_active_portals--;
 	}
-	free( p );
+	PoolFree( &portalPool, p );
 }
 
 
@@ -555,8 +557,10 @@ void MakeTreePortals_r( node_t *node ){
  */
 void MakeTreePortals( tree_t *tree ){
 	Sys_FPrintf( SYS_VRB, "--- MakeTreePortals ---\n" );
+	ProfileBegin( "MakeTreePortals" );
 	MakeHeadnodePortals( tree );
 	MakeTreePortals_r( tree->headnode );
+	ProfileEnd();
 	Sys_FPrintf( SYS_VRB, "%9d tiny portals\n", c_tinyportals );
 	Sys_FPrintf( SYS_VRB, "%9d bad portals\n", c_badportals );  /* ydnar */
 }
@@ -0,0 +1,385 @@
+/* -------------------------------------------------------------------------------
+
+   Copyright (C) 1999-2007 id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+   ----------------------------------------------------------------------------------
+
+   This code has been altered significantly from its original form, to support
+   several games based on the Quake III Arena engine, in the form of "Q3Map2."
+
+   ------------------------------------------------------------------------------- */
+
+
+
+/* marker */
+#define PROFILE_C
+
+
+
+/* dependencies */
+#include "q3map2.h"
+
+#if GDEF_OS_WINDOWS
+	#include <windows.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+
+
+/* -------------------------------------------------------------------------------
+
+   -profile: timing and memory of the compile stages
+
+   scopes are opened and closed on the main thread, calls made while worker
+   threads are running are ignored.  the report is printed at exit and written
+   as a chrome trace (chrome://tracing, perfetto) with the numbers in the args
+
+   ------------------------------------------------------------------------------- */
+
+#define MAX_PROFILE_DEPTH   32
+
+typedef struct profileScope_s
+{
+	const char      *name;
+	int parent, depth;
+	double start, wall;                     /* seconds since ProfileInit */
+	double cpu;                             /* process cpu seconds, all threads */
+	double threadRun;                       /* wall seconds spent on worker threads */
+	double threadCPU[ MAX_THREADS ];
+	int mallocs;
+	double traces;                          /* light rays */
+	int peakRSS;                            /* KB, when the scope closed */
+}
+profileScope_t;
+
+static char profileFile[ 1024 ];
+static double profileStart;
+
+static profileScope_t *profileScopes;
+static int numProfileScopes, allocatedProfileScopes;
+static int profileStack[ MAX_PROFILE_DEPTH ], profileDepth, profileSkipped;
+
+
+
+/*
+   ProfileCPUTime()
+   cpu seconds used by the process so far
+ */
+
+static double ProfileCPUTime( void ){
+#if GDEF_OS_WINDOWS
+	FILETIME creation, exit, kernel, user;
+
+	if ( !GetProcessTimes( GetCurrentProcess(), &creation, &exit, &kernel, &user ) ) {
+		return 0.0;
+	}
+	return ( ( (ULONGLONG) kernel.dwHighDateTime << 32 | kernel.dwLowDateTime )
+			 + ( (ULONGLONG) user.dwHighDateTime << 32 | user.dwLowDateTime ) ) / 10000000.0;
+#else
+	struct rusage usage;
+
+	if ( getrusage( RUSAGE_SELF, &usage ) != 0 ) {
+		return 0.0;
+	}
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0
+		   + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+#endif
+}
+
+
+
+/*
+   ProfilePeakRSS()
+   peak resident set size in KB, 0 where it isn't available
+ */
+
+static int ProfilePeakRSS( void ){
+#if GDEF_OS_WINDOWS
+	return 0;
+#else
+	struct rusage usage;
+
+	if ( getrusage( RUSAGE_SELF, &usage ) != 0 ) {
+		return 0;
+	}
+#if GDEF_OS_MACOS
+	return usage.ru_maxrss / 1024;      /* bytes */
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+
+
+/*
+   ProfileInit()
+   starts profiling, the whole run becomes the root scope
+ */
+
+void ProfileInit( const char *filename ){
+	Q_strncpyz( profileFile, filename, sizeof( profileFile ) );
+	profileStart = I_PreciseTime();
+	countMallocs = qtrue;
+	ProfileBegin( "q3map2" );
+}
+
+
+
+/*
+   ProfileBegin()
+   opens a scope, the name must stay valid (use a literal)
+ */
+
+void ProfileBegin( const char *name ){
+	profileScope_t  *scope;
+	int i;
+
+
+	if ( profileFile[ 0 ] == '\0' || threaded ) {
+		return;
+	}
+	if ( profileDepth >= MAX_PROFILE_DEPTH ) {
+		profileSkipped++;
+		return;
+	}
+
+	AUTOEXPAND_BY_REALLOC( profileScopes, numProfileScopes, allocatedProfileScopes, 256 );
+	scope = &profileScopes[ numProfileScopes ];
+	scope->name = name;
+	scope->parent = profileDepth > 0 ? profileStack[ profileDepth - 1 ] : -1;
+	scope->depth = profileDepth;
+	profileStack[ profileDepth++ ] = numProfileScopes++;
+
+	/* the totals so far, ProfileEnd turns them into differences */
+	scope->start = I_PreciseTime() - profileStart;
+	scope->cpu = ProfileCPUTime();
+	scope->threadRun = threadRunTime;
+	for ( i = 0; i < MAX_THREADS; i++ )
+		scope->threadCPU[ i ] = threadCPUTime[ i ];
+	scope->mallocs = numMallocs;
+	scope->traces = TraceCount();
+}
+
+
+
+/*
+   ProfileEnd()
+   closes the innermost scope
+ */
+
+void ProfileEnd( void ){
+	profileScope_t  *scope;
+	int i;
+
+
+	if ( profileFile[ 0 ] == '\0' || threaded ) {
+		return;
+	}
+	if ( profileSkipped > 0 ) {
+		profileSkipped--;
+		return;
+	}
+	if ( profileDepth <= 0 ) {
+		return;
+	}
+
+	scope = &profileScopes[ profileStack[ --profileDepth ] ];
+	scope->wall = I_PreciseTime() - profileStart - scope->start;
+	scope->cpu = ProfileCPUTime() - scope->cpu;
+	scope->threadRun = threadRunTime - scope->threadRun;
+	for ( i = 0; i < MAX_THREADS; i++ )
+		scope->threadCPU[ i ] = threadCPUTime[ i ] - scope->threadCPU[ i ];
+	scope->mallocs = numMallocs - scope->mallocs;
+	scope->traces = TraceCount() - scope->traces;
+	scope->peakRSS = ProfilePeakRSS();
+}
+
+
+
+/*
+   ProfileUtilisation()
+   share of the worker threads' time they spent on the cpu, -1 if none ran
+ */
+
+static double ProfileUtilisation( double threadRun, const double *threadCPU ){
+	int i;
+	double cpu;
+
+
+	if ( threadRun <= 0.0 || numthreads < 2 ) {
+		return -1.0;
+	}
+	cpu = 0.0;
+	for ( i = 0; i < numthreads; i++ )
+		cpu += threadCPU[ i ];
+	return cpu / ( threadRun * numthreads );
+}
+
+
+
+/*
+   PrintProfile_r()
+   prints the scopes with the same name under the same parent as one line
+ */
+
+typedef struct profileSum_s
+{
+	const char      *name;
+	int parent, depth, count;
+	double wall, cpu, threadRun, traces;
+	double threadCPU[ MAX_THREADS ];
+	int mallocs, peakRSS;
+}
+profileSum_t;
+
+static void PrintProfile_r( profileSum_t *sums, int numSums, int parent ){
+	int i;
+	double util;
+	char utilString[ 16 ];
+	profileSum_t    *sum;
+
+
+	for ( i = 0; i < numSums; i++ )
+	{
+		sum = &sums[ i ];
+		if ( sum->parent != parent ) {
+			continue;
+		}
+
+		util = ProfileUtilisation( sum->threadRun, sum->threadCPU );
+		if ( util < 0.0 ) {
+			strcpy( utilString, "   -" );
+		}
+		else{
+			sprintf( utilString, "%3d%%", (int) ( util * 100.0 + 0.5 ) );
+		}
+		Sys_Printf( "%9.3f %9.3f %s %8d %9d %10.0f  %*s%s",
+					sum->wall, sum->cpu, utilString, sum->peakRSS / 1024, sum->mallocs, sum->traces,
+					sum->depth * 2, "", sum->name );
+		if ( sum->count > 1 ) {
+			Sys_Printf( " (x%d)", sum->count );
+		}
+		Sys_Printf( "\n" );
+
+		PrintProfile_r( sums, numSums, i );
+	}
+}
+
+
+
+/*
+   ProfileShutdown()
+   closes the open scopes, prints the report and writes the trace file
+ */
+
+void ProfileShutdown( void ){
+	int i, j, *sumOf;
+	double util;
+	FILE            *file;
+	profileScope_t  *scope;
+	profileSum_t    *sums, *sum;
+	int numSums;
+
+
+	if ( profileFile[ 0 ] == '\0' || threaded ) {
+		return;
+	}
+	profileSkipped = 0;
+	while ( profileDepth > 0 )
+		ProfileEnd();
+
+	/* sum up scopes by name and parent */
+	sums = safe_malloc( numProfileScopes * sizeof( *sums ) );
+	sumOf = safe_malloc( numProfileScopes * sizeof( *sumOf ) );
+	numSums = 0;
+	for ( i = 0; i < numProfileScopes; i++ )
+	{
+		scope = &profileScopes[ i ];
+		for ( j = 0; j < numSums; j++ )
+		{
+			if ( sums[ j ].parent == ( scope->parent < 0 ? -1 : sumOf[ scope->parent ] )
+				 && !strcmp( sums[ j ].name, scope->name ) ) {
+				break;
+			}
+		}
+		sum = &sums[ j ];
+		if ( j == numSums ) {
+			memset( sum, 0, sizeof( *sum ) );
+			sum->name = scope->name;
+			sum->parent = scope->parent < 0 ? -1 : sumOf[ scope->parent ];
+			sum->depth = scope->depth;
+			numSums++;
+		}
+		sumOf[ i ] = j;
+
+		sum->count++;
+		sum->wall += scope->wall;
+		sum->cpu += scope->cpu;
+		sum->threadRun += scope->threadRun;
+		for ( j = 0; j < MAX_THREADS; j++ )
+			sum->threadCPU[ j ] += scope->threadCPU[ j ];
+		sum->mallocs += scope->mallocs;
+		sum->traces += scope->traces;
+		if ( scope->peakRSS > sum->peakRSS ) {
+			sum->peakRSS = scope->peakRSS;
+		}
+	}
+
+	Sys_Printf( "--- Profile ---\n" );
+	Sys_Printf( "   wall s     cpu s util  peak MB   mallocs       rays  scope\n" );
+	PrintProfile_r( sums, numSums, -1 );
+	free( sums );
+	free( sumOf );
+
+	/* chrome trace, times in microseconds */
+	Sys_Printf( "Writing %s\n", profileFile );
+	file = fopen( profileFile, "w" );
+	if ( file == NULL ) {
+		Sys_FPrintf( SYS_WRN, "WARNING: Can't write profile %s\n", profileFile );
+		profileFile[ 0 ] = '\0';
+		return;
+	}
+	fprintf( file, "{\"traceEvents\":[\n" );
+	for ( i = 0; i < numProfileScopes; i++ )
+	{
+		scope = &profileScopes[ i ];
+		fprintf( file, "{\"name\":\"%s\",\"cat\":\"q3map2\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.0f,\"dur\":%.0f,"
+				 "\"args\":{\"cpu_ms\":%.3f,\"threads_ms\":%.3f,",
+				 scope->name, scope->start * 1000000.0, scope->wall * 1000000.0,
+				 scope->cpu * 1000.0, scope->threadRun * 1000.0 );
+		util = ProfileUtilisation( scope->threadRun, scope->threadCPU );
+		if ( util >= 0.0 ) {
+			fprintf( file, "\"utilisation\":%.3f,\"thread_cpu_ms\":[", util );
+			for ( j = 0; j < numthreads; j++ )
+				fprintf( file, "%s%.3f", j > 0 ? "," : "", scope->threadCPU[ j ] * 1000.0 );
+			fprintf( file, "]," );
+		}
+		fprintf( file, "\"mallocs\":%d,\"rays\":%.0f,\"peak_rss_kb\":%d}},\n", scope->mallocs, scope->traces, scope->peakRSS );
+		fprintf( file, "{\"name\":\"peak rss\",\"ph\":\"C\",\"pid\":1,\"ts\":%.0f,\"args\":{\"KB\":%d}},\n",
+				 ( scope->start + scope->wall ) * 1000000.0, scope->peakRSS );
+	}
+	fprintf( file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"q3map2 " Q3MAP_VERSION "\"}}\n" );
+	fprintf( file, "],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"version\":\"" Q3MAP_VERSION "\",\"threads\":%d}}\n", numthreads );
+	fclose( file );
+
+	profileFile[ 0 ] = '\0';
+}
@@ -55,6 +55,12 @@ int num_visclusters;                    // clusters the player can be in
 int num_visportals;
 int num_solidfaces;
 
+/* binary portal file (see prtfile.h) */
+int numPrtRecords, allocatedPrtRecords;
+prtFileRecord_t *prtRecords;
+int numPrtPoints, allocatedPrtPoints;
+float           *prtPoints;
+
 void WriteFloat( FILE *f, vec_t v ){
 	if ( fabs( v - Q_rint( v ) ) < 0.001 ) {
 		fprintf( f,"%i ",(int)Q_rint( v ) );
@@ -64,6 +70,57 @@ void WriteFloat( FILE *f, vec_t v ){
 	}
 }
 
+/*
+   EmitPortalWinding()
+   writes one portal or solid face either as a line of text or as a binary record
+ */
+
+void EmitPortalWinding( winding_t *w, qboolean reverse, int cluster0, int cluster1, int flags, qboolean face ){
+	int i, j;
+	prtFileRecord_t *r;
+
+	if ( binaryPortalFile ) {
+		AUTOEXPAND_BY_REALLOC( prtRecords, numPrtRecords, allocatedPrtRecords, 1024 );
+		r = &prtRecords[ numPrtRecords++ ];
+		r->numPoints = w->numpoints;
+		r->firstPoint = numPrtPoints;
+		r->clusters[ 0 ] = cluster0;
+		r->clusters[ 1 ] = face ? -1 : cluster1;
+		r->flags = flags;
+
+		AUTOEXPAND_BY_REALLOC( prtPoints, ( numPrtPoints + w->numpoints ) * 3, allocatedPrtPoints, 4096 );
+		for ( i = 0; i < w->numpoints; i++ )
+		{
+			j = reverse ? w->numpoints - 1 - i : i;
+			prtPoints[ numPrtPoints * 3 + 0 ] = w->p[ j ][ 0 ];
+			prtPoints[ numPrtPoints * 3 + 1 ] = w->p[ j ][ 1 ];
+			prtPoints[ numPrtPoints * 3 + 2 ] = w->p[ j ][ 2 ];
+			numPrtPoints++;
+		}
+		return;
+	}
+
+	if ( face ) {
+		fprintf( pf,"%i %i ",w->numpoints, cluster0 );
+	}
+	else
+	{
+		fprintf( pf,"%i %i %i ",w->numpoints, cluster0, cluster1 );
+		fprintf( pf, "%d ", flags );
+	}
+
+	for ( i = 0 ; i < w->numpoints ; i++ )
+	{
+		j = reverse ? w->numpoints - 1 - i : i;
+		fprintf( pf,"(" );
+		WriteFloat( pf, w->p[j][0] );
+		WriteFloat( pf, w->p[j][1] );
+		WriteFloat( pf, w->p[j][2] );
+		fprintf( pf,") " );
+	}
+	fprintf( pf,"\n" );
+}
+
 void CountVisportals_r( node_t *node ){
 	int s;
 	portal_t    *p;
@@ -102,7 +159,7 @@ void CountVisportals_r( node_t *node ){
    =================
  */
 void WritePortalFile_r( node_t *node ){
-	int i, s, flags;
+	int s, flags;
 	portal_t    *p;
 	winding_t   *w;
 	vec3_t normal;
@@ -139,13 +196,6 @@ void WritePortalFile_r( node_t *node ){
 			// FIXME: is this still relevent?
 			WindingPlane( w, normal, &dist );
 
-			if ( DotProduct( p->plane.normal, normal ) < 0.99 ) { // backwards...
-				fprintf( pf,"%i %i %i ",w->numpoints, p->nodes[1]->cluster, p->nodes[0]->cluster );
-			}
-			else{
-				fprintf( pf,"%i %i %i ",w->numpoints, p->nodes[0]->cluster, p->nodes[1]->cluster );
-			}
-
 			flags = 0;
 
 			/* ydnar: added this change to make antiportals work */
@@ -158,18 +208,13 @@ void WritePortalFile_r( node_t *node ){
 				flags |= 2;
 			}
 
-			fprintf( pf, "%d ", flags );
-
 			/* write the winding */
-			for ( i = 0 ; i < w->numpoints ; i++ )
-			{
-				fprintf( pf,"(" );
-				WriteFloat( pf, w->p[i][0] );
-				WriteFloat( pf, w->p[i][1] );
-				WriteFloat( pf, w->p[i][2] );
-				fprintf( pf,") " );
+			if ( DotProduct( p->plane.normal, normal ) < 0.99 ) { // backwards...
+				EmitPortalWinding( w, qfalse, p->nodes[1]->cluster, p->nodes[0]->cluster, flags, qfalse );
+			}
+			else{
+				EmitPortalWinding( w, qfalse, p->nodes[0]->cluster, p->nodes[1]->cluster, flags, qfalse );
 			}
-			fprintf( pf,"\n" );
 		}
 	}
 
@@ -215,7 +260,7 @@ void CountSolidFaces_r( node_t *node ){
    =================
  */
 void WriteFaceFile_r( node_t *node ){
-	int i, s;
+	int s;
 	portal_t    *p;
 	winding_t   *w;
 
@@ -244,29 +289,11 @@ void WriteFaceFile_r( node_t *node ){
 			// write out to the file
 
 			if ( p->nodes[0] == node ) {
-				fprintf( pf,"%i %i ",w->numpoints, p->nodes[0]->cluster );
-				for ( i = 0 ; i < w->numpoints ; i++ )
-				{
-					fprintf( pf,"(" );
-					WriteFloat( pf, w->p[i][0] );
-					WriteFloat( pf, w->p[i][1] );
-					WriteFloat( pf, w->p[i][2] );
-					fprintf( pf,") " );
-				}
-				fprintf( pf,"\n" );
+				EmitPortalWinding( w, qfalse, p->nodes[0]->cluster, -1, 0, qtrue );
 			}
 			else
 			{
-				fprintf( pf,"%i %i ",w->numpoints, p->nodes[1]->cluster );
-				for ( i = w->numpoints - 1; i >= 0; i-- )
-				{
-					fprintf( pf,"(" );
-					WriteFloat( pf, w->p[i][0] );
-					WriteFloat( pf, w->p[i][1] );
-					WriteFloat( pf, w->p[i][2] );
-					fprintf( pf,") " );
-				}
-				fprintf( pf,"\n" );
+				EmitPortalWinding( w, qtrue, p->nodes[1]->cluster, -1, 0, qtrue );
 			}
 		}
 	}
@@ -366,6 +393,75 @@ void NumberClusters( tree_t *tree ) {
 	Sys_FPrintf( SYS_VRB, "%9d solidfaces\n", num_solidfaces );
 }
 
+/*
+   ================
+   BuildPortalFileBinary
+   collects the portals and faces into a binary portal file in memory
+   ================
+ */
+static byte *BuildPortalFileBinary( tree_t *tree, int *size ){
+	prtFileHeader_t *header;
+	byte            *data, *body;
+	int numPortals, recordsSize, pointsSize;
+	qboolean binary;
+
+	// collect the records
+	binary = binaryPortalFile;
+	binaryPortalFile = qtrue;
+	numPrtRecords = 0;
+	numPrtPoints = 0;
+	numPortals = num_visportals;
+	WritePortalFile_r( tree->headnode );
+	WriteFaceFile_r( tree->headnode );
+	binaryPortalFile = binary;
+
+	recordsSize = numPrtRecords * sizeof( prtFileRecord_t );
+	pointsSize = numPrtPoints * 3 * sizeof( float );
+	*size = sizeof( *header ) + recordsSize + pointsSize;
+	data = safe_malloc( *size );
+	header = (prtFileHeader_t*) data;
+	body = data + sizeof( *header );
+	if ( recordsSize > 0 ) {
+		memcpy( body, prtRecords, recordsSize );
+	}
+	if ( pointsSize > 0 ) {
+		memcpy( body + recordsSize, prtPoints, pointsSize );
+	}
+	SwapBlock( (int*) body, recordsSize + pointsSize );
+
+	memset( header, 0, sizeof( *header ) );
+	memcpy( header->ident, PRTFILE_BINARY_IDENT, 4 );
+	header->version = LittleLong( PRTFILE_BINARY_VERSION );
+	header->numClusters = LittleLong( num_visclusters );
+	header->numPortals = LittleLong( numPortals );
+	header->numFaces = LittleLong( numPrtRecords - numPortals );
+	header->numPoints = LittleLong( numPrtPoints );
+	header->checksum = LittleLong( PrtFileChecksum( body, recordsSize + pointsSize ) );
+
+	return data;
+}
+
+/*
+   ================
+   WritePortalFileBinary
+   writes the portals and faces as a PRTB file
+   ================
+ */
+void WritePortalFileBinary( tree_t *tree, const char *portalFilePath ){
+	byte    *data;
+	int size;
+
+	data = BuildPortalFileBinary( tree, &size );
+
+	// write the file
+	Sys_Printf( "writing %s\n", portalFilePath );
+	pf = SafeOpenWrite( portalFilePath );
+	SafeWrite( pf, data, size );
+	fclose( pf );
+
+	free( data );
+}
+
 /*
    ================
    WritePortalFile
@@ -375,6 +471,20 @@ void WritePortalFile( tree_t *tree, const char *portalFilePath ){
 
 	Sys_FPrintf( SYS_VRB,"--- WritePortalFile ---\n" );
 
+	// keep the portals for the vis stage of the pipeline
+	if ( bspInMemory ) {
+		free( portalFileData );
+		portalFileData = BuildPortalFileBinary( tree, &portalFileSize );
+		if ( bspStageFollows && !saveIntermediate ) {
+			return;
+		}
+	}
+
+	if ( binaryPortalFile ) {
+		WritePortalFileBinary( tree, portalFilePath );
+		return;
+	}
+
 	// write the file
 	Sys_Printf( "writing %s\n", portalFilePath );
 	pf = fopen( portalFilePath, "w" );
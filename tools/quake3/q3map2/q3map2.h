@@ -77,10 +77,12 @@
 #include "polylib.h"
 #include "imagelib.h"
 #include "qthreads.h"
+#include "mempool.h"
 #include "inout.h"
 #include "vfs.h"
 #include "png.h"
 #include "md4.h"
+#include "prtfile.h"
 #include <stdlib.h>
 
 
@@ -1503,6 +1505,16 @@ typedef struct surfaceInfo_s
 }
 surfaceInfo_t;
 
+
+typedef struct textBuffer_s
+{
+	char                *text;
+	int length, allocated;
+}
+textBuffer_t;
+
+typedef void ( *textJobFunc_t )( textBuffer_t *buffer, int num );
+
 /* -------------------------------------------------------------------------------
 
    prototypes
@@ -1518,6 +1530,12 @@ char                        *Q_strncat( char *dst, size_t dlen, const char *src,
 /* help.c */
 void                        HelpMain(const char* arg);
 
+/* profile.c */
+void                        ProfileInit( const char *filename );
+void                        ProfileBegin( const char *name );
+void                        ProfileEnd( void );
+void                        ProfileShutdown( void );
+
 /* path_init.c */
 game_t                      *GetGame( char *arg );
 void                        InitPaths( int *argc, char **argv );
@@ -1558,6 +1576,15 @@ int                         ConvertBSPToASE( char *bspName );
 /* convert_obj.c */
 int                         ConvertBSPToOBJ( char *bspName );
 
+/* textbuffer.c */
+void                        TextAppend( textBuffer_t *buffer, const char *string );
+void                        TextAppendInt( textBuffer_t *buffer, int value );
+void                        TextAppendFloat( textBuffer_t *buffer, double value );
+void                        TextPrintf( textBuffer_t *buffer, const char *format, ... );
+void                        WriteTextBuffer( textBuffer_t *buffer, FILE *f );
+void                        FreeTextBuffer( textBuffer_t *buffer );
+void                        WriteTextJobs( FILE *f, int numJobs, textJobFunc_t func, qboolean showpacifier );
+
 /* brush.c */
 sideRef_t                   *AllocSideRef( side_t *side, sideRef_t *next );
 int                         CountBrushList( brush_t *brushes );
@@ -1581,6 +1608,7 @@ void                        SplitBrush( brush_t *brush, int planenum, brush_t **
 
 tree_t                      *AllocTree( void );
 node_t                      *AllocNode( void );
+void                        FreeNode( node_t *node );
 
 
 /* mesh.c */
@@ -1598,6 +1626,9 @@ mesh_t                      *SubdivideMeshQuads( mesh_t *in, float minLength, in
 mesh_t                      *RemoveLinearMeshColumnsRows( mesh_t *in );
 void                        MakeMeshNormals( mesh_t in );
 void                        PutMeshOnCurve( mesh_t in );
+void                        CacheTesselatedMesh( mesh_t in, int iterations );
+mesh_t                      *TesselateMesh( mesh_t in, int iterations );
+void                        FreeMeshCache( void );
 
 void                        MakeNormalVectors( vec3_t forward, vec3_t right, vec3_t up );
 
@@ -1663,6 +1694,8 @@ void                        FreeTreePortals_r( node_t *node );
 /* patch.c */
 void                        ParsePatch( qboolean onlyLights );
 mesh_t                      *SubdivideMesh( mesh_t in, float maxError, float minLength );
+void                        PatchMapBorders( void );
+void                        FreePatchBorders( void );
 void                        PatchMapDrawSurfs( entity_t *e );
 void                        TriangulatePatchSurface( entity_t *e, mapDrawSurface_t *ds );
 
@@ -1703,6 +1736,9 @@ qboolean                    CalcSurfaceTextureRange( mapDrawSurface_t *ds );
 qboolean                    CalcLightmapAxis( vec3_t normal, vec3_t axis );
 void                        ClassifySurfaces( int numSurfs, mapDrawSurface_t *ds );
 void                        ClassifyEntitySurfaces( entity_t *e );
+void                        SetupDrawSurfaceTree( entity_t *e );
+void                        FreeDrawSurfaceTree( void );
+int                         DrawSurfacesInBounds( vec3_t mins, vec3_t maxs, int first, int end, int **surfs, int *allocatedSurfs );
 void                        TidyEntitySurfaces( entity_t *e );
 mapDrawSurface_t            *CloneSurface( mapDrawSurface_t *src, shaderInfo_t *si );
 mapDrawSurface_t            *MakeCelSurface( mapDrawSurface_t *src, shaderInfo_t *si );
@@ -1725,10 +1761,13 @@ void                        EmitTriangleSurface( mapDrawSurface_t *ds );
 
 
 /* surface_fur.c */
+void                        OffsetFur( mapDrawSurface_t *ds );
 void                        Fur( mapDrawSurface_t *src );
 
 
 /* surface_foliage.c */
+void                        PrepareFoliage( int firstDrawSurf, int numDrawSurfs );
+void                        FreeFoliage( void );
 void                        Foliage( mapDrawSurface_t *src );
 
 
@@ -1800,6 +1839,7 @@ int                         LightMain( int argc, char **argv );
 void                        SetupTraceNodes( void );
 void                        TraceLine( trace_t *trace );
 float                       SetupTrace( trace_t *trace );
+double                      TraceCount( void );
 
 
 /* light_bounce.c */
@@ -1864,6 +1904,7 @@ int                         ExportEntitiesMain( int argc, char **argv );
 void                        ImageFree( image_t *image );
 image_t                     *ImageFind( const char *filename );
 image_t                     *ImageLoad( const char *filename );
+qboolean                    ImagePrefetch( const char *filename );
 
 
 /* shaders.c */
@@ -1884,6 +1925,7 @@ shaderInfo_t                *CustomShader( shaderInfo_t *si, char *find, char *r
 void                        EmitVertexRemapShader( char *from, char *to );
 
 void                        LoadShaderInfo( void );
+void                        PrefetchShaderImages( void );
 shaderInfo_t                *ShaderInfoForShader( const char *shader );
 shaderInfo_t                *ShaderInfoForShaderNull( const char *shader );
 
@@ -1898,6 +1940,10 @@ void                        BSPFilesCleanup();
 
 void                        SwapBlock( int *block, int size );
 
+void                        *LoadBSPFileData( const char *filename, int *length );
+void                        FreeBSPFileData( void *data, int length );
+void                        CheckLumps( bspHeader_t *header, int numLumps, int length );
+
 int                         GetLumpElements( bspHeader_t *header, int lump, int size );
 void                        *GetLump( bspHeader_t *header, int lump );
 int                         CopyLump( bspHeader_t *header, int lump, void *dest, int size );
@@ -1906,6 +1952,7 @@ void                        AddLump( FILE *file, bspHeader_t *header, int lumpNu
 
 void                        LoadBSPFile( const char *filename );
 void                        WriteBSPFile( const char *filename );
+void                        ConformBSPData( void );
 void                        PrintBSPFileSizes( void );
 
 epair_t                     *ParseEPair( void );
@@ -1927,6 +1974,7 @@ void InjectCommandLine( char **argv, int beginArgs, int endArgs );
 /* bspfile_ibsp.c */
 void                        LoadIBSPFile( const char *filename );
 void                        WriteIBSPFile( const char *filename );
+void                        ConformIBSPData( void );
 
 
 /* bspfile_rbsp.c */
@@ -2045,6 +2093,15 @@ Q_EXTERN qboolean skyFixHack Q_ASSIGN( qfalse );                    /* ydnar */
 Q_EXTERN qboolean bspAlternateSplitWeights Q_ASSIGN( qfalse );      /* 27 */
 Q_EXTERN qboolean deepBSP Q_ASSIGN( qfalse );                       /* div0 */
 Q_EXTERN qboolean maxAreaFaceSurface Q_ASSIGN( qfalse );                    /* divVerent */
+Q_EXTERN qboolean binaryPortalFile Q_ASSIGN( qfalse );              /* write the .prt file in the binary format */
+
+/* -bsp ... -vis ... -light pipeline, stages hand over the bsp and portals in memory */
+Q_EXTERN qboolean bspInMemory Q_ASSIGN( qfalse );
+Q_EXTERN qboolean saveIntermediate Q_ASSIGN( qfalse );              /* still write the .bsp and .prt between stages */
+Q_EXTERN qboolean bspStageFollows Q_ASSIGN( qfalse );               /* a later stage takes the bsp from memory, so this one needn't write it */
+Q_EXTERN qboolean bspFileWritten Q_ASSIGN( qfalse );
+Q_EXTERN void                *portalFileData Q_ASSIGN( NULL );     /* binary portal file kept by the bsp stage */
+Q_EXTERN int portalFileSize Q_ASSIGN( 0 );
 
 Q_EXTERN int patchSubdivisions Q_ASSIGN( 8 );                       /* ydnar: -patchmeta subdivisions */
 
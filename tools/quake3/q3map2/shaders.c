@@ -831,10 +831,110 @@ shaderInfo_t *ShaderInfoForShaderNull( const char *shaderName ){
 	return ShaderInfoForShader( shaderName );
 }
 
-shaderInfo_t *ShaderInfoForShader( const char *shaderName ){
-	int i;
+/* name index over shaderInfo */
+#define SHADER_HASH_SIZE    4096
+
+static int shaderHashHead[ SHADER_HASH_SIZE ];
+static int shaderHashNext[ MAX_SHADER_INFO ];
+static int numHashedShaderInfo;
+
+
+
+/*
+   ShaderNameHash()
+   case insensitive the same way Q_stricmp is
+ */
+
+static unsigned int ShaderNameHash( const char *name ){
+	unsigned int hash;
+	int c;
+
+
+	hash = 0;
+	for ( ; *name; name++ )
+	{
+		c = *name;
+		if ( c >= 'a' && c <= 'z' ) {
+			c -= ( 'a' - 'A' );
+		}
+		hash = hash * 31 + c;
+	}
+	return hash & ( SHADER_HASH_SIZE - 1 );
+}
+
+
+
+/*
+   FindShaderInfo()
+   returns the first shader of that name, hashing shaders allocated since the
+   last call first; the chains are kept in a parallel array because shaders
+   get memcpy'd over each other by q3map_baseShader and custom shaders
+ */
+
+static shaderInfo_t *FindShaderInfo( const char *shader ){
+	int i, hash, found;
+
+
+	/* a name is set right after AllocShaderInfo and never changes after that */
+	if ( numHashedShaderInfo == 0 ) {
+		memset( shaderHashHead, 0xFF, sizeof( shaderHashHead ) );
+	}
+	for ( ; numHashedShaderInfo < numShaderInfo; numHashedShaderInfo++ )
+	{
+		hash = ShaderNameHash( shaderInfo[ numHashedShaderInfo ].shader );
+		shaderHashNext[ numHashedShaderInfo ] = shaderHashHead[ hash ];
+		shaderHashHead[ hash ] = numHashedShaderInfo;
+	}
+
+	/* chains run newest first, the linear scan this replaces returned the oldest */
+	found = -1;
+	for ( i = shaderHashHead[ ShaderNameHash( shader ) ]; i >= 0; i = shaderHashNext[ i ] )
+	{
+		if ( !Q_stricmp( shader, shaderInfo[ i ].shader ) ) {
+			found = i;
+		}
+	}
+	return found >= 0 ? &shaderInfo[ found ] : NULL;
+}
+
+
+
+/*
+   ResolveShaderInfo()
+   finds a shader by its extensionless name, following deprecations; the name
+   is replaced by the one that was found, NULL if there is no such shader
+ */
+
+static shaderInfo_t *ResolveShaderInfo( char *shader ){
 	int deprecationDepth;
 	shaderInfo_t    *si;
+
+
+	deprecationDepth = 0;
+	while ( ( si = FindShaderInfo( shader ) ) != NULL )
+	{
+		/* check if shader is deprecated */
+		if ( deprecationDepth < MAX_SHADER_DEPRECATION_DEPTH && si->deprecateShader && si->deprecateShader[ 0 ] ) {
+			/* override name */
+			strcpy( shader, si->deprecateShader );
+			StripExtension( shader );
+			/* increase deprecation depth */
+			deprecationDepth++;
+			if ( deprecationDepth == MAX_SHADER_DEPRECATION_DEPTH ) {
+				Sys_FPrintf( SYS_WRN, "WARNING: Max deprecation depth of %i is reached on shader '%s'\n", MAX_SHADER_DEPRECATION_DEPTH, shader );
+			}
+			/* search again */
+			continue;
+		}
+		return si;
+	}
+	return NULL;
+}
+
+
+
+static shaderInfo_t *ShaderInfoForShaderLocked( const char *shaderName ){
+	shaderInfo_t    *si;
 	char shader[ MAX_QPATH ];
 
 	/* dummy check */
@@ -848,35 +948,16 @@ shaderInfo_t *ShaderInfoForShader( const char *shaderName ){
 	StripExtension( shader );
 
 	/* search for it */
-	deprecationDepth = 0;
-	for ( i = 0; i < numShaderInfo; i++ )
-	{
-		si = &shaderInfo[ i ];
-		if ( !Q_stricmp( shader, si->shader ) ) {
-			/* check if shader is deprecated */
-			if ( deprecationDepth < MAX_SHADER_DEPRECATION_DEPTH && si->deprecateShader && si->deprecateShader[ 0 ] ) {
-				/* override name */
-				strcpy( shader, si->deprecateShader );
-				StripExtension( shader );
-				/* increase deprecation depth */
-				deprecationDepth++;
-				if ( deprecationDepth == MAX_SHADER_DEPRECATION_DEPTH ) {
-					Sys_FPrintf( SYS_WRN, "WARNING: Max deprecation depth of %i is reached on shader '%s'\n", MAX_SHADER_DEPRECATION_DEPTH, shader );
-				}
-				/* search again from beginning */
-				i = -1;
-				continue;
-			}
-
-			/* load image if necessary */
-			if ( si->finished == qfalse ) {
-				LoadShaderImages( si );
-				FinishShader( si );
-			}
-
-			/* return it */
-			return si;
+	si = ResolveShaderInfo( shader );
+	if ( si != NULL ) {
+		/* load image if necessary */
+		if ( si->finished == qfalse ) {
+			LoadShaderImages( si );
+			FinishShader( si );
 		}
+
+		/* return it */
+		return si;
 	}
 
 	/* allocate a default shader */
@@ -889,6 +970,17 @@ shaderInfo_t *ShaderInfoForShader( const char *shaderName ){
 	return si;
 }
 
+shaderInfo_t *ShaderInfoForShader( const char *shaderName ){
+	shaderInfo_t    *si;
+
+
+	/* finishing or allocating a shader changes the shared list, so threads take turns */
+	ThreadLock();
+	si = ShaderInfoForShaderLocked( shaderName );
+	ThreadUnlock();
+	return si;
+}
+
 
 
 /*
@@ -2077,6 +2169,83 @@ static void ParseCustomInfoParms( void ){
 
 
 
+/*
+   PrefetchShaderImages()
+   decodes the images of the loaded bsp's shaders on worker threads, in the
+   order LoadShaderImages will ask for them, so finishing those shaders later
+   only has to look them up
+ */
+
+typedef struct shaderPrefetch_s
+{
+	shaderInfo_t        *si;            /* NULL for shaders without a script */
+	char shader[ MAX_QPATH ];
+}
+shaderPrefetch_t;
+
+static shaderPrefetch_t *shaderPrefetch;
+
+static void PrefetchShaderImagesThread( int num ){
+	shaderInfo_t    *si;
+
+
+	si = shaderPrefetch[ num ].si;
+
+	/* a default shader only tries its name */
+	if ( si == NULL ) {
+		ImagePrefetch( shaderPrefetch[ num ].shader );
+		return;
+	}
+
+	/* nodraw shaders don't need images */
+	if ( si->compileFlags & C_NODRAW ) {
+		return;
+	}
+
+	/* same fallbacks as LoadShaderImages, the last of which is the light image */
+	if ( !ImagePrefetch( si->editorImagePath ) &&
+		 !ImagePrefetch( si->shader ) ) {
+		ImagePrefetch( si->implicitImagePath );
+	}
+	ImagePrefetch( si->lightImagePath );
+	ImagePrefetch( si->normalImagePath );
+}
+
+void PrefetchShaderImages( void ){
+	int i, numPrefetch;
+	shaderPrefetch_t    *sp;
+
+
+	Sys_FPrintf( SYS_VRB, "--- PrefetchShaderImages ---\n" );
+	ProfileBegin( "PrefetchShaderImages" );
+
+	/* resolve the shaders here, the name index isn't safe to update from threads */
+	shaderPrefetch = safe_malloc( numBSPShaders * sizeof( *shaderPrefetch ) );
+	numPrefetch = 0;
+	for ( i = 0; i < numBSPShaders; i++ )
+	{
+		sp = &shaderPrefetch[ numPrefetch ];
+		strcpy( sp->shader, bspShaders[ i ].shader );
+		StripExtension( sp->shader );
+		sp->si = ResolveShaderInfo( sp->shader );
+		if ( sp->si == NULL || sp->si->finished == qfalse ) {
+			numPrefetch++;
+		}
+	}
+
+	/* load them */
+	RunThreadsOnIndividual( numPrefetch, qfalse, PrefetchShaderImagesThread );
+	free( shaderPrefetch );
+	shaderPrefetch = NULL;
+
+	/* emit some statistics */
+	Sys_FPrintf( SYS_VRB, "%9d images\n", numImages );
+
+	ProfileEnd();
+}
+
+
+
 /*
    LoadShaderInfo()
    the shaders are parsed out of shaderlist.txt from a main directory
@@ -2092,6 +2261,8 @@ void LoadShaderInfo( void ){
 	char            *shaderFiles[ MAX_SHADER_FILES ];
 
 
+	ProfileBegin( "LoadShaderInfo" );
+
 	/* rr2do2: parse custom infoparms first */
 	if ( useCustomInfoParms ) {
 		ParseCustomInfoParms();
@@ -2144,4 +2315,6 @@ void LoadShaderInfo( void ){
 
 	/* emit some statistics */
 	Sys_FPrintf( SYS_VRB, "%9d shaderInfo\n", numShaderInfo );
+
+	ProfileEnd();
 }
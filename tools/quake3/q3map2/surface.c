@@ -701,6 +701,266 @@ void ClassifyEntitySurfaces( entity_t *e ){
 
 
 
+/*
+   draw surface tree
+   a bounding volume tree over the draw surfaces of an entity, so that fog
+   chopping and decal projection only look at the surfaces near a fog brush
+   or projector.  the bounds are those of the verts when the tree is built
+ */
+
+#define SURFACE_TREE_LEAF_SURFS     4
+#define MAX_SURFACE_TREE_DEPTH      128
+
+typedef struct surfaceTreeNode_s
+{
+	vec3_t mins, maxs;
+	int firstSurf, numSurfs;            /* into surfaceTreeSurfs */
+	int children;                       /* first of the two children, -1 for leaves */
+}
+surfaceTreeNode_t;
+
+static surfaceTreeNode_t *surfaceTreeNodes;
+static int numSurfaceTreeNodes, allocatedSurfaceTreeNodes;
+static int *surfaceTreeSurfs;
+static vec3_t *surfaceTreeMins, *surfaceTreeMaxs;   /* per surface, from surfaceTreeFirst */
+static int surfaceTreeFirst, surfaceTreeEnd;
+static int surfaceTreeAxis;
+
+
+
+/*
+   CompareSurfaceTreeCenters()
+   orders surfaces along surfaceTreeAxis, ties by surface number
+ */
+
+static int CompareSurfaceTreeCenters( const void *a, const void *b ){
+	int sa, sb;
+	float ca, cb;
+
+
+	sa = *( (const int*) a ) - surfaceTreeFirst;
+	sb = *( (const int*) b ) - surfaceTreeFirst;
+	ca = surfaceTreeMins[ sa ][ surfaceTreeAxis ] + surfaceTreeMaxs[ sa ][ surfaceTreeAxis ];
+	cb = surfaceTreeMins[ sb ][ surfaceTreeAxis ] + surfaceTreeMaxs[ sb ][ surfaceTreeAxis ];
+	if ( ca < cb ) {
+		return -1;
+	}
+	if ( ca > cb ) {
+		return 1;
+	}
+	return sa - sb;
+}
+
+
+
+/*
+   BuildSurfaceTree_r()
+   fills in a node and splits it at the median surface of its longest axis
+ */
+
+static void BuildSurfaceTree_r( int nodeNum, int firstSurf, int numSurfs ){
+	int i, s, half, children;
+	vec3_t centerMins, centerMaxs, center, size;
+	surfaceTreeNode_t   *node;
+
+
+	/* bound the surfaces and their centers */
+	node = &surfaceTreeNodes[ nodeNum ];
+	ClearBounds( node->mins, node->maxs );
+	ClearBounds( centerMins, centerMaxs );
+	for ( i = 0; i < numSurfs; i++ )
+	{
+		s = surfaceTreeSurfs[ firstSurf + i ] - surfaceTreeFirst;
+		AddPointToBounds( surfaceTreeMins[ s ], node->mins, node->maxs );
+		AddPointToBounds( surfaceTreeMaxs[ s ], node->mins, node->maxs );
+		VectorAdd( surfaceTreeMins[ s ], surfaceTreeMaxs[ s ], center );
+		AddPointToBounds( center, centerMins, centerMaxs );
+	}
+	node->firstSurf = firstSurf;
+	node->numSurfs = numSurfs;
+	node->children = -1;
+
+	/* small enough? */
+	if ( numSurfs <= SURFACE_TREE_LEAF_SURFS ) {
+		return;
+	}
+
+	/* split along the longest axis */
+	VectorSubtract( centerMaxs, centerMins, size );
+	surfaceTreeAxis = 0;
+	if ( size[ 1 ] > size[ surfaceTreeAxis ] ) {
+		surfaceTreeAxis = 1;
+	}
+	if ( size[ 2 ] > size[ surfaceTreeAxis ] ) {
+		surfaceTreeAxis = 2;
+	}
+	qsort( &surfaceTreeSurfs[ firstSurf ], numSurfs, sizeof( *surfaceTreeSurfs ), CompareSurfaceTreeCenters );
+
+	/* the node pointer dies here */
+	children = numSurfaceTreeNodes;
+	numSurfaceTreeNodes += 2;
+	AUTOEXPAND_BY_REALLOC( surfaceTreeNodes, numSurfaceTreeNodes, allocatedSurfaceTreeNodes, 1024 );
+	surfaceTreeNodes[ nodeNum ].children = children;
+
+	half = numSurfs / 2;
+	BuildSurfaceTree_r( children, firstSurf, half );
+	BuildSurfaceTree_r( children + 1, firstSurf + half, numSurfs - half );
+}
+
+
+
+/*
+   SetupDrawSurfaceTree()
+   builds the surface tree over the current draw surfaces of an entity
+ */
+
+void SetupDrawSurfaceTree( entity_t *e ){
+	int i, j, numSurfs;
+	mapDrawSurface_t    *ds;
+
+
+	/* note it */
+	Sys_FPrintf( SYS_VRB, "--- SetupDrawSurfaceTree ---\n" );
+
+	/* clear out the old one */
+	FreeDrawSurfaceTree();
+	surfaceTreeFirst = e->firstDrawSurf;
+	surfaceTreeEnd = numMapDrawSurfs;
+	if ( surfaceTreeEnd <= surfaceTreeFirst ) {
+		surfaceTreeFirst = surfaceTreeEnd = 0;
+		return;
+	}
+
+	/* bound the surfaces, empty ones are left out */
+	surfaceTreeMins = safe_malloc( ( surfaceTreeEnd - surfaceTreeFirst ) * sizeof( *surfaceTreeMins ) );
+	surfaceTreeMaxs = safe_malloc( ( surfaceTreeEnd - surfaceTreeFirst ) * sizeof( *surfaceTreeMaxs ) );
+	surfaceTreeSurfs = safe_malloc( ( surfaceTreeEnd - surfaceTreeFirst ) * sizeof( *surfaceTreeSurfs ) );
+	numSurfs = 0;
+	for ( i = surfaceTreeFirst; i < surfaceTreeEnd; i++ )
+	{
+		ds = &mapDrawSurfs[ i ];
+		if ( ds->numVerts <= 0 ) {
+			continue;
+		}
+		ClearBounds( surfaceTreeMins[ i - surfaceTreeFirst ], surfaceTreeMaxs[ i - surfaceTreeFirst ] );
+		for ( j = 0; j < ds->numVerts; j++ )
+			AddPointToBounds( ds->verts[ j ].xyz, surfaceTreeMins[ i - surfaceTreeFirst ], surfaceTreeMaxs[ i - surfaceTreeFirst ] );
+		surfaceTreeSurfs[ numSurfs++ ] = i;
+	}
+
+	/* build it */
+	numSurfaceTreeNodes = 1;
+	AUTOEXPAND_BY_REALLOC( surfaceTreeNodes, numSurfaceTreeNodes, allocatedSurfaceTreeNodes, 1024 );
+	BuildSurfaceTree_r( 0, 0, numSurfs );
+
+	/* emit some stats */
+	Sys_FPrintf( SYS_VRB, "%9d surfaces in %d tree nodes\n", numSurfs, numSurfaceTreeNodes );
+}
+
+
+
+/*
+   FreeDrawSurfaceTree()
+   frees the surface tree
+ */
+
+void FreeDrawSurfaceTree( void ){
+	free( surfaceTreeNodes );
+	free( surfaceTreeSurfs );
+	free( surfaceTreeMins );
+	free( surfaceTreeMaxs );
+	surfaceTreeNodes = NULL;
+	surfaceTreeSurfs = NULL;
+	surfaceTreeMins = surfaceTreeMaxs = NULL;
+	numSurfaceTreeNodes = allocatedSurfaceTreeNodes = 0;
+	surfaceTreeFirst = surfaceTreeEnd = 0;
+}
+
+
+
+/*
+   CompareSurfaceNums()
+   qsort callback for ascending surface numbers
+ */
+
+static int CompareSurfaceNums( const void *a, const void *b ){
+	return *( (const int*) a ) - *( (const int*) b );
+}
+
+
+
+/*
+   DrawSurfacesInBounds()
+   lists the draw surfaces from first to end (exclusive) that may touch the
+   bounds, in ascending order.  surfaces outside the tree (made after it was
+   built) are always listed, so callers still need their own bounds test.
+   safe to call from threads, the list belongs to the caller
+ */
+
+int DrawSurfacesInBounds( vec3_t mins, vec3_t maxs, int first, int end, int **surfs, int *allocatedSurfs ){
+	int i, s, numSurfs, numTreeSurfs, stack[ MAX_SURFACE_TREE_DEPTH ], numStack;
+	surfaceTreeNode_t   *node;
+
+
+	numSurfs = 0;
+
+	/* surfaces in front of the tree */
+	for ( i = first; i < end && i < surfaceTreeFirst; i++ )
+	{
+		AUTOEXPAND_BY_REALLOC( *surfs, numSurfs, *allocatedSurfs, 256 );
+		( *surfs )[ numSurfs++ ] = i;
+	}
+
+	/* walk the tree */
+	numTreeSurfs = numSurfs;
+	numStack = 0;
+	if ( numSurfaceTreeNodes > 0 ) {
+		stack[ numStack++ ] = 0;
+	}
+	while ( numStack > 0 )
+	{
+		node = &surfaceTreeNodes[ stack[ --numStack ] ];
+		if ( node->numSurfs <= 0 ||
+			 node->mins[ 0 ] > maxs[ 0 ] || node->maxs[ 0 ] < mins[ 0 ] ||
+			 node->mins[ 1 ] > maxs[ 1 ] || node->maxs[ 1 ] < mins[ 1 ] ||
+			 node->mins[ 2 ] > maxs[ 2 ] || node->maxs[ 2 ] < mins[ 2 ] ) {
+			continue;
+		}
+		if ( node->children >= 0 ) {
+			if ( numStack + 2 > MAX_SURFACE_TREE_DEPTH ) {
+				Error( "DrawSurfacesInBounds: MAX_SURFACE_TREE_DEPTH (%d) exceeded", MAX_SURFACE_TREE_DEPTH );
+			}
+			stack[ numStack++ ] = node->children;
+			stack[ numStack++ ] = node->children + 1;
+			continue;
+		}
+		for ( i = 0; i < node->numSurfs; i++ )
+		{
+			s = surfaceTreeSurfs[ node->firstSurf + i ];
+			if ( s < first || s >= end ||
+				 surfaceTreeMins[ s - surfaceTreeFirst ][ 0 ] > maxs[ 0 ] || surfaceTreeMaxs[ s - surfaceTreeFirst ][ 0 ] < mins[ 0 ] ||
+				 surfaceTreeMins[ s - surfaceTreeFirst ][ 1 ] > maxs[ 1 ] || surfaceTreeMaxs[ s - surfaceTreeFirst ][ 1 ] < mins[ 1 ] ||
+				 surfaceTreeMins[ s - surfaceTreeFirst ][ 2 ] > maxs[ 2 ] || surfaceTreeMaxs[ s - surfaceTreeFirst ][ 2 ] < mins[ 2 ] ) {
+				continue;
+			}
+			AUTOEXPAND_BY_REALLOC( *surfs, numSurfs, *allocatedSurfs, 256 );
+			( *surfs )[ numSurfs++ ] = s;
+		}
+	}
+	qsort( &( *surfs )[ numTreeSurfs ], numSurfs - numTreeSurfs, sizeof( **surfs ), CompareSurfaceNums );
+
+	/* surfaces made after the tree */
+	for ( i = ( first > surfaceTreeEnd ? first : surfaceTreeEnd ); i < end; i++ )
+	{
+		AUTOEXPAND_BY_REALLOC( *surfs, numSurfs, *allocatedSurfs, 256 );
+		( *surfs )[ numSurfs++ ] = i;
+	}
+
+	return numSurfs;
+}
+
+
+
 /*
    GetShaderIndexForPoint() - ydnar
    for shader-indexed surfaces (terrain), find a matching index from the indexmap
@@ -1868,6 +2128,7 @@ void ClipSidesIntoTree( entity_t *e, tree_t *tree ){
 
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- ClipSidesIntoTree ---\n" );
+	ProfileBegin( "ClipSidesIntoTree" );
 
 	/* walk the brush list */
 	for ( b = e->brushes; b; b = b->next )
@@ -1928,6 +2189,8 @@ void ClipSidesIntoTree( entity_t *e, tree_t *tree ){
 			DrawSurfaceForSide( e, b, newSide, w );
 		}
 	}
+
+	ProfileEnd();
 }
 
 
@@ -2325,16 +2588,49 @@ static int FilterTrianglesIntoTree( mapDrawSurface_t *ds, tree_t *tree ){
 
 /*
    FilterFoliageIntoTree()
-   filters a foliage surface (wolf et/splash damage)
+   filters a foliage surface (wolf et/splash damage).  every instance is the
+   same model moved, so the model bounds are taken down the tree first and
+   the triangles only have to be filtered from where the bounds get split
  */
 
 static int FilterFoliageIntoTree( mapDrawSurface_t *ds, tree_t *tree ){
-	int f, i, refs;
+	int f, i, refs, numModelVerts;
 	bspDrawVert_t   *instance;
-	vec3_t xyz;
+	vec3_t xyz, modelMins, modelMaxs, mins, maxs, low, high;
+	float dMin, dMax, d;
 	winding_t       *w;
+	node_t          *node;
+	plane_t         *plane;
+	shaderInfo_t    *si;
+	qboolean descend;
 
 
+	/* error check */
+	if ( ds->numFoliageInstances > 0 ) {
+		for ( i = 0; i < ds->numIndexes; i += 3 )
+		{
+			if ( ds->indexes[ i ] >= ds->numVerts ||
+				 ds->indexes[ i + 1 ] >= ds->numVerts ||
+				 ds->indexes[ i + 2 ] >= ds->numVerts ) {
+				Error( "Index %d greater than vertex count %d", ds->indexes[ i ], ds->numVerts );
+			}
+		}
+	}
+
+	/* the model bounds can't be used with forced planes or the deformVertexes move hack */
+	si = ds->shaderInfo;
+	descend = ( ds->planeNum < 0 &&
+				( si == NULL ||
+				  ( si->mins[ 0 ] == 0.0f && si->maxs[ 0 ] == 0.0f &&
+					si->mins[ 1 ] == 0.0f && si->maxs[ 1 ] == 0.0f &&
+					si->mins[ 2 ] == 0.0f && si->maxs[ 2 ] == 0.0f ) ) );
+
+	/* get model bounds */
+	numModelVerts = ds->numVerts - ds->numFoliageInstances;
+	ClearBounds( modelMins, modelMaxs );
+	for ( i = 0; i < numModelVerts; i++ )
+		AddPointToBounds( ds->verts[ i ].xyz, modelMins, modelMaxs );
+
 	/* walk origin list */
 	refs = 0;
 	for ( f = 0; f < ds->numFoliageInstances; f++ )
@@ -2342,30 +2638,59 @@ static int FilterFoliageIntoTree( mapDrawSurface_t *ds, tree_t *tree ){
 		/* get instance */
 		instance = ds->verts + ds->patchHeight + f;
 
+		/* take the instance bounds down while they are clearly on one side of the planes */
+		node = tree->headnode;
+		if ( descend && numModelVerts > 0 ) {
+			VectorAdd( instance->xyz, modelMins, mins );
+			VectorAdd( instance->xyz, modelMaxs, maxs );
+			while ( node->planenum != PLANENUM_LEAF )
+			{
+				plane = &mapplanes[ node->planenum ];
+				for ( i = 0; i < 3; i++ )
+				{
+					low[ i ] = plane->normal[ i ] < 0 ? maxs[ i ] : mins[ i ];
+					high[ i ] = plane->normal[ i ] < 0 ? mins[ i ] : maxs[ i ];
+				}
+				dMin = DotProduct( low, plane->normal ) - plane->dist;
+				dMax = DotProduct( high, plane->normal ) - plane->dist;
+
+				/* twice the epsilon leaves room for rounding in the per vertex tests */
+				d = 2.0f * ON_EPSILON;
+				if ( dMin > d ) {
+					node = node->children[ 0 ];
+				}
+				else if ( dMax < -d ) {
+					node = node->children[ 1 ];
+				}
+				else{
+					break;
+				}
+			}
+
+			/* all of the instance is in one leaf */
+			if ( node->planenum == PLANENUM_LEAF ) {
+				refs += AddReferenceToLeaf( ds, node );
+				continue;
+			}
+		}
+
 		/* walk triangle list */
 		for ( i = 0; i < ds->numIndexes; i += 3 )
 		{
-			/* error check */
-			if ( ds->indexes[ i ] >= ds->numVerts ||
-				 ds->indexes[ i + 1 ] >= ds->numVerts ||
-				 ds->indexes[ i + 2 ] >= ds->numVerts ) {
-				Error( "Index %d greater than vertex count %d", ds->indexes[ i ], ds->numVerts );
-			}
-
 			/* make a triangle winding and filter it into the tree */
 			w = AllocWinding( 3 );
 			w->numpoints = 3;
 			VectorAdd( instance->xyz, ds->verts[ ds->indexes[ i ] ].xyz, w->p[ 0 ] );
 			VectorAdd( instance->xyz, ds->verts[ ds->indexes[ i + 1 ] ].xyz, w->p[ 1 ] );
 			VectorAdd( instance->xyz, ds->verts[ ds->indexes[ i + 2 ] ].xyz, w->p[ 2 ] );
-			refs += FilterWindingIntoTree_r( w, ds, tree->headnode );
+			refs += FilterWindingIntoTree_r( w, ds, node );
 		}
 
 		/* use point filtering as well */
-		for ( i = 0; i < ( ds->numVerts - ds->numFoliageInstances ); i++ )
+		for ( i = 0; i < numModelVerts; i++ )
 		{
 			VectorAdd( instance->xyz, ds->verts[ i ].xyz, xyz );
-			refs += FilterPointIntoTree_r( xyz, ds, tree->headnode );
+			refs += FilterPointIntoTree_r( xyz, ds, node );
 		}
 	}
 
@@ -3333,7 +3658,7 @@ int AddSurfaceModelsToTriangle_r( mapDrawSurface_t *ds, surfaceModel_t *model, b
 int AddSurfaceModels( mapDrawSurface_t *ds ){
 	surfaceModel_t  *model;
 	int i, x, y, n, pw[ 5 ], r, localNumSurfaceModels, iterations;
-	mesh_t src, *mesh, *subdivided;
+	mesh_t src, *mesh;
 	bspDrawVert_t centroid, *tri[ 3 ];
 	float alpha;
 
@@ -3411,12 +3736,8 @@ int AddSurfaceModels( mapDrawSurface_t *ds ){
 			src.verts = ds->verts;
 			//%	subdivided = SubdivideMesh( src, 8.0f, 512 );
 			iterations = IterationsForCurve( ds->longestCurve, patchSubdivisions );
-			subdivided = SubdivideMesh2( src, iterations );
-
-			/* fit it to the curve and remove colinear verts on rows/columns */
-			PutMeshOnCurve( *subdivided );
-			mesh = RemoveLinearMeshColumnsRows( subdivided );
-			FreeMesh( subdivided );
+			/* subdivide it, fit it to the curve and remove colinear verts on rows/columns */
+			mesh = TesselateMesh( src, iterations );
 
 			/* subdivide each quad to place the models */
 			for ( y = 0; y < ( mesh->height - 1 ); y++ )
@@ -3564,6 +3885,60 @@ static void VolumeColorMods( entity_t *e, mapDrawSurface_t *ds ){
 
 
 
+/*
+   ModDrawSurface()
+   applies the shader and brush mods to the verts of a surface and offsets
+   fur, all of which only touches the surface itself
+ */
+
+static entity_t *modEntity;
+static int modFirstDrawSurf;
+
+static void ModDrawSurface( entity_t *e, mapDrawSurface_t *ds ){
+	int i;
+	shaderInfo_t        *si;
+
+
+	/* get shader */
+	si = ds->shaderInfo;
+
+	/* apply texture coordinate mods */
+	for ( i = 0; i < ds->numVerts; i++ )
+		TCMod( si->mod, ds->verts[ i ].st );
+
+	/* ydnar: apply shader colormod */
+	ColorMod( ds->shaderInfo->colorMod, ds->numVerts, ds->verts );
+
+	/* ydnar: apply brush colormod */
+	VolumeColorMods( e, ds );
+
+	/* ydnar: offset fur surfaces, the layers are added by Fur() */
+	if ( si->furNumLayers > 0 ) {
+		OffsetFur( ds );
+	}
+}
+
+
+
+/*
+   ModDrawSurfaceThread()
+   mods one of the entity surfaces ahead of FilterDrawsurfsIntoTree()
+ */
+
+static void ModDrawSurfaceThread( int num ){
+	mapDrawSurface_t    *ds;
+
+
+	/* skip the surfaces the filter loop skips */
+	ds = &mapDrawSurfs[ modFirstDrawSurf + num ];
+	if ( ds->numVerts == 0 || ds->skybox ) {
+		return;
+	}
+	ModDrawSurface( modEntity, ds );
+}
+
+
+
 /*
    FilterDrawsurfsIntoTree()
    upon completion, all drawsurfs that actually generate a reference
@@ -3572,17 +3947,26 @@ static void VolumeColorMods( entity_t *e, mapDrawSurface_t *ds ){
  */
 
 void FilterDrawsurfsIntoTree( entity_t *e, tree_t *tree ){
-	int i, j;
+	int i;
 	mapDrawSurface_t    *ds;
 	shaderInfo_t        *si;
 	vec3_t origin, mins, maxs;
 	int refs;
-	int numSurfs, numRefs, numSkyboxSurfaces;
+	int numSurfs, numRefs, numSkyboxSurfaces, numModded;
 	qboolean sb;
 
 
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- FilterDrawsurfsIntoTree ---\n" );
+	ProfileBegin( "FilterDrawsurfsIntoTree" );
+
+	/* mod the existing surfaces and find their foliage on all threads, the
+	   surfaces added by the loop below (fur, foliage, flares) are done serially */
+	numModded = numMapDrawSurfs;
+	modEntity = e;
+	modFirstDrawSurf = e->firstDrawSurf;
+	RunThreadsOnIndividual( numModded - e->firstDrawSurf, qfalse, ModDrawSurfaceThread );
+	PrepareFoliage( e->firstDrawSurf, numModded - e->firstDrawSurf );
 
 	/* filter surfaces into the tree */
 	numSurfs = 0;
@@ -3612,15 +3996,10 @@ void FilterDrawsurfsIntoTree( entity_t *e, tree_t *tree ){
 			/* refs initially zero */
 			refs = 0;
 
-			/* apply texture coordinate mods */
-			for ( j = 0; j < ds->numVerts; j++ )
-				TCMod( si->mod, ds->verts[ j ].st );
-
-			/* ydnar: apply shader colormod */
-			ColorMod( ds->shaderInfo->colorMod, ds->numVerts, ds->verts );
-
-			/* ydnar: apply brush colormod */
-			VolumeColorMods( e, ds );
+			/* apply the mods to surfaces added since the threads ran */
+			if ( i >= numModded ) {
+				ModDrawSurface( e, ds );
+			}
 
 			/* ydnar: make fur surfaces */
 			if ( si->furNumLayers > 0 ) {
@@ -3780,6 +4159,9 @@ void FilterDrawsurfsIntoTree( entity_t *e, tree_t *tree ){
 		}
 	}
 
+	/* free the foliage candidates */
+	FreeFoliage();
+
 	/* emit some statistics */
 	Sys_FPrintf( SYS_VRB, "%9d references\n", numRefs );
 	Sys_FPrintf( SYS_VRB, "%9d (%d) emitted drawsurfs\n", numSurfs, numBSPDrawSurfaces );
@@ -3792,4 +4174,6 @@ void FilterDrawsurfsIntoTree( entity_t *e, tree_t *tree ){
 		Sys_FPrintf( SYS_VRB, "%9d %s surfaces\n", numSurfacesByType[ i ], surfaceTypes[ i ] );
 
 	Sys_FPrintf( SYS_VRB, "%9d redundant indexes supressed, saving %d Kbytes\n", numRedundantIndexes, ( numRedundantIndexes * 4 / 1024 ) );
+
+	ProfileEnd();
 }
@@ -42,24 +42,41 @@
 static int numFoliageInstances;
 static foliageInstance_t foliageInstances[ MAX_FOLIAGE_INSTANCES ];
 
+/* a place where an instance may go, if the dice say so */
+typedef struct foliageCandidate_s
+{
+	foliage_t           *foliage;
+	vec3_t xyz, normal;
+	float odds;
+	qboolean valid;
+}
+foliageCandidate_t;
+
+typedef struct foliageCandidates_s
+{
+	int numCandidates, maxCandidates;
+	foliageCandidate_t  *candidates;
+}
+foliageCandidates_t;
+
+/* candidates of the surfaces handed to PrepareFoliage() */
+static int firstFoliageSurf, numFoliageSurfs;
+static foliageCandidates_t  *foliageSurfs;
+
 
 
 /*
    SubdivideFoliageTriangle_r()
    recursively subdivides a triangle until the triangle is smaller than
-   the desired density, then pseudo-randomly sets a point
+   the desired density, then adds its centroid as a candidate.  no dice are
+   rolled here, so this is safe to run on several surfaces at once
  */
 
-static void SubdivideFoliageTriangle_r( mapDrawSurface_t *ds, foliage_t *foliage, bspDrawVert_t **tri ){
+static void SubdivideFoliageTriangle_r( foliageCandidates_t *fc, foliage_t *foliage, bspDrawVert_t **tri ){
 	bspDrawVert_t mid, *tri2[ 3 ];
 	int max;
 
 
-	/* limit test */
-	if ( numFoliageInstances >= MAX_FOLIAGE_INSTANCES ) {
-		return;
-	}
-
 	/* plane test */
 	{
 		vec4_t plane;
@@ -80,17 +97,15 @@ static void SubdivideFoliageTriangle_r( mapDrawSurface_t *ds, foliage_t *foliage
 	{
 		int i;
 		float               *a, *b, dx, dy, dz, dist, maxDist;
-		foliageInstance_t   *fi;
+		vec3_t xyz, normal;
+		foliageCandidate_t  *c;
 
 
-		/* get instance */
-		fi = &foliageInstances[ numFoliageInstances ];
-
 		/* find the longest edge and split it */
 		max = -1;
 		maxDist = 0.0f;
-		VectorClear( fi->xyz );
-		VectorClear( fi->normal );
+		VectorClear( xyz );
+		VectorClear( normal );
 		for ( i = 0; i < 3; i++ )
 		{
 			/* get verts */
@@ -110,13 +125,13 @@ static void SubdivideFoliageTriangle_r( mapDrawSurface_t *ds, foliage_t *foliage
 			}
 
 			/* add to centroid */
-			VectorAdd( fi->xyz, tri[ i ]->xyz, fi->xyz );
-			VectorAdd( fi->normal, tri[ i ]->normal, fi->normal );
+			VectorAdd( xyz, tri[ i ]->xyz, xyz );
+			VectorAdd( normal, tri[ i ]->normal, normal );
 		}
 
 		/* is the triangle small enough? */
 		if ( maxDist <= ( foliage->density * foliage->density ) ) {
-			float alpha, odds, r;
+			float alpha;
 
 
 			/* get average alpha */
@@ -134,21 +149,13 @@ static void SubdivideFoliageTriangle_r( mapDrawSurface_t *ds, foliage_t *foliage
 				}
 			}
 
-			/* roll the dice */
-			odds = foliage->odds * alpha;
-			r = Random();
-			if ( r > odds ) {
-				return;
-			}
-
-			/* scale centroid */
-			VectorScale( fi->xyz, 0.33333333f, fi->xyz );
-			if ( VectorNormalize( fi->normal, fi->normal ) == 0.0f ) {
-				return;
-			}
-
-			/* add to count and return */
-			numFoliageInstances++;
+			/* add a candidate, a zero normal still costs a roll of the dice */
+			AUTOEXPAND_BY_REALLOC( fc->candidates, fc->numCandidates, fc->maxCandidates, 64 );
+			c = &fc->candidates[ fc->numCandidates++ ];
+			c->foliage = foliage;
+			c->odds = foliage->odds * alpha;
+			VectorScale( xyz, 0.33333333f, c->xyz );
+			c->valid = ( VectorNormalize( normal, c->normal ) != 0.0f );
 			return;
 		}
 	}
@@ -159,44 +166,32 @@ static void SubdivideFoliageTriangle_r( mapDrawSurface_t *ds, foliage_t *foliage
 	/* recurse to first triangle */
 	VectorCopy( tri, tri2 );
 	tri2[ max ] = &mid;
-	SubdivideFoliageTriangle_r( ds, foliage, tri2 );
+	SubdivideFoliageTriangle_r( fc, foliage, tri2 );
 
 	/* recurse to second triangle */
 	VectorCopy( tri, tri2 );
 	tri2[ ( max + 1 ) % 3 ] = &mid;
-	SubdivideFoliageTriangle_r( ds, foliage, tri2 );
+	SubdivideFoliageTriangle_r( fc, foliage, tri2 );
 }
 
 
 
 /*
-   GenFoliage()
-   generates a foliage file for a bsp
+   FindFoliageCandidates()
+   subdivides a surface for every foliage of its shader, the candidates
+   are stored in foliage order
  */
 
-void Foliage( mapDrawSurface_t *src ){
-	int i, j, k, x, y, pw[ 5 ], r, oldNumMapDrawSurfs;
-	mapDrawSurface_t    *ds;
-	shaderInfo_t        *si;
+static void FindFoliageCandidates( mapDrawSurface_t *src, foliageCandidates_t *fc ){
+	int i, x, y, pw[ 5 ], r;
 	foliage_t           *foliage;
 	mesh_t srcMesh, *subdivided, *mesh;
-	bspDrawVert_t       *verts, *dv[ 3 ], *fi;
-	vec3_t scale;
-	m4x4_t transform;
+	bspDrawVert_t       *verts, *dv[ 3 ];
 
 
-	/* get shader */
-	si = src->shaderInfo;
-	if ( si == NULL || si->foliage == NULL ) {
-		return;
-	}
-
 	/* do every foliage */
-	for ( foliage = si->foliage; foliage != NULL; foliage = foliage->next )
+	for ( foliage = src->shaderInfo->foliage; foliage != NULL; foliage = foliage->next )
 	{
-		/* zero out */
-		numFoliageInstances = 0;
-
 		/* map the surface onto the lightmap origin/cluster/normal buffers */
 		switch ( src->type )
 		{
@@ -212,7 +207,7 @@ void Foliage( mapDrawSurface_t *src ){
 				dv[ 0 ] = &verts[ src->indexes[ i ] ];
 				dv[ 1 ] = &verts[ src->indexes[ i + 1 ] ];
 				dv[ 2 ] = &verts[ src->indexes[ i + 2 ] ];
-				SubdivideFoliageTriangle_r( src, foliage, dv );
+				SubdivideFoliageTriangle_r( fc, foliage, dv );
 			}
 			break;
 
@@ -250,13 +245,13 @@ void Foliage( mapDrawSurface_t *src ){
 					dv[ 0 ] = &verts[ pw[ r + 0 ] ];
 					dv[ 1 ] = &verts[ pw[ r + 1 ] ];
 					dv[ 2 ] = &verts[ pw[ r + 2 ] ];
-					SubdivideFoliageTriangle_r( src, foliage, dv );
+					SubdivideFoliageTriangle_r( fc, foliage, dv );
 
 					/* get drawverts and map second triangle */
 					dv[ 0 ] = &verts[ pw[ r + 0 ] ];
 					dv[ 1 ] = &verts[ pw[ r + 2 ] ];
 					dv[ 2 ] = &verts[ pw[ r + 3 ] ];
-					SubdivideFoliageTriangle_r( src, foliage, dv );
+					SubdivideFoliageTriangle_r( fc, foliage, dv );
 				}
 			}
 
@@ -267,6 +262,135 @@ void Foliage( mapDrawSurface_t *src ){
 		default:
 			break;
 		}
+	}
+}
+
+
+
+/*
+   PrepareFoliageThread()
+   finds the candidates of one surface
+ */
+
+static void PrepareFoliageThread( int num ){
+	mapDrawSurface_t    *ds;
+
+
+	/* get surface */
+	ds = &mapDrawSurfs[ firstFoliageSurf + num ];
+	if ( ds->numVerts == 0 || ds->skybox || ds->shaderInfo == NULL || ds->shaderInfo->foliage == NULL ) {
+		return;
+	}
+
+	/* find them */
+	FindFoliageCandidates( ds, &foliageSurfs[ num ] );
+}
+
+
+
+/*
+   PrepareFoliage()
+   subdivides the foliage surfaces in a range of drawsurfs on all threads,
+   Foliage() then only has to roll the dice and add the models.  the
+   surface verts must be final (colormods applied) when this is called
+ */
+
+void PrepareFoliage( int firstDrawSurf, int numDrawSurfs ){
+	/* free the last range */
+	FreeFoliage();
+
+	/* set up */
+	firstFoliageSurf = firstDrawSurf;
+	numFoliageSurfs = numDrawSurfs;
+	foliageSurfs = safe_malloc( numDrawSurfs * sizeof( *foliageSurfs ) );
+	memset( foliageSurfs, 0, numDrawSurfs * sizeof( *foliageSurfs ) );
+
+	/* subdivide */
+	RunThreadsOnIndividual( numDrawSurfs, qfalse, PrepareFoliageThread );
+}
+
+
+
+/*
+   FreeFoliage()
+   frees the candidates left from PrepareFoliage()
+ */
+
+void FreeFoliage( void ){
+	int i;
+
+
+	for ( i = 0; i < numFoliageSurfs; i++ )
+		free( foliageSurfs[ i ].candidates );
+	free( foliageSurfs );
+	foliageSurfs = NULL;
+	firstFoliageSurf = numFoliageSurfs = 0;
+}
+
+
+
+/*
+   GenFoliage()
+   generates a foliage file for a bsp
+ */
+
+void Foliage( mapDrawSurface_t *src ){
+	int i, j, k, num, oldNumMapDrawSurfs;
+	float r;
+	mapDrawSurface_t    *ds;
+	shaderInfo_t        *si;
+	foliage_t           *foliage;
+	foliageCandidates_t *fc, local;
+	foliageCandidate_t  *c;
+	bspDrawVert_t       *verts, *fi;
+	vec3_t scale;
+	m4x4_t transform;
+
+
+	/* get shader */
+	si = src->shaderInfo;
+	if ( si == NULL || si->foliage == NULL ) {
+		return;
+	}
+
+	/* get the candidates, surfaces added since PrepareFoliage() are subdivided here */
+	num = src - mapDrawSurfs - firstFoliageSurf;
+	if ( num >= 0 && num < numFoliageSurfs ) {
+		fc = &foliageSurfs[ num ];
+	}
+	else
+	{
+		memset( &local, 0, sizeof( local ) );
+		fc = &local;
+		FindFoliageCandidates( src, fc );
+	}
+	c = fc->candidates;
+
+	/* do every foliage */
+	for ( foliage = si->foliage; foliage != NULL; foliage = foliage->next )
+	{
+		/* zero out */
+		numFoliageInstances = 0;
+
+		/* roll the dice for each candidate in order */
+		for ( ; c < fc->candidates + fc->numCandidates && c->foliage == foliage; c++ )
+		{
+			/* limit test */
+			if ( numFoliageInstances >= MAX_FOLIAGE_INSTANCES ) {
+				continue;
+			}
+
+			/* roll the dice */
+			r = Random();
+			if ( r > c->odds || !c->valid ) {
+				continue;
+			}
+
+			/* add it */
+			VectorCopy( c->xyz, foliageInstances[ numFoliageInstances ].xyz );
+			VectorCopy( c->normal, foliageInstances[ numFoliageInstances ].normal );
+			numFoliageInstances++;
+		}
 
 		/* any origins? */
 		if ( numFoliageInstances < 1 ) {
@@ -331,4 +455,8 @@ void Foliage( mapDrawSurface_t *src ){
 			ds->numVerts += ds->numFoliageInstances;
 		}
 	}
+
+	/* the candidates are used up */
+	free( fc->candidates );
+	memset( fc, 0, sizeof( *fc ) );
 }
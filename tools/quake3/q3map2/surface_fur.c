@@ -46,14 +46,15 @@
    ------------------------------------------------------------------------------- */
 
 /*
-   Fur()
-   runs the fur processing algorithm on a map drawsurface
+   OffsetFur()
+   moves the verts of a fur surface out along their normals, scaled by
+   their alpha.  this only touches the surface itself, so it can be done
+   for many surfaces at once before Fur() adds the layers
  */
 
-void Fur( mapDrawSurface_t *ds ){
-	int i, j, k, numLayers;
-	float offset, fade, a;
-	mapDrawSurface_t    *fur;
+void OffsetFur( mapDrawSurface_t *ds ){
+	int j;
+	float offset, a;
 	bspDrawVert_t       *dv;
 
 
@@ -63,13 +64,7 @@ void Fur( mapDrawSurface_t *ds ){
 	}
 
 	/* get basic info */
-	numLayers = ds->shaderInfo->furNumLayers;
 	offset = ds->shaderInfo->furOffset;
-	fade = ds->shaderInfo->furFade * 255.0f;
-
-	/* debug code */
-	//%	Sys_FPrintf( SYS_VRB, "Fur():  layers: %d  offset: %f   fade: %f  %s\n",
-	//%		numLayers, offset, fade, ds->shaderInfo->shader );
 
 	/* initial offset */
 	for ( j = 0; j < ds->numVerts; j++ )
@@ -83,6 +78,36 @@ void Fur( mapDrawSurface_t *ds ){
 		/* offset it */
 		VectorMA( dv->xyz, ( offset * a ), dv->normal, dv->xyz );
 	}
+}
+
+
+
+/*
+   Fur()
+   runs the fur processing algorithm on a map drawsurface, adding a layer
+   surface for every layer after the first.  OffsetFur() must be run first
+ */
+
+void Fur( mapDrawSurface_t *ds ){
+	int i, j, k, numLayers;
+	float offset, fade, a;
+	mapDrawSurface_t    *fur;
+	bspDrawVert_t       *dv;
+
+
+	/* dummy check */
+	if ( ds == NULL || ds->fur || ds->shaderInfo->furNumLayers < 1 ) {
+		return;
+	}
+
+	/* get basic info */
+	numLayers = ds->shaderInfo->furNumLayers;
+	offset = ds->shaderInfo->furOffset;
+	fade = ds->shaderInfo->furFade * 255.0f;
+
+	/* debug code */
+	//%	Sys_FPrintf( SYS_VRB, "Fur():  layers: %d  offset: %f   fade: %f  %s\n",
+	//%		numLayers, offset, fade, ds->shaderInfo->shader );
 
 	/* wash, rinse, repeat */
 	for ( i = 1; i < numLayers; i++ )
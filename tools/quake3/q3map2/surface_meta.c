@@ -49,6 +49,8 @@
 #define GROW_META_VERTS     1024
 #define GROW_META_TRIANGLES 1024
 
+#define META_VERT_HASHES    65536
+
 static int numMetaSurfaces, numPatchMetaSurfaces;
 
 static int maxMetaVerts = 0;
@@ -56,10 +58,55 @@ static int numMetaVerts = 0;
 static int firstSearchMetaVert = 0;
 static bspDrawVert_t        *metaVerts = NULL;
 
+/* metavertexes by position, chained newest first through metaVertChain */
+static int                  *metaVertHash = NULL;
+static int maxMetaVertChain = 0;
+static int                  *metaVertChain = NULL;
+
 static int maxMetaTriangles = 0;
 static int numMetaTriangles = 0;
 static metaTriangle_t       *metaTriangles = NULL;
 
+/* surfaces are converted on all threads into a pool per thread, and the pools are
+   appended to the lists above in surface order, so the lists come out the same */
+typedef struct metaPool_s
+{
+	int maxVerts, numVerts, firstSearchVert;
+	bspDrawVert_t       *verts;
+	int                 *hash;
+	int maxChain;
+	int                 *chain;
+	int maxTriangles, numTriangles;
+	metaTriangle_t      *triangles;
+}
+metaPool_t;
+
+/* where a surface's triangles went, pool vertex indexes start at firstVert */
+typedef struct metaPoolSurface_s
+{
+	int pool;
+	int firstVert, numVerts;
+	int firstTriangle, numTriangles;
+	qboolean converted, clear;
+}
+metaPoolSurface_t;
+
+static metaPool_t metaPools[ MAX_THREADS ];
+static entity_t             *metaEntity;
+static int metaFirstSurf;
+static metaPoolSurface_t    *metaPoolSurfaces;
+
+
+
+/*
+   MetaCellHash()
+   hashes a unit cell of the map
+ */
+
+static unsigned int MetaCellHash( int x, int y, int z ){
+	return (unsigned int) x * 73856093u ^ (unsigned int) y * 19349663u ^ (unsigned int) z * 83492791u;
+}
+
 
 
 /*
@@ -74,38 +121,59 @@ void ClearMetaTriangles( void ){
 
 
 
+/*
+   HashMetaVertex()
+   hashes the exact position bits, as the metavertex compare is exact too
+ */
+
+static int HashMetaVertex( const bspDrawVert_t *src ){
+	int i;
+	unsigned int h;
+	const byte      *p;
+
+
+	h = 2166136261u;
+	for ( i = 0, p = (const byte*) src->xyz; i < (int) sizeof( src->xyz ); i++ )
+		h = ( h ^ p[ i ] ) * 16777619u;
+	return h & ( META_VERT_HASHES - 1 );
+}
+
+
+
 /*
    FindMetaVertex()
    finds a matching metavertex in the global list, returning its index
  */
 
 static int FindMetaVertex( bspDrawVert_t *src ){
-	int i;
-	bspDrawVert_t   *v, *temp;
+	int i, prev, hash;
 
 
-	/* try to find an existing drawvert */
-	for ( i = firstSearchMetaVert, v = &metaVerts[ i ]; i < numMetaVerts; i++, v++ )
+	/* allocate the hash */
+	if ( metaVertHash == NULL ) {
+		metaVertHash = safe_malloc( META_VERT_HASHES * sizeof( *metaVertHash ) );
+		memset( metaVertHash, 0xFF, META_VERT_HASHES * sizeof( *metaVertHash ) );
+	}
+
+	/* try to find an existing drawvert in the search range. chains are not cleared between
+	   entities, but everything added since the range started comes first and in descending
+	   order, so the walk stops at the first index out of the range or out of order */
+	hash = HashMetaVertex( src );
+	for ( prev = numMetaVerts, i = metaVertHash[ hash ]; i >= firstSearchMetaVert && i < prev; prev = i, i = metaVertChain[ i ] )
 	{
-		if ( memcmp( src, v, sizeof( bspDrawVert_t ) ) == 0 ) {
+		if ( memcmp( src, &metaVerts[ i ], sizeof( bspDrawVert_t ) ) == 0 ) {
 			return i;
 		}
 	}
 
 	/* enough space? */
-	if ( numMetaVerts >= maxMetaVerts ) {
-		/* reallocate more room */
-		maxMetaVerts += GROW_META_VERTS;
-		temp = safe_malloc( maxMetaVerts * sizeof( bspDrawVert_t ) );
-		if ( metaVerts != NULL ) {
-			memcpy( temp, metaVerts, numMetaVerts * sizeof( bspDrawVert_t ) );
-			free( metaVerts );
-		}
-		metaVerts = temp;
-	}
+	AUTOEXPAND_BY_REALLOC( metaVerts, numMetaVerts, maxMetaVerts, GROW_META_VERTS );
+	AUTOEXPAND_BY_REALLOC( metaVertChain, numMetaVerts, maxMetaVertChain, GROW_META_VERTS );
 
-	/* add the triangle */
+	/* add the vertex */
 	memcpy( &metaVerts[ numMetaVerts ], src, sizeof( bspDrawVert_t ) );
+	metaVertChain[ numMetaVerts ] = metaVertHash[ hash ];
+	metaVertHash[ hash ] = numMetaVerts;
 	numMetaVerts++;
 
 	/* return the count */
@@ -115,26 +183,49 @@ static int FindMetaVertex( bspDrawVert_t *src ){
 
 
 /*
-   AddMetaTriangle()
-   adds a new meta triangle, allocating more memory if necessary
+   FindPoolMetaVertex()
+   same as FindMetaVertex() on a thread's pool
  */
 
-static int AddMetaTriangle( void ){
-	metaTriangle_t  *temp;
+static int FindPoolMetaVertex( metaPool_t *pool, bspDrawVert_t *src ){
+	int i, prev, hash;
 
 
-	/* enough space? */
-	if ( numMetaTriangles >= maxMetaTriangles ) {
-		/* reallocate more room */
-		maxMetaTriangles += GROW_META_TRIANGLES;
-		temp = safe_malloc( maxMetaTriangles * sizeof( metaTriangle_t ) );
-		if ( metaTriangles != NULL ) {
-			memcpy( temp, metaTriangles, numMetaTriangles * sizeof( metaTriangle_t ) );
-			free( metaTriangles );
+	/* allocate the hash */
+	if ( pool->hash == NULL ) {
+		pool->hash = safe_malloc( META_VERT_HASHES * sizeof( *pool->hash ) );
+		memset( pool->hash, 0xFF, META_VERT_HASHES * sizeof( *pool->hash ) );
+	}
+
+	/* try to find an existing drawvert in the search range */
+	hash = HashMetaVertex( src );
+	for ( prev = pool->numVerts, i = pool->hash[ hash ]; i >= pool->firstSearchVert && i < prev; prev = i, i = pool->chain[ i ] )
+	{
+		if ( memcmp( src, &pool->verts[ i ], sizeof( bspDrawVert_t ) ) == 0 ) {
+			return i;
 		}
-		metaTriangles = temp;
 	}
 
+	/* add the vertex */
+	AUTOEXPAND_BY_REALLOC( pool->verts, pool->numVerts, pool->maxVerts, GROW_META_VERTS );
+	AUTOEXPAND_BY_REALLOC( pool->chain, pool->numVerts, pool->maxChain, GROW_META_VERTS );
+	memcpy( &pool->verts[ pool->numVerts ], src, sizeof( bspDrawVert_t ) );
+	pool->chain[ pool->numVerts ] = pool->hash[ hash ];
+	pool->hash[ hash ] = pool->numVerts;
+	return pool->numVerts++;
+}
+
+
+
+/*
+   AddMetaTriangle()
+   adds a new meta triangle, allocating more memory if necessary
+ */
+
+static int AddMetaTriangle( void ){
+	/* enough space? */
+	AUTOEXPAND_BY_REALLOC( metaTriangles, numMetaTriangles, maxMetaTriangles, GROW_META_TRIANGLES );
+
 	/* increment and return */
 	numMetaTriangles++;
 	return numMetaTriangles - 1;
@@ -143,29 +234,27 @@ static int AddMetaTriangle( void ){
 
 
 /*
-   FindMetaTriangle()
-   finds a matching metatriangle in the global list,
-   otherwise adds it and returns the index to the metatriangle
+   SetupMetaTriangle()
+   finds the plane and lightmap axis of a metatriangle and repairs its normals,
+   returns qfalse for degenerate triangles
  */
 
-int FindMetaTriangle( metaTriangle_t *src, bspDrawVert_t *a, bspDrawVert_t *b, bspDrawVert_t *c, int planeNum ){
-	int triIndex;
+static qboolean SetupMetaTriangle( metaTriangle_t *src, bspDrawVert_t *a, bspDrawVert_t *b, bspDrawVert_t *c, int planeNum ){
 	vec3_t dir;
 
 
-
 	/* detect degenerate triangles fixme: do something proper here */
 	VectorSubtract( a->xyz, b->xyz, dir );
 	if ( VectorLength( dir ) < 0.125f ) {
-		return -1;
+		return qfalse;
 	}
 	VectorSubtract( b->xyz, c->xyz, dir );
 	if ( VectorLength( dir ) < 0.125f ) {
-		return -1;
+		return qfalse;
 	}
 	VectorSubtract( c->xyz, a->xyz, dir );
 	if ( VectorLength( dir ) < 0.125f ) {
-		return -1;
+		return qfalse;
 	}
 
 	/* find plane */
@@ -180,7 +269,7 @@ int FindMetaTriangle( metaTriangle_t *src, bspDrawVert_t *a, bspDrawVert_t *b, b
 		/* calculate a plane from the triangle's points (and bail if a plane can't be constructed) */
 		src->planeNum = -1;
 		if ( PlaneFromPoints( src->plane, a->xyz, b->xyz, c->xyz ) == qfalse ) {
-			return -1;
+			return qfalse;
 		}
 	}
 
@@ -209,6 +298,26 @@ int FindMetaTriangle( metaTriangle_t *src, bspDrawVert_t *a, bspDrawVert_t *b, b
 		}
 	}
 
+	return qtrue;
+}
+
+
+
+/*
+   FindMetaTriangle()
+   finds a matching metatriangle in the global list,
+   otherwise adds it and returns the index to the metatriangle
+ */
+
+int FindMetaTriangle( metaTriangle_t *src, bspDrawVert_t *a, bspDrawVert_t *b, bspDrawVert_t *c, int planeNum ){
+	int triIndex;
+
+
+	/* set it up */
+	if ( !SetupMetaTriangle( src, a, b, c, planeNum ) ) {
+		return -1;
+	}
+
 	/* fill out the src triangle */
 	src->indexes[ 0 ] = FindMetaVertex( a );
 	src->indexes[ 1 ] = FindMetaVertex( b );
@@ -242,12 +351,35 @@ int FindMetaTriangle( metaTriangle_t *src, bspDrawVert_t *a, bspDrawVert_t *b, b
 
 
 
+/*
+   AddPoolMetaTriangle()
+   same as FindMetaTriangle() on a thread's pool
+ */
+
+static void AddPoolMetaTriangle( metaPool_t *pool, metaTriangle_t *src, bspDrawVert_t *a, bspDrawVert_t *b, bspDrawVert_t *c, int planeNum ){
+	/* set it up */
+	if ( !SetupMetaTriangle( src, a, b, c, planeNum ) ) {
+		return;
+	}
+
+	/* fill out the src triangle */
+	src->indexes[ 0 ] = FindPoolMetaVertex( pool, a );
+	src->indexes[ 1 ] = FindPoolMetaVertex( pool, b );
+	src->indexes[ 2 ] = FindPoolMetaVertex( pool, c );
+
+	/* add the triangle */
+	AUTOEXPAND_BY_REALLOC( pool->triangles, pool->numTriangles, pool->maxTriangles, GROW_META_TRIANGLES );
+	memcpy( &pool->triangles[ pool->numTriangles++ ], src, sizeof( metaTriangle_t ) );
+}
+
+
+
 /*
    SurfaceToMetaTriangles()
-   converts a classified surface to metatriangles
+   converts a classified surface to metatriangles in a thread's pool
  */
 
-static void SurfaceToMetaTriangles( mapDrawSurface_t *ds ){
+static void SurfaceToMetaTriangles( metaPool_t *pool, mapDrawSurface_t *ds, metaPoolSurface_t *ps ){
 	int i;
 	metaTriangle_t src;
 	bspDrawVert_t a, b, c;
@@ -262,7 +394,9 @@ static void SurfaceToMetaTriangles( mapDrawSurface_t *ds ){
 	}
 
 	/* speed at the expense of memory */
-	firstSearchMetaVert = numMetaVerts;
+	pool->firstSearchVert = pool->numVerts;
+	ps->firstVert = pool->numVerts;
+	ps->firstTriangle = pool->numTriangles;
 
 	/* only handle valid surfaces */
 	if ( ds->type != SURFACE_BAD && ds->numVerts >= 3 && ds->numIndexes >= 3 ) {
@@ -294,28 +428,27 @@ static void SurfaceToMetaTriangles( mapDrawSurface_t *ds ){
 			memcpy( &a, &ds->verts[ ds->indexes[ i ] ], sizeof( a ) );
 			memcpy( &b, &ds->verts[ ds->indexes[ i + 1 ] ], sizeof( b ) );
 			memcpy( &c, &ds->verts[ ds->indexes[ i + 2 ] ], sizeof( c ) );
-			FindMetaTriangle( &src, &a, &b, &c, ds->planeNum );
+			AddPoolMetaTriangle( pool, &src, &a, &b, &c, ds->planeNum );
 		}
 
 		/* add to count */
-		numMetaSurfaces++;
+		ps->converted = qtrue;
 	}
+	ps->numVerts = pool->numVerts - ps->firstVert;
+	ps->numTriangles = pool->numTriangles - ps->firstTriangle;
 
-	/* clear the surface (free verts and indexes, sets it to SURFACE_BAD) */
-	ClearSurface( ds );
+	/* the surface is cleared when the triangles are appended, ClearSurface() counts */
+	ps->clear = qtrue;
 }
 
 
 
 /*
-   TriangulatePatchSurface()
-   creates triangles from a patch
+   PatchMetaIterations()
+   returns the subdivision iterations of a patch made into meta triangles, or -1
  */
 
-void TriangulatePatchSurface( entity_t *e, mapDrawSurface_t *ds ){
-	int iterations, x, y, pw[ 5 ], r;
-	mapDrawSurface_t    *dsNew;
-	mesh_t src, *subdivided, *mesh;
+static int PatchMetaIterations( entity_t *e, mapDrawSurface_t *ds ){
 	int forcePatchMeta;
 	int patchQuality;
 	int patchSubdivision;
@@ -339,6 +472,31 @@ void TriangulatePatchSurface( entity_t *e, mapDrawSurface_t *ds ){
 
 	/* try to early out */
 	if ( ds->numVerts == 0 || ds->type != SURFACE_PATCH || ( patchMeta == qfalse && !forcePatchMeta ) ) {
+		return -1;
+	}
+
+	if ( patchSubdivision ) {
+		return IterationsForCurve( ds->longestCurve, patchSubdivision );
+	}
+	return IterationsForCurve( ds->longestCurve, patchSubdivisions / patchQuality );
+}
+
+
+
+/*
+   TriangulatePatchSurface()
+   creates triangles from a patch
+ */
+
+void TriangulatePatchSurface( entity_t *e, mapDrawSurface_t *ds ){
+	int iterations, x, y, pw[ 5 ], r;
+	mapDrawSurface_t    *dsNew;
+	mesh_t src, *mesh;
+
+
+	/* try to early out */
+	iterations = PatchMetaIterations( e, ds );
+	if ( iterations < 0 ) {
 		return;
 	}
 
@@ -347,19 +505,9 @@ void TriangulatePatchSurface( entity_t *e, mapDrawSurface_t *ds ){
 	src.height = ds->patchHeight;
 	src.verts = ds->verts;
 	//%	subdivided = SubdivideMesh( src, 8, 999 );
-	if ( patchSubdivision ) {
-		iterations = IterationsForCurve( ds->longestCurve, patchSubdivision );
-	}
-	else{
-		iterations = IterationsForCurve( ds->longestCurve, patchSubdivisions / patchQuality );
-	}
 
-	subdivided = SubdivideMesh2( src, iterations ); //%	ds->maxIterations
-
-	/* fit it to the curve and remove colinear verts on rows/columns */
-	PutMeshOnCurve( *subdivided );
-	mesh = RemoveLinearMeshColumnsRows( subdivided );
-	FreeMesh( subdivided );
+	/* subdivide it, fit it to the curve and remove colinear verts on rows/columns */
+	mesh = TesselateMesh( src, iterations ); //%	ds->maxIterations
 	//% MakeMeshNormals( mesh );
 
 	/* make a copy of the drawsurface */
@@ -860,46 +1008,150 @@ void EmitMetaStats(){
 
 
 
+/*
+   IsMetaSurface()
+   returns qtrue if a surface of the entity is made into meta triangles
+ */
+
+static qboolean IsMetaSurface( mapDrawSurface_t *ds ){
+	/* ignore empty and autosprite surfaces */
+	if ( ds->numVerts <= 0 || ds->shaderInfo->autosprite ) {
+		return qfalse;
+	}
+
+	/* meta this surface? */
+	return meta || ds->shaderInfo->forceMeta;
+}
+
+
+
+/*
+   CacheMetaPatchThread()
+   tesselates a patch of the entity ahead of TriangulatePatchSurface()
+ */
+
+static void CacheMetaPatchThread( int num ){
+	int iterations;
+	mapDrawSurface_t    *ds;
+	mesh_t src;
+
+
+	ds = &mapDrawSurfs[ metaFirstSurf + num ];
+	if ( ds->type != SURFACE_PATCH || !IsMetaSurface( ds ) ) {
+		return;
+	}
+	iterations = PatchMetaIterations( metaEntity, ds );
+	if ( iterations >= 0 ) {
+		src.width = ds->patchWidth;
+		src.height = ds->patchHeight;
+		src.verts = ds->verts;
+		CacheTesselatedMesh( src, iterations );
+	}
+}
+
+
+
+/*
+   MetaTrianglesThread()
+   converts a surface of the entity into the pool of the calling thread
+ */
+
+static void MetaTrianglesThread( int num ){
+	mapDrawSurface_t    *ds;
+	metaPoolSurface_t   *ps;
+
+
+	ds = &mapDrawSurfs[ metaFirstSurf + num ];
+	if ( !IsMetaSurface( ds ) ) {
+		return;
+	}
+	ps = &metaPoolSurfaces[ num ];
+	ps->pool = ThreadNumber();
+	SurfaceToMetaTriangles( &metaPools[ ps->pool ], ds, ps );
+}
+
+
+
+/*
+   AppendMetaTriangles()
+   appends the metavertexes and metatriangles of a converted surface to the global lists
+ */
+
+static void AppendMetaTriangles( metaPoolSurface_t *ps, mapDrawSurface_t *ds ){
+	int i, j, hash, offset;
+	metaPool_t          *pool;
+	metaTriangle_t      *tri;
+
+
+	/* allocate the hash */
+	if ( metaVertHash == NULL ) {
+		metaVertHash = safe_malloc( META_VERT_HASHES * sizeof( *metaVertHash ) );
+		memset( metaVertHash, 0xFF, META_VERT_HASHES * sizeof( *metaVertHash ) );
+	}
+
+	/* the surface's vertexes are already unique, so they are added as they are */
+	pool = &metaPools[ ps->pool ];
+	offset = numMetaVerts - ps->firstVert;
+	for ( i = ps->firstVert; i < ps->firstVert + ps->numVerts; i++ )
+	{
+		AUTOEXPAND_BY_REALLOC( metaVerts, numMetaVerts, maxMetaVerts, GROW_META_VERTS );
+		AUTOEXPAND_BY_REALLOC( metaVertChain, numMetaVerts, maxMetaVertChain, GROW_META_VERTS );
+		memcpy( &metaVerts[ numMetaVerts ], &pool->verts[ i ], sizeof( bspDrawVert_t ) );
+		hash = HashMetaVertex( &pool->verts[ i ] );
+		metaVertChain[ numMetaVerts ] = metaVertHash[ hash ];
+		metaVertHash[ hash ] = numMetaVerts;
+		numMetaVerts++;
+	}
+
+	/* add the triangles */
+	for ( i = ps->firstTriangle; i < ps->firstTriangle + ps->numTriangles; i++ )
+	{
+		j = AddMetaTriangle();
+		tri = &metaTriangles[ j ];
+		memcpy( tri, &pool->triangles[ i ], sizeof( *tri ) );
+		for ( j = 0; j < 3; j++ )
+			tri->indexes[ j ] += offset;
+	}
+
+	/* add to count */
+	if ( ps->converted ) {
+		numMetaSurfaces++;
+	}
+
+	/* clear the surface (free verts and indexes, sets it to SURFACE_BAD) */
+	if ( ps->clear ) {
+		ClearSurface( ds );
+	}
+}
+
+
+
 /*
    MakeEntityMetaTriangles()
    builds meta triangles from brush faces (tristrips and fans)
  */
 
 void MakeEntityMetaTriangles( entity_t *e ){
-	int i, f, fOld, start;
+	int i, numSurfs;
 	mapDrawSurface_t    *ds;
 
 
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- MakeEntityMetaTriangles ---\n" );
+	ProfileBegin( "MakeEntityMetaTriangles" );
 
-	/* init pacifier */
-	fOld = -1;
-	start = I_FloatTime();
+	/* tesselate the patches on all threads */
+	metaEntity = e;
+	metaFirstSurf = e->firstDrawSurf;
+	RunThreadsOnIndividual( numMapDrawSurfs - e->firstDrawSurf, qfalse, CacheMetaPatchThread );
 
-	/* walk the list of surfaces in the entity */
+	/* strip the faces and triangulate the patches in surface order, as both can find new planes
+	   and patches add surfaces to the end of the list */
 	for ( i = e->firstDrawSurf; i < numMapDrawSurfs; i++ )
 	{
-		/* print pacifier */
-		f = 10 * ( i - e->firstDrawSurf ) / ( numMapDrawSurfs - e->firstDrawSurf );
-		if ( f != fOld ) {
-			fOld = f;
-			Sys_FPrintf( SYS_VRB, "%d...", f );
-		}
-
 		/* get surface */
 		ds = &mapDrawSurfs[ i ];
-		if ( ds->numVerts <= 0 ) {
-			continue;
-		}
-
-		/* ignore autosprite surfaces */
-		if ( ds->shaderInfo->autosprite ) {
-			continue;
-		}
-
-		/* meta this surface? */
-		if ( meta == qfalse && ds->shaderInfo->forceMeta == qfalse ) {
+		if ( !IsMetaSurface( ds ) ) {
 			continue;
 		}
 
@@ -914,30 +1166,33 @@ void MakeEntityMetaTriangles( entity_t *e ){
 			else{
 				StripFaceSurface( ds );
 			}
-			SurfaceToMetaTriangles( ds );
 			break;
 
 		case SURFACE_PATCH:
 			TriangulatePatchSurface( e, ds );
 			break;
 
-		case SURFACE_TRIANGLES:
-			break;
-
-		case SURFACE_FORCED_META:
-		case SURFACE_META:
-			SurfaceToMetaTriangles( ds );
-			break;
-
 		default:
 			break;
 		}
 	}
 
-	/* print time */
-	if ( ( numMapDrawSurfs - e->firstDrawSurf ) ) {
-		Sys_FPrintf( SYS_VRB, " (%d)\n", (int) ( I_FloatTime() - start ) );
+	/* convert the surfaces into the thread pools */
+	for ( i = 0; i < MAX_THREADS; i++ )
+	{
+		metaPools[ i ].numVerts = 0;
+		metaPools[ i ].numTriangles = 0;
 	}
+	numSurfs = numMapDrawSurfs - e->firstDrawSurf;
+	metaPoolSurfaces = safe_malloc( numSurfs * sizeof( *metaPoolSurfaces ) );
+	memset( metaPoolSurfaces, 0, numSurfs * sizeof( *metaPoolSurfaces ) );
+	RunThreadsOnIndividual( numSurfs, verbose, MetaTrianglesThread );
+
+	/* append them in surface order */
+	for ( i = 0; i < numSurfs; i++ )
+		AppendMetaTriangles( &metaPoolSurfaces[ i ], &mapDrawSurfs[ e->firstDrawSurf + i ] );
+	free( metaPoolSurfaces );
+	metaPoolSurfaces = NULL;
 
 	/* emit some stats */
 	Sys_FPrintf( SYS_VRB, "%9d total meta surfaces\n", numMetaSurfaces );
@@ -950,6 +1205,8 @@ void MakeEntityMetaTriangles( entity_t *e ){
 
 	/* tidy things up */
 	TidyEntitySurfaces( e );
+
+	ProfileEnd();
 }
 
 
@@ -1180,97 +1437,47 @@ void FixMetaTJunctions( void ){
 
 /*
    SmoothMetaTriangles()
-   averages coincident vertex normals in the meta triangles
+   averages coincident vertex normals in the meta triangles.
+   vertexes within EQUAL_EPSILON of each other are put in groups, and as no vertex
+   is smoothed with one outside its group, the groups are smoothed on all threads.
+   each group is walked in vertex order, same as walking the whole list
  */
 
 #define MAX_SAMPLES             256
 #define THETA_EPSILON           0.000001
 #define EQUAL_NORMAL_EPSILON    0.01
 
-void SmoothMetaTriangles( void ){
-	int i, j, k, f, fOld, start, cs, numVerts, numVotes, numSmoothed;
-	float shadeAngle, defaultShadeAngle, maxShadeAngle, dot, testAngle;
-	metaTriangle_t  *tri;
-	float           *shadeAngles;
-	byte            *smoothed;
-	vec3_t average, diff;
-	int indexes[ MAX_SAMPLES ];
-	vec3_t votes[ MAX_SAMPLES ];
+static float                *smoothShadeAngles;
+static byte                 *smoothSmoothed;
+static int                  *smoothGroupVerts;
+static int                  *smoothGroupStart;
+static int smoothCounts[ MAX_THREADS ];
 
-	/* note it */
-	Sys_FPrintf( SYS_VRB, "--- SmoothMetaTriangles ---\n" );
-
-	/* allocate shade angle table */
-	shadeAngles = safe_malloc( numMetaVerts * sizeof( float ) );
-	memset( shadeAngles, 0, numMetaVerts * sizeof( float ) );
-
-	/* allocate smoothed table */
-	cs = ( numMetaVerts / 8 ) + 1;
-	smoothed = safe_malloc( cs );
-	memset( smoothed, 0, cs );
-
-	/* set default shade angle */
-	defaultShadeAngle = DEG2RAD( npDegrees );
-	maxShadeAngle = 0.0f;
-
-	/* run through every surface and flag verts belonging to non-lightmapped surfaces
-	   and set per-vertex smoothing angle */
-	for ( i = 0, tri = &metaTriangles[ i ]; i < numMetaTriangles; i++, tri++ )
+static int FindSmoothGroup( int *parents, int i ){
+	while ( parents[ i ] != i )
 	{
-		shadeAngle = defaultShadeAngle;
-
-		/* get shade angle from shader */
-		if ( tri->si->shadeAngleDegrees > 0.0f ) {
-			shadeAngle = DEG2RAD( tri->si->shadeAngleDegrees );
-		}
-		/* get shade angle from entity */
-		else if ( tri->shadeAngleDegrees > 0.0f ) {
-			shadeAngle = DEG2RAD( tri->shadeAngleDegrees );
-		}
-
-		if ( shadeAngle <= 0.0f ) {
-			shadeAngle = defaultShadeAngle;
-		}
-
-		if ( shadeAngle > maxShadeAngle ) {
-			maxShadeAngle = shadeAngle;
-		}
-
-		/* flag its verts */
-		for ( j = 0; j < 3; j++ )
-		{
-			shadeAngles[ tri->indexes[ j ] ] = shadeAngle;
-			if ( shadeAngle <= 0 ) {
-				smoothed[ tri->indexes[ j ] >> 3 ] |= ( 1 << ( tri->indexes[ j ] & 7 ) );
-			}
-		}
+		parents[ i ] = parents[ parents[ i ] ];
+		i = parents[ i ];
 	}
+	return i;
+}
 
-	/* bail if no surfaces have a shade angle */
-	if ( maxShadeAngle <= 0 ) {
-		Sys_FPrintf( SYS_VRB, "No smoothing angles specified, aborting\n" );
-		free( shadeAngles );
-		free( smoothed );
-		return;
-	}
+static void SmoothMetaGroup( int num ){
+	int i, j, k, a, b, first, last, numVerts, numVotes;
+	float shadeAngle, dot, testAngle;
+	vec3_t average, diff;
+	int indexes[ MAX_SAMPLES ];
+	vec3_t votes[ MAX_SAMPLES ];
 
-	/* init pacifier */
-	fOld = -1;
-	start = I_FloatTime();
 
-	/* go through the list of vertexes */
-	numSmoothed = 0;
-	for ( i = 0; i < numMetaVerts; i++ )
+	/* go through the group's vertexes */
+	first = smoothGroupStart[ num ];
+	last = smoothGroupStart[ num + 1 ];
+	for ( a = first; a < last; a++ )
 	{
-		/* print pacifier */
-		f = 10 * i / numMetaVerts;
-		if ( f != fOld ) {
-			fOld = f;
-			Sys_FPrintf( SYS_VRB, "%d...", f );
-		}
-
 		/* already smoothed? */
-		if ( smoothed[ i >> 3 ] & ( 1 << ( i & 7 ) ) ) {
+		i = smoothGroupVerts[ a ];
+		if ( smoothSmoothed[ i ] ) {
 			continue;
 		}
 
@@ -1280,10 +1487,11 @@ void SmoothMetaTriangles( void ){
 		numVotes = 0;
 
 		/* build a table of coincident vertexes */
-		for ( j = i; j < numMetaVerts && numVerts < MAX_SAMPLES; j++ )
+		for ( b = a; b < last && numVerts < MAX_SAMPLES; b++ )
 		{
 			/* already smoothed? */
-			if ( smoothed[ j >> 3 ] & ( 1 << ( j & 7 ) ) ) {
+			j = smoothGroupVerts[ b ];
+			if ( smoothSmoothed[ j ] ) {
 				continue;
 			}
 
@@ -1293,7 +1501,7 @@ void SmoothMetaTriangles( void ){
 			}
 
 			/* use smallest shade angle */
-			shadeAngle = ( shadeAngles[ i ] < shadeAngles[ j ] ? shadeAngles[ i ] : shadeAngles[ j ] );
+			shadeAngle = ( smoothShadeAngles[ i ] < smoothShadeAngles[ j ] ? smoothShadeAngles[ i ] : smoothShadeAngles[ j ] );
 
 			/* check shade angle */
 			dot = DotProduct( metaVerts[ i ].normal, metaVerts[ j ].normal );
@@ -1312,7 +1520,7 @@ void SmoothMetaTriangles( void ){
 			indexes[ numVerts++ ] = j;
 
 			/* flag vertex */
-			smoothed[ j >> 3 ] |= ( 1 << ( j & 7 ) );
+			smoothSmoothed[ j ] = 1;
 
 			/* see if this normal has already been voted */
 			for ( k = 0; k < numVotes; k++ )
@@ -1343,19 +1551,168 @@ void SmoothMetaTriangles( void ){
 			/* smooth */
 			for ( j = 0; j < numVerts; j++ )
 				VectorCopy( average, metaVerts[ indexes[ j ] ].normal );
-			numSmoothed++;
+			smoothCounts[ ThreadNumber() ]++;
 		}
 	}
+}
 
-	/* free the tables */
-	free( shadeAngles );
-	free( smoothed );
+void SmoothMetaTriangles( void ){
+	int i, j, k, x, y, z, mins[ 3 ], maxs[ 3 ], hash, hashMask, numGroups, numGroupVerts, numSmoothed;
+	float shadeAngle, defaultShadeAngle, maxShadeAngle;
+	metaTriangle_t  *tri;
+	int             *hashHeads, *hashChain, *parents, *sizes, *cursors;
 
-	/* print time */
-	Sys_FPrintf( SYS_VRB, " (%d)\n", (int) ( I_FloatTime() - start ) );
+	/* note it */
+	Sys_FPrintf( SYS_VRB, "--- SmoothMetaTriangles ---\n" );
+
+	/* allocate shade angle table */
+	smoothShadeAngles = safe_malloc( numMetaVerts * sizeof( float ) );
+	memset( smoothShadeAngles, 0, numMetaVerts * sizeof( float ) );
+
+	/* allocate smoothed table, a byte per vertex so threads never share one */
+	smoothSmoothed = safe_malloc( numMetaVerts + 1 );
+	memset( smoothSmoothed, 0, numMetaVerts + 1 );
+
+	/* set default shade angle */
+	defaultShadeAngle = DEG2RAD( npDegrees );
+	maxShadeAngle = 0.0f;
+
+	/* run through every surface and flag verts belonging to non-lightmapped surfaces
+	   and set per-vertex smoothing angle */
+	for ( i = 0, tri = &metaTriangles[ i ]; i < numMetaTriangles; i++, tri++ )
+	{
+		shadeAngle = defaultShadeAngle;
+
+		/* get shade angle from shader */
+		if ( tri->si->shadeAngleDegrees > 0.0f ) {
+			shadeAngle = DEG2RAD( tri->si->shadeAngleDegrees );
+		}
+		/* get shade angle from entity */
+		else if ( tri->shadeAngleDegrees > 0.0f ) {
+			shadeAngle = DEG2RAD( tri->shadeAngleDegrees );
+		}
+
+		if ( shadeAngle <= 0.0f ) {
+			shadeAngle = defaultShadeAngle;
+		}
+
+		if ( shadeAngle > maxShadeAngle ) {
+			maxShadeAngle = shadeAngle;
+		}
+
+		/* flag its verts */
+		for ( j = 0; j < 3; j++ )
+		{
+			smoothShadeAngles[ tri->indexes[ j ] ] = shadeAngle;
+			if ( shadeAngle <= 0 ) {
+				smoothSmoothed[ tri->indexes[ j ] ] = 1;
+			}
+		}
+	}
+
+	/* bail if no surfaces have a shade angle */
+	if ( maxShadeAngle <= 0 ) {
+		Sys_FPrintf( SYS_VRB, "No smoothing angles specified, aborting\n" );
+		free( smoothShadeAngles );
+		free( smoothSmoothed );
+		return;
+	}
+
+	ProfileBegin( "SmoothMetaTriangles" );
+
+	/* join each vertex with the earlier ones within epsilon, found by unit cell */
+	for ( hashMask = 255; hashMask < numMetaVerts; hashMask = hashMask * 2 + 1 ) ;
+	hashHeads = safe_malloc( ( hashMask + 1 ) * sizeof( *hashHeads ) );
+	memset( hashHeads, 0xFF, ( hashMask + 1 ) * sizeof( *hashHeads ) );
+	hashChain = safe_malloc( ( numMetaVerts + 1 ) * sizeof( *hashChain ) );
+	parents = safe_malloc( ( numMetaVerts + 1 ) * sizeof( *parents ) );
+	for ( i = 0; i < numMetaVerts; i++ )
+	{
+		parents[ i ] = i;
+		if ( smoothSmoothed[ i ] ) {
+			continue;
+		}
+
+		for ( k = 0; k < 3; k++ )
+		{
+			mins[ k ] = floor( metaVerts[ i ].xyz[ k ] - EQUAL_EPSILON );
+			maxs[ k ] = floor( metaVerts[ i ].xyz[ k ] + EQUAL_EPSILON );
+		}
+		for ( x = mins[ 0 ]; x <= maxs[ 0 ]; x++ )
+			for ( y = mins[ 1 ]; y <= maxs[ 1 ]; y++ )
+				for ( z = mins[ 2 ]; z <= maxs[ 2 ]; z++ )
+				{
+					for ( j = hashHeads[ MetaCellHash( x, y, z ) & hashMask ]; j >= 0; j = hashChain[ j ] )
+					{
+						if ( VectorCompare( metaVerts[ i ].xyz, metaVerts[ j ].xyz ) ) {
+							parents[ FindSmoothGroup( parents, j ) ] = FindSmoothGroup( parents, i );
+						}
+					}
+				}
+
+		hash = MetaCellHash( floor( metaVerts[ i ].xyz[ 0 ] ), floor( metaVerts[ i ].xyz[ 1 ] ), floor( metaVerts[ i ].xyz[ 2 ] ) ) & hashMask;
+		hashChain[ i ] = hashHeads[ hash ];
+		hashHeads[ hash ] = i;
+	}
+
+	free( hashHeads );
+
+	/* number the groups of more than one vertex, the hash chains hold the group sizes */
+	sizes = hashChain;
+	memset( sizes, 0, numMetaVerts * sizeof( *sizes ) );
+	for ( i = 0; i < numMetaVerts; i++ )
+	{
+		if ( !smoothSmoothed[ i ] ) {
+			parents[ i ] = FindSmoothGroup( parents, i );
+			sizes[ parents[ i ] ]++;
+		}
+	}
+	smoothGroupStart = safe_malloc( ( numMetaVerts + 1 ) * sizeof( *smoothGroupStart ) );
+	cursors = safe_malloc( ( numMetaVerts + 1 ) * sizeof( *cursors ) );
+	numGroups = 0;
+	numGroupVerts = 0;
+	for ( i = 0; i < numMetaVerts; i++ )
+	{
+		if ( sizes[ i ] > 1 ) {
+			smoothGroupStart[ numGroups ] = cursors[ numGroups ] = numGroupVerts;
+			numGroupVerts += sizes[ i ];
+			sizes[ i ] = numGroups++;
+		}
+		else{
+			sizes[ i ] = -1;
+		}
+	}
+	smoothGroupStart[ numGroups ] = numGroupVerts;
+
+	/* list the vertexes of each group in order */
+	smoothGroupVerts = safe_malloc( ( numGroupVerts + 1 ) * sizeof( *smoothGroupVerts ) );
+	for ( i = 0; i < numMetaVerts; i++ )
+	{
+		if ( !smoothSmoothed[ i ] && sizes[ parents[ i ] ] >= 0 ) {
+			smoothGroupVerts[ cursors[ sizes[ parents[ i ] ] ]++ ] = i;
+		}
+	}
+	free( cursors );
+	free( sizes );
+	free( parents );
+
+	/* smooth the groups */
+	memset( smoothCounts, 0, sizeof( smoothCounts ) );
+	RunThreadsOnIndividual( numGroups, verbose, SmoothMetaGroup );
+	numSmoothed = 0;
+	for ( i = 0; i < MAX_THREADS; i++ )
+		numSmoothed += smoothCounts[ i ];
+
+	/* free the tables */
+	free( smoothShadeAngles );
+	free( smoothSmoothed );
+	free( smoothGroupStart );
+	free( smoothGroupVerts );
 
 	/* emit some stats */
 	Sys_FPrintf( SYS_VRB, "%9d smoothed vertexes\n", numSmoothed );
+
+	ProfileEnd();
 }
 
 
@@ -1397,7 +1754,6 @@ int AddMetaVertToSurface( mapDrawSurface_t *ds, bspDrawVert_t *dv1, int *coincid
 		}
 
 		/* found a winner */
-		numMergedVerts++;
 		return i;
 	}
 
@@ -1650,10 +2006,10 @@ static int AddMetaTriangleToSurface( mapDrawSurface_t *ds, metaTriangle_t *tri,
 
 		/* mark triangle as used */
 		tri->si = NULL;
-	}
 
-	/* add a side reference */
-	ds->sideRef = AllocSideRef( tri->side, ds->sideRef );
+		/* add a side reference */
+		ds->sideRef = AllocSideRef( tri->side, ds->sideRef );
+	}
 
 	/* return to sender */
 	return score;
@@ -1661,23 +2017,216 @@ static int AddMetaTriangleToSurface( mapDrawSurface_t *ds, metaTriangle_t *tri,
 
 
 
+/*
+   merge candidates
+
+   a triangle that shares no vertex (position and normal) with the surface being
+   grown scores at most META_LONE_SCORE, which is below the adequate and good
+   scores, so it can never be picked.  the possibles are therefore listed by the
+   unit cells their vertexes touch, and only triangles listed in the cells of the
+   surface's vertexes (plus triangles that coincide with themselves) are scored.
+   candidates are kept in possibles order, so the result is the same as scoring
+   the whole list.  with -metaadequatescore/-metagoodscore at or below
+   META_LONE_SCORE every later triangle is a candidate, like before
+ */
+
+#define META_LONE_SCORE     ( (AXIS_SCORE) +(SURFACE_SCORE) +2 * ( ST_SCORE2 ) )
+#define META_CELL_EPSILON   ( 2 * EQUAL_EPSILON )
+
+typedef struct metaCandidates_s
+{
+	int numPossibles;
+	metaTriangle_t      *possibles;
+	qboolean all;
+
+	/* triangles by vertex cell */
+	int hashMask;
+	int                 *hash;
+	int numCellTris, maxCellTris;
+	int                 *cellTris;      /* pairs of triangle and next */
+
+	/* triangles that coincide with themselves */
+	int numSelf;
+	int                 *self;
+
+	/* sorted candidates of the current surface */
+	int                 *stamp;
+	int numCands;
+	int                 *cands;
+}
+metaCandidates_t;
+
+
+
+/*
+   InitMetaCandidates()
+   lists the possibles by the cells their vertexes touch
+ */
+
+static void InitMetaCandidates( metaCandidates_t *mc, int numPossibles, metaTriangle_t *possibles ){
+	int i, j, k, x, y, z, mins[ 3 ], maxs[ 3 ], hash;
+	bspDrawVert_t       *a, *b;
+
+
+	memset( mc, 0, sizeof( *mc ) );
+	mc->numPossibles = numPossibles;
+	mc->possibles = possibles;
+	mc->all = ( ADEQUATE_SCORE < META_LONE_SCORE || GOOD_SCORE <= META_LONE_SCORE );
+	mc->stamp = safe_malloc( numPossibles * sizeof( *mc->stamp ) );
+	memset( mc->stamp, 0xFF, numPossibles * sizeof( *mc->stamp ) );
+	mc->cands = safe_malloc( numPossibles * sizeof( *mc->cands ) );
+	if ( mc->all ) {
+		return;
+	}
+
+	/* size the hash */
+	for ( mc->hashMask = 255; mc->hashMask < numPossibles * 3; mc->hashMask = mc->hashMask * 2 + 1 ) ;
+	mc->hash = safe_malloc( ( mc->hashMask + 1 ) * sizeof( *mc->hash ) );
+	memset( mc->hash, 0xFF, ( mc->hashMask + 1 ) * sizeof( *mc->hash ) );
+	mc->self = safe_malloc( numPossibles * sizeof( *mc->self ) );
+
+	for ( i = 0; i < numPossibles; i++ )
+	{
+		/* coincident with itself? */
+		for ( j = 0; j < 3; j++ )
+		{
+			a = &metaVerts[ possibles[ i ].indexes[ j ] ];
+			b = &metaVerts[ possibles[ i ].indexes[ ( j + 1 ) % 3 ] ];
+			if ( VectorCompare( a->xyz, b->xyz ) && VectorCompare( a->normal, b->normal ) ) {
+				mc->self[ mc->numSelf++ ] = i;
+				break;
+			}
+		}
+
+		/* list it in every cell within epsilon of a vertex */
+		for ( j = 0; j < 3; j++ )
+		{
+			a = &metaVerts[ possibles[ i ].indexes[ j ] ];
+			for ( k = 0; k < 3; k++ )
+			{
+				mins[ k ] = floor( a->xyz[ k ] - META_CELL_EPSILON );
+				maxs[ k ] = floor( a->xyz[ k ] + META_CELL_EPSILON );
+			}
+			for ( x = mins[ 0 ]; x <= maxs[ 0 ]; x++ )
+				for ( y = mins[ 1 ]; y <= maxs[ 1 ]; y++ )
+					for ( z = mins[ 2 ]; z <= maxs[ 2 ]; z++ )
+					{
+						hash = MetaCellHash( x, y, z ) & mc->hashMask;
+						AUTOEXPAND_BY_REALLOC( mc->cellTris, mc->numCellTris * 2 + 1, mc->maxCellTris, 1024 );
+						mc->cellTris[ mc->numCellTris * 2 ] = i;
+						mc->cellTris[ mc->numCellTris * 2 + 1 ] = mc->hash[ hash ];
+						mc->hash[ hash ] = mc->numCellTris++;
+					}
+		}
+	}
+}
+
+
+
+/*
+   FreeMetaCandidates()
+   frees the candidate lists of a list of possibles
+ */
+
+static void FreeMetaCandidates( metaCandidates_t *mc ){
+	free( mc->hash );
+	free( mc->cellTris );
+	free( mc->self );
+	free( mc->stamp );
+	free( mc->cands );
+}
+
+
+
+/*
+   AddMetaCandidate()
+   inserts a triangle into the sorted candidates of the surface seeded by triangle seed,
+   moving the scan position *scan along if it goes before it
+ */
+
+static void AddMetaCandidate( metaCandidates_t *mc, int seed, int tri, int *scan ){
+	int lo, hi, mid;
+
+
+	/* not after the seed, merged already or listed already? */
+	if ( tri <= seed || mc->possibles[ tri ].si == NULL || mc->stamp[ tri ] == seed ) {
+		return;
+	}
+	mc->stamp[ tri ] = seed;
+
+	/* find its place */
+	lo = 0;
+	hi = mc->numCands;
+	while ( lo < hi )
+	{
+		mid = ( lo + hi ) / 2;
+		if ( mc->cands[ mid ] < tri ) {
+			lo = mid + 1;
+		}
+		else{
+			hi = mid;
+		}
+	}
+
+	/* insert it */
+	memmove( &mc->cands[ lo + 1 ], &mc->cands[ lo ], ( mc->numCands - lo ) * sizeof( *mc->cands ) );
+	mc->cands[ lo ] = tri;
+	mc->numCands++;
+	if ( scan != NULL && lo <= *scan ) {
+		( *scan )++;
+	}
+}
+
+
+
+/*
+   AddMetaCandidates()
+   adds the triangles that touch the surface's vertexes from firstVert on
+ */
+
+static void AddMetaCandidates( metaCandidates_t *mc, int seed, mapDrawSurface_t *ds, int firstVert, int *scan ){
+	int i, c, hash;
+	float               *xyz;
+
+
+	/* all later triangles are candidates from the start */
+	if ( mc->all ) {
+		return;
+	}
+
+	for ( i = firstVert; i < ds->numVerts; i++ )
+	{
+		xyz = ds->verts[ i ].xyz;
+		hash = MetaCellHash( floor( xyz[ 0 ] ), floor( xyz[ 1 ] ), floor( xyz[ 2 ] ) ) & mc->hashMask;
+		for ( c = mc->hash[ hash ]; c >= 0; c = mc->cellTris[ c * 2 + 1 ] )
+			AddMetaCandidate( mc, seed, mc->cellTris[ c * 2 ], scan );
+	}
+}
+
+
+
 /*
    MetaTrianglesToSurface()
-   creates map drawsurface(s) from the list of possibles
+   creates drawsurface(s) from the list of possibles, the caller emits them in order
  */
 
-static void MetaTrianglesToSurface( int numPossibles, metaTriangle_t *possibles, int *fOld, int *numAdded ){
-	int i, j, f, best, score, bestScore;
+static void MetaTrianglesToSurface( int numPossibles, metaTriangle_t *possibles, int *numSurfaces, mapDrawSurface_t **surfaces ){
+	int i, j, c, best, score, bestScore, numVerts, maxSurfaces;
 	metaTriangle_t      *seed, *test;
 	mapDrawSurface_t    *ds;
 	bspDrawVert_t       *verts;
 	int                 *indexes;
 	qboolean added;
+	metaCandidates_t mc;
 
 
 	/* allocate arrays */
 	verts = safe_malloc( sizeof( *verts ) * maxSurfaceVerts );
 	indexes = safe_malloc( sizeof( *indexes ) * maxSurfaceIndexes );
+	InitMetaCandidates( &mc, numPossibles, possibles );
+	*numSurfaces = 0;
+	*surfaces = NULL;
+	maxSurfaces = 0;
 
 	/* walk the list of triangles */
 	for ( i = 0, seed = possibles; i < numPossibles; i++, seed++ )
@@ -1691,8 +2240,12 @@ static void MetaTrianglesToSurface( int numPossibles, metaTriangle_t *possibles,
 		   initial drawsurf construction
 		   ----------------------------------------------------------------- */
 
-		/* start a new drawsurface */
-		ds = AllocDrawSurface( SURFACE_META );
+		/* start a new drawsurface, set up like AllocDrawSurface would */
+		AUTOEXPAND_BY_REALLOC( *surfaces, *numSurfaces, maxSurfaces, 16 );
+		ds = &( *surfaces )[ ( *numSurfaces )++ ];
+		memset( ds, 0, sizeof( *ds ) );
+		ds->type = SURFACE_META;
+		ds->outputNum = -1;
 		ds->entityNum = seed->entityNum;
 		ds->surfaceNum = seed->surfaceNum;
 		ds->castShadows = seed->castShadows;
@@ -1715,9 +2268,17 @@ static void MetaTrianglesToSurface( int numPossibles, metaTriangle_t *possibles,
 		memset( indexes, 0, sizeof( *indexes ) * maxSurfaceIndexes );
 
 		/* add the first triangle */
-		if ( AddMetaTriangleToSurface( ds, seed, qfalse ) ) {
-			( *numAdded )++;
+		AddMetaTriangleToSurface( ds, seed, qfalse );
+
+		/* gather the first candidates */
+		mc.numCands = 0;
+		if ( mc.all ) {
+			for ( j = i + 1; j < numPossibles; j++ )
+				mc.cands[ mc.numCands++ ] = j;
 		}
+		for ( j = 0; j < mc.numSelf; j++ )
+			AddMetaCandidate( &mc, i, mc.self[ j ], NULL );
+		AddMetaCandidates( &mc, i, ds, 0, NULL );
 
 		/* -----------------------------------------------------------------
 		   add triangles
@@ -1727,22 +2288,17 @@ static void MetaTrianglesToSurface( int numPossibles, metaTriangle_t *possibles,
 		added = qtrue;
 		while ( added )
 		{
-			/* print pacifier */
-			f = 10 * *numAdded / numMetaTriangles;
-			if ( f > *fOld ) {
-				*fOld = f;
-				Sys_FPrintf( SYS_VRB, "%d...", f );
-			}
-
 			/* reset best score */
 			best = -1;
 			bestScore = 0;
 			added = qfalse;
 
 			/* walk the list of possible candidates for merging */
-			for ( j = i + 1, test = &possibles[ j ]; j < numPossibles; j++, test++ )
+			for ( c = 0; c < mc.numCands; c++ )
 			{
 				/* skip this triangle if it has already been merged */
+				j = mc.cands[ c ];
+				test = &possibles[ j ];
 				if ( test->si == NULL ) {
 					continue;
 				}
@@ -1755,9 +2311,9 @@ static void MetaTrianglesToSurface( int numPossibles, metaTriangle_t *possibles,
 
 					/* if we have a score over a certain threshold, just use it */
 					if ( bestScore >= GOOD_SCORE ) {
-						if ( AddMetaTriangleToSurface( ds, &possibles[ best ], qfalse ) ) {
-							( *numAdded )++;
-						}
+						numVerts = ds->numVerts;
+						AddMetaTriangleToSurface( ds, &possibles[ best ], qfalse );
+						AddMetaCandidates( &mc, i, ds, numVerts, &c );
 
 						/* reset */
 						best = -1;
@@ -1769,9 +2325,9 @@ static void MetaTrianglesToSurface( int numPossibles, metaTriangle_t *possibles,
 
 			/* add best candidate */
 			if ( best >= 0 && bestScore > ADEQUATE_SCORE ) {
-				if ( AddMetaTriangleToSurface( ds, &possibles[ best ], qfalse ) ) {
-					( *numAdded )++;
-				}
+				numVerts = ds->numVerts;
+				AddMetaTriangleToSurface( ds, &possibles[ best ], qfalse );
+				AddMetaCandidates( &mc, i, ds, numVerts, NULL );
 
 				/* reset */
 				added = qtrue;
@@ -1783,15 +2339,10 @@ static void MetaTrianglesToSurface( int numPossibles, metaTriangle_t *possibles,
 		memcpy( ds->verts, verts, ds->numVerts * sizeof( bspDrawVert_t ) );
 		ds->indexes = safe_malloc( ds->numIndexes * sizeof( int ) );
 		memcpy( ds->indexes, indexes, ds->numIndexes * sizeof( int ) );
-
-		/* classify the surface */
-		ClassifySurfaces( 1, ds );
-
-		/* add to count */
-		numMergedSurfaces++;
 	}
 
 	/* free arrays */
+	FreeMetaCandidates( &mc );
 	free( verts );
 	free( indexes );
 }
@@ -1897,9 +2448,37 @@ static int CompareMetaTriangles( const void *a, const void *b ){
    merges meta triangles into drawsurfaces
  */
 
+/* runs of triangles with the same shader and fog, merged independently */
+typedef struct metaMergeGroup_s
+{
+	int firstTriangle, numTriangles;
+	int numSurfaces;
+	mapDrawSurface_t    *surfaces;
+}
+metaMergeGroup_t;
+
+static int numMetaMergeGroups;
+static metaMergeGroup_t     *metaMergeGroups;
+static int                  *metaMergeOrder;
+
+static int CompareMetaMergeGroups( const void *a, const void *b ){
+	return metaMergeGroups[ *(const int*) b ].numTriangles - metaMergeGroups[ *(const int*) a ].numTriangles;
+}
+
+static void MergeMetaGroup( int num ){
+	metaMergeGroup_t    *group;
+
+
+	/* the largest groups go first */
+	group = &metaMergeGroups[ metaMergeOrder[ num ] ];
+	MetaTrianglesToSurface( group->numTriangles, &metaTriangles[ group->firstTriangle ], &group->numSurfaces, &group->surfaces );
+}
+
 void MergeMetaTriangles( void ){
-	int i, j, fOld, start, numAdded;
+	int i, j;
 	metaTriangle_t      *head, *end;
+	metaMergeGroup_t    *group;
+	mapDrawSurface_t    *ds;
 
 
 	/* only do this if there are meta triangles */
@@ -1909,51 +2488,73 @@ void MergeMetaTriangles( void ){
 
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- MergeMetaTriangles ---\n" );
+	ProfileBegin( "MergeMetaTriangles" );
 
 	/* sort the triangles by shader major, fognum minor */
 	qsort( metaTriangles, numMetaTriangles, sizeof( metaTriangle_t ), CompareMetaTriangles );
 
-	/* init pacifier */
-	fOld = -1;
-	start = I_FloatTime();
-	numAdded = 0;
-
-	/* merge */
-	for ( i = 0, j = 0; i < numMetaTriangles; i = j )
+	/* find the runs of triangles that can merge with each other */
+	metaMergeGroups = safe_malloc( numMetaTriangles * sizeof( *metaMergeGroups ) );
+	metaMergeOrder = safe_malloc( numMetaTriangles * sizeof( *metaMergeOrder ) );
+	numMetaMergeGroups = 0;
+	for ( i = 0; i < numMetaTriangles; i = j )
 	{
 		/* get head of list */
 		head = &metaTriangles[ i ];
 
-		/* skip this triangle if it has already been merged */
-		if ( head->si == NULL ) {
-			continue;
-		}
-
 		/* find end */
-		if ( j <= i ) {
-			for ( j = i + 1; j < numMetaTriangles; j++ )
-			{
-				/* get end of list */
-				end = &metaTriangles[ j ];
-				if ( head->si != end->si || head->fogNum != end->fogNum ) {
-					break;
-				}
+		for ( j = i + 1; j < numMetaTriangles; j++ )
+		{
+			/* get end of list */
+			end = &metaTriangles[ j ];
+			if ( head->si != end->si || head->fogNum != end->fogNum ) {
+				break;
 			}
 		}
 
-		/* try to merge this list of possible merge candidates */
-		MetaTrianglesToSurface( ( j - i ), head, &fOld, &numAdded );
+		/* the sort puts already merged triangles (si == NULL) last */
+		if ( head->si == NULL ) {
+			break;
+		}
+
+		group = &metaMergeGroups[ numMetaMergeGroups ];
+		group->firstTriangle = i;
+		group->numTriangles = j - i;
+		metaMergeOrder[ numMetaMergeGroups ] = numMetaMergeGroups;
+		numMetaMergeGroups++;
 	}
 
-	/* clear meta triangle list */
-	ClearMetaTriangles();
+	/* groups share nothing but the read-only metaverts, so merge them on all threads */
+	qsort( metaMergeOrder, numMetaMergeGroups, sizeof( *metaMergeOrder ), CompareMetaMergeGroups );
+	RunThreadsOnIndividual( numMetaMergeGroups, verbose, MergeMetaGroup );
 
-	/* print time */
-	if ( i ) {
-		Sys_FPrintf( SYS_VRB, " (%d)\n", (int) ( I_FloatTime() - start ) );
+	/* emit the surfaces in list order, planes are found here as well */
+	for ( i = 0; i < numMetaMergeGroups; i++ )
+	{
+		group = &metaMergeGroups[ i ];
+		for ( j = 0; j < group->numSurfaces; j++ )
+		{
+			ds = AllocDrawSurface( SURFACE_META );
+			memcpy( ds, &group->surfaces[ j ], sizeof( *ds ) );
+
+			/* classify the surface */
+			ClassifySurfaces( 1, ds );
+
+			/* add to count */
+			numMergedSurfaces++;
+			numMergedVerts += ds->numIndexes - ds->numVerts;
+		}
+		free( group->surfaces );
 	}
+	free( metaMergeGroups );
+	free( metaMergeOrder );
+
+	/* clear meta triangle list */
+	ClearMetaTriangles();
 
 	/* emit some stats */
 	Sys_FPrintf( SYS_VRB, "%9d surfaces merged\n", numMergedSurfaces );
 	Sys_FPrintf( SYS_VRB, "%9d vertexes merged\n", numMergedVerts );
+
+	ProfileEnd();
 }
@@ -0,0 +1,380 @@
+/* -------------------------------------------------------------------------------
+
+   Copyright (C) 1999-2007 id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+   ----------------------------------------------------------------------------------
+
+   This code has been altered significantly from its original form, to support
+   several games based on the Quake III Arena engine, in the form of "Q3Map2."
+
+   ------------------------------------------------------------------------------- */
+
+
+
+/* marker */
+#define TEXTBUFFER_C
+
+
+
+/* dependencies */
+#include "q3map2.h"
+
+
+
+/* -------------------------------------------------------------------------------
+
+   text output of the converters
+
+   the text is printed into memory buffers and written with one fwrite.
+   TextPrintf() formats %d, %s, %f and %.Nf itself, exactly like printf does, and
+   hands anything else to vsnprintf.  WriteTextJobs() prints independent
+   pieces of a file (surfaces, brushes) on all threads and writes them in order
+
+   ------------------------------------------------------------------------------- */
+
+/* how many jobs are kept in memory at once */
+#define TEXT_JOB_WINDOW     4096
+
+static textJobFunc_t textJobFunc;
+static textBuffer_t     *textJobBuffers;
+static int textJobBase;
+
+
+
+/*
+   TextReserve()
+   makes room for length more characters and the terminator
+ */
+
+static void TextReserve( textBuffer_t *buffer, int length ){
+	AUTOEXPAND_BY_REALLOC( buffer->text, buffer->length + length, buffer->allocated, 1024 );
+}
+
+
+
+/*
+   TextAppend()
+   appends a string
+ */
+
+void TextAppend( textBuffer_t *buffer, const char *string ){
+	int length;
+
+	length = strlen( string );
+	TextReserve( buffer, length );
+	memcpy( buffer->text + buffer->length, string, length + 1 );
+	buffer->length += length;
+}
+
+
+
+/*
+   TextAppendUnsigned()
+   prints digits of an unsigned number, zero padded to width
+ */
+
+static void TextAppendUnsigned( textBuffer_t *buffer, unsigned long long value, int width ){
+	char digits[ 24 ];
+	int num;
+
+	num = 0;
+	do
+	{
+		digits[ num++ ] = '0' + (int) ( value % 10 );
+		value /= 10;
+	} while ( value != 0 || num < width );
+
+	TextReserve( buffer, num );
+	while ( num > 0 )
+		buffer->text[ buffer->length++ ] = digits[ --num ];
+	buffer->text[ buffer->length ] = '\0';
+}
+
+
+
+/*
+   TextAppendInt()
+   same as %d
+ */
+
+void TextAppendInt( textBuffer_t *buffer, int value ){
+	if ( value < 0 ) {
+		TextAppend( buffer, "-" );
+		TextAppendUnsigned( buffer, -(long long) value, 0 );
+	}
+	else{
+		TextAppendUnsigned( buffer, value, 0 );
+	}
+}
+
+
+
+/*
+   TextAppendFixed()
+   same as %.*f for up to 9 decimals: the exact binary value, ties to even.
+   the value is m * 2^e, so value * 10^p = m * 10^p * 2^e is done in
+   integers, m * 10^p needs up to 83 bits and is kept in two words
+ */
+
+static const unsigned long long textPowers[ 10 ] =
+{
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull
+};
+
+static void TextAppendFixed( textBuffer_t *buffer, double value, int precision ){
+	int exponent, shift;
+	unsigned long long mantissa, lo, hi, a, b, quotient, power;
+	qboolean half, sticky;
+	double magnitude;
+	char text[ 512 ];
+
+
+	/* nan, inf and values whose digits do not fit in 60 bits go the slow way */
+	power = textPowers[ precision ];
+	magnitude = fabs( value );
+	if ( !( magnitude * power < 1e18 ) ) {
+		snprintf( text, sizeof( text ), "%.*f", precision, value );
+		TextAppend( buffer, text );
+		return;
+	}
+
+	/* magnitude = mantissa * 2^exponent, mantissa has 53 bits */
+	if ( magnitude == 0.0 ) {
+		mantissa = 0;
+		exponent = -1;
+	}
+	else
+	{
+		magnitude = frexp( magnitude, &exponent );
+		mantissa = (unsigned long long) ldexp( magnitude, 53 );
+		exponent -= 53;
+	}
+
+	/* hi:lo = mantissa * 10^precision */
+	a = ( mantissa & 0xFFFFFFFFull ) * power;
+	b = ( mantissa >> 32 ) * power;
+	lo = a + ( b << 32 );
+	hi = ( b >> 32 ) + ( lo < a ? 1 : 0 );
+
+	/* shift to the integer part, remembering the first dropped bit and if any
+	   other was set */
+	shift = -exponent;
+	if ( mantissa == 0 || shift > 127 ) {
+		quotient = 0;
+		half = sticky = qfalse;
+	}
+	else if ( shift <= 0 ) {
+		/* integers of 53 bits and more */
+		quotient = lo << -shift;
+		half = sticky = qfalse;
+	}
+	else
+	{
+		/* the half bit is bit shift - 1 */
+		if ( shift - 1 >= 64 ) {
+			half = ( hi >> ( shift - 1 - 64 ) ) & 1;
+			sticky = lo != 0 || ( hi & ( ( 1ull << ( shift - 1 - 64 ) ) - 1 ) ) != 0;
+		}
+		else
+		{
+			half = ( lo >> ( shift - 1 ) ) & 1;
+			sticky = ( lo & ( ( 1ull << ( shift - 1 ) ) - 1 ) ) != 0;
+		}
+		if ( shift >= 64 ) {
+			quotient = hi >> ( shift - 64 );
+		}
+		else{
+			quotient = ( lo >> shift ) | ( hi << ( 64 - shift ) );
+		}
+	}
+	if ( half && ( sticky || ( quotient & 1 ) ) ) {
+		quotient++;
+	}
+
+	/* print it, the sign stays on values that round to zero */
+	if ( signbit( value ) ) {
+		TextAppend( buffer, "-" );
+	}
+	TextAppendUnsigned( buffer, quotient / power, 0 );
+	if ( precision > 0 ) {
+		TextAppend( buffer, "." );
+		TextAppendUnsigned( buffer, quotient % power, precision );
+	}
+}
+
+
+
+/*
+   TextAppendFloat()
+   same as %f
+ */
+
+void TextAppendFloat( textBuffer_t *buffer, double value ){
+	TextAppendFixed( buffer, value, 6 );
+}
+
+
+
+/*
+   TextPrintf()
+   sprintf into a growing buffer
+ */
+
+void TextPrintf( textBuffer_t *buffer, const char *format, ... ){
+	va_list argptr;
+	const char      *c;
+	int length, precision;
+	qboolean simple;
+
+
+	/* only plain %d %s %f and %.Nf are formatted here */
+	simple = qtrue;
+	for ( c = format; simple && *c != '\0'; c++ )
+	{
+		if ( *c == '%' ) {
+			c++;
+			if ( *c == '.' && *( c + 1 ) >= '0' && *( c + 1 ) <= '9' ) {
+				c += 2;
+				simple = ( *c == 'f' );
+			}
+			else{
+				simple = ( *c == 'd' || *c == 's' || *c == 'f' || *c == '%' );
+			}
+		}
+	}
+
+	if ( simple ) {
+		va_start( argptr, format );
+		for ( c = format; *c != '\0'; c++ )
+		{
+			if ( *c != '%' ) {
+				TextReserve( buffer, 1 );
+				buffer->text[ buffer->length++ ] = *c;
+				buffer->text[ buffer->length ] = '\0';
+				continue;
+			}
+			c++;
+			precision = 6;
+			if ( *c == '.' ) {
+				precision = *( c + 1 ) - '0';
+				c += 2;
+			}
+			if ( *c == 'd' ) {
+				TextAppendInt( buffer, va_arg( argptr, int ) );
+			}
+			else if ( *c == 's' ) {
+				TextAppend( buffer, va_arg( argptr, const char * ) );
+			}
+			else if ( *c == 'f' ) {
+				TextAppendFixed( buffer, va_arg( argptr, double ), precision );
+			}
+			else{
+				TextAppend( buffer, "%" );
+			}
+		}
+		va_end( argptr );
+		return;
+	}
+
+	for ( ;; )
+	{
+		TextReserve( buffer, 255 );
+		va_start( argptr, format );
+		length = vsnprintf( buffer->text + buffer->length, buffer->allocated - buffer->length, format, argptr );
+		va_end( argptr );
+		if ( length >= 0 && length < buffer->allocated - buffer->length ) {
+			buffer->length += length;
+			return;
+		}
+
+		/* make room, older c libraries just return -1 */
+		TextReserve( buffer, length >= 0 ? length : buffer->allocated );
+	}
+}
+
+
+
+/*
+   WriteTextBuffer()
+   writes the text to a file and empties the buffer
+ */
+
+void WriteTextBuffer( textBuffer_t *buffer, FILE *f ){
+	if ( buffer->length > 0 ) {
+		fwrite( buffer->text, 1, buffer->length, f );
+	}
+	buffer->length = 0;
+}
+
+
+
+/*
+   FreeTextBuffer()
+   frees the text
+ */
+
+void FreeTextBuffer( textBuffer_t *buffer ){
+	free( buffer->text );
+	memset( buffer, 0, sizeof( *buffer ) );
+}
+
+
+
+/*
+   TextJobThread()
+   prints one job into its buffer
+ */
+
+static void TextJobThread( int num ){
+	textJobFunc( &textJobBuffers[ num ], textJobBase + num );
+}
+
+
+
+/*
+   WriteTextJobs()
+   prints jobs 0 .. numJobs - 1 on all threads, a window at a time, and
+   writes their text to the file in job order
+ */
+
+void WriteTextJobs( FILE *f, int numJobs, textJobFunc_t func, qboolean showpacifier ){
+	int i, num;
+
+
+	textJobFunc = func;
+	textJobBuffers = safe_malloc( TEXT_JOB_WINDOW * sizeof( *textJobBuffers ) );
+	memset( textJobBuffers, 0, TEXT_JOB_WINDOW * sizeof( *textJobBuffers ) );
+
+	for ( textJobBase = 0; textJobBase < numJobs; textJobBase += num )
+	{
+		num = numJobs - textJobBase;
+		if ( num > TEXT_JOB_WINDOW ) {
+			num = TEXT_JOB_WINDOW;
+		}
+		RunThreadsOnIndividual( num, showpacifier && numJobs <= TEXT_JOB_WINDOW, TextJobThread );
+		for ( i = 0; i < num; i++ )
+			WriteTextBuffer( &textJobBuffers[ i ], f );
+	}
+
+	for ( i = 0; i < TEXT_JOB_WINDOW; i++ )
+		FreeTextBuffer( &textJobBuffers[ i ] );
+	free( textJobBuffers );
+	textJobBuffers = NULL;
+}
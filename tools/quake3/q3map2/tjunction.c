@@ -83,6 +83,45 @@ int c_natural, c_rotate, c_cant;
 #define LINE_POSITION_EPSILON   0.25
 #define POINT_ON_LINE_EPSILON   0.25
 
+/*
+   edge lines are also listed in a coarse grid over the entity's surfaces.  a line
+   goes into every cell that its tube of POINT_ON_LINE_EPSILON (padded) can touch,
+   in creation order, so AddEdge only has to test the lines in the cell of the
+   edge's first point and still finds the same, first matching line
+ */
+
+#define EDGE_GRID_CELLS     64          /* cells along the longest side of the bounds */
+#define EDGE_GRID_MIN_SIZE  64.0f
+#define EDGE_GRID_TUBE      1.0f
+#define EDGE_GRID_HASHES    16384
+
+typedef struct edgeCell_s
+{
+	int xyz[ 3 ];
+	int first, last;                    /* edgeCellLines, ascending line numbers */
+	int next;                           /* hash chain */
+}
+edgeCell_t;
+
+typedef struct edgeCellLine_s
+{
+	int line;
+	int next;
+}
+edgeCellLine_t;
+
+static vec3_t edgeGridMins, edgeGridMaxs;
+static float edgeGridSize;
+static int edgeGridHash[ EDGE_GRID_HASHES ];
+
+static edgeCell_t *edgeCells = NULL;
+static int numEdgeCells;
+static int allocatedEdgeCells = 0;
+
+static edgeCellLine_t *edgeCellLines = NULL;
+static int numEdgeCellLines;
+static int allocatedEdgeCellLines = 0;
+
 /*
    ====================
    InsertPointOnEdge
@@ -132,13 +171,180 @@ void InsertPointOnEdge( vec3_t v, edgeLine_t *e ) {
 }
 
 
+/*
+   ClearEdgeGrid()
+   sizes an empty edge line grid to the bounds of the entity's t-junction surfaces
+ */
+
+static void ClearEdgeGrid( entity_t *ent ){
+	int i, j;
+	float size;
+	mapDrawSurface_t    *ds;
+	shaderInfo_t        *si;
+
+
+	/* clear the grid */
+	memset( edgeGridHash, 0xFF, sizeof( edgeGridHash ) );
+	numEdgeCells = 0;
+	numEdgeCellLines = 0;
+
+	/* get the bounds */
+	ClearBounds( edgeGridMins, edgeGridMaxs );
+	for ( i = ent->firstDrawSurf; i < numMapDrawSurfs; i++ )
+	{
+		ds = &mapDrawSurfs[ i ];
+		si = ds->shaderInfo;
+		if ( ( si->compileFlags & C_NODRAW ) || si->autosprite || si->notjunc || ds->numVerts == 0 ) {
+			continue;
+		}
+		if ( ds->type != SURFACE_FACE && ds->type != SURFACE_PATCH ) {
+			continue;
+		}
+		for ( j = 0; j < ds->numVerts; j++ )
+			AddPointToBounds( ds->verts[ j ].xyz, edgeGridMins, edgeGridMaxs );
+	}
+
+	/* pick a cell size */
+	size = 0.0f;
+	for ( i = 0; i < 3; i++ )
+	{
+		edgeGridMins[ i ] -= EDGE_GRID_TUBE;
+		edgeGridMaxs[ i ] += EDGE_GRID_TUBE;
+		if ( edgeGridMaxs[ i ] - edgeGridMins[ i ] > size ) {
+			size = edgeGridMaxs[ i ] - edgeGridMins[ i ];
+		}
+	}
+	edgeGridSize = size / EDGE_GRID_CELLS;
+	if ( edgeGridSize < EDGE_GRID_MIN_SIZE ) {
+		edgeGridSize = EDGE_GRID_MIN_SIZE;
+	}
+}
+
+
+
+/*
+   EdgeGridCell()
+   returns the index of a grid cell, optionally creating it
+ */
+
+static int EdgeGridCell( int xyz[ 3 ], qboolean create ){
+	int hash, cellNum;
+	edgeCell_t  *cell;
+
+
+	/* find it */
+	hash = ( xyz[ 0 ] * 73856093 ^ xyz[ 1 ] * 19349663 ^ xyz[ 2 ] * 83492791 ) & ( EDGE_GRID_HASHES - 1 );
+	for ( cellNum = edgeGridHash[ hash ]; cellNum >= 0; cellNum = edgeCells[ cellNum ].next )
+	{
+		cell = &edgeCells[ cellNum ];
+		if ( cell->xyz[ 0 ] == xyz[ 0 ] && cell->xyz[ 1 ] == xyz[ 1 ] && cell->xyz[ 2 ] == xyz[ 2 ] ) {
+			return cellNum;
+		}
+	}
+	if ( !create ) {
+		return -1;
+	}
+
+	/* add it */
+	AUTOEXPAND_BY_REALLOC( edgeCells, numEdgeCells, allocatedEdgeCells, 1024 );
+	cell = &edgeCells[ numEdgeCells ];
+	VectorCopy( xyz, cell->xyz );
+	cell->first = cell->last = -1;
+	cell->next = edgeGridHash[ hash ];
+	edgeGridHash[ hash ] = numEdgeCells;
+	return numEdgeCells++;
+}
+
+
+
+/*
+   AddEdgeLineToGrid()
+   lists an edge line in every cell its tube passes through, walking slabs of cells
+   along the line's major axis
+ */
+
+static void AddEdgeLineToGrid( int lineNum ){
+	int i, k, m, axes[ 2 ], range[ 2 ][ 2 ], xyz[ 3 ], cellNum;
+	float t[ 2 ], p, lo, hi;
+	edgeLine_t      *e;
+	edgeCell_t      *cell;
+	edgeCellLine_t  *cl;
+
+
+	/* get major axis */
+	e = &edgeLines[ lineNum ];
+	m = 0;
+	for ( i = 1; i < 3; i++ )
+	{
+		if ( fabs( e->dir[ i ] ) > fabs( e->dir[ m ] ) ) {
+			m = i;
+		}
+	}
+	axes[ 0 ] = ( m + 1 ) % 3;
+	axes[ 1 ] = ( m + 2 ) % 3;
+
+	/* walk the slabs */
+	for ( k = floor( edgeGridMins[ m ] / edgeGridSize ); k <= floor( edgeGridMaxs[ m ] / edgeGridSize ); k++ )
+	{
+		/* where the line crosses the (padded) slab */
+		t[ 0 ] = ( k * edgeGridSize - EDGE_GRID_TUBE - e->origin[ m ] ) / e->dir[ m ];
+		t[ 1 ] = ( ( k + 1 ) * edgeGridSize + EDGE_GRID_TUBE - e->origin[ m ] ) / e->dir[ m ];
+
+		/* cells covered on the other axes, clipped to the grid */
+		for ( i = 0; i < 2; i++ )
+		{
+			lo = hi = e->origin[ axes[ i ] ] + t[ 0 ] * e->dir[ axes[ i ] ];
+			p = e->origin[ axes[ i ] ] + t[ 1 ] * e->dir[ axes[ i ] ];
+			if ( p < lo ) {
+				lo = p;
+			}
+			if ( p > hi ) {
+				hi = p;
+			}
+			range[ i ][ 0 ] = floor( ( lo - EDGE_GRID_TUBE ) / edgeGridSize );
+			range[ i ][ 1 ] = floor( ( hi + EDGE_GRID_TUBE ) / edgeGridSize );
+			if ( range[ i ][ 0 ] < floor( edgeGridMins[ axes[ i ] ] / edgeGridSize ) ) {
+				range[ i ][ 0 ] = floor( edgeGridMins[ axes[ i ] ] / edgeGridSize );
+			}
+			if ( range[ i ][ 1 ] > floor( edgeGridMaxs[ axes[ i ] ] / edgeGridSize ) ) {
+				range[ i ][ 1 ] = floor( edgeGridMaxs[ axes[ i ] ] / edgeGridSize );
+			}
+		}
+
+		/* append the line to each cell */
+		xyz[ m ] = k;
+		for ( xyz[ axes[ 0 ] ] = range[ 0 ][ 0 ]; xyz[ axes[ 0 ] ] <= range[ 0 ][ 1 ]; xyz[ axes[ 0 ] ]++ )
+		{
+			for ( xyz[ axes[ 1 ] ] = range[ 1 ][ 0 ]; xyz[ axes[ 1 ] ] <= range[ 1 ][ 1 ]; xyz[ axes[ 1 ] ]++ )
+			{
+				cellNum = EdgeGridCell( xyz, qtrue );
+				AUTOEXPAND_BY_REALLOC( edgeCellLines, numEdgeCellLines, allocatedEdgeCellLines, 4096 );
+				cl = &edgeCellLines[ numEdgeCellLines ];
+				cl->line = lineNum;
+				cl->next = -1;
+				cell = &edgeCells[ cellNum ];
+				if ( cell->last < 0 ) {
+					cell->first = numEdgeCellLines;
+				}
+				else{
+					edgeCellLines[ cell->last ].next = numEdgeCellLines;
+				}
+				cell->last = numEdgeCellLines;
+				numEdgeCellLines++;
+			}
+		}
+	}
+}
+
+
+
 /*
    ====================
    AddEdge
    ====================
  */
 int AddEdge( vec3_t v1, vec3_t v2, qboolean createNonAxial ) {
-	int i;
+	int i, cl, xyz[ 3 ];
 	edgeLine_t  *e;
 	float d;
 	vec3_t dir;
@@ -162,7 +368,12 @@ int AddEdge( vec3_t v1, vec3_t v2, qboolean createNonAxial ) {
 		}
 	}
 
-	for ( i = 0 ; i < numEdgeLines ; i++ ) {
+	/* only lines listed in the first point's cell can match */
+	for ( i = 0; i < 3; i++ )
+		xyz[ i ] = floor( v1[ i ] / edgeGridSize );
+	i = EdgeGridCell( xyz, qfalse );
+	for ( cl = ( i >= 0 ? edgeCells[ i ].first : -1 ); cl >= 0; cl = edgeCellLines[ cl ].next ) {
+		i = edgeCellLines[ cl ].line;
 		e = &edgeLines[i];
 
 		d = DotProduct( v1, e->normal1 ) - e->dist1;
@@ -208,6 +419,8 @@ int AddEdge( vec3_t v1, vec3_t v2, qboolean createNonAxial ) {
 	InsertPointOnEdge( v1, e );
 	InsertPointOnEdge( v2, e );
 
+	AddEdgeLineToGrid( numEdgeLines - 1 );
+
 	return numEdgeLines - 1;
 }
 
@@ -630,8 +843,10 @@ void FixTJunctions( entity_t *ent ){
 
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- FixTJunctions ---\n" );
+	ProfileBegin( "FixTJunctions" );
 	numEdgeLines = 0;
 	numOriginalEdges = 0;
+	ClearEdgeGrid( ent );
 
 	// add all the edges
 	// this actually creates axial edges, but it
@@ -717,4 +932,6 @@ void FixTJunctions( entity_t *ent ){
 	Sys_FPrintf( SYS_VRB, "%9d rotated orders\n", c_rotate );
 	Sys_FPrintf( SYS_VRB, "%9d can't order\n", c_cant );
 	Sys_FPrintf( SYS_VRB, "%9d broken (degenerate) surfaces removed\n", c_broken );
+
+	ProfileEnd();
 }
@@ -229,7 +229,9 @@ void CalcPortalVis( void ){
 	//get rid of the counter
 	RunThreadsOnIndividual( numportals * 2, qfalse, PortalFlow );
 #else
+	ProfileBegin( "PortalFlow" );
 	RunThreadsOnIndividual( numportals * 2, qtrue, PortalFlow );
+	ProfileEnd();
 #endif
 
 }
@@ -251,10 +253,14 @@ void CalcPassageVis( void ){
 	_printf( "\n" );
 #else
 	Sys_Printf( "\n--- CreatePassages (%d) ---\n", numportals * 2 );
+	ProfileBegin( "CreatePassages" );
 	RunThreadsOnIndividual( numportals * 2, qtrue, CreatePassages );
+	ProfileEnd();
 
 	Sys_Printf( "\n--- PassageFlow (%d) ---\n", numportals * 2 );
+	ProfileBegin( "PassageFlow" );
 	RunThreadsOnIndividual( numportals * 2, qtrue, PassageFlow );
+	ProfileEnd();
 #endif
 }
 
@@ -275,10 +281,14 @@ void CalcPassagePortalVis( void ){
 	Sys_Printf( "\n" );
 #else
 	Sys_Printf( "\n--- CreatePassages (%d) ---\n", numportals * 2 );
+	ProfileBegin( "CreatePassages" );
 	RunThreadsOnIndividual( numportals * 2, qtrue, CreatePassages );
+	ProfileEnd();
 
 	Sys_Printf( "\n--- PassagePortalFlow (%d) ---\n", numportals * 2 );
+	ProfileBegin( "PassagePortalFlow" );
 	RunThreadsOnIndividual( numportals * 2, qtrue, PassagePortalFlow );
+	ProfileEnd();
 #endif
 }
 
@@ -331,7 +341,9 @@ void CalcVis( void ){
 
 
 	Sys_Printf( "\n--- BasePortalVis (%d) ---\n", numportals * 2 );
+	ProfileBegin( "BasePortalVis" );
 	RunThreadsOnIndividual( numportals * 2, qtrue, BasePortalVis );
+	ProfileEnd();
 
 //	RunThreadsOnIndividual (numportals*2, qtrue, BetterPortalVis);
 
@@ -353,8 +365,10 @@ void CalcVis( void ){
 	// assemble the leaf vis lists by oring and compressing the portal lists
 	//
 	Sys_Printf( "creating leaf vis...\n" );
+	ProfileBegin( "ClusterMerge" );
 	for ( i = 0 ; i < portalclusters ; i++ )
 		ClusterMerge( i );
+	ProfileEnd();
 
 	totalvis = 0;
 	totalvis2 = 0;
@@ -888,37 +902,11 @@ void WritePortals( char *portalpathfile ){
 
 /*
    ============
-   LoadPortals
+   AllocPortals
    ============
  */
-void LoadPortals( char *name ){
-	int i, j, flags;
-	vportal_t   *p;
-	leaf_t      *l;
-	char magic[80];
-	FILE        *f;
-	int numpoints;
-	fixedWinding_t  *w;
-	int leafnums[2];
-	visPlane_t plane;
-
-	if ( !strcmp( name,"-" ) ) {
-		f = stdin;
-	}
-	else
-	{
-		f = fopen( name, "r" );
-		if ( !f ) {
-			Error( "LoadPortals: couldn't read %s\n",name );
-		}
-	}
-
-	if ( fscanf( f,"%79s\n%i\n%i\n%i\n",magic, &portalclusters, &numportals, &numfaces ) != 4 ) {
-		Error( "LoadPortals: failed to read header" );
-	}
-	if ( strcmp( magic,PORTALFILE ) ) {
-		Error( "LoadPortals: not a portal file" );
-	}
+void AllocPortals( void ){
+	int i;
 
 	Sys_Printf( "%6i portalclusters\n", portalclusters );
 	Sys_Printf( "%6i numportals\n", numportals );
@@ -954,7 +942,242 @@ void LoadPortals( char *name ){
 	( (int *)bspVisBytes )[0] = portalclusters;
 	( (int *)bspVisBytes )[1] = leafbytes;
 
-	for ( i = 0, p = portals ; i < numportals ; i++ )
+	faces = safe_malloc( 2 * numfaces * sizeof( vportal_t ) );
+	memset( faces, 0, 2 * numfaces * sizeof( vportal_t ) );
+
+	faceleafs = safe_malloc( portalclusters * sizeof( leaf_t ) );
+	memset( faceleafs, 0, portalclusters * sizeof( leaf_t ) );
+}
+
+/*
+   ============
+   AddPortal
+   creates the forward and backward memory portals for file portal i
+   ============
+ */
+void AddPortal( int i, fixedWinding_t *w, int leafnums[ 2 ], int flags ){
+	int j;
+	vportal_t   *p;
+	leaf_t      *l;
+	visPlane_t plane;
+
+	if ( leafnums[0] < 0 || leafnums[0] >= portalclusters
+		 || leafnums[1] < 0 || leafnums[1] >= portalclusters ) {
+		Error( "LoadPortals: reading portal %i", i );
+	}
+
+	// calc plane
+	PlaneFromWinding( w, &plane );
+
+	// create forward portal
+	p = &portals[ i * 2 ];
+	l = &leafs[leafnums[0]];
+	if ( l->numportals == MAX_PORTALS_ON_LEAF ) {
+		Error( "Leaf with too many portals" );
+	}
+	l->portals[l->numportals] = p;
+	l->numportals++;
+
+	p->num = i + 1;
+	p->hint = ((flags & PRTFILE_FLAG_HINT) != 0);
+	p->sky = ((flags & PRTFILE_FLAG_SKY) != 0);
+	p->winding = w;
+	VectorSubtract( vec3_origin, plane.normal, p->plane.normal );
+	p->plane.dist = -plane.dist;
+	p->leaf = leafnums[1];
+	SetPortalSphere( p );
+	p++;
+
+	// create backwards portal
+	l = &leafs[leafnums[1]];
+	if ( l->numportals == MAX_PORTALS_ON_LEAF ) {
+		Error( "Leaf with too many portals" );
+	}
+	l->portals[l->numportals] = p;
+	l->numportals++;
+
+	p->num = i + 1;
+	p->hint = hint;
+	p->winding = NewFixedWinding( w->numpoints );
+	p->winding->numpoints = w->numpoints;
+	for ( j = 0 ; j < w->numpoints ; j++ )
+	{
+		VectorCopy( w->points[w->numpoints - 1 - j], p->winding->points[j] );
+	}
+
+	p->plane = plane;
+	p->leaf = leafnums[0];
+	SetPortalSphere( p );
+}
+
+/*
+   ============
+   AddFace
+   ============
+ */
+void AddFace( int i, fixedWinding_t *w, int leafnum ){
+	vportal_t   *p;
+	leaf_t      *l;
+	visPlane_t plane;
+
+	if ( leafnum < 0 || leafnum >= portalclusters ) {
+		Error( "LoadPortals: reading face %i", i );
+	}
+
+	// calc plane
+	PlaneFromWinding( w, &plane );
+
+	p = &faces[ i ];
+	l = &faceleafs[leafnum];
+	l->merged = -1;
+	if ( l->numportals == MAX_PORTALS_ON_LEAF ) {
+		Error( "Leaf with too many faces" );
+	}
+	l->portals[l->numportals] = p;
+	l->numportals++;
+
+	p->num = i + 1;
+	p->winding = w;
+	// normal pointing out of the leaf
+	VectorSubtract( vec3_origin, plane.normal, p->plane.normal );
+	p->plane.dist = -plane.dist;
+	p->leaf = -1;
+	SetPortalSphere( p );
+}
+
+/*
+   ============
+   LoadPortalsBinaryData
+   reads a PRTB portal file from memory, the records are swapped in place
+   ============
+ */
+void LoadPortalsBinaryData( byte *buffer, int size, const char *name ){
+	int i, j, k, bodySize;
+	prtFileHeader_t *header;
+	prtFileRecord_t *records, *r;
+	float           *points;
+	fixedWinding_t  *w;
+	int numPoints;
+
+	if ( size < (int) sizeof( prtFileHeader_t ) ) {
+		Error( "LoadPortals: failed to read header" );
+	}
+
+	header = (prtFileHeader_t*) buffer;
+	if ( LittleLong( header->version ) != PRTFILE_BINARY_VERSION ) {
+		Error( "LoadPortals: %s is version %d, not %d", name, LittleLong( header->version ), PRTFILE_BINARY_VERSION );
+	}
+
+	portalclusters = LittleLong( header->numClusters );
+	numportals = LittleLong( header->numPortals );
+	numfaces = LittleLong( header->numFaces );
+	numPoints = LittleLong( header->numPoints );
+	if ( portalclusters < 0 || numportals < 0 || numfaces < 0 || numPoints < 0 ) {
+		Error( "LoadPortals: bad header in %s", name );
+	}
+
+	bodySize = size - sizeof( prtFileHeader_t );
+	if ( (size_t) bodySize != ( (size_t) numportals + numfaces ) * sizeof( prtFileRecord_t ) + (size_t) numPoints * 3 * sizeof( float ) ) {
+		Error( "LoadPortals: %s is truncated", name );
+	}
+	if ( PrtFileChecksum( buffer + sizeof( prtFileHeader_t ), bodySize ) != (unsigned int) LittleLong( header->checksum ) ) {
+		Error( "LoadPortals: checksum mismatch in %s", name );
+	}
+
+	/* swap in place (no-op on little-endian hosts) */
+	SwapBlock( (int*) ( buffer + sizeof( prtFileHeader_t ) ), bodySize );
+	records = (prtFileRecord_t*) ( buffer + sizeof( prtFileHeader_t ) );
+	points = (float*) ( records + numportals + numfaces );
+
+	AllocPortals();
+
+	for ( i = 0; i < numportals + numfaces; i++ )
+	{
+		r = &records[ i ];
+		if ( r->numPoints < 3 || r->numPoints > MAX_POINTS_ON_WINDING
+			 || r->firstPoint < 0 || r->firstPoint > numPoints - r->numPoints ) {
+			Error( "LoadPortals: reading portal %i", i );
+		}
+
+		w = NewFixedWinding( r->numPoints );
+		w->numpoints = r->numPoints;
+		for ( j = 0; j < r->numPoints; j++ )
+		{
+			for ( k = 0; k < 3; k++ )
+				w->points[ j ][ k ] = points[ ( r->firstPoint + j ) * 3 + k ];
+		}
+
+		if ( i < numportals ) {
+			AddPortal( i, w, r->clusters, r->flags );
+		}
+		else{
+			AddFace( i - numportals, w, r->clusters[ 0 ] );
+		}
+	}
+}
+
+/*
+   ============
+   LoadPortalsBinary
+   reads a PRTB portal file
+   ============
+ */
+void LoadPortalsBinary( const char *name ){
+	int size;
+	byte    *buffer;
+
+	size = LoadFile( name, (void**) &buffer );
+	LoadPortalsBinaryData( buffer, size, name );
+	free( buffer );
+}
+
+/*
+   ============
+   LoadPortals
+   ============
+ */
+void LoadPortals( char *name ){
+	int i, j, flags;
+	char magic[80];
+	FILE        *f;
+	int numpoints;
+	fixedWinding_t  *w;
+	int leafnums[2];
+
+	if ( !strcmp( name,"-" ) ) {
+		f = stdin;
+	}
+	else
+	{
+		f = fopen( name, "rb" );
+		if ( !f ) {
+			Error( "LoadPortals: couldn't read %s\n",name );
+		}
+
+		/* binary portal file? */
+		if ( fread( magic, 1, 4, f ) == 4 && !memcmp( magic, PRTFILE_BINARY_IDENT, 4 ) ) {
+			fclose( f );
+			LoadPortalsBinary( name );
+			return;
+		}
+		fclose( f );
+
+		f = fopen( name, "r" );
+		if ( !f ) {
+			Error( "LoadPortals: couldn't read %s\n",name );
+		}
+	}
+
+	if ( fscanf( f,"%79s\n%i\n%i\n%i\n",magic, &portalclusters, &numportals, &numfaces ) != 4 ) {
+		Error( "LoadPortals: failed to read header" );
+	}
+	if ( strcmp( magic,PORTALFILE ) ) {
+		Error( "LoadPortals: not a portal file" );
+	}
+
+	AllocPortals();
+
+	for ( i = 0; i < numportals; i++ )
 	{
 		if ( fscanf( f, "%i %i %i ", &numpoints, &leafnums[0], &leafnums[1] ) != 3 ) {
 			Error( "LoadPortals: reading portal %i", i );
@@ -962,15 +1185,11 @@ void LoadPortals( char *name ){
 		if ( numpoints > MAX_POINTS_ON_WINDING ) {
 			Error( "LoadPortals: portal %i has too many points", i );
 		}
-		if ( leafnums[0] > portalclusters
-			 || leafnums[1] > portalclusters ) {
-			Error( "LoadPortals: reading portal %i", i );
-		}
 		if ( fscanf( f, "%i ", &flags ) != 1 ) {
 			Error( "LoadPortals: reading flags" );
 		}
 
-		w = p->winding = NewFixedWinding( numpoints );
+		w = NewFixedWinding( numpoints );
 		w->numpoints = numpoints;
 
 		for ( j = 0 ; j < numpoints ; j++ )
@@ -991,64 +1210,16 @@ void LoadPortals( char *name ){
 			// silence gcc warning
 		}
 
-		// calc plane
-		PlaneFromWinding( w, &plane );
-
-		// create forward portal
-		l = &leafs[leafnums[0]];
-		if ( l->numportals == MAX_PORTALS_ON_LEAF ) {
-			Error( "Leaf with too many portals" );
-		}
-		l->portals[l->numportals] = p;
-		l->numportals++;
-
-		p->num = i + 1;
-		p->hint = ((flags & 1) != 0);
-		p->sky = ((flags & 2) != 0);
-		p->winding = w;
-		VectorSubtract( vec3_origin, plane.normal, p->plane.normal );
-		p->plane.dist = -plane.dist;
-		p->leaf = leafnums[1];
-		SetPortalSphere( p );
-		p++;
-
-		// create backwards portal
-		l = &leafs[leafnums[1]];
-		if ( l->numportals == MAX_PORTALS_ON_LEAF ) {
-			Error( "Leaf with too many portals" );
-		}
-		l->portals[l->numportals] = p;
-		l->numportals++;
-
-		p->num = i + 1;
-		p->hint = hint;
-		p->winding = NewFixedWinding( w->numpoints );
-		p->winding->numpoints = w->numpoints;
-		for ( j = 0 ; j < w->numpoints ; j++ )
-		{
-			VectorCopy( w->points[w->numpoints - 1 - j], p->winding->points[j] );
-		}
-
-		p->plane = plane;
-		p->leaf = leafnums[0];
-		SetPortalSphere( p );
-		p++;
-
+		AddPortal( i, w, leafnums, flags );
 	}
 
-	faces = safe_malloc( 2 * numfaces * sizeof( vportal_t ) );
-	memset( faces, 0, 2 * numfaces * sizeof( vportal_t ) );
-
-	faceleafs = safe_malloc( portalclusters * sizeof( leaf_t ) );
-	memset( faceleafs, 0, portalclusters * sizeof( leaf_t ) );
-
-	for ( i = 0, p = faces; i < numfaces; i++ )
+	for ( i = 0; i < numfaces; i++ )
 	{
 		if ( fscanf( f, "%i %i ", &numpoints, &leafnums[0] ) != 2 ) {
 			Error( "LoadPortals: reading portal %i", i );
 		}
 
-		w = p->winding = NewFixedWinding( numpoints );
+		w = NewFixedWinding( numpoints );
 		w->numpoints = numpoints;
 
 		for ( j = 0 ; j < numpoints ; j++ )
@@ -1069,25 +1240,7 @@ void LoadPortals( char *name ){
 			// silence gcc warning
 		}
 
-		// calc plane
-		PlaneFromWinding( w, &plane );
-
-		l = &faceleafs[leafnums[0]];
-		l->merged = -1;
-		if ( l->numportals == MAX_PORTALS_ON_LEAF ) {
-			Error( "Leaf with too many faces" );
-		}
-		l->portals[l->numportals] = p;
-		l->numportals++;
-
-		p->num = i + 1;
-		p->winding = w;
-		// normal pointing out of the leaf
-		VectorSubtract( vec3_origin, plane.normal, p->plane.normal );
-		p->plane.dist = -plane.dist;
-		p->leaf = -1;
-		SetPortalSphere( p );
-		p++;
+		AddFace( i, w, leafnums[0] );
 	}
 
 	fclose( f );
@@ -1178,8 +1331,10 @@ int VisMain( int argc, char **argv ){
 	sprintf( source, "%s%s", inbase, ExpandArg( argv[ i ] ) );
 	StripExtension( source );
 	strcat( source, ".bsp" );
-	Sys_Printf( "Loading %s\n", source );
-	LoadBSPFile( source );
+	if ( !bspInMemory ) {
+		Sys_Printf( "Loading %s\n", source );
+		LoadBSPFile( source );
+	}
 
 	/* load the portal file */
 	if (!portalFilePath[0]) {
@@ -1187,12 +1342,34 @@ int VisMain( int argc, char **argv ){
 		StripExtension( portalFilePath );
 		strcat( portalFilePath, ".prt" );
 	}
-	Sys_Printf( "Loading %s\n", portalFilePath );
-	LoadPortals( portalFilePath );
+	ProfileBegin( "LoadPortals" );
+	if ( bspInMemory ) {
+		/* the bsp stage kept them, a leaked map has none */
+		if ( portalFileData != NULL ) {
+			LoadPortalsBinaryData( portalFileData, portalFileSize, portalFilePath );
+			free( portalFileData );
+			portalFileData = NULL;
+		}
+		else{
+			Sys_FPrintf( SYS_WRN, "WARNING: no portals from the bsp stage, map leaked?\n" );
+		}
+	}
+	else
+	{
+		Sys_Printf( "Loading %s\n", portalFilePath );
+		LoadPortals( portalFilePath );
+	}
+	ProfileEnd();
 
 	/* ydnar: exit if no portals, hence no vis */
 	if ( numportals == 0 ) {
 		Sys_Printf( "No portals means no vis, exiting.\n" );
+
+		/* the pipeline ends here and the bsp stage left the writing to us */
+		if ( bspInMemory && !bspStageFollows ) {
+			Sys_Printf( "Writing %s\n", source );
+			WriteBSPFile( source );
+		}
 		return 0;
 	}
 
@@ -1223,6 +1400,11 @@ int VisMain( int argc, char **argv ){
 		remove( portalFilePath );
 	}
 
+	/* the light stage picks it up from memory */
+	if ( bspStageFollows && !saveIntermediate ) {
+		return 0;
+	}
+
 	/* write the bsp file */
 	Sys_Printf( "Writing %s\n", source );
 	WriteBSPFile( source );
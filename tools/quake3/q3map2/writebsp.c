@@ -410,6 +410,14 @@ void EndBSPFile( qboolean do_write, const char *BSPFilePath, const char *surface
 	UnparseEntities();
 
 	if ( do_write ) {
+		/* the next stage of the pipeline takes it all from memory */
+		if ( bspInMemory ) {
+			ConformBSPData();
+			if ( bspStageFollows && !saveIntermediate ) {
+				return;
+			}
+		}
+
 		/* write the surface extra file */
 		WriteSurfaceExtraFile( surfaceFilePath );
 